@@ -1,2 +1,8 @@
 glslc shaders/vert.vert -o build/shaders/vert.spv
-glslc shaders/frag.frag -o build/shaders/frag.spv
\ No newline at end of file
+glslc shaders/frag.frag -o build/shaders/frag.spv
+glslc shaders/frag_bindless.frag -o build/shaders/frag_bindless.spv
+glslc shaders/particles.comp -o build/shaders/particles.spv
+glslc shaders/skinning.comp -o build/shaders/skinning.spv
+glslc shaders/hiz_reduce.comp -o build/shaders/hiz_reduce.spv
+glslc -DMULTISAMPLED shaders/hiz_reduce.comp -o build/shaders/hiz_reduce_ms.spv
+glslc shaders/cull.comp -o build/shaders/cull.spv
\ No newline at end of file
@@ -0,0 +1,368 @@
+#include "package.hpp"
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include "archive.hpp"
+#include "gltf.hpp"
+#include "gltfscene.hpp"
+#include "hotreload.hpp"
+#include "imagedecoder.hpp"
+#include "jobsystem.hpp"
+#include "pixelformat.hpp"
+#include "tree.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+    domk-cook <output-dir> <inputs...>
+    domk-cook --archive <file> [--compress lz4|zstd] <files...>
+
+    Turns source assets into the packages the runtime maps without parsing:
+    .obj/.gltf/.glb -> .dmesh, images -> .dtex with the full mip chain, GLSL -> .spv.
+    Every input is one job on the JobSystem, outputs are named after the input's stem. Inputs that would
+    cook to the same output fail instead of overwriting each other.
+
+    --archive packs files into one AssetArchive under the paths given, which are the paths the
+    runtime asks for, so run it from the directory DOMK runs in.
+*/
+
+namespace std {
+    template<> struct hash<package::Vertex> {
+        size_t operator()(package::Vertex const& vertex) const {
+            return ((hash<glm::vec3>()(vertex.pos) ^
+                (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
+                (hash<glm::vec2>()(vertex.tex_coord) << 1);
+        }
+    };
+}
+
+namespace {
+    struct Result{
+        std::string output;
+        size_t input_bytes = 0;
+        size_t output_bytes = 0;
+        double milliseconds = 0.0;
+        std::string error;
+    };
+
+    /*
+        Renumbers a draw's vertices in the order its indices first use them, so the vertex fetch walks
+        memory forwards instead of jumping around the buffer. Vertices no index uses are dropped.
+        Returns the new vertex count; indices stay local to the range.
+    */
+    uint32_t optimizeVertexFetch(package::Vertex* vertices, uint32_t vertex_count, uint32_t* indices, uint32_t index_count){
+        std::vector<uint32_t> remap(vertex_count, UINT32_MAX);
+        std::vector<package::Vertex> ordered;
+        ordered.reserve(vertex_count);
+
+        for(uint32_t i = 0; i < index_count; i++){
+            uint32_t& slot = remap[indices[i]];
+            if(slot == UINT32_MAX){
+                slot = static_cast<uint32_t>(ordered.size());
+                ordered.push_back(vertices[indices[i]]);
+            }
+            indices[i] = slot;
+        }
+
+        std::copy(ordered.begin(), ordered.end(), vertices);
+        return static_cast<uint32_t>(ordered.size());
+    }
+
+    void cookObj(const std::string& path, const std::string& output){
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string err;
+        std::string warn;
+
+        if(!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str())){
+            throw std::runtime_error(err);
+        }
+
+        //same conversion and deduplication as Application::loadObj
+        std::vector<package::Vertex> vertices;
+        std::vector<uint32_t> indices;
+        std::unordered_map<package::Vertex, uint32_t> unique_vert{};
+        for(const tinyobj::shape_t& shape : shapes){
+            for(const tinyobj::index_t& index : shape.mesh.indices){
+                package::Vertex v{};
+                v.pos = {
+                    attrib.vertices[3*index.vertex_index + 0],
+                    attrib.vertices[3*index.vertex_index + 1],
+                    attrib.vertices[3*index.vertex_index + 2]
+                };
+                if(index.texcoord_index >= 0){
+                    v.tex_coord = {
+                        attrib.texcoords[2*index.texcoord_index + 0],
+                        1.0f - attrib.texcoords[2*index.texcoord_index + 1]
+                    };
+                }
+                v.color = {1.0f, 1.0f, 1.0f};
+
+                auto [it, inserted] = unique_vert.try_emplace(v, static_cast<uint32_t>(vertices.size()));
+                if(inserted){
+                    vertices.push_back(v);
+                }
+                indices.push_back(it->second);
+            }
+        }
+
+        vertices.resize(optimizeVertexFetch(vertices.data(), static_cast<uint32_t>(vertices.size()),
+            indices.data(), static_cast<uint32_t>(indices.size())));
+
+        package::MeshDraw draw{};
+        const glm::mat4 identity(1.0f);
+        std::copy(glm::value_ptr(identity), glm::value_ptr(identity) + 16, draw.transform);
+        draw.index_count = static_cast<uint32_t>(indices.size());
+        draw.material = UINT32_MAX;
+
+        package::writeMesh(output, std::span(&draw, 1), vertices, indices);
+    }
+
+    //Flattens the node hierarchy into draws like Application::importGltf. Materials aren't packaged.
+    void cookGltf(const std::string& path, const std::string& output){
+        GltfAsset asset(path);
+        GltfScene scene(asset);
+
+        std::vector<package::Vertex> vertices(scene.vertexCount());
+        std::vector<uint32_t> indices(scene.indexCount());
+        GltfScene::VertexLayout layout{};
+        layout.stride = sizeof(package::Vertex) / sizeof(float);
+        layout.position_offset = offsetof(package::Vertex, pos) / sizeof(float);
+        layout.color_offset = offsetof(package::Vertex, color) / sizeof(float);
+        layout.uv_offset = offsetof(package::Vertex, tex_coord) / sizeof(float);
+        scene.writeVertices(reinterpret_cast<float*>(vertices.data()), layout);
+        scene.writeIndices(indices.data());
+
+        //primitives keep their vertex range, unused slots at its end are left as they are
+        for(const GltfScene::Primitive& primitive : scene.primitives()){
+            optimizeVertexFetch(vertices.data() + primitive.vertex_offset, primitive.vertex_count,
+                indices.data() + primitive.first_index, primitive.index_count);
+        }
+
+        //glTF is Y up, the scene is Z up
+        Tree tree;
+        Object* file_root = tree.create_object();
+        file_root->set_transform(glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f)));
+        scene.buildTree(tree, file_root);
+
+        const std::vector<GltfScene::Mesh>& meshes = scene.meshes();
+        const std::vector<GltfScene::Primitive>& primitives = scene.primitives();
+        std::vector<package::MeshDraw> draws;
+
+        std::vector<Object*> pending = {tree.get_root()};
+        while(!pending.empty()){
+            Object* object = pending.back();
+            pending.pop_back();
+            for(Object* child : object->get_children()){
+                pending.push_back(child);
+            }
+
+            int32_t mesh = object->get_mesh();
+            if(mesh < 0 || static_cast<size_t>(mesh) >= meshes.size()){
+                continue;
+            }
+            glm::mat4 world = object->get_world_transform();
+            for(uint32_t i = 0; i < meshes[mesh].primitive_count; i++){
+                const GltfScene::Primitive& primitive = primitives[meshes[mesh].first_primitive + i];
+
+                package::MeshDraw draw{};
+                std::copy(glm::value_ptr(world), glm::value_ptr(world) + 16, draw.transform);
+                draw.first_index = primitive.first_index;
+                draw.index_count = primitive.index_count;
+                draw.vertex_offset = primitive.vertex_offset;
+                draw.material = UINT32_MAX;
+                draws.push_back(draw);
+            }
+        }
+
+        package::writeMesh(output, draws, vertices, indices);
+    }
+
+    //RGBA8 with every mip built here, the runtime copies it instead of decoding and filtering
+    void cookTexture(const std::string& path, const std::string& output){
+        MappedFile file(path);
+        ImageDecoder::Image image{};
+        image.path = path;
+        if(!ImageDecoder::probe(file.bytes(), image)){
+            throw std::runtime_error("Can't decode " + path + ".");
+        }
+
+        std::vector<size_t> mip_offsets;
+        std::vector<uint8_t> pixels(package::mipLayout(image.width, image.height, mip_offsets));
+        ImageDecoder::decodeInto(file.bytes(), image, pixels.data(), false);
+        for(uint32_t mip = 1; mip < mip_offsets.size(); mip++){
+            pixelformat::downsampleRgba(pixels.data() + mip_offsets[mip - 1],
+                std::max(image.width >> (mip - 1), 1u), std::max(image.height >> (mip - 1), 1u),
+                pixels.data() + mip_offsets[mip]);
+        }
+
+        package::writeTexture(output, image.width, image.height, static_cast<uint32_t>(mip_offsets.size()), pixels);
+    }
+
+    //output path for an input, empty if the extension isn't cooked
+    std::string outputPath(const std::string& output_dir, const std::string& input){
+        std::filesystem::path path(input);
+        std::string extension = path.extension().string();
+        std::string cooked;
+        if(extension == ".obj" || extension == ".gltf" || extension == ".glb"){
+            cooked = ".dmesh";
+        } else if(extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp"){
+            cooked = ".dtex";
+        } else if(extension == ".vert" || extension == ".frag" || extension == ".comp"){
+            cooked = ".spv";
+        } else {
+            return {};
+        }
+        return (std::filesystem::path(output_dir) / path.stem()).string() + cooked;
+    }
+
+    void cook(const std::string& input, const std::string& output){
+        std::string extension = std::filesystem::path(input).extension().string();
+        if(extension == ".obj"){
+            cookObj(input, output);
+        } else if(extension == ".gltf" || extension == ".glb"){
+            cookGltf(input, output);
+        } else if(output.ends_with(".spv")){
+            HotReload::compileGlsl(input, output);
+        } else {
+            cookTexture(input, output);
+        }
+    }
+
+    int packArchive(const std::string& path, AssetArchive::Compression compression, const std::vector<std::string>& files){
+        std::vector<AssetArchive::Source> sources;
+        size_t input_bytes = 0;
+        for(const std::string& file : files){
+            sources.push_back({file, file});
+            input_bytes += std::filesystem::file_size(file);
+        }
+
+        JobSystem jobs;
+        auto start = std::chrono::steady_clock::now();
+        AssetArchive::write(path, sources, compression, jobs);
+        double write_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        //read it back the way the runtime does, for the decompression throughput
+        AssetArchive archive(path);
+        archive.unpack(jobs);
+        const AssetArchive::Stats& stats = archive.stats();
+        std::printf("Packed %zu files (%zu bytes) into %s (%zu bytes) in %.2f ms.\n", files.size(), input_bytes,
+            path.c_str(), static_cast<size_t>(std::filesystem::file_size(path)), write_ms);
+        std::printf("%zu compressed entries unpack in %.2f ms (%.1f MiB/s read).\n", stats.unpacked_entries,
+            stats.seconds * 1000.0, stats.seconds > 0.0 ? stats.read_bytes / (1024.0 * 1024.0) / stats.seconds : 0.0);
+        return EXIT_SUCCESS;
+    }
+}
+
+int main(int argc, char** argv){
+    if(argc >= 3 && std::string(argv[1]) == "--archive"){
+        std::string path = argv[2];
+        AssetArchive::Compression compression = AssetArchive::Compression::None;
+        int first = 3;
+        if(argc >= 5 && std::string(argv[3]) == "--compress"){
+            std::string codec = argv[4];
+            if(codec == "lz4"){
+                compression = AssetArchive::Compression::Lz4;
+            } else if(codec == "zstd"){
+                compression = AssetArchive::Compression::Zstd;
+            } else {
+                std::cerr << "Unknown codec " << codec << ", use lz4 or zstd." << std::endl;
+                return EXIT_FAILURE;
+            }
+            first = 5;
+        }
+        try {
+            return packArchive(path, compression, std::vector<std::string>(argv + first, argv + argc));
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(argc < 3){
+        std::cerr << "Usage: domk-cook <output-dir> <inputs...>" << std::endl;
+        std::cerr << "       domk-cook --archive <file> [--compress lz4|zstd] <files...>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string output_dir = argv[1];
+    std::vector<std::string> inputs(argv + 2, argv + argc);
+    std::filesystem::create_directories(output_dir);
+
+    std::vector<Result> results(inputs.size());
+    //outputs are named by the source stem, which the runtime looks them up by, so two inputs cooking to the
+    //same file (x.vert and x.frag, or same-named assets in different directories) are both refused
+    std::unordered_map<std::string, size_t> claimed;
+    for(size_t i = 0; i < inputs.size(); i++){
+        results[i].output = outputPath(output_dir, inputs[i]);
+        if(results[i].output.empty()){
+            continue;
+        }
+        auto [it, inserted] = claimed.try_emplace(std::filesystem::path(results[i].output).lexically_normal().string(), i);
+        if(!inserted){
+            results[i].error = "output " + results[i].output + " collides with " + inputs[it->second];
+            if(results[it->second].error.empty()){
+                results[it->second].error = "output " + results[i].output + " collides with " + inputs[i];
+            }
+        }
+    }
+
+    JobSystem jobs;
+    auto start = std::chrono::steady_clock::now();
+    jobs.parallelFor(static_cast<uint32_t>(inputs.size()), [&inputs, &results](uint32_t i){
+        Result& result = results[i];
+        if(result.output.empty()){
+            result.error = "unknown asset type";
+            return;
+        }
+        if(!result.error.empty()){
+            return;
+        }
+
+        auto asset_start = std::chrono::steady_clock::now();
+        try {
+            result.input_bytes = std::filesystem::file_size(inputs[i]);
+            cook(inputs[i], result.output);
+            result.output_bytes = std::filesystem::file_size(result.output);
+        } catch (const std::exception& e) {
+            result.error = e.what();
+        }
+        result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - asset_start).count();
+    });
+    double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    size_t failed = 0;
+    double serial_ms = 0.0;
+    for(size_t i = 0; i < inputs.size(); i++){
+        const Result& result = results[i];
+        serial_ms += result.milliseconds;
+        if(!result.error.empty()){
+            std::printf("FAILED %s: %s\n", inputs[i].c_str(), result.error.c_str());
+            failed++;
+            continue;
+        }
+        std::printf("%8.2f ms  %s -> %s (%zu -> %zu bytes)\n", result.milliseconds, inputs[i].c_str(),
+            result.output.c_str(), result.input_bytes, result.output_bytes);
+    }
+    std::printf("Cooked %zu of %zu assets in %.2f ms on %u threads (%.2f ms of work).\n",
+        inputs.size() - failed, inputs.size(), total_ms, jobs.workerCount() + 1, serial_ms);
+
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
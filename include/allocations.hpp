@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+
+/*
+    With DOMK_COUNT_ALLOCATIONS, src/allocations.cpp replaces the global operator new and counts its calls
+    on every thread, so a path meant not to touch the heap can be checked by comparing count() before and
+    after it. What calls malloc itself, like ImGui and the Vulkan driver, isn't seen. Counting is a relaxed
+    atomic add on every allocation of the process, builds have it unless configured without, count() stays 0 then.
+*/
+namespace allocations{
+    //the build replaced operator new
+    bool counted();
+    uint64_t count();
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "gltf.hpp"
+
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Local transform of one joint. The rotation is a unit quaternion stored x, y, z, w like glTF.
+struct JointPose{
+    glm::vec4 translation;
+    glm::vec4 rotation;
+    glm::vec4 scale;
+};
+
+struct Skeleton{
+    //parent joint of each joint, -1 for roots. Indices follow the skin's joint list, like JOINTS_0.
+    std::vector<int32_t> parents;
+    //evaluation order, every parent comes before its children
+    std::vector<uint32_t> order;
+    std::vector<glm::mat4> inverse_bind;
+    //rest transform of the non-joint nodes above a root joint, identity for the other joints
+    std::vector<glm::mat4> root_transforms;
+    std::vector<JointPose> rest_pose;
+
+    size_t jointCount() const;
+};
+
+struct AnimationTrack{
+    std::vector<float> times;
+    std::vector<glm::vec4> values;
+    bool step = false;
+};
+
+struct AnimationClip{
+    enum Path : uint32_t{ Translation, Rotation, Scale, PATH_COUNT };
+
+    std::string name;
+    float duration = 0.0f;
+    //joint * PATH_COUNT + path, an empty track keeps the rest pose
+    std::vector<AnimationTrack> tracks;
+};
+
+//Mirrors the std430 SkinnedVertex struct in skinning.comp
+struct SkinnedVertex{
+    float position[3];
+    float u;
+    float color[3];
+    float v;
+    uint32_t joints[4];
+    float weights[4];
+};
+
+//The first skinned mesh of a glTF asset with its skeleton and every animation that targets it.
+struct SkinnedModel{
+    Skeleton skeleton;
+    std::vector<AnimationClip> clips;
+    std::vector<SkinnedVertex> vertices;
+    std::vector<uint32_t> indices;
+    glm::vec3 bounds_min = glm::vec3(0.0f);
+    glm::vec3 bounds_max = glm::vec3(0.0f);
+
+    static SkinnedModel load(const GltfAsset& asset);
+};
+
+/*
+    Keyframe sampling, blending and palette building. Every joint channel is one 4-wide vector, so the
+    interpolation kernels run as single SSE (x86) or NEON (ARM) operations with a scalar fallback.
+*/
+namespace animation{
+    //Samples every joint of clip at time (wrapped to the clip's duration) into out, one pose per joint.
+    void samplePose(const Skeleton& skeleton, const AnimationClip& clip, float time, JointPose* out);
+
+    //out = lerp(a, b, weight) per joint, rotations are nlerp'd along the shortest arc. out may alias a or b.
+    void blendPoses(const JointPose* a, const JointPose* b, float weight, size_t count, JointPose* out);
+
+    //Skinning matrices (model space * inverse bind). model is scratch space of one matrix per joint.
+    void buildPalette(const Skeleton& skeleton, const JointPose* pose, glm::mat4* model, glm::mat4* palette);
+
+    void lerp4(const float* a, const float* b, float t, float* out);
+    void nlerp4(const float* a, const float* b, float t, float* out);
+}
@@ -13,14 +13,81 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <array>
+#include <chrono>
 #include <stb_image.h>
 
 #include <imgui.h>
 #include <backends/imgui_impl_vulkan.h>
 #include <backends/imgui_impl_glfw.h>
 
+#include "rendergraph.hpp"
+#include "file.hpp"
+#include "texturestreamer.hpp"
+#include "jobsystem.hpp"
+#include "imagedecoder.hpp"
+#include "asynccompute.hpp"
+#include "skinning.hpp"
+#include "gltfscene.hpp"
+#include "tree.hpp"
+#include "hotreload.hpp"
+#include "package.hpp"
+#include "archive.hpp"
+#include "occlusion.hpp"
+#include "softocclusion.hpp"
+#include "geometrypool.hpp"
+#include "drawlist.hpp"
+#include "framearena.hpp"
+#include "deviceinfo.hpp"
+#include "immediatecommands.hpp"
+#include "resourcetracker.hpp"
+#include "deletionqueue.hpp"
+
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <source_location>
+#include <span>
+
 class Application{
 public:
+    //Command line switches, parsed in main.
+    struct Options{
+        bool benchmark_msaa = false;
+        uint32_t texture_budget_mb = 0;
+        std::string benchmark_decode_dir;
+        //the same model as glTF and OBJ, their parse times are compared
+        std::string benchmark_import_gltf;
+        std::string benchmark_import_obj;
+        //.obj, .gltf, .glb or a cooked .dmesh, replaces the default model
+        std::string model;
+        //asset archive packed by domk-cook; shaders, the texture and a .dmesh model are read from it when it has them
+        std::string archive;
+        //watch shaders, textures and the model and swap in changes while running
+        bool hot_reload = false;
+        //GLSL sources, relative to the working directory like the compiled shaders/*.spv
+        std::string shader_source_dir = "../shaders";
+        //index or part of the name of the device to use, overrides scoring
+        std::string device;
+        //glTF file with a skinned mesh, drawn as a crowd of animated characters
+        std::string skinned_model;
+        uint32_t characters = 64;
+        //two-phase Hi-Z culling of the scene draws, needs dynamic rendering
+        bool occlusion_culling = true;
+        //rasterize occluders on the CPU instead, used anyway when the Hi-Z passes aren't available or the device is a CPU
+        bool software_occlusion = false;
+        bool benchmark_occlusion = false;
+        bool benchmark_sort = false;
+        //count heap allocations of whole frames once warmed up and report them, steady frames should have none.
+        //The run exits with a failure when any did. Needs DOMK_COUNT_ALLOCATIONS, which builds have by default.
+        bool count_allocations = false;
+        //stage geometry uploads even where device local memory is host visible
+        bool staged_uploads = false;
+        bool benchmark_upload = false;
+    };
+
+    explicit Application(const Options& launch_options = {});
+
     void run();
     
     struct Vertex{
@@ -39,10 +106,30 @@ private:
         std::optional<uint32_t> graphics;
         std::optional<uint32_t> present;
         std::optional<uint32_t> transfer;
+        //family with compute but no graphics, for async compute; optional
+        std::optional<uint32_t> compute;
 
         bool isComplete() const;
     };
 
+    //What a Physical Device offers, scored by pickPhysicalDevice and then used to enable the fast paths.
+    struct DeviceCapabilities{
+        VkPhysicalDeviceProperties properties{};
+        VkDeviceSize device_local_bytes = 0;
+        bool dedicated_transfer = false;
+        bool async_compute = false;
+        bool present_on_graphics = false;
+        bool dynamic_rendering = false;
+        bool bindless = false;
+        bool timeline_semaphores = false;
+        bool memory_budget = false;
+        //RG32F storage images, which the Hi-Z pyramid needs
+        bool extended_storage_formats = false;
+        //several draws per indirect call, and indirect draws with a first instance other than 0
+        bool multi_draw_indirect = false;
+        bool indirect_first_instance = false;
+    };
+
     struct SwapChainSupportDetails{
         VkSurfaceCapabilitiesKHR capabilities;
         std::vector<VkPresentModeKHR> present_modes;
@@ -59,6 +146,7 @@ private:
         VkSharingMode sharing_mode;
         uint32_t* indices;
         uint32_t family_count;
+        const char* tag = "buffer";
     };
 
     struct ImageCreateInfo{
@@ -74,41 +162,128 @@ private:
         VkImage* image;
         VkDeviceMemory* memory;
         VkMemoryPropertyFlags mem_props = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        VkMemoryPropertyFlags fallback_mem_props = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        const char* tag = "image";
     };
 
-    struct UniformBufferObject{
-        glm::mat4 model;
+    //Sweeps the sample counts and reports the average frame time of each.
+    struct MsaaBenchmark{
+        std::vector<VkSampleCountFlagBits> counts;
+        size_t current = 0;
+        uint32_t frame = 0;
+        std::chrono::steady_clock::time_point start;
+        std::vector<double> frame_ms;
+    };
+
+    //Heap allocations counted over the frames after warmup, and how many of the frames had any.
+    struct AllocationCheck{
+        uint32_t frame = 0;
+        uint64_t allocations = 0;
+        uint32_t allocating_frames = 0;
+    };
+
+    //Smoothed GPU time of a frame's graphics work and of the compute work running next to it
+    struct ComputeTiming{
+        double graphics_ms = 0.0;
+        double compute_ms = 0.0;
+        double overlap_ms = 0.0;
+    };
+
+    //Mirrors the push constants of particles.comp
+    struct ParticleStep{
+        float dt;
+        float time;
+        uint32_t count;
+    };
+
+    //Per-view data, one slice per frame in flight in the dynamic uniform ring
+    struct ViewUniforms{
         glm::mat4 view;
         glm::mat4 proj;
     };
 
+    //Mirrors the std430 Material struct in frag_bindless.frag
+    struct Material{
+        glm::vec4 base_color;
+        uint32_t albedo;
+        uint32_t pad[3];
+    };
+
+    //Per-draw data, mirrors the std430 DrawData of vert.vert. Draws find theirs at gl_InstanceIndex.
+    struct DrawData{
+        glm::mat4 model;
+        uint32_t material;
+        uint32_t pad[3];
+    };
+
+    //One indexed draw of the loaded model, flattened from the object tree at load
+    struct SceneDraw{
+        glm::mat4 transform;
+        uint32_t first_index;
+        uint32_t index_count;
+        int32_t vertex_offset;
+        //material of the imported file, UINT32_MAX for the default one
+        uint32_t material;
+        //model space box of the vertices the draw uses
+        glm::vec3 bounds_min;
+        glm::vec3 bounds_max;
+    };
+
+    //Sort key pass of a draw, the skinned characters read other vertex buffers and skip the late culling pass
+    enum class DrawPass : uint32_t{
+        Scene,
+        Skinned
+    };
+
+    //Sorted draws sharing a pass and pipeline, recorded without binding anything in between
+    struct DrawBatch{
+        uint32_t pass;
+        uint32_t pipeline;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    //A parsed model before it is uploaded. glTF and cooked geometry stays in the mapped file until then.
+    struct ModelData{
+        Tree tree;
+        std::vector<SceneDraw> draws;
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        std::unique_ptr<GltfAsset> gltf_asset;
+        std::unique_ptr<GltfScene> gltf_scene;
+        std::unique_ptr<package::Mesh> mesh_package;
+    };
+
     static void framebufferResizeCallback(GLFWwindow* window, int new_width, int new_height);
     
     static void check_vk_result(VkResult result);
-    static std::vector<char> readFile(const std::string& file_name);
-    void createBuffer(BufferCreateInfo *create_info);
-    void copyBuffer(VkBuffer srcb, VkBuffer dstb, VkDeviceSize size);
-    void createImage(ImageCreateInfo *create_info);
-    void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout);
-    VkCommandBuffer beginSingleTimeCommands();
-    void endSingleTimeCommands(VkCommandBuffer buffer);
-    void copyBufferImage(VkBuffer srcbuffer, VkImage fromimage, uint32_t width, uint32_t height);
+    //both track what they create under create_info->tag, at the caller's line
+    void createBuffer(BufferCreateInfo *create_info, std::source_location where = std::source_location::current());
+    void submitTransfer(const std::function<void(VkCommandBuffer)>& record);
+    void createImage(ImageCreateInfo *create_info, std::source_location where = std::source_location::current());
     VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspects);
 
     void initWindow();
     void initVulkan();
+    void endStartupPhase(const char* name);
+    void printStartupTimes() const;
     bool checkValidationLayerSupport() const;
     std::vector<const char*> getRequiredExtensions() const;
     void createInstance();
     void createSurface();
     void pickPhysicalDevice();
-    bool isDeviceSuitable(VkPhysicalDevice target, VkPhysicalDeviceFeatures& features, VkPhysicalDeviceProperties& properties) const;
-    bool checkDeviceExtensionsSupported(VkPhysicalDevice target) const;
-    QueueFamilyIndices findQueueFamilies(VkPhysicalDevice target) const;
+    bool isDeviceSuitable(const DeviceInfo& info) const;
+    bool checkDeviceExtensionsSupported(const DeviceInfo& info) const;
+    bool checkDynamicRenderingSupport(const DeviceInfo& info) const;
+    bool checkBindlessSupport(const DeviceInfo& info) const;
+    bool checkTimelineSemaphoreSupport(const DeviceInfo& info) const;
+    DeviceCapabilities queryCapabilities(const DeviceInfo& info) const;
+    static int64_t scoreDevice(const DeviceCapabilities& caps);
+    QueueFamilyIndices findQueueFamilies(const DeviceInfo& info) const;
     void createLogicalDevice();
     void createSwapChain();
     SwapChainSupportDetails querySwapchainSupport(VkPhysicalDevice target) const;
-    static VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR>& available_modes);
+    static VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR>& available_modes, bool uncapped);
     static VkSurfaceFormatKHR chooseFormat(const std::vector<VkSurfaceFormatKHR>& available_formats);
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
     void createImageViews();
@@ -118,20 +293,77 @@ private:
     void createDescriptorSetLayout();
     void createGraphicsPipeline();
     VkShaderModule createShaderModule(const std::string& path);
+    std::vector<VkShaderModule> createShaderModules(std::initializer_list<std::string> paths);
+    VkShaderModule createShaderModule(std::span<const std::byte> code);
     void createFrameBuffers();
     void createDepthResources();
+    void createColorResources();
+    void applyMsaaSamples();
+    bool stepMsaaBenchmark();
+    bool stepAllocationCheck(uint64_t allocated);
+    void benchmarkDecode();
+    void benchmarkImport();
+    void benchmarkOcclusion();
+    void benchmarkSort();
+    void benchmarkUpload();
     void createTextureImage();
     void createTextureImageView();
     void createTextureSampler();
+    void openArchive();
+    std::span<const std::byte> archivedAsset(const std::string& path) const;
     void loadModel();
-    void createVertexBuffer();
-    void createIndexBuffer();
+    std::string modelPath() const;
+    static ModelData importModel(const std::string& path);
+    static void importGltf(const std::string& path, ModelData& model);
+    static void importPackage(std::unique_ptr<package::Mesh> mesh, const std::string& path, ModelData& model);
+    void adoptModel(ModelData model);
+    static void loadObj(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+    static void computeBounds(std::span<const Vertex> vertices, std::span<const uint32_t> indices, SceneDraw& draw);
+    void createSceneMaterials();
+    void createPipelineCache();
+    VkPipeline buildGraphicsPipeline(VkShaderModule vert, VkShaderModule frag);
+    std::string fragmentShaderPath() const;
+    void setupHotReload();
+    void swapModel(ModelData model);
+    void retireResource(DeletionQueue::Destroy destroy);
+    GeometryPool::Context geometryPoolContext(bool direct);
+    void createGeometryPool();
+    void uploadModel();
+    uint32_t addModel(GeometryPool& pool);
     void createUniformBuffers();
+    void reserveDraws(uint32_t count);
+    uint32_t sceneMaterial(const SceneDraw& draw) const;
+    void sortDraws();
+    void writeDraws();
     void createDescriptorPool();
     void createDescriptorSets();
+    void createBindlessSetLayout();
+    void createBindlessSet();
+    void createTextureStreamer();
+    void createAsyncCompute();
+    void createParticleStage();
+    void recordParticles(VkCommandBuffer buffer, uint64_t frame);
+    void sampleComputeTiming();
+    void createSkinning();
+    void createOcclusionCuller();
+    void updateOcclusion();
+    void collectOccluders();
+    void updateSoftwareOcclusion();
+    uint32_t registerTexture(VkImageView view);
+    void releaseTexture(uint32_t slot);
+    uint32_t createMaterial(const Material& material);
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+    uint32_t findMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags properties);
     void createCommandPoolBuffer();
     void recordCommandBuffer(VkCommandBuffer buffer, uint32_t image_index);
+    void recordRenderPass(VkCommandBuffer buffer, uint32_t image_index);
+    void recordDynamicRendering(VkCommandBuffer buffer, uint32_t image_index);
+    void recordMeshDraws(VkCommandBuffer buffer, std::optional<OcclusionCuller::Phase> culled = std::nullopt);
+    void recordDraws(VkCommandBuffer buffer, uint32_t first, uint32_t count);
+    void recordIndirect(VkCommandBuffer buffer, VkBuffer commands, VkDeviceSize offset, uint32_t count);
+    void recordImGui(VkCommandBuffer buffer);
+    void buildRenderGraph();
+    void loadDynamicRenderingFunctions();
     void createSyncObjects();
     void initImGUI();
     void setupImGuiStyle(bool dark, float alpha);
@@ -139,25 +371,41 @@ private:
     void imGuiLoop();
     void drawFrame();
     void updateUniformBuffer(uint32_t cur_image);
+    void setCamera(const glm::vec3& eye, const glm::vec3& target);
     void cleanUp();
 
     VkInstance instance = nullptr;
 
     VkPhysicalDevice p_device = VK_NULL_HANDLE;
+    DeviceCapabilities device_caps;
+    //queried once in pickPhysicalDevice, along with the families chosen from it
+    DeviceInfo device_info;
+    QueueFamilyIndices queue_families;
     VkDevice device = nullptr;
+    //every buffer, image and allocation, set up right after the device
+    ResourceTracker tracker;
     VkQueue graphics_queue = nullptr;
     VkQueue present_queue = nullptr;
     VkQueue transfer_queue = nullptr;
+    VkQueue compute_queue = nullptr;
 
-    VkBuffer vertex_buffer = nullptr;
-    VkDeviceMemory vertex_mem = nullptr;
-    VkBuffer index_buffer = nullptr;
-    VkDeviceMemory index_mem = nullptr;
+    //every loaded mesh shares these vertex and index buffers, the model is scene_mesh in them
+    GeometryPool geometry;
+    uint32_t scene_mesh = 0;
 
     VkImage depth_tex = nullptr;
     VkDeviceMemory depth_memory;
     VkImageView depth_view;
 
+    //multisampled color target of the render pass path, resolved into the swapchain image in-pass
+    VkImage color_tex = nullptr;
+    VkDeviceMemory color_memory = nullptr;
+    VkImageView color_view = nullptr;
+
+    VkSampleCountFlagBits max_msaa_samples = VK_SAMPLE_COUNT_1_BIT;
+    VkSampleCountFlagBits msaa_samples = VK_SAMPLE_COUNT_1_BIT;
+    VkSampleCountFlagBits requested_msaa_samples = VK_SAMPLE_COUNT_1_BIT;
+
     VkSampler tex_sampler = nullptr;
     VkImage tex_image = nullptr;
     VkDeviceMemory tex_mem = nullptr;
@@ -165,9 +413,42 @@ private:
     VkDeviceMemory staging_mem = nullptr;
     VkImageView tex_view = nullptr;
 
-    std::vector<VkBuffer> uniform_buffers;
-    std::vector<VkDeviceMemory> uniform_buffer_mems;
-    std::vector<void*> muniform_buffers;
+    //persistently mapped ring of ViewUniforms, bound with a per-frame dynamic offset
+    VkBuffer view_ring = nullptr;
+    VkDeviceMemory view_ring_mem = nullptr;
+    char* mview_ring = nullptr;
+    VkDeviceSize view_ring_stride = 0;
+    std::vector<uint64_t> view_ring_versions;
+
+    //this frame's draws in sorted order, a draw's position in it is its slot in the draw ring
+    DrawList draw_list;
+    std::vector<DrawBatch> draw_batches;
+    //key pipeline of the mesh pipeline, the only one draws use so far
+    const uint32_t MESH_PIPELINE = 0;
+
+    //per frame in flight, the DrawData of every draw followed by its indirect command, in draw_list order
+    VkBuffer draw_ring = nullptr;
+    VkDeviceMemory draw_ring_mem = nullptr;
+    char* mdraw_ring = nullptr;
+    VkDeviceSize draw_ring_stride = 0;
+    VkDeviceSize draw_commands_offset = 0;
+    uint32_t draw_capacity = 0;
+    //this frame's commands, drawn directly without indirect first instance, in the frame arena
+    std::span<VkDrawIndexedIndirectCommand> draw_commands;
+    bool multi_draw_indirect = false;
+    bool indirect_first_instance = false;
+    //draw calls recorded last frame, a multi-draw counts once, and pipeline and vertex buffer binds
+    uint32_t draw_calls = 0;
+    uint32_t state_binds = 0;
+
+    //camera inputs, view/proj are only rebuilt when camera_version moves
+    glm::vec3 camera_eye = glm::vec3(2.0f, 2.0f, 2.0f);
+    glm::vec3 camera_target = glm::vec3(0.0f, 0.0f, 0.0f);
+    glm::vec3 camera_up = glm::vec3(0.0f, 0.0f, 1.0f);
+    uint64_t camera_version = 1;
+    uint64_t view_version = 0;
+    ViewUniforms view_uniforms{};
+    glm::mat4 draw_model = glm::mat4(1.0f);
 
     VkSwapchainKHR swapchain = nullptr;
     std::vector<VkImage> sc_images;
@@ -177,9 +458,72 @@ private:
     std::vector<VkFramebuffer> sc_fb;
 
     VkRenderPass render_pass = nullptr;
+
+    //VK_KHR_dynamic_rendering + VK_KHR_synchronization2, core or extension. Replaces render_pass and sc_fb when available.
+    bool dynamic_rendering = false;
+    bool dynamic_rendering_ext = false;
+    PFN_vkCmdBeginRenderingKHR cmd_begin_rendering = nullptr;
+    PFN_vkCmdEndRenderingKHR cmd_end_rendering = nullptr;
+    PFN_vkCmdPipelineBarrier2KHR cmd_pipeline_barrier2 = nullptr;
+
+    //frame graph used on the dynamic rendering path, rebuilt with the swapchain
+    RenderGraph render_graph;
+    RenderGraph::ResourceId rg_backbuffer = 0;
     VkDescriptorSetLayout descriptor_set_layout;
     VkDescriptorPool dpool;
-    std::vector<VkDescriptorSet> dsets;
+    VkDescriptorSet dset = nullptr;
+
+    //bindless textures and materials (descriptor indexing), bound as set 1 once per command buffer
+    bool bindless = false;
+    bool bindless_ext = false;
+    uint32_t bindless_capacity = 0;
+    VkDescriptorSetLayout bindless_layout = nullptr;
+    VkDescriptorPool bindless_pool = nullptr;
+    VkDescriptorSet bindless_set = nullptr;
+    std::vector<uint32_t> free_texture_slots;
+    uint32_t next_texture_slot = 0;
+    VkBuffer material_buffer = nullptr;
+    VkDeviceMemory material_mem = nullptr;
+    Material* mmaterials = nullptr;
+    uint32_t material_count = 0;
+    uint32_t draw_material = 0;
+
+    //streams mips of bindless textures under a device memory budget, fed by the fragment shader
+    TextureStreamer texture_streamer;
+    bool memory_budget = false;
+
+    //compute stages run a frame ahead on the async compute queue, ordered against graphics by timeline semaphores
+    bool timeline_semaphores = false;
+    bool timeline_semaphores_ext = false;
+    AsyncCompute async_compute;
+    VkSemaphore graphics_timeline = nullptr;
+    uint64_t frame_number = 0;
+    uint64_t compute_frame = 0;
+    VkQueryPool frame_queries = nullptr;
+    double timestamp_period = 0.0;
+    uint64_t timestamp_mask = 0;
+    ComputeTiming compute_timing;
+
+    //demo compute stage
+    VkBuffer particle_buffer = nullptr;
+    VkDeviceMemory particle_mem = nullptr;
+    VkDescriptorSetLayout particle_layout = nullptr;
+    VkDescriptorPool particle_pool = nullptr;
+    VkDescriptorSet particle_set = nullptr;
+    VkPipelineLayout particle_pl_layout = nullptr;
+    VkPipeline particle_pipeline = nullptr;
+    std::chrono::steady_clock::time_point particle_clock;
+    float particle_time = 0.0f;
+
+    //skinned crowd, animated on the job threads and skinned by an async compute stage
+    SkinningSystem skinning;
+    bool skinning_enabled = false;
+    std::chrono::steady_clock::time_point skinning_clock;
+
+    //scene draws go through an early and a late pass, culled against the Hi-Z pyramid of the frame before
+    OcclusionCuller occlusion;
+    bool occlusion_culling = false;
+
     VkPipelineLayout pl_layout = nullptr;
     VkPipeline pipeline = nullptr;
 
@@ -192,8 +536,9 @@ private:
     VkCommandPool cmdp = nullptr;
     std::vector<VkCommandBuffer> cmdb;
     
-    //command pool transfer family
-    VkCommandPool cmdp_t = nullptr;
+    //one-off uploads outside the frame loop, batched into one submission each
+    ImmediateCommands immediate;
+    ImmediateCommands transfer_immediate;
 
     VkDebugUtilsMessengerEXT debug_messenger = nullptr;
 
@@ -205,9 +550,52 @@ private:
 
     VkDescriptorPool imm_dpool;
 
+    Options options;
+    JobSystem jobs;
+    //temporaries of drawFrame, reset once the slot's fence signalled
+    FrameArena frame_arena;
+
+    //without the Hi-Z passes, the biggest scene draws are rasterized on the job threads and the rest tested against them
+    SoftwareOcclusion soft_occlusion{jobs};
+    bool software_occlusion = false;
+    //scene draw of each occluder and its model matrix this frame
+    std::vector<uint32_t> occluder_draws;
+    std::vector<glm::mat4> occluder_models;
+    std::vector<SoftwareOcclusion::Box> occlusion_boxes;
+    //per scene draw, 0 when recordMeshDraws skips it
+    std::vector<uint8_t> draw_visible;
+    const uint32_t MAX_OCCLUDERS = 32;
+    const uint32_t MAX_OCCLUDER_TRIANGLES = 4096;
+
+    //initVulkan's steps with their milliseconds, device_info_ms of them spent querying every device
+    std::vector<std::pair<const char*, double>> startup_phases;
+    std::chrono::steady_clock::time_point phase_start;
+    double device_info_ms = 0.0;
+
+    MsaaBenchmark msaa_bench;
+    AllocationCheck allocation_check;
+    const uint32_t BENCH_WARMUP_FRAMES = 60;
+    const uint32_t BENCH_FRAMES = 300;
+    const size_t DECODE_BENCH_IMAGES = 32;
+    const size_t IMPORT_BENCH_RUNS = 10;
+    const size_t OCCLUSION_BENCH_RUNS = 20;
+    const uint32_t CITY_BLOCKS = 16;
+    const uint32_t CITY_PROPS_PER_BLOCK = 24;
+    const size_t SORT_BENCH_RUNS = 20;
+    const size_t UPLOAD_BENCH_RUNS = 10;
+
+    const uint32_t GEOMETRY_VERTICES = 1 << 18;
+    const uint32_t GEOMETRY_INDICES = 1 << 20;
+    const uint32_t MIN_DRAW_CAPACITY = 256;
+    //per frame in flight, grown when a frame needs more
+    const size_t FRAME_ARENA_BYTES = 256 * 1024;
+
     const uint16_t START_WIDTH = 640;
     const uint16_t START_HEIGHT = 360;
 
+    //the first of D32S8, D24S8 and D32 the device can render depth to
+    VkFormat depth_format = VK_FORMAT_D32_SFLOAT_S8_UINT;
+
     const char* tex_path = "textures/tex.png";
     const char* model_path = "models/suzanne.obj";
 
@@ -221,9 +609,35 @@ private:
 
     const uint32_t MAX_FLIGHT_FRAMES = 2;
 
+    const uint32_t MAX_BINDLESS_TEXTURES = 16384;
+    const uint32_t MAX_STREAMED_TEXTURES = 4096;
+    const uint32_t MAX_MATERIALS = 4096;
+    const uint32_t PARTICLE_COUNT = 1 << 18;
+
     std::vector<Vertex> vertexi;
     
     std::vector<uint32_t> indices;
 
+    //hierarchy of the loaded model. A glTF file or mesh package stays mapped until its buffers and images are uploaded.
+    Tree scene;
+    std::vector<SceneDraw> scene_draws;
+    std::vector<uint32_t> scene_materials;
+    std::unique_ptr<GltfAsset> gltf_asset;
+    std::unique_ptr<GltfScene> gltf_scene;
+    std::unique_ptr<package::Mesh> mesh_package;
+    //stays open for the whole run, assets read from it point into its mapping
+    std::unique_ptr<AssetArchive> archive;
+
+    //rebuilds run on the reload thread, pipeline_mutex keeps the MSAA switch and swapchain recreation from changing
+    //their inputs meanwhile
+    HotReload hot_reload;
+    //reused every frame by the overlay
+    std::string reload_error;
+    VkPipelineCache pipeline_cache = nullptr;
+    std::mutex pipeline_mutex;
+    uint64_t pipeline_generation = 0;
+    //keyed by frame_number, drained after the frame's fence wait
+    DeletionQueue deletion_queue;
+
     const char* WINDOW_TITLE = "Demonstration of my knowledge.";
 };
\ No newline at end of file
@@ -0,0 +1,104 @@
+#pragma once
+#include "file.hpp"
+#include "jobsystem.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+/*
+    Single-file asset archive, mapped once instead of opening every asset on its own.
+
+    Layout: Header, the table of contents sorted by asset id, a bucket table over the top id bits, the
+    entry names, then the entries, each starting on a page boundary. Asset ids are 64-bit FNV-1a hashes
+    of the normalized path, so a lookup hashes the path, reads one bucket and compares the one or two ids
+    in it. Stored entries are handed out straight from the mapping; compressed ones (LZ4 or zstd, when
+    the library was found at build time) are decompressed in parallel by unpack().
+*/
+class AssetArchive{
+public:
+    enum class Compression : uint32_t{
+        None = 0,
+        Lz4 = 1,
+        Zstd = 2
+    };
+
+    struct Source{
+        //the path the runtime asks for, relative to the working directory
+        std::string name;
+        std::string path;
+    };
+
+    struct Stats{
+        size_t entries = 0;
+        size_t unpacked_entries = 0;
+        //bytes read from the archive and what they decompressed to
+        uint64_t read_bytes = 0;
+        uint64_t unpacked_bytes = 0;
+        double seconds = 0.0;
+    };
+
+    explicit AssetArchive(const std::string& path);
+
+    AssetArchive(const AssetArchive&) = delete;
+    AssetArchive& operator=(const AssetArchive&) = delete;
+
+    //Decompresses every compressed entry, one job per entry. Stored entries are only mapped.
+    void unpack(JobSystem& jobs);
+
+    //Empty when the archive has no such asset. Compressed entries need unpack() first.
+    std::span<const std::byte> find(const std::string& name) const;
+    std::span<const std::byte> find(uint64_t id) const;
+
+    const Stats& stats() const;
+    size_t size() const;
+
+    static uint64_t assetId(const std::string& name);
+
+    //Packs sources into an archive at path, compressing them in parallel. Entries that don't shrink
+    //by at least an eighth are stored. Throws if two names hash to the same id.
+    static void write(const std::string& path, const std::vector<Source>& sources, Compression compression, JobSystem& jobs);
+    static bool supports(Compression compression);
+
+private:
+    struct Header{
+        uint32_t magic;
+        uint32_t version;
+        uint32_t page_size;
+        uint32_t bucket_bits;
+        uint64_t entry_count;
+        uint64_t toc_offset;
+        uint64_t buckets_offset;
+        uint64_t names_offset;
+        uint64_t names_size;
+    };
+
+    struct TocEntry{
+        uint64_t id;
+        uint64_t offset;
+        uint64_t stored_size;
+        uint64_t size;
+        Compression compression;
+        uint32_t name_offset;
+    };
+
+    const TocEntry* lookup(uint64_t id) const;
+
+    std::string source;
+    MappedFile file;
+    const Header* header = nullptr;
+    const TocEntry* toc = nullptr;
+    //bucket b holds entries [buckets[b], buckets[b + 1])
+    const uint32_t* buckets = nullptr;
+
+    std::vector<std::byte> unpacked;
+    //offset of each entry in unpacked, SIZE_MAX when it isn't there
+    std::vector<size_t> unpacked_offsets;
+    Stats statistics;
+
+    static const uint32_t MAGIC = 0x43524144;   //"DARC"
+    static const uint32_t VERSION = 1;
+    static const uint32_t PAGE_SIZE = 4096;
+};
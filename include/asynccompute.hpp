@@ -0,0 +1,83 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "deviceinfo.hpp"
+
+/*
+    Runs compute stages on their own queue, one frame ahead of graphics.
+    The dispatches of frame N signal the timeline semaphore with N + 1. Graphics of frame N waits for that
+    value, so the dispatches of frame N + 1 can already run next to it. Graphics hands buffers back through
+    its own timeline, which submit() waits on before the stages overwrite them.
+    Without a compute-only family the graphics queue is used: same dependencies, no overlap.
+*/
+class AsyncCompute{
+public:
+    struct Context{
+        VkDevice device = VK_NULL_HANDLE;
+        const DeviceInfo* device_info = nullptr;
+        VkQueue queue = VK_NULL_HANDLE;
+        uint32_t queue_family = 0;
+        //the queue isn't the graphics queue
+        bool dedicated = false;
+        //VK_KHR_timeline_semaphore entry points instead of the core 1.2 ones
+        bool timeline_ext = false;
+        uint32_t frames_in_flight = 1;
+    };
+
+    //GPU start and end of a frame's work, in nanoseconds
+    struct Interval{
+        double begin = 0.0;
+        double end = 0.0;
+    };
+
+    using RecordFn = std::function<void(VkCommandBuffer, uint64_t)>;
+
+    void setup(const Context& context);
+    void destroy();
+
+    //Stages are recorded in the order they were added, with a compute to compute barrier in front of each.
+    void addStage(const std::string& name, RecordFn record);
+
+    //Records and submits every stage for frame once wait_semaphore reaches wait_value. Returns the value graphics waits on.
+    uint64_t submit(uint64_t frame, VkSemaphore wait_semaphore, uint64_t wait_value);
+
+    void wait(uint64_t frame) const;
+    bool finished(uint64_t frame) const;
+
+    //False when frame hasn't finished, its slot was reused since or the queue can't write timestamps.
+    bool interval(uint64_t frame, Interval& out) const;
+
+    VkSemaphore timeline() const;
+    bool dedicated() const;
+    size_t stageCount() const;
+
+    //A timeline semaphore starting at 0. Graphics creates its own with this.
+    static VkSemaphore createTimeline(VkDevice device);
+
+private:
+    struct Stage{
+        std::string name;
+        RecordFn record;
+    };
+
+    Context ctx{};
+    std::vector<Stage> stages;
+
+    VkSemaphore timeline_semaphore = VK_NULL_HANDLE;
+    VkCommandPool pool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> buffers;
+    //frame last recorded into each slot, UINT64_MAX while unused
+    std::vector<uint64_t> slot_frames;
+
+    VkQueryPool queries = VK_NULL_HANDLE;
+    double timestamp_period = 0.0;
+    uint64_t timestamp_mask = 0;
+
+    PFN_vkWaitSemaphoresKHR wait_semaphores = nullptr;
+    PFN_vkGetSemaphoreCounterValueKHR get_counter_value = nullptr;
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+    Destroys what the GPU may still be using once it is done with it. Entries wait for a point on a counter
+    that only grows, a frame number or a timeline semaphore value, one queue per counter. A point lower than
+    one pushed before is raised to it, which only delays the entry and keeps the queue in order, so release()
+    looks at the front and costs nothing while nothing is due.
+    Entries live in a ring that only grows and their callables are stored in place, so once the ring is big
+    enough pushing and releasing never allocate.
+*/
+class DeletionQueue{
+public:
+    /*
+        A void() callable kept inside the entry rather than on the heap like std::function would for anything
+        but the smallest captures. A capture larger than CAPACITY bytes doesn't compile.
+    */
+    class Destroy{
+    public:
+        static constexpr size_t CAPACITY = 64;
+
+        Destroy() = default;
+
+        template<typename Function, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Function>, Destroy>>>
+        Destroy(Function&& function){
+            using Stored = std::decay_t<Function>;
+            static_assert(sizeof(Stored) <= CAPACITY, "Capture too large for a deletion queue entry.");
+            static_assert(alignof(Stored) <= alignof(std::max_align_t));
+            static_assert(std::is_nothrow_move_constructible_v<Stored>);
+            new (storage) Stored(std::forward<Function>(function));
+            ops = &OPS<Stored>;
+        }
+
+        Destroy(Destroy&& other) noexcept {
+            take(other);
+        }
+
+        Destroy& operator=(Destroy&& other) noexcept {
+            if(this != &other){
+                reset();
+                take(other);
+            }
+            return *this;
+        }
+
+        Destroy(const Destroy&) = delete;
+        Destroy& operator=(const Destroy&) = delete;
+
+        ~Destroy(){
+            reset();
+        }
+
+        void operator()(){
+            ops->call(storage);
+        }
+
+        explicit operator bool() const {
+            return ops != nullptr;
+        }
+
+    private:
+        struct Ops{
+            void (*call)(void*);
+            //move constructs into the first, then destroys the second
+            void (*relocate)(void*, void*);
+            void (*destroy)(void*);
+        };
+
+        template<typename Stored>
+        static constexpr Ops OPS{
+            [](void* self){ (*static_cast<Stored*>(self))(); },
+            [](void* target, void* source){
+                new (target) Stored(std::move(*static_cast<Stored*>(source)));
+                static_cast<Stored*>(source)->~Stored();
+            },
+            [](void* self){ static_cast<Stored*>(self)->~Stored(); }
+        };
+
+        void take(Destroy& other){
+            if(other.ops != nullptr){
+                other.ops->relocate(storage, other.storage);
+                ops = other.ops;
+                other.ops = nullptr;
+            }
+        }
+
+        void reset(){
+            if(ops != nullptr){
+                ops->destroy(storage);
+                ops = nullptr;
+            }
+        }
+
+        alignas(std::max_align_t) unsigned char storage[CAPACITY];
+        const Ops* ops = nullptr;
+    };
+
+    void push(uint64_t point, Destroy destroy);
+    //Runs the entries due by completed, oldest first, and returns how many ran. Entries they push wait for
+    //a later call even when they are due already.
+    size_t release(uint64_t completed);
+    //Runs everything, for when the device is idle.
+    void flush();
+    size_t size() const;
+
+private:
+    struct Entry{
+        uint64_t point = 0;
+        Destroy destroy;
+    };
+
+    Entry& at(size_t index);
+    void grow();
+
+    //a power of two in size, count entries from head on
+    std::vector<Entry> entries;
+    size_t head = 0;
+    size_t count = 0;
+    uint64_t last_point = 0;
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+/*
+    What a physical device reports that can't change while it runs, queried once by query(): properties
+    and limits, core features, memory types and heaps, queue families and which of them can present to
+    the surface, extensions and the format features of every core format. The features and properties of
+    the extensions the optional paths need come from one vkGetPhysicalDeviceFeatures2 and one
+    vkGetPhysicalDeviceProperties2 call. A structure stays zeroed when neither the device's core version
+    nor its extensions provide it, so its feature bits read as unsupported.
+    findMemoryType() answers from a table holding, for each combination of property flags, the mask of
+    memory types having all of them, so a lookup is an AND and a bit scan instead of a query and a loop.
+    Memory budgets do change and are still queried where they are used.
+*/
+class DeviceInfo{
+public:
+    void query(VkPhysicalDevice target, VkSurfaceKHR surface);
+
+    VkPhysicalDevice physicalDevice() const;
+    const VkPhysicalDeviceProperties& properties() const;
+    const VkPhysicalDeviceLimits& limits() const;
+    const VkPhysicalDeviceFeatures& features() const;
+    //core in 1.2 or VK_EXT_descriptor_indexing
+    const VkPhysicalDeviceDescriptorIndexingFeaturesEXT& descriptorIndexingFeatures() const;
+    const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& descriptorIndexingProperties() const;
+    //core in 1.2 or VK_KHR_timeline_semaphore
+    const VkPhysicalDeviceTimelineSemaphoreFeaturesKHR& timelineSemaphoreFeatures() const;
+    //core in 1.3 or VK_KHR_dynamic_rendering / VK_KHR_synchronization2
+    const VkPhysicalDeviceDynamicRenderingFeaturesKHR& dynamicRenderingFeatures() const;
+    const VkPhysicalDeviceSynchronization2FeaturesKHR& synchronization2Features() const;
+    const VkPhysicalDeviceMemoryProperties& memory() const;
+    const std::vector<VkQueueFamilyProperties>& queueFamilies() const;
+    bool canPresent(uint32_t family) const;
+    bool hasExtension(const char* name) const;
+
+    //Features of the format with linear or optimal tiling. Formats added by extensions are queried on the spot.
+    VkFormatFeatureFlags formatFeatures(VkFormat format, VkImageTiling tiling) const;
+    //the first candidate having all of required with tiling, VK_FORMAT_UNDEFINED if none does
+    VkFormat findFormat(std::initializer_list<VkFormat> candidates, VkImageTiling tiling, VkFormatFeatureFlags required) const;
+
+    //Lowest memory type in type_filter with all of properties, UINT32_MAX when there is none.
+    uint32_t findMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties) const;
+    //Lowest memory type in type_filter the CPU can write device local data into directly, UINT32_MAX when
+    //uploads have to be staged. See directUploadTypes().
+    uint32_t findDirectUploadType(uint32_t type_filter) const;
+    //Device local, host visible and coherent types on a heap as big as the biggest device local one: all of
+    //memory on UMA devices (integrated GPUs, lavapipe), all of VRAM behind resizable BAR. The 256 MiB BAR
+    //window of a discrete GPU without it doesn't count, it is too small to place resources in.
+    uint32_t directUploadTypes() const;
+
+    //how long query() took
+    double queryMs() const;
+
+private:
+    void queryExtensionFeatures();
+
+    //VK_FORMAT_UNDEFINED up to the last format of Vulkan 1.0, they are numbered without gaps
+    static const uint32_t CORE_FORMATS = VK_FORMAT_ASTC_12x12_SRGB_BLOCK + 1;
+    //property flag combinations with a table entry, up to VK_MEMORY_PROPERTY_DEVICE_UNCACHED_BIT_AMD
+    static const uint32_t MEMORY_FLAG_COMBINATIONS = 256;
+
+    VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties device_properties{};
+    VkPhysicalDeviceFeatures device_features{};
+    //pNext is cleared after the query, the chain would point into a moved-from DeviceInfo
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing_features{};
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexing_properties{};
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_features{};
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR rendering_features{};
+    VkPhysicalDeviceSynchronization2FeaturesKHR sync2_features{};
+    VkPhysicalDeviceMemoryProperties memory_properties{};
+    std::vector<VkQueueFamilyProperties> families;
+    std::vector<VkBool32> present_support;
+    //sorted, for binary search
+    std::vector<std::string> extensions;
+    std::vector<VkFormatProperties> formats;
+    //bit i set when memory type i has every flag of the index
+    std::array<uint32_t, MEMORY_FLAG_COMBINATIONS> types_with{};
+    uint32_t direct_upload_types = 0;
+    double query_ms = 0.0;
+};
@@ -0,0 +1,50 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+#include "jobsystem.hpp"
+
+/*
+    A frame's draws as 64-bit sort keys, so ordering them is one integer sort. From the most significant bits:
+    pass, pipeline, view depth, material, then the draw's own index, which keeps every key unique and tells
+    the recorder which draw it was. Depth ranks above material: materials are indices into the bindless
+    table and switching them binds nothing, while front to back order lets early depth testing reject
+    the hidden fragments of opaque draws.
+    sort() is an LSD radix sort, 8 bits per pass, with the key ranges split over the job threads.
+    Passes over a byte every key shares are skipped, which are most of them for a few thousand draws.
+    Its ping-pong buffer and histograms only live for the call and come from the memory resource given,
+    the frame arena when sorting a frame's draws.
+*/
+class DrawList{
+public:
+    static const uint32_t PASS_BITS = 2;
+    static const uint32_t PIPELINE_BITS = 6;
+    static const uint32_t DEPTH_BITS = 16;
+    static const uint32_t MATERIAL_BITS = 16;
+    static const uint32_t INDEX_BITS = 24;
+
+    //depth is the distance along the view direction, negative values sort as 0. Fields are masked to their bits.
+    static uint64_t makeKey(uint32_t pass, uint32_t pipeline, float depth, uint32_t material, uint32_t index);
+    static uint32_t pass(uint64_t key);
+    static uint32_t pipeline(uint64_t key);
+    static uint32_t index(uint64_t key);
+
+    void clear();
+    void add(uint64_t key);
+    size_t size() const;
+
+    //Ascending. Without jobs, or for short lists, it runs on the calling thread.
+    void sort(JobSystem* jobs, std::pmr::memory_resource* scratch_memory = std::pmr::get_default_resource());
+    std::span<const uint64_t> keys() const;
+    //the keys to fill directly, for benchmarking
+    std::vector<uint64_t>& data();
+
+private:
+    //below this many keys per job, splitting costs more than it saves
+    static const uint32_t MIN_CHUNK_KEYS = 4096;
+
+    std::vector<uint64_t> packed;
+};
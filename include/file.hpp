@@ -0,0 +1,85 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+/*
+    Read-only memory mapping of a whole file.
+    The bytes stay valid for the lifetime of the object, so shader code and binary blobs
+    can be handed to Vulkan or memcpy'd into staging memory without a heap copy in between.
+*/
+class MappedFile{
+public:
+    //Translated to madvise hints where the platform has them.
+    enum class Access{
+        Sequential,
+        Random,
+        WillNeed
+    };
+
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path, Access access = Access::Sequential);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::span<const std::byte> bytes() const;
+    const char* data() const;
+    size_t size() const;
+
+    //Tells the kernel the pages won't be touched again (e.g. after the upload), they stay mapped.
+    void release();
+
+private:
+    void unmap();
+
+    void* mapping = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void* file_handle = nullptr;
+    void* map_handle = nullptr;
+#endif
+};
+
+/*
+    Bulk reader for asset loading.
+    Reads are queued with read() and run together in wait(). With io_uring available they are
+    all in flight at once, otherwise they fall back to plain positional reads.
+*/
+class AsyncFileReader{
+public:
+    explicit AsyncFileReader(uint32_t queue_depth = 64);
+    ~AsyncFileReader();
+
+    AsyncFileReader(const AsyncFileReader&) = delete;
+    AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+    static size_t fileSize(const std::string& path);
+
+    //dst has to stay valid until wait() returns. Reads dst.size() bytes starting at offset.
+    void read(const std::string& path, std::span<std::byte> dst, uint64_t offset = 0);
+    void wait();
+
+    bool usesIoUring() const;
+
+private:
+    struct Request{
+        std::string path;
+        int fd = -1;
+        std::byte* dst;
+        size_t size;
+        uint64_t offset;
+        size_t done = 0;
+    };
+
+    void readBlocking(Request& request);
+
+    std::vector<Request> requests;
+    uint32_t depth;
+    void* ring = nullptr;
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+/*
+    Bump allocator for memory that only lives for one frame, as a std::pmr::memory_resource so containers
+    can take it. Every frame in flight has its own slot; beginFrame() is called once the slot's fence
+    signalled and hands its memory out again from the start. Deallocating does nothing, it all comes back
+    with the slot, so whatever is allocated here must be gone before the slot's next beginFrame().
+    A frame that outgrows its slot gets extra blocks from the heap, and the next beginFrame() of that slot
+    replaces them by one block the size of the whole frame, so a steady frame never reaches the heap.
+*/
+class FrameArena : public std::pmr::memory_resource{
+public:
+    struct Stats{
+        //bytes handed out this frame and the most of any frame, in every slot
+        size_t used = 0;
+        size_t peak = 0;
+        size_t capacity = 0;
+        //blocks that went to the heap because a slot was full
+        uint32_t overflows = 0;
+    };
+
+    FrameArena() = default;
+    ~FrameArena() override;
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void setup(uint32_t slot_count, size_t slot_bytes);
+    void destroy();
+
+    //Allocates from the slot from now on and forgets everything allocated from it before.
+    void beginFrame(uint32_t slot_index);
+    Stats stats() const;
+
+private:
+    //every block is aligned to this, larger alignments are padded inside the block
+    static const size_t BLOCK_ALIGNMENT = 64;
+
+    struct Block{
+        std::byte* memory = nullptr;
+        size_t size = 0;
+    };
+
+    struct Slot{
+        Block block;
+        size_t used = 0;
+        std::vector<Block> overflow;
+        //bytes of the current frame that went into overflow blocks
+        size_t overflow_used = 0;
+    };
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    static Block allocateBlock(size_t size);
+    static void freeBlock(Block& block);
+
+    std::vector<Slot> slots;
+    uint32_t current = 0;
+    size_t peak = 0;
+    uint32_t overflows = 0;
+};
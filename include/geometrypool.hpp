@@ -0,0 +1,122 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include "deletionqueue.hpp"
+#include "resourcetracker.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+/*
+    All static geometry in one vertex and one index buffer, so draws of every mesh share the same bindings
+    and go in the same multi-draw. Each mesh gets a range of both out of a first fit free list.
+    Removing a mesh leaves holes; once they add up to a quarter of what is still in use, the live ranges
+    are copied packed into fresh buffers and the old ones retired. Running out of room does the same
+    with bigger buffers. Either way ranges move, so draws read range() every time they are recorded.
+    Where device local memory is host visible (UMA devices, resizable BAR) the buffers stay mapped and
+    add() writes meshes in place; elsewhere they go through a staging buffer and a copy on the transfer queue.
+*/
+class GeometryPool{
+public:
+    struct Context{
+        VkDevice device = VK_NULL_HANDLE;
+        //buffers, images and memory are created and destroyed through it
+        ResourceTracker* tracker = nullptr;
+        //returns UINT32_MAX when no type matches
+        std::function<uint32_t(uint32_t, VkMemoryPropertyFlags)> find_memory_type;
+        //device local type the CPU writes directly for a type filter, UINT32_MAX to stage. Staged when empty.
+        std::function<uint32_t(uint32_t)> find_direct_type;
+        //families the buffers are used on, shared concurrently when there is more than one
+        std::vector<uint32_t> queue_families;
+        //records into a one-time command buffer on the transfer queue, submits it and waits for it
+        std::function<void(const std::function<void(VkCommandBuffer)>&)> submit_transfer;
+        //destroys something a frame in flight may still use once that frame is done
+        std::function<void(DeletionQueue::Destroy)> retire;
+    };
+
+    //Where a mesh is, in vertices and indices. Its indices are relative to first_vertex.
+    struct Range{
+        uint32_t first_vertex;
+        uint32_t vertex_count;
+        uint32_t first_index;
+        uint32_t index_count;
+    };
+
+    struct Stats{
+        uint32_t meshes = 0;
+        VkDeviceSize vertex_bytes = 0;
+        VkDeviceSize vertex_capacity = 0;
+        VkDeviceSize index_bytes = 0;
+        VkDeviceSize index_capacity = 0;
+        //rebuilds that packed or grew the buffers
+        uint32_t compactions = 0;
+        //meshes written in place into mapped buffers rather than staged
+        bool direct = false;
+    };
+
+    //Capacities are in vertices of stride bytes and in 32-bit indices.
+    void setup(const Context& context, uint32_t stride, uint32_t vertex_capacity, uint32_t index_capacity);
+    void destroy();
+
+    //Reserves room for a mesh and fills it, in place or through staging memory: write_vertices gets room for
+    //vertex_count vertices, write_indices for index_count indices. Returns the mesh's id.
+    uint32_t add(uint32_t vertex_count, uint32_t index_count, const std::function<void(void*)>& write_vertices,
+        const std::function<void(uint32_t*)>& write_indices);
+    //Frees the mesh's ranges. No frame in flight may still draw it.
+    void remove(uint32_t mesh);
+    const Range& range(uint32_t mesh) const;
+
+    VkBuffer vertexBuffer() const;
+    VkBuffer indexBuffer() const;
+    Stats stats() const;
+
+private:
+    //First fit over the free blocks, sorted by offset. Released blocks merge with their neighbours.
+    class FreeList{
+    public:
+        //one free block from used to capacity
+        void reset(uint32_t capacity, uint32_t used);
+        std::optional<uint32_t> allocate(uint32_t count);
+        void release(uint32_t offset, uint32_t count);
+        //free elements in front of the last block, which can only be reused by packing
+        uint32_t holes(uint32_t capacity) const;
+
+    private:
+        struct Block{
+            uint32_t offset;
+            uint32_t count;
+        };
+        std::vector<Block> blocks;
+    };
+
+    //mapped is set to the buffer's memory when it went into a direct type, to nullptr otherwise
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, const char* tag, VkBuffer& buffer, VkDeviceMemory& memory,
+        std::byte*& mapped);
+    //Moves every live range to the front of new buffers of these capacities and retires the old ones.
+    void rebuild(uint32_t new_vertex_capacity, uint32_t new_index_capacity);
+
+    Context ctx{};
+    uint32_t vertex_stride = 0;
+
+    VkBuffer vertex_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory vertex_memory = VK_NULL_HANDLE;
+    VkBuffer index_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory index_memory = VK_NULL_HANDLE;
+    //persistently mapped when the memory is host visible
+    std::byte* vertex_mapped = nullptr;
+    std::byte* index_mapped = nullptr;
+    uint32_t vertex_capacity = 0;
+    uint32_t index_capacity = 0;
+    uint32_t used_vertices = 0;
+    uint32_t used_indices = 0;
+    FreeList free_vertices;
+    FreeList free_indices;
+
+    //by id, empty once removed. Ids of removed meshes are handed out again.
+    std::vector<std::optional<Range>> meshes;
+    std::vector<uint32_t> free_ids;
+    uint32_t compactions = 0;
+};
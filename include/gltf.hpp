@@ -0,0 +1,60 @@
+#pragma once
+#include "file.hpp"
+#include "json.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+/*
+    A glTF 2.0 asset, .glb or .gltf with external buffers, memory mapped.
+    Accessors are views into the mapped buffers; the read helpers convert them to tightly packed
+    floats or integers. Embedded data: URIs and sparse accessors aren't supported.
+*/
+class GltfAsset{
+public:
+    //componentType values from the spec
+    enum ComponentType : uint32_t{
+        Byte = 5120,
+        UnsignedByte = 5121,
+        Short = 5122,
+        UnsignedShort = 5123,
+        UnsignedInt = 5125,
+        Float = 5126
+    };
+
+    struct Accessor{
+        const std::byte* data = nullptr;
+        size_t count = 0;
+        size_t stride = 0;
+        uint32_t component_type = Float;
+        //1 for SCALAR up to 16 for MAT4
+        uint32_t components = 1;
+        bool normalized = false;
+    };
+
+    explicit GltfAsset(const std::string& path);
+
+    const json::Value& document() const;
+    const std::string& path() const;
+
+    Accessor accessor(size_t index) const;
+    std::span<const std::byte> bufferView(size_t index) const;
+
+    //Reads components floats per element (missing ones are 0), applying normalization.
+    //Elements are dst_stride floats apart, 0 packs them tightly.
+    void readFloats(size_t accessor_index, float* dst, uint32_t components, size_t dst_stride = 0) const;
+    //Reads components integers per element, for indices and joint ids.
+    void readUints(size_t accessor_index, uint32_t* dst, uint32_t components) const;
+
+    static uint32_t componentSize(uint32_t component_type);
+
+private:
+    std::string source;
+    MappedFile file;
+    std::vector<MappedFile> external;
+    json::Value root;
+    std::vector<std::span<const std::byte>> buffers;
+};
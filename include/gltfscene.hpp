@@ -0,0 +1,90 @@
+#pragma once
+#include "gltf.hpp"
+#include "tree.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+/*
+    Meshes, materials, images and the node hierarchy of a glTF asset.
+    The constructor only walks the document and counts, so the caller can size its upload first.
+    writeVertices() and writeIndices() then convert every primitive's accessors straight from the mapped
+    file into the destination, usually mapped staging memory. Primitives are already indexed, so unlike
+    the OBJ path there is no deduplication pass. Only triangle lists are imported.
+*/
+class GltfScene{
+public:
+    //where each attribute goes in the destination vertex, in floats
+    struct VertexLayout{
+        uint32_t stride = 0;
+        uint32_t position_offset = 0;
+        uint32_t color_offset = 0;
+        uint32_t uv_offset = 0;
+    };
+
+    struct Primitive{
+        uint32_t first_index;
+        uint32_t index_count;
+        //indices are local to the primitive, the draw adds this
+        int32_t vertex_offset;
+        uint32_t vertex_count;
+        //glTF material, UINT32_MAX for the default one
+        uint32_t material;
+        //box of the positions, in the mesh's space
+        glm::vec3 bounds_min;
+        glm::vec3 bounds_max;
+        //accessors, SIZE_MAX when the primitive doesn't have them
+        size_t positions;
+        size_t uvs;
+        size_t colors;
+        size_t indices;
+    };
+
+    struct Mesh{
+        std::string name;
+        uint32_t first_primitive;
+        uint32_t primitive_count;
+    };
+
+    struct Material{
+        glm::vec4 base_color;
+        //UINT32_MAX without a base color texture
+        uint32_t image;
+    };
+
+    struct Image{
+        std::string name;
+        //empty when the image lives in a buffer view
+        std::string path;
+        std::span<const std::byte> bytes;
+    };
+
+    explicit GltfScene(const GltfAsset& asset);
+
+    //Adds an object per node of the default scene under parent. Objects with a mesh get its index.
+    void buildTree(Tree& tree, Object* parent) const;
+
+    void writeVertices(float* dst, const VertexLayout& layout) const;
+    void writeIndices(uint32_t* dst) const;
+
+    size_t vertexCount() const;
+    size_t indexCount() const;
+    const std::vector<Mesh>& meshes() const;
+    const std::vector<Primitive>& primitives() const;
+    const std::vector<Material>& materials() const;
+    const std::vector<Image>& images() const;
+
+private:
+    void addNode(Tree& tree, Object* parent, size_t node, uint32_t depth) const;
+
+    const GltfAsset& asset;
+    std::vector<Mesh> mesh_list;
+    std::vector<Primitive> primitive_list;
+    std::vector<Material> material_list;
+    std::vector<Image> image_list;
+    size_t vertex_total = 0;
+    size_t index_total = 0;
+};
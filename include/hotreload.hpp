@@ -0,0 +1,69 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+    Watches directories with inotify and hands every changed file to a handler on a background thread.
+    Handlers do the slow part there (compiling, decoding, parsing, building pipelines) and return the
+    step that swaps the result in, which apply() runs on the render thread between frames.
+    Editors save in bursts of events, so a file is handled once it has been quiet for SETTLE_MS.
+    inotify is Linux only, start() returns false elsewhere and nothing is watched.
+*/
+class HotReload{
+public:
+    //Runs on the reload thread. Returns the work left for the render thread, or an empty function.
+    using Handler = std::function<std::function<void()>(const std::string& path)>;
+
+    HotReload() = default;
+    ~HotReload();
+
+    HotReload(const HotReload&) = delete;
+    HotReload& operator=(const HotReload&) = delete;
+
+    //Files directly in directory ending in one of extensions go to handler. Call before start().
+    void watch(const std::string& directory, const std::vector<std::string>& extensions, Handler handler);
+    bool start();
+    void stop();
+
+    //Runs the swaps finished since the last call, in the order they finished. Returns how many ran.
+    size_t apply();
+
+    size_t reloadCount() const;
+    //Copies the message of the last failed reload, cleared by the next successful one. message keeps its
+    //capacity, so polling it every frame into the same string doesn't allocate once it's large enough.
+    void lastError(std::string& message) const;
+
+    //Compiles a GLSL file to SPIR-V with shaderc (or glslc without it) and moves the result over
+    //spv_path in one rename, so readers never see a half-written module. Throws with the compiler log.
+    static void compileGlsl(const std::string& source_path, const std::string& spv_path);
+    static bool samePath(const std::string& a, const std::string& b);
+
+private:
+    struct Watch{
+        std::string directory;
+        std::vector<std::string> extensions;
+        Handler handler;
+        int descriptor = -1;
+    };
+
+    void threadLoop();
+    void handle(const Watch& target, const std::string& path);
+
+    std::vector<Watch> watches;
+    int inotify_fd = -1;
+    std::thread thread;
+    std::atomic<bool> stopping{false};
+
+    mutable std::mutex mutex;
+    std::vector<std::function<void()>> ready;
+    std::string error;
+    size_t reloads = 0;
+
+    const int SETTLE_MS = 50;
+    const int POLL_MS = 100;
+};
@@ -0,0 +1,45 @@
+#pragma once
+#include "file.hpp"
+#include "jobsystem.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+/*
+    Decodes batches of images to RGBA8 in parallel, straight into caller memory (usually mapped staging).
+    plan() only parses the headers of the mapped files, so the destination can be sized and allocated
+    up front; decode() then runs one job per image and expands each image from its native channel count.
+*/
+class ImageDecoder{
+public:
+    struct Image{
+        std::string path;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t channels = 0;
+        size_t offset = 0;
+        size_t size = 0;
+    };
+
+    explicit ImageDecoder(JobSystem& job_system);
+
+    //Returns the number of bytes decode() writes. Every image starts at a multiple of alignment.
+    size_t plan(const std::vector<std::string>& paths, size_t alignment = 16);
+    void decode(uint8_t* dst, bool premultiply = false);
+
+    //stbi_load forcing RGBA and a memcpy on the calling thread, the baseline decode() is measured against.
+    void decodeSerial(uint8_t* dst, bool premultiply = false);
+
+    const std::vector<Image>& images() const;
+
+    static bool probe(std::span<const std::byte> file, Image& image);
+    static void decodeInto(std::span<const std::byte> file, const Image& image, uint8_t* dst, bool premultiply);
+
+private:
+    JobSystem& jobs;
+    std::vector<Image> planned;
+    std::vector<MappedFile> files;
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+/*
+    One-off GPU work outside the frame loop, batched: layout transitions, buffer to image copies and
+    anything handed to record() go into one command buffer that flush() submits once and waits on with a
+    fence. Transitions queued back to back become a single barrier, recorded when something has to see
+    them. The pool is reset after every flush and its one command buffer reused, nothing is allocated
+    per call. Uploading N images is N copies between two merged barriers and one wait.
+*/
+class ImmediateCommands{
+public:
+    struct Context{
+        VkDevice device = VK_NULL_HANDLE;
+        VkQueue queue = VK_NULL_HANDLE;
+        uint32_t queue_family = 0;
+        //sync2 entry point, core or KHR. Without it the merged barrier goes through vkCmdPipelineBarrier.
+        PFN_vkCmdPipelineBarrier2KHR pipeline_barrier2 = nullptr;
+    };
+
+    struct Stats{
+        uint32_t submits = 0;
+        //barrier commands recorded, each holding every transition queued before it
+        uint32_t barriers = 0;
+        uint32_t transitions = 0;
+        uint32_t copies = 0;
+    };
+
+    void setup(const Context& context);
+    void destroy();
+
+    //Queues a transition of the first mip_levels levels and array_layers layers. Queued transitions share
+    //a barrier, so an image is transitioned once between two commands. Layouts other than UNDEFINED,
+    //TRANSFER_SRC, TRANSFER_DST and SHADER_READ_ONLY throw std::invalid_argument.
+    void transition(VkImage image, VkImageAspectFlags aspect, VkImageLayout old_layout, VkImageLayout new_layout,
+        uint32_t mip_levels = 1, uint32_t array_layers = 1);
+    //The image has to be in TRANSFER_DST_OPTIMAL by then, a queued transition to it counts.
+    void copyBufferToImage(VkBuffer buffer, VkImage image, std::span<const VkBufferImageCopy> regions);
+    //Records into the batch after the transitions queued so far.
+    void record(const std::function<void(VkCommandBuffer)>& commands);
+
+    //Submits the batch and waits for it. Nothing happens when nothing is queued.
+    void flush();
+
+    const Stats& stats() const;
+
+private:
+    VkCommandBuffer commandBuffer();
+    void recordBarriers();
+
+    Context ctx{};
+    VkCommandPool pool = VK_NULL_HANDLE;
+    VkCommandBuffer buffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    bool recording = false;
+    std::vector<VkImageMemoryBarrier2KHR> pending;
+    //for the vkCmdPipelineBarrier fallback
+    std::vector<VkImageMemoryBarrier> legacy;
+    Stats counted;
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+    Fixed pool of worker threads for data-parallel work.
+    parallelFor() hands out indices through one atomic counter and the calling thread works along,
+    so a batch finishes as soon as the slowest index does. Batches are issued by one thread at a time.
+    The job is called through a plain function pointer, not wrapped in a std::function, so issuing a batch
+    never allocates, whatever the job captures.
+*/
+class JobSystem{
+public:
+    //0 picks one worker per hardware thread, minus the caller.
+    explicit JobSystem(uint32_t threads = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    //Runs job(0..count-1) and returns once all of them finished. The first exception thrown is rethrown here.
+    template<typename Job>
+    void parallelFor(uint32_t count, const Job& job){
+        run(count, &job, [](const void* context, uint32_t index){ (*static_cast<const Job*>(context))(index); });
+    }
+
+    uint32_t workerCount() const;
+
+private:
+    using Invoke = void(*)(const void*, uint32_t);
+
+    void run(uint32_t count, const void* context, Invoke invoke);
+    void workerLoop();
+    void runIndices();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    //the job of the running batch and how to call it
+    const void* batch = nullptr;
+    Invoke batch_invoke = nullptr;
+    uint32_t batch_size = 0;
+    uint64_t generation = 0;
+    uint32_t busy_workers = 0;
+    bool stopping = false;
+
+    std::atomic<uint32_t> next_index{0};
+    std::exception_ptr error;
+};
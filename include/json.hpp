@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*
+    Minimal JSON DOM, enough for glTF documents.
+    Lookups of missing members or out of range elements return a shared null value, so chains like
+    doc["meshes"][0]["primitives"] never throw; the typed getters fall back to their default.
+*/
+namespace json{
+    class Value{
+    public:
+        enum class Type{ Null, Bool, Number, String, Array, Object };
+
+        Value() = default;
+
+        Type type() const;
+        bool isNull() const;
+        bool isNumber() const;
+        bool isString() const;
+        bool isArray() const;
+        bool isObject() const;
+
+        bool boolean(bool fallback = false) const;
+        double number(double fallback = 0.0) const;
+        int64_t integer(int64_t fallback = 0) const;
+        const std::string& string() const;
+
+        //elements of an array or members of an object, 0 for anything else
+        size_t size() const;
+        bool has(std::string_view key) const;
+
+        const Value& operator[](size_t index) const;
+        const Value& operator[](std::string_view key) const;
+        const std::vector<std::pair<std::string, Value>>& members() const;
+
+    private:
+        friend class Parser;
+
+        Type kind = Type::Null;
+        bool flag = false;
+        double num = 0.0;
+        std::string str;
+        std::vector<Value> elements;
+        std::vector<std::pair<std::string, Value>> fields;
+    };
+
+    //Throws std::runtime_error with the byte offset on malformed input.
+    Value parse(std::string_view text);
+}
@@ -1,12 +1,35 @@
 #pragma once
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
 #include <vector>
 
 class Object{
     public:
         Object* get_parent();
         std::vector<Object*> get_children();
+        void add_child(Object* child);
+
+        const std::string& get_name();
+        void set_name(const std::string& new_name);
+
+        //transform relative to the parent
+        const glm::mat4& get_transform();
+        void set_transform(const glm::mat4& new_transform);
+        glm::mat4 get_world_transform();
+
+        //index of the mesh drawn at this object, -1 for none
+        int32_t get_mesh();
+        void set_mesh(int32_t new_mesh);
     private:
-        Object* parent;
+        Object* parent = nullptr;
         std::vector<Object*> children;
+        std::string name;
+        glm::mat4 transform = glm::mat4(1.0f);
+        int32_t mesh = -1;
 
-};
\ No newline at end of file
+};
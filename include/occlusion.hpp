@@ -0,0 +1,169 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "deletionqueue.hpp"
+#include "deviceinfo.hpp"
+#include "resourcetracker.hpp"
+
+/*
+    Two-phase Hi-Z occlusion culling of the scene draws.
+    After the early mesh pass a compute chain reduces its depth into a min/max pyramid (RG32F, level 0 at
+    half resolution, odd edges folded into their neighbour so every level stays conservative). The next
+    frame, recordEarly() tests each draw's bounds against that pyramid with the previous view-projection
+    and writes the indirect commands of the early pass. recordLate() rebuilds the pyramid from the early
+    depth and re-tests everything the early pass skipped with the current view-projection, so draws that
+    just came into view are drawn by the late pass the same frame instead of popping in a frame later.
+*/
+class OcclusionCuller{
+public:
+    struct Context{
+        VkDevice device = VK_NULL_HANDLE;
+        //buffers, images and memory are created and destroyed through it
+        ResourceTracker* tracker = nullptr;
+        const DeviceInfo* device_info = nullptr;
+        uint32_t frames_in_flight = 1;
+        PFN_vkCmdPipelineBarrier2KHR pipeline_barrier2 = nullptr;
+        //returns UINT32_MAX when no type matches
+        std::function<uint32_t(uint32_t, VkMemoryPropertyFlags)> find_memory_type;
+        std::function<VkShaderModule(const std::string&)> create_shader;
+        //destroys something a frame in flight may still use once that frame is done
+        std::function<void(DeletionQueue::Destroy)> retire;
+    };
+
+    enum class Phase{
+        Early,
+        Late
+    };
+
+    //Mirrors the std430 Object struct in cull.comp. Bounds are in model space.
+    struct Object{
+        glm::mat4 model;
+        glm::vec4 bounds_min;
+        glm::vec4 bounds_max;
+        uint32_t first_index;
+        uint32_t index_count;
+        int32_t vertex_offset;
+        uint32_t pad;
+    };
+
+    //What the GPU counted for one frame
+    struct Stats{
+        uint32_t objects = 0;
+        uint32_t early = 0;
+        uint32_t late = 0;
+        uint32_t frustum_culled = 0;
+    };
+
+    void setup(const Context& context);
+    void destroy();
+
+    //Recreates the pyramid for a new depth target and drops the history. Only while the GPU is idle,
+    //like the render graph rebuild that calls it.
+    void bindDepth(VkImageView depth, VkExtent2D extent, VkSampleCountFlagBits samples);
+    //Grows the per-frame buffers to hold count objects, the old ones are retired.
+    void reserve(uint32_t count);
+
+    //Reads back the statistics of the frame that last used frame's slot and returns its object list,
+    //to be filled with count objects before recording. frame's slot must no longer be in use by the GPU.
+    Object* beginFrame(uint64_t frame, uint32_t count, const glm::mat4& view_proj);
+    //Tests against the previous frame's pyramid, before the early mesh pass.
+    void recordEarly(VkCommandBuffer target, uint64_t frame);
+    //Builds the pyramid from the early depth (read in the SHADER_READ_ONLY layout) and re-tests the rest.
+    void recordLate(VkCommandBuffer target, uint64_t frame);
+
+    //VkDrawIndexedIndirectCommand of object in phase, instance count 0 when it's culled
+    VkBuffer drawBuffer() const;
+    VkDeviceSize drawOffset(uint64_t frame, Phase phase, uint32_t object) const;
+
+    const Stats& stats() const;
+    uint32_t pyramidLevels() const;
+
+private:
+    //Mirrors the std140 Cull block of cull.comp
+    struct CullUniforms{
+        glm::mat4 view_proj;
+        glm::mat4 prev_view_proj;
+        glm::vec2 depth_size;
+        uint32_t object_count;
+        uint32_t levels;
+        uint32_t history;
+        uint32_t late_base;
+        uint32_t pad[2];
+    };
+
+    //Mirrors the Stats block of cull.comp
+    struct Counters{
+        uint32_t early;
+        uint32_t late;
+        uint32_t frustum_culled;
+        uint32_t pad;
+    };
+
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, const char* tag,
+        VkBuffer& buffer, VkDeviceMemory& memory);
+    void createPipelines();
+    VkPipeline createComputePipeline(const std::string& shader, VkPipelineLayout layout);
+    void createPyramid(VkExtent2D extent);
+    void destroyPyramid();
+    void writeCullSets();
+    void memoryBarrier(VkCommandBuffer target, VkPipelineStageFlags2KHR src_stage, VkAccessFlags2KHR src_access,
+        VkPipelineStageFlags2KHR dst_stage, VkAccessFlags2KHR dst_access);
+
+    Context ctx{};
+    VkPhysicalDeviceLimits limits{};
+
+    VkSampler sampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout reduce_layout = VK_NULL_HANDLE;
+    VkPipelineLayout reduce_pl_layout = VK_NULL_HANDLE;
+    VkPipeline reduce_pipeline = VK_NULL_HANDLE;
+    //level 0 out of a multisampled depth buffer
+    VkPipeline reduce_ms_pipeline = VK_NULL_HANDLE;
+    VkDescriptorSetLayout cull_layout = VK_NULL_HANDLE;
+    VkPipelineLayout cull_pl_layout = VK_NULL_HANDLE;
+    VkPipeline cull_pipeline = VK_NULL_HANDLE;
+
+    VkImage pyramid = VK_NULL_HANDLE;
+    VkDeviceMemory pyramid_memory = VK_NULL_HANDLE;
+    //whole chain for the cull shader, then one view per level for the reduction
+    VkImageView pyramid_view = VK_NULL_HANDLE;
+    std::vector<VkImageView> level_views;
+    std::vector<VkExtent2D> level_extents;
+    VkDescriptorPool reduce_pool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> reduce_sets;
+    VkExtent2D depth_extent{};
+    bool multisampled = false;
+    //the pyramid is still UNDEFINED
+    bool pyramid_fresh = false;
+    //the pyramid holds a frame's depth, drawn with prev_view_proj
+    bool history = false;
+    glm::mat4 view_proj{1.0f};
+    glm::mat4 prev_view_proj{1.0f};
+
+    uint32_t capacity = 0;
+    //per slot: CullUniforms, Counters, then the objects
+    VkBuffer upload_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory upload_memory = VK_NULL_HANDLE;
+    char* mupload = nullptr;
+    VkDeviceSize upload_stride = 0;
+    VkDeviceSize counters_offset = 0;
+    VkDeviceSize objects_offset = 0;
+    //per slot: early commands, then late ones
+    VkBuffer draw_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory draw_memory = VK_NULL_HANDLE;
+    VkDeviceSize draw_stride = 0;
+    VkDescriptorPool cull_pool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> cull_sets;
+    std::vector<uint32_t> slot_counts;
+
+    Stats last_stats;
+};
@@ -0,0 +1,105 @@
+#pragma once
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "file.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+/*
+    GPU-ready assets written by domk-cook (cook/main.cpp) and mapped by the runtime as they are.
+    A package is a header followed by its sections, each at a 16 byte aligned offset, so sections can be
+    memcpy'd into staging memory straight from the mapping. Loading only validates the header and bounds.
+    Packages are native endian and tied to the runtime's vertex layout; the header records the layout
+    and a mismatch means the asset has to be cooked again.
+*/
+namespace package{
+    const uint32_t MESH_MAGIC = 0x48534D44;     //"DMSH"
+    const uint32_t TEXTURE_MAGIC = 0x58455444;  //"DTEX"
+    const uint32_t VERSION = 1;
+    const size_t SECTION_ALIGNMENT = 16;
+
+    //Same members and GLM configuration as Application::Vertex
+    struct Vertex{
+        glm::vec3 pos;
+        glm::vec3 color;
+        glm::vec2 tex_coord;
+
+        bool operator==(const Vertex& other) const;
+    };
+
+    //One draw of a cooked mesh, its node transform already flattened into model space
+    struct MeshDraw{
+        float transform[16];
+        uint32_t first_index;
+        uint32_t index_count;
+        int32_t vertex_offset;
+        uint32_t material;
+    };
+
+    struct MeshHeader{
+        uint32_t magic;
+        uint32_t version;
+        //in bytes
+        uint32_t vertex_stride;
+        uint32_t position_offset;
+        uint32_t color_offset;
+        uint32_t uv_offset;
+        uint32_t draw_count;
+        uint32_t reserved;
+        uint64_t vertex_count;
+        uint64_t index_count;
+        uint64_t draws_offset;
+        uint64_t vertices_offset;
+        uint64_t indices_offset;
+    };
+
+    //RGBA8 with the full mip chain, laid out like TextureStreamer::Decoded
+    struct TextureHeader{
+        uint32_t magic;
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t mip_count;
+        uint32_t reserved;
+        uint64_t pixels_offset;
+        uint64_t pixels_size;
+    };
+
+    //Mip count of a full chain and where each mip starts in tightly packed RGBA8. Returns the total size.
+    size_t mipLayout(uint32_t width, uint32_t height, std::vector<size_t>& mip_offsets);
+
+    //nullptr unless bytes start with a complete, current texture package
+    const TextureHeader* textureHeader(std::span<const std::byte> bytes);
+
+    void writeMesh(const std::string& path, std::span<const MeshDraw> draws, std::span<const Vertex> vertices,
+        std::span<const uint32_t> indices);
+    void writeTexture(const std::string& path, uint32_t width, uint32_t height, uint32_t mip_count,
+        std::span<const uint8_t> pixels);
+
+    //A mapped .dmesh. Throws if the file isn't one or is truncated.
+    class Mesh{
+    public:
+        explicit Mesh(const std::string& path);
+        //A package already in memory, like an archive entry. bytes have to outlive the Mesh.
+        Mesh(const std::string& name, std::span<const std::byte> bytes);
+
+        const MeshHeader& header() const;
+        std::span<const MeshDraw> draws() const;
+        std::span<const std::byte> vertices() const;
+        std::span<const uint32_t> indices() const;
+
+    private:
+        void validate(const std::string& name);
+
+        MappedFile file;
+        std::span<const std::byte> data;
+        const MeshHeader* head = nullptr;
+    };
+}
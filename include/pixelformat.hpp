@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/*
+    Pixel conversion kernels used when decoding textures into staging memory.
+    rgbToRgba has a SIMD path (SSSE3 picked at runtime on x86, NEON on ARM) and a scalar fallback.
+    premultiplySrgb goes through lookup tables one pixel at a time either way, SIMD only tests groups of
+    pixels for full opacity and skips them, so it beats the scalar loop on mostly opaque images only.
+    Source and destination must not overlap.
+*/
+namespace pixelformat{
+    //Expands tightly packed 1, 2, 3 or 4 channel 8-bit pixels to RGBA8 (grey replicates, missing alpha is 255).
+    void expandToRgba(const uint8_t* src, uint32_t channels, uint8_t* dst, size_t pixels);
+
+    void rgbToRgba(const uint8_t* src, uint8_t* dst, size_t pixels);
+
+    //Premultiplies sRGB-encoded RGBA8 in place, in linear space. Fully opaque runs are skipped.
+    void premultiplySrgb(uint8_t* rgba, size_t pixels);
+
+    //2x2 box filter from one RGBA8 mip to the next, odd edges reuse the last texel. Scalar only, it runs
+    //once per texture at load or cook time.
+    void downsampleRgba(const uint8_t* src, uint32_t src_width, uint32_t src_height, uint8_t* dst);
+
+    //Scalar versions, kept for benchmarking against and for the tails the SIMD loops leave. The premultiply
+    //one checks each pixel's alpha on its own.
+    void rgbToRgbaScalar(const uint8_t* src, uint8_t* dst, size_t pixels);
+    void premultiplySrgbScalar(uint8_t* rgba, size_t pixels);
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include "resourcetracker.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+/*
+    Small render graph.
+    Passes declare which images they read and write. compile() culls the passes whose
+    results never reach an output, places transient images into one shared allocation
+    (aliasing the ones whose lifetimes don't overlap) and plans one batched sync2 barrier
+    per pass. execute() only replays that plan, so it is cheap to run every frame.
+*/
+class RenderGraph{
+public:
+    using ResourceId = uint32_t;
+
+    struct Context{
+        VkDevice device = VK_NULL_HANDLE;
+        //buffers, images and memory are created and destroyed through it
+        ResourceTracker* tracker = nullptr;
+        PFN_vkCmdBeginRenderingKHR begin_rendering = nullptr;
+        PFN_vkCmdEndRenderingKHR end_rendering = nullptr;
+        PFN_vkCmdPipelineBarrier2KHR pipeline_barrier2 = nullptr;
+        std::function<uint32_t(uint32_t, VkMemoryPropertyFlags)> find_memory_type;
+    };
+
+    struct ImageDesc{
+        VkFormat format;
+        VkExtent2D extent;
+        VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    };
+
+    struct Attachment{
+        ResourceId resource;
+        VkAttachmentLoadOp load_op;
+        VkAttachmentStoreOp store_op;
+        VkClearValue clear;
+        std::optional<ResourceId> resolve;
+    };
+
+    struct Pass{
+        explicit Pass(std::string pass_name);
+
+        Pass& writeColor(ResourceId resource, VkAttachmentLoadOp load_op, VkClearValue clear = {});
+        Pass& writeDepth(ResourceId resource, VkAttachmentLoadOp load_op, VkClearValue clear = {});
+        Pass& resolveColor(ResourceId target);
+        Pass& read(ResourceId resource);
+        Pass& compute();
+        Pass& sideEffects();
+        Pass& execute(std::function<void(VkCommandBuffer)> callback);
+
+        std::string name;
+        std::vector<Attachment> color;
+        std::optional<Attachment> depth;
+        std::vector<ResourceId> sampled;
+        std::function<void(VkCommandBuffer)> record;
+        bool side_effects = false;
+        //reads are sampled by compute shaders instead of fragment shaders
+        bool compute_reads = false;
+    };
+
+    void setup(const Context& context);
+
+    //Imported images are owned elsewhere, their handles are (re)bound every frame with bindImported.
+    ResourceId importImage(const std::string& name, const ImageDesc& desc, VkImageLayout initial_layout,
+        VkPipelineStageFlags2KHR initial_stage, VkImageLayout final_layout);
+    ResourceId createTransient(const std::string& name, const ImageDesc& desc);
+    void bindImported(ResourceId resource, VkImage image, VkImageView view);
+    void markOutput(ResourceId resource);
+    void addPass(const Pass& pass);
+
+    void compile();
+    void execute(VkCommandBuffer buffer);
+    void reset();
+
+    //Valid after compile(), transients get new views every time the graph is built.
+    VkImageView view(ResourceId resource) const;
+    size_t passCount() const;
+    size_t culledPassCount() const;
+    VkDeviceSize transientMemorySize() const;
+    VkDeviceSize transientRequestedSize() const;
+
+    static VkImageAspectFlags aspectOf(VkFormat format);
+
+private:
+    struct State{
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags2KHR stage = VK_PIPELINE_STAGE_2_NONE_KHR;
+        VkAccessFlags2KHR access = 0;
+        bool write = false;
+    };
+
+    struct Resource{
+        std::string name;
+        ImageDesc desc;
+        bool imported = false;
+        bool output = false;
+        State initial;
+        VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkImageUsageFlags usage = 0;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        uint32_t first_use = UINT32_MAX;
+        uint32_t last_use = 0;
+        State last_state;
+    };
+
+    struct Barrier{
+        ResourceId resource;
+        State src;
+        State dst;
+    };
+
+    struct PlannedPass{
+        uint32_t pass;
+        std::vector<Barrier> barriers;
+    };
+
+    static State stateFor(const Pass& pass, ResourceId resource, bool& used);
+    void cullPasses(std::vector<uint32_t>& live) const;
+    void storeReadDepth(const std::vector<uint32_t>& live);
+    void computeLifetimes(const std::vector<uint32_t>& live);
+    void allocateTransients();
+    void planBarriers(const std::vector<uint32_t>& live);
+    void emitBarriers(VkCommandBuffer buffer, const std::vector<Barrier>& barriers);
+    void beginRendering(VkCommandBuffer buffer, const Pass& pass);
+
+    Context ctx;
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    std::vector<PlannedPass> plan;
+    std::vector<Barrier> final_barriers;
+    VkDeviceMemory transient_memory = VK_NULL_HANDLE;
+    VkDeviceSize transient_size = 0;
+
+    //reused by execute() so recording a frame doesn't allocate
+    std::vector<VkImageMemoryBarrier2KHR> barrier_scratch;
+    std::vector<VkRenderingAttachmentInfoKHR> attachment_scratch;
+};
@@ -0,0 +1,88 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include "deviceinfo.hpp"
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <source_location>
+#include <type_traits>
+#include <unordered_map>
+
+/*
+    Buffers, images and device memory are created and destroyed through here, so every live one is known
+    with a tag, its size, the heap its memory is on and the line that created it. heapUsage() puts what
+    was allocated through the tracker next to what VK_EXT_memory_budget says the whole process uses and
+    may use per heap. reportLeaks() lists what is still alive, called right before the device goes.
+    Tags are kept by pointer, pass string literals.
+*/
+class ResourceTracker{
+public:
+    struct Context{
+        VkDevice device = VK_NULL_HANDLE;
+        const DeviceInfo* device_info = nullptr;
+        //VK_EXT_memory_budget is enabled
+        bool memory_budget = false;
+    };
+
+    struct HeapUsage{
+        VkMemoryHeapFlags flags = 0;
+        VkDeviceSize size = 0;
+        //live allocations made through the tracker
+        VkDeviceSize tracked = 0;
+        uint32_t allocations = 0;
+        //Whole process, with VK_EXT_memory_budget. Without it usage is 0 and budget the heap size.
+        VkDeviceSize usage = 0;
+        VkDeviceSize budget = 0;
+    };
+
+    void setup(const Context& context);
+
+    VkResult createBuffer(const VkBufferCreateInfo& info, VkBuffer& buffer, const char* tag,
+        std::source_location where = std::source_location::current());
+    VkResult createImage(const VkImageCreateInfo& info, VkImage& image, const char* tag,
+        std::source_location where = std::source_location::current());
+    VkResult allocateMemory(const VkMemoryAllocateInfo& info, VkDeviceMemory& memory, const char* tag,
+        std::source_location where = std::source_location::current());
+    //null handles are ignored, like Vulkan does
+    void destroyBuffer(VkBuffer buffer);
+    void destroyImage(VkImage image);
+    void freeMemory(VkDeviceMemory memory);
+
+    //Fills the first memoryHeapCount entries and returns that count. The budget is queried on every call.
+    uint32_t heapUsage(std::array<HeapUsage, VK_MAX_MEMORY_HEAPS>& heaps) const;
+    //Writes a line per live object and returns how many there are.
+    size_t reportLeaks(std::ostream& out) const;
+
+private:
+    enum Kind{ BUFFER, IMAGE, MEMORY, KIND_COUNT };
+
+    struct Entry{
+        const char* tag;
+        VkDeviceSize size;
+        //UINT32_MAX for buffers and images, their memory is tracked separately
+        uint32_t heap;
+        std::source_location where;
+    };
+
+    //non-dispatchable handles are pointers on 64-bit platforms and uint64_t elsewhere
+    template<typename Handle>
+    static uint64_t key(Handle handle){
+        if constexpr(std::is_pointer_v<Handle>){
+            return reinterpret_cast<uintptr_t>(handle);
+        } else {
+            return handle;
+        }
+    }
+
+    void add(Kind kind, uint64_t handle, const Entry& entry);
+    void remove(Kind kind, uint64_t handle);
+
+    Context ctx{};
+    mutable std::mutex mutex;
+    std::array<std::unordered_map<uint64_t, Entry>, KIND_COUNT> live;
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heap_bytes{};
+    std::array<uint32_t, VK_MAX_MEMORY_HEAPS> heap_allocations{};
+};
@@ -0,0 +1,117 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include "animation.hpp"
+#include "deviceinfo.hpp"
+#include "jobsystem.hpp"
+#include "resourcetracker.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+    Animates and skins many instances of one skinned model.
+    animate() samples and blends each character's two clips on the job threads and writes the joint
+    palettes straight into the frame's slice of a mapped SSBO. record() then adds a compute dispatch that
+    skins every character into the frame's output buffer, laid out like Application::Vertex, so the
+    regular graphics pipeline draws it. Meant to run as an AsyncCompute stage, one slot per frame in flight.
+*/
+class SkinningSystem{
+public:
+    struct Context{
+        VkDevice device = VK_NULL_HANDLE;
+        //buffers, images and memory are created and destroyed through it
+        ResourceTracker* tracker = nullptr;
+        const DeviceInfo* device_info = nullptr;
+        uint32_t frames_in_flight = 1;
+        //families that use the output buffer (compute and graphics), it's shared concurrently when they differ
+        std::vector<uint32_t> queue_families;
+        //family the dispatches are recorded for, its timestamps measure the GPU time
+        uint32_t compute_family = 0;
+        JobSystem* jobs = nullptr;
+        //returns UINT32_MAX when no type matches
+        std::function<uint32_t(uint32_t, VkMemoryPropertyFlags)> find_memory_type;
+        std::function<VkShaderModule(const std::string&)> create_shader;
+        //layout of the output vertices, in floats
+        uint32_t vertex_stride = 0;
+        uint32_t position_offset = 0;
+        uint32_t color_offset = 0;
+        uint32_t uv_offset = 0;
+    };
+
+    struct Character{
+        glm::mat4 transform;
+        uint32_t clip_a;
+        uint32_t clip_b;
+        //0 plays clip_a only, 1 clip_b only
+        float blend;
+        float time;
+        float speed;
+    };
+
+    void setup(const Context& context, SkinnedModel skinned_model, uint32_t max_characters);
+    void destroy();
+
+    uint32_t addCharacter(const glm::mat4& transform, uint32_t clip_a, uint32_t clip_b, float blend, float time_offset);
+
+    //Advances every character by dt and writes frame's palettes. frame's slot must no longer be in use by the GPU.
+    void animate(uint64_t frame, float dt);
+    void record(VkCommandBuffer target, uint64_t frame);
+
+    VkBuffer outputBuffer(uint64_t frame) const;
+    VkBuffer indexBuffer() const;
+    uint32_t indexCount() const;
+    uint32_t vertexCount() const;
+    const std::vector<Character>& characters() const;
+    const SkinnedModel& model() const;
+
+    //smoothed CPU time of animate() and GPU time of the dispatch, 0 until measured
+    double animateMs() const;
+    double skinMs() const;
+
+private:
+    //Mirrors the push constants of skinning.comp
+    struct SkinParams{
+        uint32_t vertex_count;
+        uint32_t joint_count;
+    };
+
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+        bool shared, const char* tag, VkBuffer& buffer, VkDeviceMemory& memory);
+    void createPipeline();
+
+    Context ctx{};
+    SkinnedModel skinned;
+    std::vector<Character> instances;
+    uint32_t capacity = 0;
+
+    VkBuffer source_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory source_memory = VK_NULL_HANDLE;
+    VkBuffer index_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory index_memory = VK_NULL_HANDLE;
+
+    //one slice per frame in flight
+    VkBuffer palette_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory palette_memory = VK_NULL_HANDLE;
+    char* mpalettes = nullptr;
+    VkDeviceSize palette_stride = 0;
+
+    std::vector<VkBuffer> output_buffers;
+    std::vector<VkDeviceMemory> output_memory;
+
+    VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> sets;
+    VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    VkQueryPool queries = VK_NULL_HANDLE;
+    double timestamp_period = 0.0;
+    uint64_t timestamp_mask = 0;
+    std::vector<bool> queries_written;
+
+    double animate_ms = 0.0;
+    double skin_ms = 0.0;
+};
@@ -0,0 +1,114 @@
+#pragma once
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "jobsystem.hpp"
+
+/*
+    CPU occlusion culling for devices without the Hi-Z path (or where it runs on the CPU anyway, like lavapipe).
+    A few large occluder meshes are rasterized into a small depth buffer: triangles are set up once per frame,
+    then every tile is filled by its own job with the AVX2 or SSE2 kernel, keeping the nearest depth per pixel.
+    Only pixels whose center a triangle covers are written, so occluders never grow. test() then rejects
+    boxes outside the frustum or behind the buffer over every pixel their projection touches.
+*/
+class SoftwareOcclusion{
+public:
+    static const uint32_t WIDTH = 320;
+    static const uint32_t HEIGHT = 192;
+    static const uint32_t TILE_SIZE = 32;
+
+    enum class Kernel{
+        Scalar,
+        Sse2,
+        Avx2
+    };
+
+    //A box to test, bounds in model space
+    struct Box{
+        glm::mat4 model;
+        glm::vec3 bounds_min;
+        glm::vec3 bounds_max;
+    };
+
+    struct Stats{
+        uint32_t occluders = 0;
+        //after frustum and near plane clipping
+        uint32_t triangles = 0;
+        uint32_t objects = 0;
+        uint32_t frustum_culled = 0;
+        uint32_t occluded = 0;
+        double raster_ms = 0.0;
+        double test_ms = 0.0;
+    };
+
+    explicit SoftwareOcclusion(JobSystem& job_system);
+
+    //Model space triangles. Returns the index the occluder's matrix has in rasterize().
+    uint32_t addOccluder(std::vector<glm::vec3> positions, std::vector<uint32_t> indices);
+    void clearOccluders();
+    size_t occluderCount() const;
+
+    //The widest kernel the CPU runs, Scalar outside x86. Only changed for benchmarking.
+    void setKernel(Kernel used);
+    Kernel kernel() const;
+    static Kernel bestKernel();
+    static const char* kernelName(Kernel named);
+
+    //Clears the buffer and draws every occluder with models[occluder].
+    void rasterize(const glm::mat4& view_proj, std::span<const glm::mat4> models);
+    //visible[i] is 0 when boxes[i] is outside the frustum or hidden behind what rasterize() drew, 1 otherwise.
+    void test(std::span<const Box> boxes, uint8_t* visible);
+
+    const Stats& stats() const;
+    //WIDTH * HEIGHT depths, row by row
+    const float* depth() const;
+
+    //A triangle in pixels, what the kernels fill. Inside where all three edge functions a * x + b * y + c
+    //are >= 0 at the pixel center, the depth is a plane as well.
+    struct ScreenTriangle{
+        float edge_a[3];
+        float edge_b[3];
+        float edge_c[3];
+        float depth_a;
+        float depth_b;
+        float depth_c;
+        //pixel rectangle, max exclusive
+        int32_t min_x;
+        int32_t min_y;
+        int32_t max_x;
+        int32_t max_y;
+    };
+
+private:
+    struct Occluder{
+        std::vector<glm::vec3> positions;
+        std::vector<uint32_t> indices;
+        //clip space positions of this frame, only touched by the occluder's setup job
+        std::vector<glm::vec4> clip;
+    };
+
+    void setupTriangles(uint32_t occluder, const glm::mat4& mvp);
+    static void addTriangle(const glm::vec4& p0, const glm::vec4& p1, const glm::vec4& p2, std::vector<ScreenTriangle>& out);
+    void rasterizeTile(uint32_t tile);
+    bool testBox(const Box& box, uint32_t& frustum_culled) const;
+
+    JobSystem& jobs;
+    Kernel used_kernel;
+
+    std::vector<Occluder> occluders;
+    //per occluder, rebuilt every frame
+    std::vector<std::vector<ScreenTriangle>> triangles;
+
+    glm::mat4 view_proj{1.0f};
+    std::vector<float> depth_buffer;
+    //farthest depth of each tile, a box behind it needs no per pixel test there
+    std::vector<float> tile_farthest;
+
+    Stats last_stats;
+};
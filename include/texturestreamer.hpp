@@ -0,0 +1,179 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "deviceinfo.hpp"
+#include "deletionqueue.hpp"
+#include "resourcetracker.hpp"
+
+class ImmediateCommands;
+
+/*
+    Streams texture mips into device memory on demand.
+    Every texture keeps its full mip chain in system memory, only a small mip tail is always resident.
+    The fragment shader reports the finest mip it wanted per texture (feedback buffer), update() then
+    grows textures one mip at a time and shrinks the least recently used ones to stay under the budget.
+
+    A texture's resident image only holds mips [min_lod, mip_count), so it is rebuilt when its residency
+    changes. Shaders find the current image through the TextureInfo table, indexed by texture id. The table
+    has a slice per frame in flight: publishing changes the CPU copy and update() writes it into the slice of
+    the frame being recorded, so a frame on the GPU never sees a slot change under it.
+*/
+class TextureStreamer{
+public:
+    using TextureId = uint32_t;
+
+    struct Context{
+        VkDevice device = VK_NULL_HANDLE;
+        //buffers, images and memory are created and destroyed through it
+        ResourceTracker* tracker = nullptr;
+        const DeviceInfo* device_info = nullptr;
+        VkQueue queue = VK_NULL_HANDLE;
+        uint32_t queue_family = 0;
+        //on the same queue, add() records the mip tails into it
+        ImmediateCommands* immediate = nullptr;
+        uint32_t frames_in_flight = 1;
+        bool memory_budget = false;
+        //returns UINT32_MAX when no type matches
+        std::function<uint32_t(uint32_t, VkMemoryPropertyFlags)> find_memory_type;
+        std::function<uint32_t(VkImageView)> register_texture;
+        std::function<void(uint32_t)> release_texture;
+        //destroys something a frame in flight may still use once that frame is done
+        std::function<void(DeletionQueue::Destroy)> retire;
+    };
+
+    //Mirrors the std430 TextureInfo struct in frag_bindless.frag
+    struct TextureInfo{
+        uint32_t slot;
+        float min_lod;
+    };
+
+    //CPU side of a texture, its full mip chain in RGBA8
+    struct Decoded{
+        std::string path;
+        uint32_t width;
+        uint32_t height;
+        uint32_t mip_count;
+        uint32_t tail_mip;
+        std::vector<uint8_t> pixels;
+        std::vector<size_t> mip_offsets;
+    };
+
+    void setup(const Context& context, uint32_t max_textures, VkDeviceSize budget);
+    void destroy();
+
+    //Decodes the file, builds its mip chain and queues the upload of its mip tail, so it is for load time.
+    //The texture can't be sampled before flush(). A cooked .dtex from domk-cook already has its mips and skips the decode.
+    TextureId add(const std::string& path);
+    //Same for an image already in memory, like one embedded in a .glb. path only names it in errors.
+    TextureId add(const std::string& path, std::span<const std::byte> encoded);
+    //Same for a texture decode() already produced, so many can be decoded in parallel first.
+    TextureId add(Decoded decoded);
+    //Submits every tail queued by add() since the last flush in one batch, waits for it once and publishes them.
+    void flush();
+
+    //The CPU half of add(). It only reads constants, so it may run on any thread, like a reload thread.
+    Decoded decode(const std::string& path, std::span<const std::byte> encoded) const;
+    //Swaps in a new version of a texture, e.g. after its file changed. Returns without waiting, the old image
+    //is sampled until update() publishes the new tail and retired once no frame in flight uses it.
+    void replace(TextureId id, Decoded decoded);
+    //UINT32_MAX when no texture was added from path
+    TextureId find(const std::string& path) const;
+
+    //Call once the frame's fence has signalled, its feedback is complete then.
+    void update(uint32_t frame);
+
+    //0 means the reported VK_EXT_memory_budget budget alone limits residency.
+    void setBudget(VkDeviceSize budget);
+
+    VkBuffer infoBuffer() const;
+    VkDeviceSize infoRange() const;
+    uint32_t infoOffset(uint32_t frame) const;
+    VkBuffer feedbackBuffer() const;
+    VkDeviceSize feedbackRange() const;
+    uint32_t feedbackOffset(uint32_t frame) const;
+
+    size_t textureCount() const;
+    size_t pendingUploads() const;
+    VkDeviceSize residentBytes() const;
+    VkDeviceSize budgetBytes() const;
+
+private:
+    struct Residency{
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        uint32_t slot = UINT32_MAX;
+        uint32_t base_mip = 0;
+        VkDeviceSize size = 0;
+    };
+
+    struct Texture : Decoded{
+        Residency resident;
+        uint32_t wanted_mip;
+        uint64_t last_used = 0;
+        bool pending = false;
+    };
+
+    struct Upload{
+        TextureId texture;
+        Residency residency;
+        VkBuffer staging;
+        VkDeviceMemory staging_memory;
+        VkCommandBuffer commands;
+        VkFence fence;
+        //built from pixels replace() swapped out, freed instead of published
+        bool discarded = false;
+    };
+
+    void createHostBuffer(VkDeviceSize size, VkBufferUsageFlags usage, bool readback, const char* tag, VkBuffer& buffer,
+        VkDeviceMemory& memory, void** mapped);
+    void buildMips(Decoded& texture) const;
+    uint32_t tailMip(const Decoded& texture) const;
+    void makeTailResident(TextureId id);
+    bool prepare(TextureId id, uint32_t base_mip, Upload& upload, std::vector<VkBufferImageCopy>& regions);
+    bool schedule(TextureId id, uint32_t base_mip);
+    void publish(Upload& upload);
+    void complete(Upload& upload);
+    void release(Residency& residency);
+    VkDeviceSize mipBytes(const Texture& texture, uint32_t base_mip) const;
+    VkDeviceSize queryBudget() const;
+
+    Context ctx;
+    std::vector<Texture> textures;
+    std::vector<Upload> uploads;
+    //recorded into ctx.immediate by add(), waiting for flush()
+    std::vector<Upload> added;
+    VkCommandPool pool = VK_NULL_HANDLE;
+
+    VkBuffer info_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory info_memory = VK_NULL_HANDLE;
+    TextureInfo* minfo = nullptr;
+    VkDeviceSize info_stride = 0;
+    //what publish() wrote, copied into a frame's slice when that slice's version is behind
+    std::vector<TextureInfo> infos;
+    uint64_t info_version = 0;
+    std::vector<uint64_t> info_slice_versions;
+
+    VkBuffer feedback_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory feedback_memory = VK_NULL_HANDLE;
+    uint32_t* mfeedback = nullptr;
+    VkDeviceSize feedback_stride = 0;
+
+    uint32_t capacity = 0;
+    uint64_t frame_counter = 0;
+    VkDeviceSize configured_budget = 0;
+    VkDeviceSize budget_bytes = 0;
+    VkDeviceSize resident_bytes = 0;
+
+    //reused by update() so a steady frame doesn't allocate
+    std::vector<TextureId> candidates;
+
+    const uint32_t TAIL_SIZE = 64;
+    const VkDeviceSize MAX_UPLOAD_BYTES_PER_FRAME = 32ull * 1024 * 1024;
+};
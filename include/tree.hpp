@@ -1,10 +1,18 @@
 #pragma once
 #include "object.h"
 
+#include <memory>
+#include <vector>
+
 class Tree{
     public:
     Object* get_root();
+    //Creates an object owned by the tree, under the root when parent is null.
+    Object* create_object(Object* parent = nullptr);
+    size_t size();
+    void clear();
 
     private:
-    Object* root;
-};
\ No newline at end of file
+    Object* root = nullptr;
+    std::vector<std::unique_ptr<Object>> objects;
+};
@@ -0,0 +1,51 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0)in vec3 frag_color;
+layout(location = 1)in vec2 tex_coord;
+layout(location = 2)flat in uint draw_material;
+
+struct Material{
+    vec4 base_color;
+    uint albedo;
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
+struct TextureInfo{
+    uint slot;
+    float min_lod;
+};
+
+//finest mip each streamed texture was sampled at this frame, reset by the CPU once read
+layout(std430, set = 0, binding = 2)buffer Feedback{
+    uint wanted_mip[];
+};
+
+//this frame's slice of the streamed texture table
+layout(std430, set = 0, binding = 4)readonly buffer Textures{
+    TextureInfo texture_info[];
+};
+
+layout(set = 1, binding = 0)uniform sampler tex_sampler;
+layout(set = 1, binding = 1)uniform texture2D textures[];
+layout(std430, set = 1, binding = 2)readonly buffer Materials{
+    Material materials[];
+};
+
+layout(location = 0)out vec4 out_color;
+
+void main(){
+    Material material = materials[draw_material];
+    TextureInfo info = texture_info[material.albedo];
+
+    //the resident image starts at mip min_lod, so its lods are offset from the full chain's.
+    //the lod needs derivatives, so it is queried in uniform control flow; one pixel in 8x8 reports it
+    float lod = textureQueryLod(sampler2D(textures[nonuniformEXT(info.slot)], tex_sampler), tex_coord).y;
+    if(((uint(gl_FragCoord.x) | uint(gl_FragCoord.y)) & 7u) == 0u){
+        atomicMin(wanted_mip[material.albedo], uint(max(lod + info.min_lod, 0.0)));
+    }
+
+    out_color = material.base_color * texture(sampler2D(textures[nonuniformEXT(info.slot)], tex_sampler), tex_coord);
+}
@@ -6,15 +6,30 @@ layout(location = 2)in vec2 tex_coord;
 
 layout(location = 0) out vec3 frag_color;
 layout(location = 1) out vec2 frag_tex_coord;
+layout(location = 2) flat out uint frag_material;
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
+layout(binding = 0) uniform ViewUniforms {
     mat4 view;
     mat4 proj;
 } ubo;
 
+struct DrawData{
+    mat4 model;
+    uint material;
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
+//every draw of a multi-draw is its own instance, first_instance is the draw's index here
+layout(std430, binding = 3) readonly buffer Draws {
+    DrawData draws[];
+};
+
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(vert_pos, 1.0);
+    DrawData draw = draws[gl_InstanceIndex];
+    gl_Position = ubo.proj * ubo.view * draw.model * vec4(vert_pos, 1.0);
     frag_color = vert_color;
     frag_tex_coord = tex_coord;
+    frag_material = draw.material;
 }
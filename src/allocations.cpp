@@ -0,0 +1,77 @@
+#include "allocations.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#ifdef DOMK_COUNT_ALLOCATIONS
+namespace{
+    std::atomic<uint64_t> allocated{0};
+}
+
+bool allocations::counted(){
+    return true;
+}
+
+uint64_t allocations::count(){
+    return allocated.load(std::memory_order_relaxed);
+}
+
+//The array and nothrow forms call these two, so every allocation through new passes here.
+void* operator new(std::size_t size){
+    allocated.fetch_add(1, std::memory_order_relaxed);
+    if(void* memory = std::malloc(size != 0 ? size : 1)){
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment){
+    allocated.fetch_add(1, std::memory_order_relaxed);
+    std::size_t align = static_cast<std::size_t>(alignment);
+#ifdef _WIN32
+    if(void* memory = _aligned_malloc(size != 0 ? size : 1, align)){
+        return memory;
+    }
+#else
+    //aligned_alloc wants a multiple of the alignment
+    std::size_t rounded = (size + align - 1) / align * align;
+    if(void* memory = std::aligned_alloc(align, rounded != 0 ? rounded : align)){
+        return memory;
+    }
+#endif
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t alignment) noexcept {
+    operator delete(memory, alignment);
+}
+#else
+bool allocations::counted(){
+    return false;
+}
+
+uint64_t allocations::count(){
+    return 0;
+}
+#endif
@@ -0,0 +1,449 @@
+#include "animation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DOMK_ANIM_SSE
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define DOMK_ANIM_NEON
+#include <arm_neon.h>
+#endif
+
+namespace {
+    const uint32_t MODE_TRIANGLES = 4;
+
+#ifdef DOMK_ANIM_SSE
+    inline __m128 dot4(__m128 a, __m128 b){
+        __m128 m = _mm_mul_ps(a, b);
+        __m128 s = _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_add_ps(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+#endif
+
+    glm::vec4 quatFromMatrix(const glm::mat3& m){
+        float trace = m[0][0] + m[1][1] + m[2][2];
+        glm::vec4 q;
+        if(trace > 0.0f){
+            float s = std::sqrt(trace + 1.0f) * 2.0f;
+            q = glm::vec4((m[1][2] - m[2][1]) / s, (m[2][0] - m[0][2]) / s, (m[0][1] - m[1][0]) / s, 0.25f * s);
+        } else if(m[0][0] > m[1][1] && m[0][0] > m[2][2]){
+            float s = std::sqrt(1.0f + m[0][0] - m[1][1] - m[2][2]) * 2.0f;
+            q = glm::vec4(0.25f * s, (m[1][0] + m[0][1]) / s, (m[2][0] + m[0][2]) / s, (m[1][2] - m[2][1]) / s);
+        } else if(m[1][1] > m[2][2]){
+            float s = std::sqrt(1.0f + m[1][1] - m[0][0] - m[2][2]) * 2.0f;
+            q = glm::vec4((m[1][0] + m[0][1]) / s, 0.25f * s, (m[2][1] + m[1][2]) / s, (m[2][0] - m[0][2]) / s);
+        } else {
+            float s = std::sqrt(1.0f + m[2][2] - m[0][0] - m[1][1]) * 2.0f;
+            q = glm::vec4((m[2][0] + m[0][2]) / s, (m[2][1] + m[1][2]) / s, 0.25f * s, (m[0][1] - m[1][0]) / s);
+        }
+        return glm::normalize(q);
+    }
+
+    glm::mat4 composeMatrix(const JointPose& pose){
+        float x = pose.rotation.x, y = pose.rotation.y, z = pose.rotation.z, w = pose.rotation.w;
+
+        glm::mat4 m(1.0f);
+        m[0] = glm::vec4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y), 0.0f) * pose.scale.x;
+        m[1] = glm::vec4(2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x), 0.0f) * pose.scale.y;
+        m[2] = glm::vec4(2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y), 0.0f) * pose.scale.z;
+        m[3] = glm::vec4(pose.translation.x, pose.translation.y, pose.translation.z, 1.0f);
+        return m;
+    }
+
+    JointPose nodePose(const json::Value& node){
+        JointPose pose{};
+        pose.translation = glm::vec4(0.0f);
+        pose.rotation = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        pose.scale = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+
+        const json::Value& matrix = node["matrix"];
+        if(matrix.size() == 16){
+            glm::mat4 m;
+            for(int c = 0; c < 4; c++){
+                for(int r = 0; r < 4; r++){
+                    m[c][r] = static_cast<float>(matrix[c * 4 + r].number());
+                }
+            }
+            pose.translation = glm::vec4(glm::vec3(m[3]), 0.0f);
+            glm::vec3 scale(glm::length(glm::vec3(m[0])), glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2])));
+            pose.scale = glm::vec4(scale, 0.0f);
+            pose.rotation = quatFromMatrix(glm::mat3(glm::vec3(m[0]) / scale.x, glm::vec3(m[1]) / scale.y, glm::vec3(m[2]) / scale.z));
+            return pose;
+        }
+
+        const json::Value& t = node["translation"];
+        const json::Value& r = node["rotation"];
+        const json::Value& s = node["scale"];
+        if(t.size() == 3){
+            pose.translation = glm::vec4(t[0].number(), t[1].number(), t[2].number(), 0.0);
+        }
+        if(r.size() == 4){
+            pose.rotation = glm::vec4(r[0].number(), r[1].number(), r[2].number(), r[3].number());
+        }
+        if(s.size() == 3){
+            pose.scale = glm::vec4(s[0].number(), s[1].number(), s[2].number(), 0.0);
+        }
+        return pose;
+    }
+
+    void sampleTrack(const AnimationTrack& track, float time, bool rotation, float* out){
+        const float* first = &track.values.front().x;
+        if(time <= track.times.front() || track.times.size() == 1){
+            std::copy(first, first + 4, out);
+            return;
+        }
+        if(time >= track.times.back()){
+            const float* last = &track.values.back().x;
+            std::copy(last, last + 4, out);
+            return;
+        }
+
+        size_t key = static_cast<size_t>(std::upper_bound(track.times.begin(), track.times.end(), time) - track.times.begin()) - 1;
+        const float* a = &track.values[key].x;
+        const float* b = &track.values[key + 1].x;
+        if(track.step){
+            std::copy(a, a + 4, out);
+            return;
+        }
+
+        float t = (time - track.times[key]) / (track.times[key + 1] - track.times[key]);
+        if(rotation){
+            animation::nlerp4(a, b, t, out);
+        } else {
+            animation::lerp4(a, b, t, out);
+        }
+    }
+}
+
+size_t Skeleton::jointCount() const {
+    return parents.size();
+}
+
+SkinnedModel SkinnedModel::load(const GltfAsset& asset){
+    const json::Value& doc = asset.document();
+    const json::Value& nodes = doc["nodes"];
+
+    size_t mesh_node = nodes.size();
+    for(size_t i = 0; i < nodes.size(); i++){
+        if(nodes[i].has("mesh") && nodes[i].has("skin")){
+            mesh_node = i;
+            break;
+        }
+    }
+    if(mesh_node == nodes.size()){
+        throw std::runtime_error("No skinned mesh in " + asset.path() + ".");
+    }
+
+    SkinnedModel model;
+    Skeleton& skeleton = model.skeleton;
+
+    const json::Value& skin = doc["skins"][static_cast<size_t>(nodes[mesh_node]["skin"].integer())];
+    const json::Value& joints = skin["joints"];
+    size_t joint_count = joints.size();
+    if(joint_count == 0){
+        throw std::runtime_error("Skin without joints in " + asset.path() + ".");
+    }
+
+    std::vector<int64_t> node_parent(nodes.size(), -1);
+    for(size_t i = 0; i < nodes.size(); i++){
+        const json::Value& children = nodes[i]["children"];
+        for(size_t c = 0; c < children.size(); c++){
+            size_t child = static_cast<size_t>(children[c].integer());
+            if(child < nodes.size()){
+                node_parent[child] = static_cast<int64_t>(i);
+            }
+        }
+    }
+
+    std::vector<int32_t> joint_of_node(nodes.size(), -1);
+    for(size_t j = 0; j < joint_count; j++){
+        size_t node = static_cast<size_t>(joints[j].integer());
+        if(node >= nodes.size()){
+            throw std::runtime_error("Skin joint out of range in " + asset.path() + ".");
+        }
+        joint_of_node[node] = static_cast<int32_t>(j);
+    }
+
+    //the nearest joint ancestor is the parent, the nodes above a root joint are folded into its root transform
+    skeleton.parents.assign(joint_count, -1);
+    skeleton.root_transforms.assign(joint_count, glm::mat4(1.0f));
+    skeleton.rest_pose.resize(joint_count);
+    std::vector<uint32_t> depth(joint_count, 0);
+    for(size_t j = 0; j < joint_count; j++){
+        size_t node = static_cast<size_t>(joints[j].integer());
+        skeleton.rest_pose[j] = nodePose(nodes[node]);
+
+        glm::mat4 above(1.0f);
+        //a chain longer than the node count loops, which only a malformed file has
+        size_t steps = 0;
+        for(int64_t ancestor = node_parent[node]; ancestor >= 0; ancestor = node_parent[ancestor]){
+            if(++steps > nodes.size()){
+                throw std::runtime_error("Couldn't resolve the joint hierarchy of " + asset.path() + ", its nodes form a cycle.");
+            }
+            if(joint_of_node[ancestor] >= 0){
+                if(skeleton.parents[j] < 0){
+                    skeleton.parents[j] = joint_of_node[ancestor];
+                }
+                depth[j]++;
+            } else if(skeleton.parents[j] < 0){
+                above = composeMatrix(nodePose(nodes[ancestor])) * above;
+            }
+        }
+        if(skeleton.parents[j] < 0){
+            skeleton.root_transforms[j] = above;
+        }
+    }
+
+    skeleton.order.resize(joint_count);
+    for(size_t j = 0; j < joint_count; j++){
+        skeleton.order[j] = static_cast<uint32_t>(j);
+    }
+    std::stable_sort(skeleton.order.begin(), skeleton.order.end(), [&](uint32_t a, uint32_t b){
+        return depth[a] < depth[b];
+    });
+
+    skeleton.inverse_bind.assign(joint_count, glm::mat4(1.0f));
+    if(skin.has("inverseBindMatrices")){
+        std::vector<float> matrices(joint_count * 16);
+        size_t accessor = static_cast<size_t>(skin["inverseBindMatrices"].integer());
+        if(asset.accessor(accessor).count < joint_count){
+            throw std::runtime_error("Too few inverse bind matrices in " + asset.path() + ".");
+        }
+        asset.readFloats(accessor, matrices.data(), 16);
+        for(size_t j = 0; j < joint_count; j++){
+            for(int c = 0; c < 4; c++){
+                skeleton.inverse_bind[j][c] = glm::vec4(matrices[j * 16 + c * 4], matrices[j * 16 + c * 4 + 1],
+                    matrices[j * 16 + c * 4 + 2], matrices[j * 16 + c * 4 + 3]);
+            }
+        }
+    }
+
+    //every triangle primitive of the mesh, merged into one vertex and index stream
+    const json::Value& primitives = doc["meshes"][static_cast<size_t>(nodes[mesh_node]["mesh"].integer())]["primitives"];
+    model.bounds_min = glm::vec3(std::numeric_limits<float>::max());
+    model.bounds_max = glm::vec3(std::numeric_limits<float>::lowest());
+    for(size_t p = 0; p < primitives.size(); p++){
+        const json::Value& primitive = primitives[p];
+        const json::Value& attributes = primitive["attributes"];
+        if(primitive["mode"].integer(MODE_TRIANGLES) != MODE_TRIANGLES || !attributes.has("POSITION")
+            || !attributes.has("JOINTS_0") || !attributes.has("WEIGHTS_0")){
+            continue;
+        }
+
+        size_t position = static_cast<size_t>(attributes["POSITION"].integer());
+        size_t count = asset.accessor(position).count;
+        size_t base = model.vertices.size();
+
+        std::vector<float> positions(count * 3);
+        std::vector<float> uvs(count * 2, 0.0f);
+        std::vector<float> colors(count * 3, 1.0f);
+        std::vector<uint32_t> joint_ids(count * 4);
+        std::vector<float> weights(count * 4);
+
+        asset.readFloats(position, positions.data(), 3);
+        if(attributes.has("TEXCOORD_0")){
+            asset.readFloats(static_cast<size_t>(attributes["TEXCOORD_0"].integer()), uvs.data(), 2);
+        }
+        if(attributes.has("COLOR_0")){
+            asset.readFloats(static_cast<size_t>(attributes["COLOR_0"].integer()), colors.data(), 3);
+        }
+        asset.readUints(static_cast<size_t>(attributes["JOINTS_0"].integer()), joint_ids.data(), 4);
+        asset.readFloats(static_cast<size_t>(attributes["WEIGHTS_0"].integer()), weights.data(), 4);
+
+        model.vertices.resize(base + count);
+        for(size_t i = 0; i < count; i++){
+            SkinnedVertex& vertex = model.vertices[base + i];
+            float total = weights[i * 4] + weights[i * 4 + 1] + weights[i * 4 + 2] + weights[i * 4 + 3];
+            for(int c = 0; c < 3; c++){
+                vertex.position[c] = positions[i * 3 + c];
+                vertex.color[c] = colors[i * 3 + c];
+            }
+            vertex.u = uvs[i * 2];
+            vertex.v = uvs[i * 2 + 1];
+            for(int c = 0; c < 4; c++){
+                vertex.joints[c] = std::min<uint32_t>(joint_ids[i * 4 + c], static_cast<uint32_t>(joint_count - 1));
+                vertex.weights[c] = total > 0.0f ? weights[i * 4 + c] / total : (c == 0 ? 1.0f : 0.0f);
+            }
+
+            glm::vec3 p(positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]);
+            model.bounds_min = glm::min(model.bounds_min, p);
+            model.bounds_max = glm::max(model.bounds_max, p);
+        }
+
+        if(primitive.has("indices")){
+            size_t indices = static_cast<size_t>(primitive["indices"].integer());
+            size_t first = model.indices.size();
+            model.indices.resize(first + asset.accessor(indices).count);
+            asset.readUints(indices, model.indices.data() + first, 1);
+            for(size_t i = first; i < model.indices.size(); i++){
+                model.indices[i] += static_cast<uint32_t>(base);
+            }
+        } else {
+            for(size_t i = 0; i < count; i++){
+                model.indices.push_back(static_cast<uint32_t>(base + i));
+            }
+        }
+    }
+    if(model.vertices.empty()){
+        throw std::runtime_error("Skinned mesh of " + asset.path() + " has no skinned triangles.");
+    }
+
+    const json::Value& animations = doc["animations"];
+    for(size_t a = 0; a < animations.size(); a++){
+        const json::Value& animation = animations[a];
+        const json::Value& samplers = animation["samplers"];
+        const json::Value& channels = animation["channels"];
+
+        AnimationClip clip;
+        clip.name = animation["name"].string();
+        clip.tracks.resize(joint_count * AnimationClip::PATH_COUNT);
+        bool targets_skeleton = false;
+
+        for(size_t c = 0; c < channels.size(); c++){
+            const json::Value& target = channels[c]["target"];
+            size_t node = static_cast<size_t>(target["node"].integer(-1));
+            if(node >= nodes.size() || joint_of_node[node] < 0){
+                continue;
+            }
+
+            const std::string& path = target["path"].string();
+            uint32_t path_index;
+            if(path == "translation"){
+                path_index = AnimationClip::Translation;
+            } else if(path == "rotation"){
+                path_index = AnimationClip::Rotation;
+            } else if(path == "scale"){
+                path_index = AnimationClip::Scale;
+            } else {
+                continue;
+            }
+
+            const json::Value& sampler = samplers[static_cast<size_t>(channels[c]["sampler"].integer())];
+            const std::string& interpolation = sampler["interpolation"].string();
+            size_t input = static_cast<size_t>(sampler["input"].integer());
+            size_t output = static_cast<size_t>(sampler["output"].integer());
+
+            AnimationTrack& track = clip.tracks[joint_of_node[node] * AnimationClip::PATH_COUNT + path_index];
+            track.step = interpolation == "STEP";
+            track.times.resize(asset.accessor(input).count);
+            asset.readFloats(input, track.times.data(), 1);
+
+            std::vector<glm::vec4> values(asset.accessor(output).count);
+            asset.readFloats(output, &values.data()->x, 4);
+            if(interpolation == "CUBICSPLINE"){
+                //in-tangent, value, out-tangent per key; the tangents are dropped and the curve sampled linearly
+                track.values.resize(values.size() / 3);
+                for(size_t k = 0; k < track.values.size(); k++){
+                    track.values[k] = values[k * 3 + 1];
+                }
+            } else {
+                track.values = std::move(values);
+            }
+
+            if(track.times.empty() || track.values.size() < track.times.size()){
+                track = AnimationTrack{};
+                continue;
+            }
+            clip.duration = std::max(clip.duration, track.times.back());
+            targets_skeleton = true;
+        }
+
+        if(targets_skeleton){
+            model.clips.push_back(std::move(clip));
+        }
+    }
+
+    return model;
+}
+
+namespace animation{
+    void lerp4(const float* a, const float* b, float t, float* out){
+#if defined(DOMK_ANIM_SSE)
+        __m128 va = _mm_loadu_ps(a);
+        __m128 vb = _mm_loadu_ps(b);
+        _mm_storeu_ps(out, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), _mm_set1_ps(t))));
+#elif defined(DOMK_ANIM_NEON)
+        float32x4_t va = vld1q_f32(a);
+        vst1q_f32(out, vfmaq_n_f32(va, vsubq_f32(vld1q_f32(b), va), t));
+#else
+        for(int i = 0; i < 4; i++){
+            out[i] = a[i] + (b[i] - a[i]) * t;
+        }
+#endif
+    }
+
+    void nlerp4(const float* a, const float* b, float t, float* out){
+#if defined(DOMK_ANIM_SSE)
+        __m128 va = _mm_loadu_ps(a);
+        __m128 vb = _mm_loadu_ps(b);
+        //q and -q are the same rotation, flip b onto a's hemisphere for the shortest arc
+        __m128 sign = _mm_and_ps(dot4(va, vb), _mm_set1_ps(-0.0f));
+        vb = _mm_xor_ps(vb, sign);
+        __m128 q = _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), _mm_set1_ps(t)));
+        _mm_storeu_ps(out, _mm_div_ps(q, _mm_sqrt_ps(dot4(q, q))));
+#elif defined(DOMK_ANIM_NEON)
+        float32x4_t va = vld1q_f32(a);
+        float32x4_t vb = vld1q_f32(b);
+        if(vaddvq_f32(vmulq_f32(va, vb)) < 0.0f){
+            vb = vnegq_f32(vb);
+        }
+        float32x4_t q = vfmaq_n_f32(va, vsubq_f32(vb, va), t);
+        vst1q_f32(out, vmulq_n_f32(q, 1.0f / std::sqrt(vaddvq_f32(vmulq_f32(q, q)))));
+#else
+        float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+        float flip = dot < 0.0f ? -1.0f : 1.0f;
+        float q[4];
+        for(int i = 0; i < 4; i++){
+            q[i] = a[i] + (b[i] * flip - a[i]) * t;
+        }
+        float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        for(int i = 0; i < 4; i++){
+            out[i] = q[i] / length;
+        }
+#endif
+    }
+
+    void samplePose(const Skeleton& skeleton, const AnimationClip& clip, float time, JointPose* out){
+        if(clip.duration > 0.0f){
+            time = std::fmod(time, clip.duration);
+            if(time < 0.0f){
+                time += clip.duration;
+            }
+        }
+
+        for(size_t j = 0; j < skeleton.jointCount(); j++){
+            out[j] = skeleton.rest_pose[j];
+            const AnimationTrack* tracks = &clip.tracks[j * AnimationClip::PATH_COUNT];
+            if(!tracks[AnimationClip::Translation].times.empty()){
+                sampleTrack(tracks[AnimationClip::Translation], time, false, &out[j].translation.x);
+            }
+            if(!tracks[AnimationClip::Rotation].times.empty()){
+                sampleTrack(tracks[AnimationClip::Rotation], time, true, &out[j].rotation.x);
+            }
+            if(!tracks[AnimationClip::Scale].times.empty()){
+                sampleTrack(tracks[AnimationClip::Scale], time, false, &out[j].scale.x);
+            }
+        }
+    }
+
+    void blendPoses(const JointPose* a, const JointPose* b, float weight, size_t count, JointPose* out){
+        for(size_t j = 0; j < count; j++){
+            lerp4(&a[j].translation.x, &b[j].translation.x, weight, &out[j].translation.x);
+            nlerp4(&a[j].rotation.x, &b[j].rotation.x, weight, &out[j].rotation.x);
+            lerp4(&a[j].scale.x, &b[j].scale.x, weight, &out[j].scale.x);
+        }
+    }
+
+    void buildPalette(const Skeleton& skeleton, const JointPose* pose, glm::mat4* model, glm::mat4* palette){
+        for(uint32_t j : skeleton.order){
+            glm::mat4 local = composeMatrix(pose[j]);
+            int32_t parent = skeleton.parents[j];
+            model[j] = parent < 0 ? skeleton.root_transforms[j] * local : model[parent] * local;
+            palette[j] = model[j] * skeleton.inverse_bind[j];
+        }
+    }
+}
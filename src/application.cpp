@@ -12,13 +12,18 @@
 #include <limits>
 #include <algorithm>
 #include <fstream>
-#include <map>
 #include <set>
 #include <iostream>
 #include <vector>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 #include <chrono>
 #include <unordered_map>
+#include <filesystem>
+#include <cmath>
+#include <cstdio>
+#include "pixelformat.hpp"
+#include "allocations.hpp"
 
 void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator) {
     auto func = reinterpret_cast<PFN_vkDestroyDebugUtilsMessengerEXT>(
@@ -36,6 +41,8 @@ void Application::check_vk_result(VkResult result){
         throw std::runtime_error("Uh oh! Something happened!");
     }
 }
+Application::Application(const Options& launch_options) : options(launch_options) {}
+
 /*
     Starts the Application.
     First initializes the window, then Vulkan.
@@ -43,11 +50,49 @@ void Application::check_vk_result(VkResult result){
     After the main loop is over, cleans up and closes.
 */
 void Application::run() {
+    if(!options.benchmark_decode_dir.empty()){
+        benchmarkDecode();
+        return;
+    }
+    if(!options.benchmark_import_gltf.empty()){
+        benchmarkImport();
+        return;
+    }
+    if(options.benchmark_occlusion){
+        benchmarkOcclusion();
+        return;
+    }
+    if(options.benchmark_sort){
+        benchmarkSort();
+        return;
+    }
+
     initWindow();
     initVulkan();
     initImGUI();
+
+    //the upload benchmark ran in initVulkan, while the model's source data was still there
+    if(options.benchmark_upload){
+        cleanUp();
+        return;
+    }
+
+    if(options.benchmark_msaa){
+        for(VkSampleCountFlagBits count : {VK_SAMPLE_COUNT_1_BIT, VK_SAMPLE_COUNT_2_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_8_BIT}){
+            if(count <= max_msaa_samples){
+                msaa_bench.counts.push_back(count);
+            }
+        }
+        requested_msaa_samples = msaa_bench.counts[0];
+    }
+
     mainLoop();
     cleanUp();
+
+    //after cleanUp, so a failed check still tears down, main turns it into a failing exit code
+    if(options.count_allocations && allocation_check.allocations != 0){
+        throw std::runtime_error("Frames allocated on the heap in steady state.");
+    }
 }
 
 
@@ -104,27 +149,8 @@ void Application::framebufferResizeCallback(GLFWwindow* window, int new_width, i
     app->framebuffer_resized = true;
 }
 
-//Reads a file byte per byte
-std::vector<char> Application::readFile(const std::string& file_name){
-    std::ifstream file(file_name, std::ios::ate | std::ios::binary);
-
-    if(!file.is_open()){
-        throw std::runtime_error("Couldn't open file " + file_name + "!");
-    }
-
-    size_t file_size = (size_t) file.tellg();
-    std::vector<char> buffer(file_size);
-
-    file.seekg(0);
-    file.read(buffer.data(), file_size);
-
-    file.close();
-
-    return buffer;
-}
-
 //Create buffer
-void Application::createBuffer(Application::BufferCreateInfo *create_info){
+void Application::createBuffer(Application::BufferCreateInfo *create_info, std::source_location where){
     VkBufferCreateInfo bci{};
     bci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bci.size = create_info->size;
@@ -134,7 +160,7 @@ void Application::createBuffer(Application::BufferCreateInfo *create_info){
     bci.queueFamilyIndexCount = create_info->family_count;
 
 
-    if(vkCreateBuffer(device, &bci, nullptr, create_info->buffer) != VK_SUCCESS){
+    if(tracker.createBuffer(bci, *create_info->buffer, create_info->tag, where) != VK_SUCCESS){
         throw std::runtime_error("Could'nt create buffer.");
     }
 
@@ -146,14 +172,14 @@ void Application::createBuffer(Application::BufferCreateInfo *create_info){
     alloci.allocationSize = memreq.size;
     alloci.memoryTypeIndex = findMemoryType(memreq.memoryTypeBits, create_info->properties);
 
-    if(vkAllocateMemory(device, &alloci, nullptr, create_info->buffer_memory) != VK_SUCCESS){
+    if(tracker.allocateMemory(alloci, *create_info->buffer_memory, create_info->tag, where) != VK_SUCCESS){
         throw std::runtime_error("Failed to allocate buffer memory.");
     }
 
     vkBindBufferMemory(device, *create_info->buffer, *create_info->buffer_memory, 0);
 }
 
-void Application::createImage(ImageCreateInfo *create_info){
+void Application::createImage(ImageCreateInfo *create_info, std::source_location where){
 
     VkImageCreateInfo ici{};
     ici.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -173,7 +199,7 @@ void Application::createImage(ImageCreateInfo *create_info){
     ici.samples = create_info->sample_count;
     
 
-    if(vkCreateImage(device, &ici, nullptr, create_info->image) != VK_SUCCESS){
+    if(tracker.createImage(ici, *create_info->image, create_info->tag, where) != VK_SUCCESS){
         throw std::runtime_error("Couldn't create image.");
     }
 
@@ -182,10 +208,13 @@ void Application::createImage(ImageCreateInfo *create_info){
 
     VkMemoryAllocateInfo alloci{};
     alloci.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    alloci.memoryTypeIndex = findMemoryType(memreq.memoryTypeBits, create_info->mem_props);
+    alloci.memoryTypeIndex = findMemoryTypeIndex(memreq.memoryTypeBits, create_info->mem_props);
+    if(alloci.memoryTypeIndex == UINT32_MAX){
+        alloci.memoryTypeIndex = findMemoryType(memreq.memoryTypeBits, create_info->fallback_mem_props);
+    }
     alloci.allocationSize = memreq.size;
 
-    if(vkAllocateMemory(device, &alloci, nullptr, create_info->memory) != VK_SUCCESS) {
+    if(tracker.allocateMemory(alloci, *create_info->memory, create_info->tag, where) != VK_SUCCESS) {
         throw std::runtime_error("Couldn't allocate memory for image.");
     }
 
@@ -194,112 +223,6 @@ void Application::createImage(ImageCreateInfo *create_info){
     }
 }
 
-VkCommandBuffer Application::beginSingleTimeCommands(){
-    VkCommandBufferAllocateInfo ai{};
-    ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    ai.commandPool = cmdp;
-    ai.commandBufferCount = 1;
-
-    VkCommandBuffer buffer;
-    vkAllocateCommandBuffers(device, & ai, &buffer);
-
-    VkCommandBufferBeginInfo bi{};
-    bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    vkBeginCommandBuffer(buffer, &bi);
-
-    return buffer;
-}
-
-void Application::endSingleTimeCommands(VkCommandBuffer buffer){
-    vkEndCommandBuffer(buffer);
-
-    VkSubmitInfo si{};
-    si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    si.commandBufferCount = 1;
-    si.pCommandBuffers = &buffer;
-    
-    vkQueueSubmit(graphics_queue, 1, &si, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphics_queue);
-    
-    vkFreeCommandBuffers(device, cmdp, 1, &buffer);
-    
-}
-
-void Application::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout){
-    VkCommandBuffer buffer = beginSingleTimeCommands();
-
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout = old_layout;
-    barrier.newLayout = new_layout;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = image;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-
-    VkPipelineStageFlags source_stage;
-    VkPipelineStageFlags destination_stage;
-
-
-    if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-        source_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        destination_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    } else if (old_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && new_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        source_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        destination_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    } else {
-        throw std::invalid_argument("unsupported layout transition!");
-    }
-
-    barrier.srcAccessMask = 0;
-    barrier.dstAccessMask = 0;
-    
-
-
-    vkCmdPipelineBarrier(buffer, source_stage, destination_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-
-    endSingleTimeCommands(buffer);
-}
-
-void Application::copyBufferImage(VkBuffer srcbuffer, VkImage dstimage, uint32_t width, uint32_t height){
-    VkCommandBuffer buffer = beginSingleTimeCommands();
-    VkBufferImageCopy bic{};
-    bic.bufferOffset = 0;
-    bic.bufferImageHeight = 0;
-    bic.bufferRowLength = 0;
-    bic.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-
-    bic.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    bic.imageSubresource.mipLevel = 0;
-    bic.imageSubresource.baseArrayLayer = 0;
-    bic.imageSubresource.layerCount = 1;
-
-    bic.imageOffset = {0, 0, 0};
-    bic.imageExtent = {
-        width,
-        height,
-        1
-    };
-
-    vkCmdCopyBufferToImage(buffer, srcbuffer, dstimage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bic);
-
-    endSingleTimeCommands(buffer);
-
-}
-
 VkImageView Application::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect){
     VkImageViewCreateInfo ci{};
     ci.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -339,28 +262,111 @@ void Application::initWindow() {
 
 //Creates the Vulkan Instance.
 void Application::initVulkan() {
+    phase_start = std::chrono::steady_clock::now();
+    if(!options.archive.empty()){
+        openArchive();
+    }
     createInstance();
     createSurface();
+    endStartupPhase("instance and surface");
     pickPhysicalDevice();
+    endStartupPhase("device selection");
     createLogicalDevice();
+    endStartupPhase("logical device");
     createSwapChain();
     createImageViews();
-    createRenderPass();
+    if(!dynamic_rendering){
+        createRenderPass();
+    }
+    endStartupPhase("swapchain");
     createDescriptorSetLayout();
+    createPipelineCache();
     createGraphicsPipeline();
+    endStartupPhase("pipelines");
     createCommandPoolBuffer();
-    createDepthResources();
-    createFrameBuffers();
+    createGeometryPool();
+    if(occlusion_culling){
+        createOcclusionCuller();
+    }
+    if(dynamic_rendering){
+        buildRenderGraph();
+    } else {
+        createColorResources();
+        createDepthResources();
+        createFrameBuffers();
+    }
+    endStartupPhase("render targets");
     createTextureImage();
     createTextureImageView();
     createTextureSampler();
+    endStartupPhase("texture");
     loadModel();
-    createVertexBuffer();
-    createIndexBuffer();
+    if(software_occlusion){
+        collectOccluders();
+    }
+    uploadModel();
+    if(options.benchmark_upload){
+        benchmarkUpload();
+    }
+    if(occlusion_culling){
+        occlusion.reserve(static_cast<uint32_t>(scene_draws.size()));
+    }
+    endStartupPhase("model");
     createUniformBuffers();
+    reserveDraws(static_cast<uint32_t>(scene_draws.size()));
+    if(bindless){
+        createTextureStreamer();
+    }
     createDescriptorPool();
     createDescriptorSets();
+    if(bindless){
+        createBindlessSet();
+    }
     createSyncObjects();
+    frame_arena.setup(MAX_FLIGHT_FRAMES, FRAME_ARENA_BYTES);
+    endStartupPhase("descriptors and sync");
+    if(timeline_semaphores){
+        createAsyncCompute();
+    } else if(!options.skinned_model.empty()){
+        std::cerr << "Skinning needs timeline semaphores, " << options.skinned_model << " isn't loaded." << std::endl;
+    }
+    endStartupPhase("async compute");
+
+    //everything that read the mapped glTF file or package has run
+    gltf_scene.reset();
+    gltf_asset.reset();
+    mesh_package.reset();
+
+    if(options.hot_reload){
+        setupHotReload();
+    }
+    endStartupPhase("hot reload");
+    printStartupTimes();
+}
+
+void Application::endStartupPhase(const char* name){
+    auto now = std::chrono::steady_clock::now();
+    startup_phases.push_back({name, std::chrono::duration<double, std::milli>(now - phase_start).count()});
+    phase_start = now;
+}
+
+//Where startup went. Device selection includes querying every device once; nothing after it queries the device again.
+void Application::printStartupTimes() const {
+    double total = 0.0;
+    for(const auto& [name, ms] : startup_phases){
+        total += ms;
+    }
+
+    std::cout << std::endl << "Startup: " << total << " ms" << std::endl;
+    for(const auto& [name, ms] : startup_phases){
+        std::cout << "  " << name << ": " << ms << " ms" << std::endl;
+    }
+    std::cout << "  device queries, within device selection: " << device_info_ms << " ms" << std::endl;
+
+    const ImmediateCommands::Stats& uploads = immediate.stats();
+    std::cout << "  one-off graphics work: " << uploads.transitions << " transitions in " << uploads.barriers
+        << " barriers, " << uploads.copies << " copies, " << uploads.submits << " waits; transfer: "
+        << transfer_immediate.stats().submits << " waits" << std::endl;
 }
 
 /*
@@ -446,7 +452,10 @@ void Application::createSurface(){
 
 }
 
-//Picks the best GPU available.
+/*
+    Picks the GPU to use: the suitable device with the best capability score, or the one named by --device.
+    The chosen device's capabilities then decide which optional paths get enabled.
+*/
 void Application::pickPhysicalDevice(){
     uint32_t device_count;
     vkEnumeratePhysicalDevices(instance, &device_count, nullptr);
@@ -458,101 +467,275 @@ void Application::pickPhysicalDevice(){
     std::vector<VkPhysicalDevice> devices(device_count);
     vkEnumeratePhysicalDevices(instance, &device_count, devices.data());
 
-    std::multimap<int, VkPhysicalDevice> map;
-
-    for(VkPhysicalDevice d : devices){
-        VkPhysicalDeviceFeatures features;
-        vkGetPhysicalDeviceFeatures(d, &features);
+    int64_t best_score = -1;
+    bool overridden = false;
+    std::optional<uint32_t> chosen_index;
+    std::vector<DeviceInfo> infos(device_count);
+
+    std::cout << std::endl << "Devices:" << std::endl;
+    for(uint32_t i = 0; i < device_count; i++){
+        infos[i].query(devices[i], surface);
+        device_info_ms += infos[i].queryMs();
+        const VkPhysicalDeviceProperties& properties = infos[i].properties();
+        bool suitable = isDeviceSuitable(infos[i]);
+
+        DeviceCapabilities caps{};
+        int64_t score = -1;
+        if(suitable){
+            caps = queryCapabilities(infos[i]);
+            score = scoreDevice(caps);
+        }
 
-        if(!features.geometryShader) continue;
+        std::cout << "  [" << i << "] " << properties.deviceName;
+        if(suitable){
+            std::cout << " score " << score << std::endl;
+        } else {
+            std::cout << " (unsuitable)" << std::endl;
+        }
 
-        uint32_t device_score = 0;
-        
-        VkPhysicalDeviceProperties properties;
-        vkGetPhysicalDeviceProperties(d, &properties);
+        bool requested = !options.device.empty() && !overridden
+            && (options.device == std::to_string(i) || std::string(properties.deviceName).find(options.device) != std::string::npos);
+        if(requested){
+            if(!suitable){
+                throw std::runtime_error("Requested device " + std::string(properties.deviceName) + " is not suitable.");
+            }
+            overridden = true;
+        }
 
-        if(properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU){
-            device_score += 1;
+        if(requested || (!overridden && suitable && score > best_score)){
+            p_device = devices[i];
+            device_caps = caps;
+            best_score = score;
+            chosen_index = i;
         }
+    }
 
-        device_score += properties.limits.maxImageDimension2D;
+    if(!options.device.empty() && !overridden){
+        throw std::runtime_error("No device matches --device " + options.device + ".");
+    }
+    if(p_device == VK_NULL_HANDLE){
+        throw std::runtime_error("No suitable GPU found.");
+    }
+    std::cout << "Using " << device_caps.properties.deviceName << std::endl;
+    device_info = std::move(infos[chosen_index.value()]);
+    queue_families = findQueueFamilies(device_info);
+    depth_format = device_info.findFormat({VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D32_SFLOAT},
+        VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+    if(depth_format == VK_FORMAT_UNDEFINED){
+        throw std::runtime_error("No supported depth format.");
+    }
+
+    const VkPhysicalDeviceProperties& chosen = device_caps.properties;
 
-        map.insert(std::make_pair(device_score, d));
+    //highest sample count usable for both the color and the depth attachment
+    VkSampleCountFlags sample_counts = chosen.limits.framebufferColorSampleCounts & chosen.limits.framebufferDepthSampleCounts;
+    for(VkSampleCountFlagBits count : {VK_SAMPLE_COUNT_64_BIT, VK_SAMPLE_COUNT_32_BIT, VK_SAMPLE_COUNT_16_BIT,
+        VK_SAMPLE_COUNT_8_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_2_BIT}){
+        if(sample_counts & count){
+            max_msaa_samples = count;
+            break;
+        }
     }
+    msaa_samples = max_msaa_samples;
+    requested_msaa_samples = max_msaa_samples;
+
+    dynamic_rendering = device_caps.dynamic_rendering;
+    dynamic_rendering_ext = dynamic_rendering && chosen.apiVersion < VK_API_VERSION_1_3;
+
+    memory_budget = device_caps.memory_budget;
 
-    if(map.empty()){
-        throw std::runtime_error("No GPUS with Vulkan support found and i dont know how we got here.");
+    bindless = device_caps.bindless;
+    bindless_ext = bindless && chosen.apiVersion < VK_API_VERSION_1_2;
+
+    timeline_semaphores = device_caps.timeline_semaphores;
+    timeline_semaphores_ext = timeline_semaphores && chosen.apiVersion < VK_API_VERSION_1_2;
+
+    multi_draw_indirect = device_caps.multi_draw_indirect;
+    indirect_first_instance = device_caps.indirect_first_instance;
+
+    //the culling passes are render graph passes and record sync2 barriers, their commands pick DrawData by first instance
+    occlusion_culling = options.occlusion_culling && dynamic_rendering && device_caps.extended_storage_formats
+        && indirect_first_instance;
+    //on a CPU device like lavapipe those passes would run on the CPU as well, a small rasterizer is cheaper there
+    software_occlusion = options.occlusion_culling
+        && (options.software_occlusion || !occlusion_culling || chosen.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU);
+    occlusion_culling = occlusion_culling && !software_occlusion;
+
+    if(bindless){
+        const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& indexing = device_info.descriptorIndexingProperties();
+        bindless_capacity = std::min({MAX_BINDLESS_TEXTURES,
+            indexing.maxDescriptorSetUpdateAfterBindSampledImages,
+            indexing.maxPerStageDescriptorUpdateAfterBindSampledImages});
     }
-    p_device = map.rbegin()->second;
 }
 
 //Checks if a Physical Device(GPU) is suitable for usage
-bool Application::isDeviceSuitable(VkPhysicalDevice target, VkPhysicalDeviceFeatures& features, VkPhysicalDeviceProperties& properties) const {
-    vkGetPhysicalDeviceFeatures(target, &features);
-    vkGetPhysicalDeviceProperties(target, &properties);
+bool Application::isDeviceSuitable(const DeviceInfo& info) const {
+    QueueFamilyIndices indices = findQueueFamilies(info);
 
-    QueueFamilyIndices indices = findQueueFamilies(target);
-
-    bool extensions_supported = checkDeviceExtensionsSupported(target);
+    bool extensions_supported = checkDeviceExtensionsSupported(info);
 
     bool swapchain_adequate = false;
     if(extensions_supported){
-        SwapChainSupportDetails details = querySwapchainSupport(target);
+        SwapChainSupportDetails details = querySwapchainSupport(info.physicalDevice());
         swapchain_adequate = !details.formats.empty();
     }
 
-    return indices.isComplete() && extensions_supported && swapchain_adequate && features.samplerAnisotropy;
+    return indices.isComplete() && extensions_supported && swapchain_adequate && info.features().samplerAnisotropy;
+}
+
+/*
+    Collects everything scoreDevice weighs. Only called for suitable devices.
+*/
+Application::DeviceCapabilities Application::queryCapabilities(const DeviceInfo& info) const {
+    DeviceCapabilities caps{};
+    caps.properties = info.properties();
+
+    const VkPhysicalDeviceMemoryProperties& memory = info.memory();
+    for(uint32_t heap = 0; heap < memory.memoryHeapCount; heap++){
+        if(memory.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT){
+            caps.device_local_bytes = std::max(caps.device_local_bytes, memory.memoryHeaps[heap].size);
+        }
+    }
+
+    QueueFamilyIndices indices = findQueueFamilies(info);
+    caps.dedicated_transfer = indices.transfer != indices.graphics;
+    caps.async_compute = indices.compute.has_value();
+    caps.present_on_graphics = indices.present == indices.graphics;
+
+    caps.dynamic_rendering = checkDynamicRenderingSupport(info);
+    caps.bindless = checkBindlessSupport(info);
+    caps.timeline_semaphores = checkTimelineSemaphoreSupport(info);
+    caps.memory_budget = info.hasExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    const VkPhysicalDeviceFeatures& features = info.features();
+    caps.extended_storage_formats = features.shaderStorageImageExtendedFormats;
+    caps.multi_draw_indirect = features.multiDrawIndirect;
+    caps.indirect_first_instance = features.drawIndirectFirstInstance;
+
+    return caps;
+}
+
+/*
+    Device type dominates, so a discrete GPU wins over an integrated one on hybrid laptops and a
+    software rasterizer like lavapipe is only used when nothing else is there. Within a type,
+    more device local memory, separate transfer/compute queues and the optional fast paths decide.
+*/
+int64_t Application::scoreDevice(const DeviceCapabilities& caps){
+    int64_t score = 0;
+
+    switch(caps.properties.deviceType){
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: score += 100000; break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score += 50000; break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: score += 20000; break;
+        default: break;
+    }
+
+    //a point per 64 MiB, capped at 32 GiB so a huge heap can't outweigh missing features
+    VkDeviceSize mib = caps.device_local_bytes / (1024 * 1024);
+    score += static_cast<int64_t>(std::min<VkDeviceSize>(mib, 32 * 1024) / 64);
+
+    if(caps.dedicated_transfer) score += 1000;
+    if(caps.async_compute) score += 1000;
+    if(caps.present_on_graphics) score += 500;
+    if(caps.dynamic_rendering) score += 2000;
+    if(caps.bindless) score += 2000;
+    if(caps.timeline_semaphores) score += 1000;
+    if(caps.memory_budget) score += 250;
 
+    return score;
 }
 
 //Checks if a Physical Device(GPU) supports all required extensions
-bool Application::checkDeviceExtensionsSupported(VkPhysicalDevice target) const {
-    uint32_t extension_count;
-    vkEnumerateDeviceExtensionProperties(target, nullptr, &extension_count, nullptr);
+bool Application::checkDeviceExtensionsSupported(const DeviceInfo& info) const {
+    for(const char* extension : DEVICE_EXTENSIONS){
+        if(!info.hasExtension(extension)){
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+    Checks if the Physical Device can render without VkRenderPass/VkFramebuffer objects.
+    Vulkan 1.3 devices expose dynamic rendering and synchronization2 as core features,
+    1.2 devices can still get them through VK_KHR_dynamic_rendering and VK_KHR_synchronization2.
+*/
+bool Application::checkDynamicRenderingSupport(const DeviceInfo& info) const {
+    uint32_t version = info.properties().apiVersion;
+    if(version < VK_API_VERSION_1_3 && (version < VK_API_VERSION_1_2
+        || !info.hasExtension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)
+        || !info.hasExtension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME))){
+        return false;
+    }
+
+    return info.dynamicRenderingFeatures().dynamicRendering && info.synchronization2Features().synchronization2;
+}
+
+//Checks if the Physical Device can index a large, partially bound, update-after-bind texture array.
+bool Application::checkBindlessSupport(const DeviceInfo& info) const {
+    if(info.properties().apiVersion < VK_API_VERSION_1_2 && !info.hasExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)){
+        return false;
+    }
 
-    std::vector<VkExtensionProperties> extensions(extension_count);
-    vkEnumerateDeviceExtensionProperties(target, nullptr, &extension_count, extensions.data());
+    const VkPhysicalDeviceDescriptorIndexingFeaturesEXT& indexing = info.descriptorIndexingFeatures();
 
-    std::set<std::string> required_extensions(DEVICE_EXTENSIONS.begin(), DEVICE_EXTENSIONS.end());
+    //texture streaming rides on the bindless path: slots are swapped while frames are in flight
+    //and the fragment shader writes mip feedback
+    return indexing.shaderSampledImageArrayNonUniformIndexing
+        && indexing.descriptorBindingSampledImageUpdateAfterBind
+        && indexing.descriptorBindingPartiallyBound
+        && indexing.descriptorBindingUpdateUnusedWhilePending
+        && indexing.runtimeDescriptorArray
+        && info.features().fragmentStoresAndAtomics;
+}
 
-    for(VkExtensionProperties extension:extensions){
-        required_extensions.erase(extension.extensionName);
+//Checks for timeline semaphores, core in 1.2 or VK_KHR_timeline_semaphore.
+bool Application::checkTimelineSemaphoreSupport(const DeviceInfo& info) const {
+    if(info.properties().apiVersion < VK_API_VERSION_1_2 && !info.hasExtension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)){
+        return false;
     }
 
-    return required_extensions.empty();
+    return info.timelineSemaphoreFeatures().timelineSemaphore;
 }
 
-//Finds all queueFamilies supported by the Physical Device
-Application::QueueFamilyIndices Application::findQueueFamilies(VkPhysicalDevice target) const {
+/*
+    Finds the queue families to use on the Physical Device.
+    Prefers presenting from the graphics family, a transfer-only family for uploads (the copy engine
+    on discrete GPUs) and a compute family without graphics for async compute.
+*/
+Application::QueueFamilyIndices Application::findQueueFamilies(const DeviceInfo& info) const {
     QueueFamilyIndices indices;
 
-    uint32_t family_count;
-    vkGetPhysicalDeviceQueueFamilyProperties(target, &family_count, nullptr);
+    const std::vector<VkQueueFamilyProperties>& families = info.queueFamilies();
+    uint32_t family_count = static_cast<uint32_t>(families.size());
+
+    const VkQueueFlags graphics_compute = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+
+    for(uint32_t i = 0; i < family_count; i++){
+        VkQueueFlags flags = families[i].queueFlags;
 
-    std::vector<VkQueueFamilyProperties> families(family_count);
-    vkGetPhysicalDeviceQueueFamilyProperties(target, &family_count, families.data());
+        bool present_support = info.canPresent(i);
 
-    uint32_t i = 0;
-    for(VkQueueFamilyProperties family : families){
-        if (family.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        if((flags & VK_QUEUE_GRAPHICS_BIT) && (!indices.graphics || (present_support && indices.present != indices.graphics))){
             indices.graphics = i;
         }
-        if (family.queueFlags & VK_QUEUE_TRANSFER_BIT){
-            indices.transfer = i;
+        if(present_support && (!indices.present || indices.present != indices.graphics)){
+            indices.present = i;
         }
 
-        VkBool32 present_support = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(target, i, surface, &present_support);
-
-        if (present_support) {
-            indices.present = i;
+        if((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & graphics_compute) && !indices.transfer){
+            indices.transfer = i;
         }
 
-        if (indices.isComplete()) {
-            break;
+        if((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && !indices.compute){
+            indices.compute = i;
         }
+    }
 
-        i++;
+    //graphics queues implicitly support transfers
+    if(!indices.transfer){
+        indices.transfer = indices.graphics;
     }
 
     return indices;
@@ -562,7 +745,7 @@ Application::QueueFamilyIndices Application::findQueueFamilies(VkPhysicalDevice
 void Application::createSwapChain(){
     SwapChainSupportDetails details = querySwapchainSupport(p_device);
 
-    VkPresentModeKHR present = choosePresentMode(details.present_modes);
+    VkPresentModeKHR present = choosePresentMode(details.present_modes, options.benchmark_msaa);
     VkSurfaceFormatKHR format = chooseFormat(details.formats);
     VkExtent2D extent = chooseSwapExtent(details.capabilities);
 
@@ -578,7 +761,7 @@ void Application::createSwapChain(){
     ci.imageArrayLayers = 1;
     ci.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-    QueueFamilyIndices indices = findQueueFamilies(p_device);
+    QueueFamilyIndices indices = queue_families;
     uint32_t queueFamilyIndices[] = {indices.graphics.value(), indices.present.value()};
 
     if (indices.graphics != indices.present) {
@@ -636,8 +819,16 @@ Application::SwapChainSupportDetails Application::querySwapchainSupport(VkPhysic
     return details;
 }
 
-//Chooses preferred VkPresentModeKHR from a list of available present modes.
-VkPresentModeKHR Application::choosePresentMode(const std::vector<VkPresentModeKHR>& available_modes){
+//Chooses preferred VkPresentModeKHR from a list of available present modes. Benchmarks want frames not capped by vsync.
+VkPresentModeKHR Application::choosePresentMode(const std::vector<VkPresentModeKHR>& available_modes, bool uncapped){
+    if(uncapped){
+        for(VkPresentModeKHR mode : available_modes){
+            if(mode == VK_PRESENT_MODE_IMMEDIATE_KHR){
+                return mode;
+            }
+        }
+    }
+
     for(VkPresentModeKHR mode : available_modes){
         if(mode == VK_PRESENT_MODE_MAILBOX_KHR){
             return mode;
@@ -682,7 +873,7 @@ VkExtent2D Application::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabil
 
 //Creates the logical device to interface with the p_device
 void Application::createLogicalDevice(){
-    Application::QueueFamilyIndices indices = findQueueFamilies(p_device);
+    Application::QueueFamilyIndices indices = queue_families;
 
     std::vector<VkDeviceQueueCreateInfo> cis;
     std::set<uint32_t> families = {
@@ -690,6 +881,9 @@ void Application::createLogicalDevice(){
         indices.present.value(),
         indices.transfer.value()
     };
+    if(indices.compute && timeline_semaphores){
+        families.insert(indices.compute.value());
+    }
 
     float priority = 1.0f;
     for (uint32_t family : families) {
@@ -703,10 +897,78 @@ void Application::createLogicalDevice(){
 
     VkPhysicalDeviceFeatures features{};
     features.samplerAnisotropy = VK_TRUE;
+    features.shaderStorageImageExtendedFormats = occlusion_culling;
+    features.multiDrawIndirect = multi_draw_indirect;
+    features.drawIndirectFirstInstance = indirect_first_instance;
+
+    std::vector<const char*> extensions(DEVICE_EXTENSIONS.begin(), DEVICE_EXTENSIONS.end());
+
+    //optional features are pushed onto the front of this pNext chain
+    void* feature_chain = nullptr;
+
+    VkPhysicalDeviceVulkan13Features features13{};
+    features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR rendering_features{};
+    rendering_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+
+    VkPhysicalDeviceSynchronization2FeaturesKHR sync2_features{};
+    sync2_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+
+    if(dynamic_rendering && !dynamic_rendering_ext){
+        features13.dynamicRendering = VK_TRUE;
+        features13.synchronization2 = VK_TRUE;
+        features13.pNext = feature_chain;
+        feature_chain = &features13;
+    } else if(dynamic_rendering){
+        extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+        extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+
+        rendering_features.dynamicRendering = VK_TRUE;
+        rendering_features.pNext = feature_chain;
+        sync2_features.synchronization2 = VK_TRUE;
+        sync2_features.pNext = &rendering_features;
+        feature_chain = &sync2_features;
+    }
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing_features{};
+    indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+    if(bindless){
+        if(bindless_ext){
+            extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        }
+        indexing_features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        indexing_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        indexing_features.descriptorBindingPartiallyBound = VK_TRUE;
+        indexing_features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        indexing_features.runtimeDescriptorArray = VK_TRUE;
+        features.fragmentStoresAndAtomics = VK_TRUE;
+        indexing_features.pNext = feature_chain;
+        feature_chain = &indexing_features;
+    }
+
+    //the standalone struct rather than VkPhysicalDeviceVulkan12Features, which can't share the chain with indexing_features
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_features{};
+    timeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+
+    if(timeline_semaphores){
+        if(timeline_semaphores_ext){
+            extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+        }
+        timeline_features.timelineSemaphore = VK_TRUE;
+        timeline_features.pNext = feature_chain;
+        feature_chain = &timeline_features;
+    }
+
+    if(memory_budget){
+        extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
 
     VkDeviceCreateInfo deviceci{};
 
     deviceci.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceci.pNext = feature_chain;
     deviceci.queueCreateInfoCount = static_cast<uint32_t>(cis.size());
     deviceci.pQueueCreateInfos = cis.data();
 
@@ -714,16 +976,47 @@ void Application::createLogicalDevice(){
     
     deviceci.enabledLayerCount = 0;
 
-    deviceci.enabledExtensionCount = static_cast<uint32_t>(DEVICE_EXTENSIONS.size());
-    deviceci.ppEnabledExtensionNames = DEVICE_EXTENSIONS.data(); 
+    deviceci.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    deviceci.ppEnabledExtensionNames = extensions.data(); 
 
     if (vkCreateDevice(p_device, &deviceci, nullptr, &device) != VK_SUCCESS) {
         throw std::runtime_error("Couldn't create logical device.");
     }
 
+    ResourceTracker::Context tracker_ctx{};
+    tracker_ctx.device = device;
+    tracker_ctx.device_info = &device_info;
+    tracker_ctx.memory_budget = memory_budget;
+    tracker.setup(tracker_ctx);
+
     vkGetDeviceQueue(device, indices.graphics.value(), 0, &graphics_queue);
     vkGetDeviceQueue(device, indices.present.value(), 0, &present_queue);
     vkGetDeviceQueue(device, indices.transfer.value(), 0, &transfer_queue);
+    if(indices.compute && timeline_semaphores){
+        vkGetDeviceQueue(device, indices.compute.value(), 0, &compute_queue);
+    } else {
+        compute_queue = graphics_queue;
+    }
+
+    loadDynamicRenderingFunctions();
+}
+
+//Core 1.3 and KHR entry points share signatures, only the name differs.
+void Application::loadDynamicRenderingFunctions(){
+    if(!dynamic_rendering){
+        return;
+    }
+
+    cmd_begin_rendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(
+        vkGetDeviceProcAddr(device, dynamic_rendering_ext ? "vkCmdBeginRenderingKHR" : "vkCmdBeginRendering"));
+    cmd_end_rendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(
+        vkGetDeviceProcAddr(device, dynamic_rendering_ext ? "vkCmdEndRenderingKHR" : "vkCmdEndRendering"));
+    cmd_pipeline_barrier2 = reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(
+        vkGetDeviceProcAddr(device, dynamic_rendering_ext ? "vkCmdPipelineBarrier2KHR" : "vkCmdPipelineBarrier2"));
+
+    if(cmd_begin_rendering == nullptr || cmd_end_rendering == nullptr || cmd_pipeline_barrier2 == nullptr){
+        throw std::runtime_error("Couldn't load dynamic rendering functions.");
+    }
 }
 
 //Creates the an image view for each VkImage in sc_images.
@@ -745,41 +1038,72 @@ void Application::recreateSwapChain(){
 
     vkDeviceWaitIdle(device);
 
+    //sc_format and sc_extent are pipeline inputs, a rebuild on the reload thread mustn't read them halfway
+    //through and one built from the old ones is dropped
+    std::lock_guard<std::mutex> lock(pipeline_mutex);
+    pipeline_generation++;
+
     cleanupSwapChain();
 
     createSwapChain();
     createImageViews();
-    createDepthResources();
-    createFrameBuffers();
+    if(dynamic_rendering){
+        buildRenderGraph();
+    } else {
+        createColorResources();
+        createDepthResources();
+        createFrameBuffers();
+    }
+
+    //the projection depends on the aspect ratio
+    camera_version++;
 }
 
 void Application::cleanupSwapChain(){
+    render_graph.reset();
     for(VkFramebuffer buffer : sc_fb){
         vkDestroyFramebuffer(device, buffer, nullptr);
     }
     for(VkImageView view : sc_views){
         vkDestroyImageView(device, view, nullptr);
     }
-    vkDestroyImage(device, depth_tex, nullptr);
+    vkDestroyImageView(device, depth_view, nullptr);
+    tracker.destroyImage(depth_tex);
+    tracker.freeMemory(depth_memory);
+    depth_view = nullptr;
+    depth_tex = nullptr;
+    depth_memory = nullptr;
+    vkDestroyImageView(device, color_view, nullptr);
+    tracker.destroyImage(color_tex);
+    tracker.freeMemory(color_memory);
+    color_view = nullptr;
+    color_tex = nullptr;
+    color_memory = nullptr;
     vkDestroySwapchainKHR(device, swapchain, nullptr);
 }
 
+/*
+    Without MSAA the swapchain image is the color attachment.
+    With MSAA the subpass renders into the transient multisampled color_tex and resolves into the swapchain image at the end of the subpass.
+*/
 void Application::createRenderPass(){
+    bool multisampled = msaa_samples != VK_SAMPLE_COUNT_1_BIT;
+
     VkAttachmentDescription color_att{};
     color_att.format = sc_format;
-    color_att.samples = VK_SAMPLE_COUNT_1_BIT;
+    color_att.samples = msaa_samples;
     color_att.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    color_att.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    color_att.storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
 
     color_att.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     color_att.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 
     color_att.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    color_att.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    color_att.finalLayout = multisampled ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
     
     VkAttachmentDescription depth_att{};
-    depth_att.format = VK_FORMAT_D32_SFLOAT_S8_UINT;
-    depth_att.samples = VK_SAMPLE_COUNT_1_BIT;
+    depth_att.format = depth_format;
+    depth_att.samples = msaa_samples;
     depth_att.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     depth_att.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 
@@ -789,6 +1113,18 @@ void Application::createRenderPass(){
     depth_att.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     depth_att.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
+    VkAttachmentDescription resolve_att{};
+    resolve_att.format = sc_format;
+    resolve_att.samples = VK_SAMPLE_COUNT_1_BIT;
+    resolve_att.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    resolve_att.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+    resolve_att.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    resolve_att.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+    resolve_att.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    resolve_att.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
     VkAttachmentReference depth_ref{};
     depth_ref.attachment = 1;
     depth_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
@@ -796,18 +1132,23 @@ void Application::createRenderPass(){
     VkAttachmentReference att_ref{};
     att_ref.attachment = 0;
     att_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference resolve_ref{};
+    resolve_ref.attachment = 2;
+    resolve_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
     
-    std::array<VkAttachmentDescription, 2> attachments = {color_att, depth_att};
+    std::array<VkAttachmentDescription, 3> attachments = {color_att, depth_att, resolve_att};
     
     VkSubpassDescription subpass{};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &att_ref;
     subpass.pDepthStencilAttachment = &depth_ref;
+    subpass.pResolveAttachments = multisampled ? &resolve_ref : nullptr;
 
     VkRenderPassCreateInfo rp_ci{};
     rp_ci.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    rp_ci.attachmentCount = static_cast<uint32_t>(attachments.size());
+    rp_ci.attachmentCount = multisampled ? 3 : 2;
     rp_ci.pAttachments = attachments.data();
     rp_ci.subpassCount = 1;
     rp_ci.pSubpasses = &subpass;
@@ -833,7 +1174,7 @@ void Application::createDescriptorSetLayout(){
     VkDescriptorSetLayoutBinding binding{};
     binding.binding = 0;
     binding.descriptorCount = 1;
-    binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     binding.pImmutableSamplers = nullptr;
 
@@ -844,7 +1185,35 @@ void Application::createDescriptorSetLayout(){
     cis.pImmutableSamplers = nullptr;
     cis.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-    std::array<VkDescriptorSetLayoutBinding, 2> bindings = {binding, cis};
+    //per-frame slice of the texture streaming feedback, only the bindless shader writes it
+    VkDescriptorSetLayoutBinding feedback{};
+    feedback.binding = 2;
+    feedback.descriptorCount = 1;
+    feedback.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    feedback.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    //per-frame slice of the draw ring, the DrawData of every draw
+    VkDescriptorSetLayoutBinding draws{};
+    draws.binding = 3;
+    draws.descriptorCount = 1;
+    draws.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    draws.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    //per-frame slice of the streamed texture table, so publishing a texture never rewrites what a frame in flight reads
+    VkDescriptorSetLayoutBinding texture_infos{};
+    texture_infos.binding = 4;
+    texture_infos.descriptorCount = 1;
+    texture_infos.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    texture_infos.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    std::vector<VkDescriptorSetLayoutBinding> bindings = {binding, cis};
+    if(bindless){
+        bindings.push_back(feedback);
+    }
+    bindings.push_back(draws);
+    if(bindless){
+        bindings.push_back(texture_infos);
+    }
 
     VkDescriptorSetLayoutCreateInfo ci{};
     ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -854,16 +1223,92 @@ void Application::createDescriptorSetLayout(){
     if(vkCreateDescriptorSetLayout(device, &ci, nullptr, &descriptor_set_layout) != VK_SUCCESS){
         throw std::runtime_error("Couldn't create descriptor set layout.");
     }
+
+    if(bindless){
+        createBindlessSetLayout();
+    }
 };
 
+/*
+    Set 1 in bindless mode: one sampler, one big texture array and the material SSBO. The streamed texture
+    table is per frame and lives in set 0 with a dynamic offset, update-after-bind sets can't have one. Texture slots are partially bound, update-after-bind and update-unused-while-pending, so registering
+    a texture never touches a slot that a bound or in-flight set still uses.
+*/
+void Application::createBindlessSetLayout(){
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    bindings[1].descriptorCount = bindless_capacity;
+    bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    bindings[2].binding = 2;
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[2].descriptorCount = 1;
+    bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    std::array<VkDescriptorBindingFlagsEXT, 3> flags = {
+        0,
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT
+            | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT,
+        0
+    };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flags_ci{};
+    flags_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    flags_ci.bindingCount = static_cast<uint32_t>(flags.size());
+    flags_ci.pBindingFlags = flags.data();
+
+    VkDescriptorSetLayoutCreateInfo ci{};
+    ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    ci.pNext = &flags_ci;
+    ci.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+    ci.bindingCount = static_cast<uint32_t>(bindings.size());
+    ci.pBindings = bindings.data();
+
+    if(vkCreateDescriptorSetLayout(device, &ci, nullptr, &bindless_layout) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create bindless descriptor set layout.");
+    }
+}
+
 /*
     Creates the Graphics Pipeline
     okay this is it yall
 */
 void Application::createGraphicsPipeline(){
-    VkShaderModule vert = createShaderModule("shaders/vert.spv");
-    VkShaderModule frag = createShaderModule("shaders/frag.spv");
+    VkPipelineLayoutCreateInfo layout_ci{};
+    layout_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    std::array<VkDescriptorSetLayout, 2> set_layouts = {descriptor_set_layout, bindless_layout};
 
+    layout_ci.setLayoutCount = bindless ? 2 : 1;
+    layout_ci.pSetLayouts = set_layouts.data();
+
+    if(vkCreatePipelineLayout(device, &layout_ci, nullptr, &pl_layout) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create Pipeline Layout.");
+    }
+
+    std::vector<VkShaderModule> stages = createShaderModules({"shaders/vert.spv", fragmentShaderPath()});
+    VkShaderModule vert = stages[0];
+    VkShaderModule frag = stages[1];
+    pipeline = buildGraphicsPipeline(vert, frag);
+
+    vkDestroyShaderModule(device, vert, nullptr);
+    vkDestroyShaderModule(device, frag, nullptr);
+}
+
+std::string Application::fragmentShaderPath() const {
+    return bindless ? "shaders/frag_bindless.spv" : "shaders/frag.spv";
+}
+
+/*
+    Builds the mesh pipeline for the current pl_layout, sample count and attachments through the pipeline cache.
+    Hot reload calls it from its own thread with pipeline_mutex held, so none of those can change meanwhile.
+*/
+VkPipeline Application::buildGraphicsPipeline(VkShaderModule vert, VkShaderModule frag){
     VkPipelineShaderStageCreateInfo vert_ci{};
     vert_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vert_ci.stage = VK_SHADER_STAGE_VERTEX_BIT;
@@ -935,7 +1380,7 @@ void Application::createGraphicsPipeline(){
     VkPipelineMultisampleStateCreateInfo multisampling_ci{};
     multisampling_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
     multisampling_ci.sampleShadingEnable = VK_FALSE;
-    multisampling_ci.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampling_ci.rasterizationSamples = msaa_samples;
 
     VkPipelineColorBlendAttachmentState blend_att{};
     blend_att.blendEnable = VK_TRUE;
@@ -954,11 +1399,6 @@ void Application::createGraphicsPipeline(){
     blend_ci.attachmentCount = 1;
     blend_ci.pAttachments = &blend_att;
     
-    VkPipelineLayoutCreateInfo layout_ci{};
-    layout_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    layout_ci.setLayoutCount = 1;
-    layout_ci.pSetLayouts = &descriptor_set_layout;
-
     VkPipelineDepthStencilStateCreateInfo ds_ci{};
     ds_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
     ds_ci.depthTestEnable = VK_TRUE;
@@ -970,10 +1410,6 @@ void Application::createGraphicsPipeline(){
 
     ds_ci.stencilTestEnable = VK_FALSE;
 
-    if(vkCreatePipelineLayout(device, &layout_ci, nullptr, &pl_layout) != VK_SUCCESS){
-        throw std::runtime_error("Couldn't create Pipeline Layout.");
-    }
-
     VkGraphicsPipelineCreateInfo pl_ci{};
     pl_ci.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     pl_ci.stageCount = 2;
@@ -988,25 +1424,86 @@ void Application::createGraphicsPipeline(){
     pl_ci.pRasterizationState = &rasterizer_ci;
     pl_ci.pDepthStencilState = &ds_ci;
 
+    //with dynamic rendering the pipeline only has to know the attachment formats
+    VkPipelineRenderingCreateInfoKHR rendering_ci{};
+    rendering_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    rendering_ci.colorAttachmentCount = 1;
+    rendering_ci.pColorAttachmentFormats = &sc_format;
+    rendering_ci.depthAttachmentFormat = depth_format;
+
     pl_ci.layout = pl_layout;
-    pl_ci.renderPass = render_pass;
+    if(dynamic_rendering){
+        pl_ci.pNext = &rendering_ci;
+        pl_ci.renderPass = VK_NULL_HANDLE;
+    } else {
+        pl_ci.renderPass = render_pass;
+    }
     pl_ci.subpass = 0;
 
-    if(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pl_ci, nullptr, &pipeline) != VK_SUCCESS){
+    VkPipeline result;
+    if(vkCreateGraphicsPipelines(device, pipeline_cache, 1, &pl_ci, nullptr, &result) != VK_SUCCESS){
         throw std::runtime_error("Couldn't create graphics pipeline.");
     }
+    return result;
+}
 
-    vkDestroyShaderModule(device, vert, nullptr);
-    vkDestroyShaderModule(device, frag, nullptr);
+void Application::createPipelineCache(){
+    VkPipelineCacheCreateInfo ci{};
+    ci.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    if(vkCreatePipelineCache(device, &ci, nullptr, &pipeline_cache) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create pipeline cache.");
+    }
 }
 
 VkShaderModule Application::createShaderModule(const std::string& path){
-    const std::vector<char>& file = readFile(path);
-    
+    std::span<const std::byte> code = archivedAsset(path);
+    if(!code.empty()){
+        return createShaderModule(code);
+    }
+    MappedFile file(path);
+    return createShaderModule(file.bytes());
+}
+
+/*
+    Reads all the loose files in one AsyncFileReader batch, so with io_uring a pipeline's stages are in
+    flight together, and creates a module from each. Stages found in the archive are used in place.
+    vkCreateShaderModule copies the code anyway, a mapping would only save the read. The buffers are
+    uint32_t, which keeps the SPIR-V words aligned.
+*/
+std::vector<VkShaderModule> Application::createShaderModules(std::initializer_list<std::string> paths){
+    std::vector<std::span<const std::byte>> archived(paths.size());
+    std::vector<std::vector<uint32_t>> code(paths.size());
+    std::vector<size_t> sizes(paths.size());
+    AsyncFileReader reader;
+    size_t stage = 0;
+    for(const std::string& path : paths){
+        archived[stage] = archivedAsset(path);
+        if(archived[stage].empty()){
+            sizes[stage] = AsyncFileReader::fileSize(path);
+            code[stage].resize((sizes[stage] + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+            reader.read(path, std::as_writable_bytes(std::span(code[stage])).first(sizes[stage]));
+        }
+        stage++;
+    }
+    reader.wait();
+
+    std::vector<VkShaderModule> modules;
+    for(stage = 0; stage < code.size(); stage++){
+        if(!archived[stage].empty()){
+            modules.push_back(createShaderModule(archived[stage]));
+        } else {
+            modules.push_back(createShaderModule(std::as_bytes(std::span(code[stage])).first(sizes[stage])));
+        }
+    }
+    return modules;
+}
+
+//archive entries and mappings are page aligned, so the SPIR-V words can be handed over as they are
+VkShaderModule Application::createShaderModule(std::span<const std::byte> code){
     VkShaderModuleCreateInfo ci{};
     ci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    ci.codeSize = file.size();
-    ci.pCode = reinterpret_cast<const uint32_t*>(file.data());
+    ci.codeSize = code.size();
+    ci.pCode = reinterpret_cast<const uint32_t*>(code.data());
 
     VkShaderModule module;
     if(vkCreateShaderModule(device, &ci, nullptr, &module) != VK_SUCCESS){
@@ -1021,14 +1518,20 @@ void Application::createFrameBuffers(){
     sc_fb.resize(sc_images.size());
 
     for(size_t i = 0; i < sc_fb.size(); i++){
-        std::array<VkImageView, 2> atts = {
+        std::array<VkImageView, 3> atts = {
             sc_views[i],
             depth_view
         };
+        uint32_t att_count = 2;
+
+        if(msaa_samples != VK_SAMPLE_COUNT_1_BIT){
+            atts = {color_view, depth_view, sc_views[i]};
+            att_count = 3;
+        }
 
         VkFramebufferCreateInfo fb_ci{};
         fb_ci.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        fb_ci.attachmentCount = static_cast<uint32_t>(atts.size());
+        fb_ci.attachmentCount = att_count;
         fb_ci.pAttachments = atts.data();
         fb_ci.renderPass = render_pass;
         fb_ci.width = sc_extent.width;
@@ -1042,50 +1545,121 @@ void Application::createFrameBuffers(){
 }
 
 void Application::createDepthResources(){
-    uint32_t family = findQueueFamilies(p_device).graphics.value();
+    uint32_t family = queue_families.graphics.value();
 
+    //depth is never stored, so tile-based and CPU devices don't have to back it with real memory
     ImageCreateInfo ici{};
     ici.image_type = VK_IMAGE_TYPE_2D;
-    ici.image_usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-    ici.format = VK_FORMAT_D32_SFLOAT_S8_UINT;
+    ici.image_usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    ici.format = depth_format;
     ici.image = &depth_tex;
     ici.memory = &depth_memory;
+    ici.tag = "depth";
     ici.array_layers = 1;
     ici.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
     ici.family_count = 1;
     ici.indices = &family;
     ici.mip_levels = 1;
     ici.tiling = VK_IMAGE_TILING_OPTIMAL;
-    ici.sample_count = VK_SAMPLE_COUNT_1_BIT;
+    ici.sample_count = msaa_samples;
     ici.tex_width = sc_extent.width;
     ici.tex_height = sc_extent.height;
     ici.tex_depth = 1;
     ici.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
-    ici.mem_props = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    ici.mem_props = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+    ici.fallback_mem_props = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
     createImage(&ici);
 
-    depth_view = createImageView(depth_tex, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_IMAGE_ASPECT_DEPTH_BIT);
+    depth_view = createImageView(depth_tex, depth_format, VK_IMAGE_ASPECT_DEPTH_BIT);
 }
 
-void Application::createTextureImage(){
-    int tex_width, tex_height, tex_channels;
-    stbi_uc* pixels = stbi_load(tex_path, &tex_width, &tex_height, &tex_channels, STBI_rgb_alpha);
-    VkDeviceSize img_size = tex_width * tex_height * 4;
-
-    if(!pixels) {
-        throw std::runtime_error("Failed to load texture image!");
+//Multisampled color target, only needed when msaa_samples > 1. Resolved in-pass, so it is transient as well.
+void Application::createColorResources(){
+    if(msaa_samples == VK_SAMPLE_COUNT_1_BIT){
+        return;
     }
 
-    VkBuffer sb;
-    VkDeviceMemory sbm;
+    uint32_t family = queue_families.graphics.value();
 
-    QueueFamilyIndices qfi = findQueueFamilies(p_device);
-    uint32_t indices[] = {qfi.graphics.value(), qfi.transfer.value()};
+    ImageCreateInfo ici{};
+    ici.image_type = VK_IMAGE_TYPE_2D;
+    ici.image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    ici.format = sc_format;
+    ici.image = &color_tex;
+    ici.memory = &color_memory;
+    ici.tag = "msaa color";
+    ici.array_layers = 1;
+    ici.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
+    ici.family_count = 1;
+    ici.indices = &family;
+    ici.mip_levels = 1;
+    ici.tiling = VK_IMAGE_TILING_OPTIMAL;
+    ici.sample_count = msaa_samples;
+    ici.tex_width = sc_extent.width;
+    ici.tex_height = sc_extent.height;
+    ici.tex_depth = 1;
+    ici.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    ici.mem_props = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+    ici.fallback_mem_props = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    createImage(&ici);
+
+    color_view = createImageView(color_tex, sc_format, VK_IMAGE_ASPECT_COLOR_BIT);
+}
+
+/*
+    Switches to requested_msaa_samples.
+    The pipeline (and render pass on the legacy path) bake the sample count in, the attachments are rebuilt with the swapchain.
+*/
+void Application::applyMsaaSamples(){
+    vkDeviceWaitIdle(device);
+
+    {
+        std::lock_guard<std::mutex> lock(pipeline_mutex);
+        msaa_samples = requested_msaa_samples;
+        pipeline_generation++;
+
+        vkDestroyPipeline(device, pipeline, nullptr);
+        vkDestroyPipelineLayout(device, pl_layout, nullptr);
+
+        if(!dynamic_rendering){
+            vkDestroyRenderPass(device, render_pass, nullptr);
+            createRenderPass();
+        }
+
+        createGraphicsPipeline();
+
+        //the overlay shares the subpass on the legacy path, so its pipeline has to match the sample count
+        if(!dynamic_rendering){
+            ImGui_ImplVulkan_PipelineInfo info{};
+            info.RenderPass = render_pass;
+            info.Subpass = 0;
+            info.MSAASamples = msaa_samples;
+            ImGui_ImplVulkan_CreateMainPipeline(&info);
+        }
+    }
+
+    //takes pipeline_mutex itself
+    recreateSwapChain();
+}
+
+void Application::createTextureImage(){
+    ImageDecoder decoder(jobs);
+    VkDeviceSize img_size = decoder.plan({tex_path});
+    uint32_t tex_width = decoder.images()[0].width;
+    uint32_t tex_height = decoder.images()[0].height;
+
+    VkBuffer sb;
+    VkDeviceMemory sbm;
+
+    QueueFamilyIndices qfi = queue_families;
+    uint32_t indices[] = {qfi.graphics.value(), qfi.transfer.value()};
 
     BufferCreateInfo bci{};
     bci.buffer = &sb;
     bci.buffer_memory = &sbm;
+    bci.tag = "texture staging";
     if(qfi.graphics.value() == qfi.transfer.value()){
         bci.family_count = 1;
         bci.indices = &qfi.graphics.value();
@@ -1103,17 +1677,16 @@ void Application::createTextureImage(){
     
     void* data;
     vkMapMemory(device, sbm, 0, img_size, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(img_size));
+    decoder.decode(static_cast<uint8_t*>(data));
     vkUnmapMemory(device, sbm);
 
-    stbi_image_free(pixels); 
-
     ImageCreateInfo ci{};
     ci.image_type = VK_IMAGE_TYPE_2D;
     ci.image_usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
     ci.format = VK_FORMAT_R8G8B8A8_SRGB;
     ci.image = &tex_image;
     ci.memory = &tex_mem;
+    ci.tag = "texture";
     ci.array_layers = 1;
     ci.family_count = 2;
     ci.indices = indices;
@@ -1136,12 +1709,18 @@ void Application::createTextureImage(){
     ci.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
     
     createImage(&ci);
-    transitionImageLayout(tex_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    copyBufferImage(sb, tex_image, static_cast<uint32_t>(tex_width), static_cast<uint32_t>(tex_height));
-    transitionImageLayout(tex_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
-    vkDestroyBuffer(device, sb, nullptr);
-    vkFreeMemory(device, sbm, nullptr);
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {tex_width, tex_height, 1};
+
+    immediate.transition(tex_image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    immediate.copyBufferToImage(sb, tex_image, {&region, 1});
+    immediate.transition(tex_image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    immediate.flush();
+
+    tracker.destroyBuffer(sb);
+    tracker.freeMemory(sbm);
 }
 
 void Application::createTextureImageView(){
@@ -1158,11 +1737,8 @@ void Application::createTextureSampler(){
     ci.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
     ci.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
     
-    VkPhysicalDeviceProperties prop{};
-    vkGetPhysicalDeviceProperties(p_device, &prop);
-
     ci.anisotropyEnable = true;
-    ci.maxAnisotropy = prop.limits.maxSamplerAnisotropy;
+    ci.maxAnisotropy = device_info.limits().maxSamplerAnisotropy;
     
     ci.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
     ci.unnormalizedCoordinates = VK_FALSE;
@@ -1173,28 +1749,179 @@ void Application::createTextureSampler(){
     ci.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     ci.mipLodBias = 0.0f;
     ci.minLod = 0.0f;
-    ci.maxLod = 0.0f;
+    ci.maxLod = VK_LOD_CLAMP_NONE;
 
     if(vkCreateSampler(device, &ci, nullptr, &tex_sampler) != VK_SUCCESS){
         throw std::runtime_error("Couldn't create image sampler!");
     }
 }
 
+/*
+    Maps the archive and decompresses its compressed entries across the job system up front,
+    so every later lookup is a hash, a bucket read and a pointer into memory.
+*/
+void Application::openArchive(){
+    archive = std::make_unique<AssetArchive>(options.archive);
+    archive->unpack(jobs);
+
+    const AssetArchive::Stats& stats = archive->stats();
+    double read_mib = stats.read_bytes / (1024.0 * 1024.0);
+    std::cout << "Asset archive " << options.archive << ": " << stats.entries << " entries, " << stats.unpacked_entries
+        << " decompressed (" << read_mib << " MiB -> " << stats.unpacked_bytes / (1024.0 * 1024.0) << " MiB) in "
+        << stats.seconds * 1000.0 << " ms";
+    if(stats.seconds > 0.0){
+        std::cout << ", " << read_mib / stats.seconds << " MiB/s";
+    }
+    std::cout << std::endl;
+}
+
+//Empty without an archive or when it doesn't have path, the caller then reads the loose file.
+std::span<const std::byte> Application::archivedAsset(const std::string& path) const {
+    return archive ? archive->find(path) : std::span<const std::byte>();
+}
+
 void Application::loadModel(){
+    //a cooked mesh in the archive is used from its mapping, anything else is parsed from the loose file
+    std::span<const std::byte> archived = archivedAsset(modelPath());
+    if(!archived.empty() && std::filesystem::path(modelPath()).extension() == ".dmesh"){
+        ModelData model;
+        importPackage(std::make_unique<package::Mesh>(modelPath(), archived), modelPath(), model);
+        adoptModel(std::move(model));
+        return;
+    }
+    adoptModel(importModel(modelPath()));
+}
+
+std::string Application::modelPath() const {
+    return options.model.empty() ? model_path : options.model;
+}
+
+/*
+    Loads a model into its own tree and flattens it into draws. OBJ files become a single object,
+    glTF files keep their node hierarchy and cooked .dmesh packages get an object per draw. Touches no Application state, so reloads run it off the render thread.
+*/
+Application::ModelData Application::importModel(const std::string& path){
+    ModelData model;
+    std::string extension = std::filesystem::path(path).extension().string();
+    if(extension == ".gltf" || extension == ".glb"){
+        importGltf(path, model);
+        return model;
+    }
+    if(extension == ".dmesh"){
+        importPackage(std::make_unique<package::Mesh>(path), path, model);
+        return model;
+    }
+
+    loadObj(path, model.vertices, model.indices);
+
+    Object* object = model.tree.create_object();
+    object->set_name(path);
+    object->set_mesh(0);
+    SceneDraw draw{glm::mat4(1.0f), 0, static_cast<uint32_t>(model.indices.size()), 0, UINT32_MAX};
+    computeBounds(model.vertices, model.indices, draw);
+    model.draws.push_back(draw);
+    return model;
+}
+
+/*
+    Keeps the asset mapped and only counts here, uploadModel converts the accessors straight into
+    the geometry pool's staging memory.
+*/
+void Application::importGltf(const std::string& path, ModelData& model){
+    model.gltf_asset = std::make_unique<GltfAsset>(path);
+    model.gltf_scene = std::make_unique<GltfScene>(*model.gltf_asset);
+
+    //glTF is Y up, the scene is Z up
+    Object* file_root = model.tree.create_object();
+    file_root->set_name(path);
+    file_root->set_transform(glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f)));
+    model.gltf_scene->buildTree(model.tree, file_root);
+
+    const std::vector<GltfScene::Mesh>& meshes = model.gltf_scene->meshes();
+    const std::vector<GltfScene::Primitive>& primitives = model.gltf_scene->primitives();
+
+    std::vector<Object*> pending = {model.tree.get_root()};
+    while(!pending.empty()){
+        Object* object = pending.back();
+        pending.pop_back();
+        for(Object* child : object->get_children()){
+            pending.push_back(child);
+        }
+
+        int32_t mesh = object->get_mesh();
+        if(mesh < 0 || static_cast<size_t>(mesh) >= meshes.size()){
+            continue;
+        }
+        glm::mat4 world = object->get_world_transform();
+        for(uint32_t i = 0; i < meshes[mesh].primitive_count; i++){
+            const GltfScene::Primitive& primitive = primitives[meshes[mesh].first_primitive + i];
+            model.draws.push_back({world, primitive.first_index, primitive.index_count, primitive.vertex_offset, primitive.material,
+                primitive.bounds_min, primitive.bounds_max});
+        }
+    }
+}
+
+/*
+    A mesh cooked by domk-cook. Its draws come flattened, each becomes an object under the file's root.
+    Nothing is converted, uploadModel copies the sections from the mapping.
+*/
+void Application::importPackage(std::unique_ptr<package::Mesh> mesh, const std::string& path, ModelData& model){
+    model.mesh_package = std::move(mesh);
+    const package::MeshHeader& header = model.mesh_package->header();
+    if(header.vertex_stride != sizeof(Vertex) || header.position_offset != offsetof(Vertex, pos)
+        || header.color_offset != offsetof(Vertex, color) || header.uv_offset != offsetof(Vertex, tex_coord)){
+        throw std::runtime_error(path + " was cooked for a different vertex layout, cook it again.");
+    }
+
+    //the layout matches, so the mapped vertices can be read as they are
+    std::span<const Vertex> vertices(reinterpret_cast<const Vertex*>(model.mesh_package->vertices().data()), header.vertex_count);
+
+    Object* file_root = model.tree.create_object();
+    file_root->set_name(path);
+    for(const package::MeshDraw& draw : model.mesh_package->draws()){
+        glm::mat4 transform = glm::make_mat4(draw.transform);
+        Object* object = model.tree.create_object(file_root);
+        object->set_transform(transform);
+        object->set_mesh(static_cast<int32_t>(model.draws.size()));
+
+        SceneDraw scene_draw{transform, draw.first_index, draw.index_count, draw.vertex_offset, draw.material};
+        computeBounds(vertices, model.mesh_package->indices(), scene_draw);
+        model.draws.push_back(scene_draw);
+    }
+}
+
+void Application::adoptModel(ModelData model){
+    scene = std::move(model.tree);
+    scene_draws = std::move(model.draws);
+    vertexi = std::move(model.vertices);
+    indices = std::move(model.indices);
+    gltf_scene = std::move(model.gltf_scene);
+    gltf_asset = std::move(model.gltf_asset);
+    mesh_package = std::move(model.mesh_package);
+}
+
+void Application::loadObj(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices){
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
     std::string err;
     std::string warn;
 
-    if(!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, model_path)){
+    if(!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str())){
         throw std::runtime_error(err);
     }
 
     std::cout << warn << std::endl;
 
-    std::unordered_map<Vertex, uint32_t> unique_vert{};
+    size_t corner_count = 0;
+    for(const tinyobj::shape_t& shape : shapes){
+        corner_count += shape.mesh.indices.size();
+    }
+    indices.reserve(indices.size() + corner_count);
 
+    //the map is dropped as a whole, so its nodes come out of a few growing blocks instead of one allocation each
+    std::pmr::monotonic_buffer_resource map_memory;
+    std::pmr::unordered_map<Vertex, uint32_t> unique_vert(&map_memory);
 
     for(const tinyobj::shape_t& shape : shapes){
         for(const tinyobj::index_t& index : shape.mesh.indices) {
@@ -1211,182 +1938,277 @@ void Application::loadModel(){
 
             v.color = {1.0f, 1.0f, 1.0f};
 
-            if(unique_vert.count(v) == 0){
-                unique_vert[v] = static_cast<uint32_t>(vertexi.size());
-                vertexi.push_back(v);
+            auto [it, inserted] = unique_vert.try_emplace(v, static_cast<uint32_t>(vertices.size()));
+            if(inserted){
+                vertices.push_back(v);
             }
-            indices.push_back(unique_vert[v]);
+            indices.push_back(it->second);
         }
     }
 }
 
-void Application::createVertexBuffer(){
-    QueueFamilyIndices qfi = findQueueFamilies(p_device);
-
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_memory;
-
-    VkDeviceSize bsize = sizeof(vertexi[0]) * vertexi.size();
-    BufferCreateInfo sci{};
-    sci.buffer = &staging_buffer;
-    sci.buffer_memory = &staging_memory;
-    sci.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    sci.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    sci.size = sizeof(vertexi[0]) * vertexi.size();
-    uint32_t sindices[1] = {qfi.transfer.value()};
-    sci.indices = sindices;
-    sci.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
-    sci.family_count = 1;
-
-    createBuffer(&sci);
+//Model space box of the vertices draw's indices reach. Indices outside vertices are skipped.
+void Application::computeBounds(std::span<const Vertex> vertices, std::span<const uint32_t> indices, SceneDraw& draw){
+    glm::vec3 lo(std::numeric_limits<float>::max());
+    glm::vec3 hi(std::numeric_limits<float>::lowest());
 
-    void* data;
-    vkMapMemory(device, staging_memory, 0, bsize, 0, &data);
-    memcpy(data, vertexi.data(), (size_t) bsize);
-    vkUnmapMemory(device, staging_memory);
-    
-    BufferCreateInfo ci{};
-    ci.buffer = &vertex_buffer;
-    ci.buffer_memory = &vertex_mem;
-    ci.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    ci.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-    ci.size = sizeof(vertexi[0]) * vertexi.size();
-    if(qfi.transfer.value() == qfi.graphics.value()){
-        ci.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
-        ci.family_count = 1;
-        ci.indices = sindices;
-    } else {
-        uint32_t iindices[2] = {qfi.transfer.value(), qfi.graphics.value()};
-        ci.indices = iindices;
-        ci.sharing_mode = VK_SHARING_MODE_CONCURRENT;
-        ci.family_count = 2;
+    size_t end = std::min<size_t>(size_t(draw.first_index) + draw.index_count, indices.size());
+    for(size_t i = draw.first_index; i < end; i++){
+        int64_t vertex = int64_t(indices[i]) + draw.vertex_offset;
+        if(vertex < 0 || static_cast<uint64_t>(vertex) >= vertices.size()){
+            continue;
+        }
+        lo = glm::min(lo, vertices[vertex].pos);
+        hi = glm::max(hi, vertices[vertex].pos);
     }
 
-    createBuffer(&ci);
-
-    copyBuffer(staging_buffer, vertex_buffer, bsize);
+    if(lo.x > hi.x){
+        lo = hi = glm::vec3(0.0f);
+    }
+    draw.bounds_min = lo;
+    draw.bounds_max = hi;
+}
 
-    vkDestroyBuffer(device, staging_buffer, nullptr);
-    vkFreeMemory(device, staging_memory, nullptr);
+/*
+    Shared by the transfer queue that fills the pool and the graphics queue that draws it. With direct set,
+    meshes are written in place where device local memory is host visible.
+*/
+GeometryPool::Context Application::geometryPoolContext(bool direct){
+    QueueFamilyIndices qfi = queue_families;
+
+    GeometryPool::Context ctx{};
+    ctx.device = device;
+    ctx.tracker = &tracker;
+    ctx.find_memory_type = [this](uint32_t type_filter, VkMemoryPropertyFlags properties){
+        return findMemoryTypeIndex(type_filter, properties);
+    };
+    if(direct){
+        ctx.find_direct_type = [this](uint32_t type_filter){
+            return device_info.findDirectUploadType(type_filter);
+        };
+    }
+    ctx.queue_families = {qfi.transfer.value()};
+    if(qfi.graphics.value() != qfi.transfer.value()){
+        ctx.queue_families.push_back(qfi.graphics.value());
+    }
+    ctx.submit_transfer = [this](const std::function<void(VkCommandBuffer)>& record){
+        submitTransfer(record);
+    };
+    ctx.retire = [this](DeletionQueue::Destroy destroy){
+        retireResource(std::move(destroy));
+    };
+    return ctx;
 }
 
-void Application::createIndexBuffer(){
-    QueueFamilyIndices qfi = findQueueFamilies(p_device);
-    VkDeviceSize size = sizeof(indices[0]) * indices.size();
+//One pool for every mesh.
+void Application::createGeometryPool(){
+    geometry.setup(geometryPoolContext(!options.staged_uploads), sizeof(Vertex), GEOMETRY_VERTICES, GEOMETRY_INDICES);
+}
 
-    uint32_t sindices[1] = {qfi.transfer.value()};
+//Adds the loaded model to the geometry pool as scene_mesh.
+void Application::uploadModel(){
+    scene_mesh = addModel(geometry);
+}
 
-    VkBuffer sbuffer;
-    VkDeviceMemory smem;
-    BufferCreateInfo sci{};
-    sci.size = size;
-    sci.buffer = &sbuffer;
-    sci.buffer_memory = &smem;
-    sci.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    sci.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    sci.indices = sindices;
-    sci.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
-    createBuffer(&sci);
+//Adds the loaded model to pool, converting glTF accessors straight into the mapped or staging memory.
+uint32_t Application::addModel(GeometryPool& pool){
+    size_t vertex_count = gltf_scene ? gltf_scene->vertexCount() : mesh_package ? mesh_package->header().vertex_count : vertexi.size();
+    size_t index_count = gltf_scene ? gltf_scene->indexCount() : mesh_package ? mesh_package->header().index_count : indices.size();
+
+    return pool.add(static_cast<uint32_t>(vertex_count), static_cast<uint32_t>(index_count),
+        [this, vertex_count](void* data){
+            if(gltf_scene){
+                GltfScene::VertexLayout layout{};
+                layout.stride = sizeof(Vertex) / sizeof(float);
+                layout.position_offset = offsetof(Vertex, pos) / sizeof(float);
+                layout.color_offset = offsetof(Vertex, color) / sizeof(float);
+                layout.uv_offset = offsetof(Vertex, tex_coord) / sizeof(float);
+                gltf_scene->writeVertices(static_cast<float*>(data), layout);
+            } else if(mesh_package){
+                memcpy(data, mesh_package->vertices().data(), sizeof(Vertex) * vertex_count);
+            } else {
+                memcpy(data, vertexi.data(), sizeof(Vertex) * vertex_count);
+            }
+        },
+        [this, index_count](uint32_t* data){
+            if(gltf_scene){
+                gltf_scene->writeIndices(data);
+            } else if(mesh_package){
+                memcpy(data, mesh_package->indices().data(), sizeof(uint32_t) * index_count);
+            } else {
+                memcpy(data, indices.data(), sizeof(uint32_t) * index_count);
+            }
+        });
+}
 
-    void* data;
-    vkMapMemory(device, smem, 0, size, 0, &data);
-    memcpy(data, indices.data(), (size_t) size);
-    vkUnmapMemory(device, smem);
+/*
+    One persistently mapped buffer holds a ViewUniforms slice per frame in flight.
+    Slices are aligned to minUniformBufferOffsetAlignment and picked with a dynamic offset when binding.
+*/
+void Application::createUniformBuffers(){
+    VkDeviceSize alignment = device_info.limits().minUniformBufferOffsetAlignment;
+    view_ring_stride = (sizeof(ViewUniforms) + alignment - 1) / alignment * alignment;
+    VkDeviceSize buffer_size = view_ring_stride * MAX_FLIGHT_FRAMES;
 
     BufferCreateInfo ci{};
-    ci.size = size;
-    ci.buffer = &index_buffer;
-    ci.buffer_memory = &index_mem;
-    ci.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-    ci.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-    
-    if(qfi.transfer.value() == qfi.graphics.value()){
-        ci.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
-        ci.family_count = 1;
-        ci.indices = sindices;
-    } else {
-        uint32_t iindices[2] = {qfi.transfer.value(), qfi.graphics.value()};
-        ci.indices = iindices;
-        ci.sharing_mode = VK_SHARING_MODE_CONCURRENT;
-        ci.family_count = 2;
-    }
+    ci.size = buffer_size;
+    ci.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    ci.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    ci.buffer = &view_ring;
+    ci.buffer_memory = &view_ring_mem;
+    ci.tag = "view ring";
+    ci.sharing_mode = VK_SHARING_MODE_EXCLUSIVE; 
     createBuffer(&ci);
 
-    copyBuffer(sbuffer, index_buffer, size);
+    vkMapMemory(device, view_ring_mem, 0, buffer_size, 0, reinterpret_cast<void**>(&mview_ring));
 
-    vkDestroyBuffer(device, sbuffer, nullptr);
-    vkFreeMemory(device, smem, nullptr);
+    view_ring_versions.assign(MAX_FLIGHT_FRAMES, 0);
 }
 
-void Application::createUniformBuffers(){
-    VkDeviceSize buffer_size = sizeof(UniformBufferObject);
+/*
+    Makes room for count draws in every slice of the draw ring. Each slice is the DrawData array, bound at
+    binding 3 with a dynamic offset, followed by the indirect commands. Growing makes a new ring and, once
+    the set exists, a new set pointing at it; frames in flight keep the old ones until they are retired.
+*/
+void Application::reserveDraws(uint32_t count){
+    if(count <= draw_capacity && draw_ring != nullptr){
+        return;
+    }
+    if(draw_ring != nullptr){
+        VkDescriptorPool old_pool = dset != nullptr ? dpool : VK_NULL_HANDLE;
+        retireResource([this, old_pool, ring = draw_ring, ring_mem = draw_ring_mem]{
+            vkDestroyDescriptorPool(device, old_pool, nullptr);
+            tracker.destroyBuffer(ring);
+            tracker.freeMemory(ring_mem);
+        });
+    }
+    draw_capacity = std::max({count, draw_capacity * 2, MIN_DRAW_CAPACITY});
 
-    uniform_buffers.resize(MAX_FLIGHT_FRAMES);
-    uniform_buffer_mems.resize(MAX_FLIGHT_FRAMES);
-    muniform_buffers.resize(MAX_FLIGHT_FRAMES);
+    VkDeviceSize alignment = device_info.limits().minStorageBufferOffsetAlignment;
+    draw_commands_offset = sizeof(DrawData) * draw_capacity;
+    draw_ring_stride = draw_commands_offset + sizeof(VkDrawIndexedIndirectCommand) * draw_capacity;
+    draw_ring_stride = (draw_ring_stride + alignment - 1) / alignment * alignment;
+    VkDeviceSize buffer_size = draw_ring_stride * MAX_FLIGHT_FRAMES;
 
-    for(size_t i = 0; i < MAX_FLIGHT_FRAMES; i++){
-        BufferCreateInfo ci{};
-        ci.size = buffer_size;
-        ci.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-        ci.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-        ci.buffer = &uniform_buffers[i];
-        ci.buffer_memory = &uniform_buffer_mems[i];
-        ci.sharing_mode = VK_SHARING_MODE_EXCLUSIVE; 
-        createBuffer(&ci);
+    BufferCreateInfo ci{};
+    ci.size = buffer_size;
+    ci.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    ci.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    ci.buffer = &draw_ring;
+    ci.buffer_memory = &draw_ring_mem;
+    ci.tag = "draw ring";
+    ci.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
+    createBuffer(&ci);
+
+    vkMapMemory(device, draw_ring_mem, 0, buffer_size, 0, reinterpret_cast<void**>(&mdraw_ring));
 
-        vkMapMemory(device, uniform_buffer_mems[i], 0, buffer_size, 0, &muniform_buffers[i]);
+    //at startup createDescriptorSets writes it. Later the set may be bound by a frame in flight, so it isn't updated.
+    if(dset != nullptr){
+        createDescriptorPool();
+        createDescriptorSets();
     }
 }
 
-void Application::copyBuffer(VkBuffer srcb, VkBuffer dstb, VkDeviceSize size){
-    VkCommandBufferAllocateInfo aci{};
-    aci.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    aci.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    aci.commandPool = cmdp_t; 
-    aci.commandBufferCount = 1;
-
-    VkCommandBuffer command_buffer;
-    vkAllocateCommandBuffers(device, &aci, &command_buffer);
-
-    VkCommandBufferBeginInfo bi{}; //begininfo
-    bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    vkBeginCommandBuffer(command_buffer, &bi);
+uint32_t Application::sceneMaterial(const SceneDraw& draw) const {
+    return draw.material < scene_materials.size() ? scene_materials[draw.material] : draw_material;
+}
 
-    VkBufferCopy copyr{}; //copy region
-    copyr.size = size;
-    vkCmdCopyBuffer(command_buffer, srcb, dstb, 1, &copyr);
+/*
+    Keys this frame's draws by pass, pipeline, view depth and material and sorts them on the job threads.
+    Scene draws the software occluder hid are left out; with the Hi-Z passes every scene draw goes in,
+    the culler decides on the GPU. Scene keys sort first, so they keep the positions the culler sees.
+    Runs of the same pass and pipeline become the batches recordMeshDraws binds state between.
+*/
+void Application::sortDraws(){
+    draw_list.clear();
+    const glm::mat4& view = view_uniforms.view;
+    for(uint32_t i = 0; i < scene_draws.size(); i++){
+        if(software_occlusion && i < draw_visible.size() && draw_visible[i] == 0){
+            continue;
+        }
+        const SceneDraw& draw = scene_draws[i];
+        glm::vec4 center = view * draw_model * draw.transform * glm::vec4((draw.bounds_min + draw.bounds_max) * 0.5f, 1.0f);
+        draw_list.add(DrawList::makeKey(static_cast<uint32_t>(DrawPass::Scene), MESH_PIPELINE, -center.z, sceneMaterial(draw), i));
+    }
+    if(skinning_enabled){
+        const std::vector<SkinningSystem::Character>& characters = skinning.characters();
+        for(uint32_t i = 0; i < characters.size(); i++){
+            glm::vec4 center = view * characters[i].transform * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            draw_list.add(DrawList::makeKey(static_cast<uint32_t>(DrawPass::Skinned), MESH_PIPELINE, -center.z, draw_material, i));
+        }
+    }
+    draw_list.sort(&jobs, &frame_arena);
+
+    draw_batches.clear();
+    std::span<const uint64_t> keys = draw_list.keys();
+    for(uint32_t i = 0; i < keys.size(); i++){
+        uint32_t pass = DrawList::pass(keys[i]);
+        uint32_t pipeline_key = DrawList::pipeline(keys[i]);
+        if(draw_batches.empty() || draw_batches.back().pass != pass || draw_batches.back().pipeline != pipeline_key){
+            draw_batches.push_back({pass, pipeline_key, i, 0});
+        }
+        draw_batches.back().count++;
+    }
+}
 
-    vkEndCommandBuffer(command_buffer);
+/*
+    Fills this frame's slice of the draw ring in draw_list order: the DrawData of every draw and a command
+    drawing it, whose first instance is its position. Scene commands point into the model's range of the
+    geometry pool. With the Hi-Z passes the culler writes the scene commands that get drawn instead.
+*/
+void Application::writeDraws(){
+    std::span<const uint64_t> keys = draw_list.keys();
+    reserveDraws(static_cast<uint32_t>(keys.size()));
+
+    DrawData* data = reinterpret_cast<DrawData*>(mdraw_ring + draw_ring_stride * cur_frame);
+    const GeometryPool::Range& range = geometry.range(scene_mesh);
+    draw_commands = {static_cast<VkDrawIndexedIndirectCommand*>(frame_arena.allocate(
+        sizeof(VkDrawIndexedIndirectCommand) * keys.size(), alignof(VkDrawIndexedIndirectCommand))), keys.size()};
+
+    for(uint32_t i = 0; i < keys.size(); i++){
+        uint32_t index = DrawList::index(keys[i]);
+        if(DrawList::pass(keys[i]) == static_cast<uint32_t>(DrawPass::Scene)){
+            const SceneDraw& draw = scene_draws[index];
+            data[i].model = draw_model * draw.transform;
+            data[i].material = sceneMaterial(draw);
+            draw_commands[i] = {draw.index_count, 1, range.first_index + draw.first_index,
+                static_cast<int32_t>(range.first_vertex) + draw.vertex_offset, i};
+        } else {
+            //skinned this frame by the compute stage, every character's vertices follow the previous one's
+            data[i].model = skinning.characters()[index].transform;
+            data[i].material = draw_material;
+            draw_commands[i] = {skinning.indexCount(), 1, 0, static_cast<int32_t>(index * skinning.vertexCount()), i};
+        }
+    }
 
-    VkSubmitInfo submit{};
-    submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit.commandBufferCount = 1;
-    submit.pCommandBuffers = &command_buffer;
+    std::copy(draw_commands.begin(), draw_commands.end(),
+        reinterpret_cast<VkDrawIndexedIndirectCommand*>(mdraw_ring + draw_ring_stride * cur_frame + draw_commands_offset));
+    draw_calls = 0;
+    state_binds = 0;
+}
 
-    vkQueueSubmit(transfer_queue, 1, &submit, VK_NULL_HANDLE);
-    vkQueueWaitIdle(transfer_queue);
-    vkFreeCommandBuffers(device, cmdp_t, 1, &command_buffer);
+//Records into the transfer queue's immediate batch, submits it and waits for it.
+void Application::submitTransfer(const std::function<void(VkCommandBuffer)>& record){
+    transfer_immediate.record(record);
+    transfer_immediate.flush();
 }
 
 uint32_t Application::findMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties mem_prop;
-    vkGetPhysicalDeviceMemoryProperties(p_device, &mem_prop);
-
-    for (uint32_t i = 0; i < mem_prop.memoryTypeCount; i++) {
-        if ((type_filter & (1 << i)) && (mem_prop.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
-        }
+    uint32_t index = findMemoryTypeIndex(type_filter, properties);
+    if(index == UINT32_MAX){
+        throw std::runtime_error("Failed to find suitable memory type.");
     }
+    return index;
+}
 
-    throw std::runtime_error("Failed to find suitable memory type.");
+//Same as findMemoryType, but returns UINT32_MAX instead of throwing so callers can fall back.
+uint32_t Application::findMemoryTypeIndex(uint32_t type_filter, VkMemoryPropertyFlags properties) {
+    return device_info.findMemoryType(type_filter, properties);
 }
 
 void Application::createCommandPoolBuffer(){
     //graphics pool
-    QueueFamilyIndices indices = findQueueFamilies(p_device);
+    QueueFamilyIndices indices = queue_families;
 
     VkCommandPoolCreateInfo ci{};
     ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -1409,138 +2231,1070 @@ void Application::createCommandPoolBuffer(){
         throw std::runtime_error("Couldn't allocate graphics command buffers.");
     }
 
-    //transfer pool
-    VkCommandPoolCreateInfo cit{};
-    cit.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    cit.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-    cit.queueFamilyIndex = indices.transfer.value();
-    if(vkCreateCommandPool(device, &cit, nullptr, &cmdp_t) != VK_SUCCESS){
-        throw std::runtime_error("Couldn't create transfer command pool.");
+    //one-off work: image uploads on the graphics queue, buffer copies on the transfer queue
+    ImmediateCommands::Context immediate_ctx{};
+    immediate_ctx.device = device;
+    immediate_ctx.queue = graphics_queue;
+    immediate_ctx.queue_family = indices.graphics.value();
+    immediate_ctx.pipeline_barrier2 = cmd_pipeline_barrier2;
+    immediate.setup(immediate_ctx);
+
+    immediate_ctx.queue = transfer_queue;
+    immediate_ctx.queue_family = indices.transfer.value();
+    transfer_immediate.setup(immediate_ctx);
+}
+
+void Application::recordCommandBuffer(VkCommandBuffer target, uint32_t image_index){    
+    VkCommandBufferBeginInfo begin_i{};
+    begin_i.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    
+    if(vkBeginCommandBuffer(target, &begin_i) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't begin recording command buffer.");
+    }
+
+    if(frame_queries != nullptr){
+        vkCmdResetQueryPool(target, frame_queries, cur_frame * 2, 2);
+        vkCmdWriteTimestamp(target, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame_queries, cur_frame * 2);
+    }
+
+    if(dynamic_rendering){
+        recordDynamicRendering(target, image_index);
+    } else {
+        recordRenderPass(target, image_index);
+    }
+
+    if(frame_queries != nullptr){
+        vkCmdWriteTimestamp(target, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame_queries, cur_frame * 2 + 1);
+    }
+
+    if(vkEndCommandBuffer(target) != VK_SUCCESS){
+        throw std::runtime_error("Failed to record command buffer.");
+    }
+}
+
+//Legacy path: VkRenderPass + per-image VkFramebuffer.
+void Application::recordRenderPass(VkCommandBuffer target, uint32_t image_index){
+    VkRenderPassBeginInfo rp_bi{};
+    rp_bi.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    rp_bi.renderPass = render_pass;
+    rp_bi.framebuffer = sc_fb[image_index];
+    rp_bi.renderArea.offset = {0,0};
+    rp_bi.renderArea.extent = sc_extent;
+
+    std::array<VkClearValue, 2> clears{};
+    clears[0].color = {{0.2f, 0.2f, 0.2f, 1.0f}};
+    clears[1].depthStencil = {1, 0};
+    rp_bi.clearValueCount = 2;
+    rp_bi.pClearValues = clears.data();
+
+    vkCmdBeginRenderPass(target, &rp_bi, VK_SUBPASS_CONTENTS_INLINE);
+
+    recordMeshDraws(target);
+    recordImGui(target);
+
+    vkCmdEndRenderPass(target);
+}
+
+/*
+    Dynamic rendering path: the render graph begins rendering on the attachments each pass declared
+    and does the layout transitions the render pass used to do with batched sync2 barriers.
+*/
+void Application::recordDynamicRendering(VkCommandBuffer target, uint32_t image_index){
+    render_graph.bindImported(rg_backbuffer, sc_images[image_index], sc_views[image_index]);
+    render_graph.execute(target);
+}
+
+/*
+    Declares the frame: the mesh pass draws into the backbuffer (or a multisampled transient resolved into it)
+    and a transient depth buffer, the ImGui pass loads the backbuffer and draws the overlay on top at 1x.
+    With occlusion culling the mesh pass is split in an early and a late pass around the Hi-Z rebuild.
+*/
+void Application::buildRenderGraph(){
+    RenderGraph::Context ctx{};
+    ctx.device = device;
+    ctx.tracker = &tracker;
+    ctx.begin_rendering = cmd_begin_rendering;
+    ctx.end_rendering = cmd_end_rendering;
+    ctx.pipeline_barrier2 = cmd_pipeline_barrier2;
+    ctx.find_memory_type = [this](uint32_t type_filter, VkMemoryPropertyFlags properties){
+        return findMemoryTypeIndex(type_filter, properties);
+    };
+    render_graph.setup(ctx);
+
+    rg_backbuffer = render_graph.importImage("backbuffer", {sc_format, sc_extent},
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    RenderGraph::ResourceId depth = render_graph.createTransient("depth", {depth_format, sc_extent, msaa_samples});
+
+    VkClearValue clear_color{};
+    clear_color.color = {{0.2f, 0.2f, 0.2f, 1.0f}};
+    VkClearValue clear_depth{};
+    clear_depth.depthStencil = {1, 0};
+
+    RenderGraph::ResourceId color = rg_backbuffer;
+    if(msaa_samples != VK_SAMPLE_COUNT_1_BIT){
+        color = render_graph.createTransient("msaa color", {sc_format, sc_extent, msaa_samples});
+    }
+
+    if(occlusion_culling){
+        //cull against last frame's pyramid, draw, rebuild the pyramid from that depth, then draw what it reveals
+        render_graph.addPass(RenderGraph::Pass("cull early")
+            .sideEffects()
+            .execute([this](VkCommandBuffer buffer){ occlusion.recordEarly(buffer, frame_number); }));
+
+        render_graph.addPass(RenderGraph::Pass("mesh early")
+            .writeColor(color, VK_ATTACHMENT_LOAD_OP_CLEAR, clear_color)
+            .writeDepth(depth, VK_ATTACHMENT_LOAD_OP_CLEAR, clear_depth)
+            .execute([this](VkCommandBuffer buffer){ recordMeshDraws(buffer, OcclusionCuller::Phase::Early); }));
+
+        render_graph.addPass(RenderGraph::Pass("hi-z")
+            .read(depth)
+            .compute()
+            .sideEffects()
+            .execute([this](VkCommandBuffer buffer){ occlusion.recordLate(buffer, frame_number); }));
+
+        RenderGraph::Pass late("mesh late");
+        late.writeColor(color, VK_ATTACHMENT_LOAD_OP_LOAD);
+        if(color != rg_backbuffer){
+            late.resolveColor(rg_backbuffer);
+        }
+        late.writeDepth(depth, VK_ATTACHMENT_LOAD_OP_LOAD)
+            .execute([this](VkCommandBuffer buffer){ recordMeshDraws(buffer, OcclusionCuller::Phase::Late); });
+        render_graph.addPass(late);
+    } else {
+        RenderGraph::Pass mesh("mesh");
+        mesh.writeColor(color, VK_ATTACHMENT_LOAD_OP_CLEAR, clear_color);
+        if(color != rg_backbuffer){
+            mesh.resolveColor(rg_backbuffer);
+        }
+        mesh.writeDepth(depth, VK_ATTACHMENT_LOAD_OP_CLEAR, clear_depth)
+            .execute([this](VkCommandBuffer buffer){ recordMeshDraws(buffer); });
+        render_graph.addPass(mesh);
+    }
+
+    render_graph.addPass(RenderGraph::Pass("imgui")
+        .writeColor(rg_backbuffer, VK_ATTACHMENT_LOAD_OP_LOAD)
+        .execute([this](VkCommandBuffer buffer){ recordImGui(buffer); }));
+
+    render_graph.markOutput(rg_backbuffer);
+    render_graph.compile();
+
+    if(occlusion_culling){
+        occlusion.bindDepth(render_graph.view(depth), sc_extent, msaa_samples);
+    }
+}
+
+/*
+    Draw commands shared by both rendering paths, one multi-draw per batch of sorted draws, with the pipeline
+    and vertex buffers only bound when a batch needs others than the one before. Scene batches draw from the
+    geometry pool: the commands writeDraws left in the draw ring, or with culled set, the ones the culler
+    wrote for that phase. The skinned characters only go in the early pass.
+*/
+void Application::recordMeshDraws(VkCommandBuffer target, std::optional<OcclusionCuller::Phase> culled){
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(sc_extent.width);
+    viewport.height = static_cast<float>(sc_extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(target, 0, 1, &viewport);
+    
+    VkRect2D scissor{};
+    scissor.offset = {0,0};
+    scissor.extent = sc_extent;
+    vkCmdSetScissor(target, 0, 1, &scissor);
+
+    //in binding order: view uniforms, texture feedback when bindless, draw data, texture table when bindless
+    std::array<uint32_t, 4> dynamic_offsets{};
+    uint32_t offset_count = 0;
+    dynamic_offsets[offset_count++] = static_cast<uint32_t>(view_ring_stride * cur_frame);
+    if(bindless){
+        dynamic_offsets[offset_count++] = texture_streamer.feedbackOffset(cur_frame);
+    }
+    dynamic_offsets[offset_count++] = static_cast<uint32_t>(draw_ring_stride * cur_frame);
+    if(bindless){
+        dynamic_offsets[offset_count++] = texture_streamer.infoOffset(cur_frame);
+    }
+    vkCmdBindDescriptorSets(target, VK_PIPELINE_BIND_POINT_GRAPHICS, pl_layout, 0, 1, &dset, offset_count, dynamic_offsets.data());
+
+    if(bindless){
+        vkCmdBindDescriptorSets(target, VK_PIPELINE_BIND_POINT_GRAPHICS, pl_layout, 1, 1, &bindless_set, 0, nullptr);
+    }
+
+    uint32_t bound_pipeline = UINT32_MAX;
+    uint32_t bound_pass = UINT32_MAX;
+    for(const DrawBatch& batch : draw_batches){
+        bool skinned = batch.pass == static_cast<uint32_t>(DrawPass::Skinned);
+        if(skinned && culled == OcclusionCuller::Phase::Late){
+            continue;
+        }
+
+        if(batch.pipeline != bound_pipeline){
+            vkCmdBindPipeline(target, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            bound_pipeline = batch.pipeline;
+            state_binds++;
+        }
+        if(batch.pass != bound_pass){
+            VkBuffer vertices = skinned ? skinning.outputBuffer(frame_number) : geometry.vertexBuffer();
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(target, 0, 1, &vertices, &offset);
+            vkCmdBindIndexBuffer(target, skinned ? skinning.indexBuffer() : geometry.indexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+            bound_pass = batch.pass;
+            state_binds++;
+        }
+
+        if(culled && !skinned){
+            recordIndirect(target, occlusion.drawBuffer(), occlusion.drawOffset(frame_number, *culled, batch.first), batch.count);
+        } else {
+            recordDraws(target, batch.first, batch.count);
+        }
+    }
+}
+
+//Draws commands of this frame's draw ring slice, or straight from draw_commands when indirect draws can't set the first instance.
+void Application::recordDraws(VkCommandBuffer target, uint32_t first, uint32_t count){
+    if(indirect_first_instance){
+        recordIndirect(target, draw_ring, draw_ring_stride * cur_frame + draw_commands_offset
+            + sizeof(VkDrawIndexedIndirectCommand) * first, count);
+        return;
+    }
+    for(uint32_t i = first; i < first + count; i++){
+        const VkDrawIndexedIndirectCommand& command = draw_commands[i];
+        vkCmdDrawIndexed(target, command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset,
+            command.firstInstance);
+        draw_calls++;
+    }
+}
+
+//count tightly packed commands, in as few calls as maxDrawIndirectCount allows, one call each without multi-draw
+void Application::recordIndirect(VkCommandBuffer target, VkBuffer commands, VkDeviceSize offset, uint32_t count){
+    uint32_t batch = multi_draw_indirect ? std::max(device_info.limits().maxDrawIndirectCount, 1u) : 1;
+    for(uint32_t first = 0; first < count; first += batch){
+        vkCmdDrawIndexedIndirect(target, commands, offset + sizeof(VkDrawIndexedIndirectCommand) * first,
+            std::min(batch, count - first), sizeof(VkDrawIndexedIndirectCommand));
+        draw_calls++;
+    }
+}
+
+void Application::recordImGui(VkCommandBuffer target){
+    ImDrawData* dd = ImGui::GetDrawData();
+    if(dd != nullptr){
+        ImGui_ImplVulkan_RenderDrawData(dd, target);
+    }
+}
+
+void Application::createDescriptorPool(){
+    std::array<VkDescriptorPoolSize, 3> psizes{};
+    psizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    psizes[0].descriptorCount = 1;
+    psizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    psizes[1].descriptorCount = 1;
+    psizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    psizes[2].descriptorCount = bindless ? 3 : 1;
+    VkDescriptorPoolCreateInfo ci{};
+    ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    ci.poolSizeCount = 3;
+    ci.pPoolSizes = psizes.data();
+    ci.maxSets = 1;
+
+    if(vkCreateDescriptorPool(device, &ci, nullptr, &dpool) != VK_SUCCESS ){
+        throw std::runtime_error("Couldn't create descriptor pool.");
+    }
+}
+
+//A single set serves every frame in flight, the frame's ring slice is selected by the dynamic offset.
+void Application::createDescriptorSets(){
+    VkDescriptorSetAllocateInfo ai{};
+    ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    ai.descriptorPool = dpool;
+    ai.descriptorSetCount = 1;
+    ai.pSetLayouts = &descriptor_set_layout;
+    
+    if(vkAllocateDescriptorSets(device, &ai, &dset) != VK_SUCCESS) {
+        throw std::runtime_error("Couldn't allocate descriptor sets.");
+    }
+
+    VkDescriptorBufferInfo bi{};
+    bi.buffer = view_ring;
+    bi.offset = 0;
+    bi.range = sizeof(ViewUniforms);
+    
+    VkDescriptorImageInfo ii{};
+    ii.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    ii.imageView = tex_view;
+    ii.sampler = tex_sampler;
+
+    VkDescriptorBufferInfo fi{};
+    if(bindless){
+        fi.buffer = texture_streamer.feedbackBuffer();
+        fi.offset = 0;
+        fi.range = texture_streamer.feedbackRange();
+    }
+
+    VkDescriptorBufferInfo di{};
+    di.buffer = draw_ring;
+    di.offset = 0;
+    di.range = sizeof(DrawData) * draw_capacity;
+
+    VkDescriptorBufferInfo ti{};
+    if(bindless){
+        ti.buffer = texture_streamer.infoBuffer();
+        ti.offset = 0;
+        ti.range = texture_streamer.infoRange();
+    }
+
+    std::array<VkWriteDescriptorSet, 5> dwrites{};
+
+    dwrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    dwrites[0].dstSet = dset;
+    dwrites[0].dstBinding = 0;
+    dwrites[0].dstArrayElement = 0;
+    dwrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    dwrites[0].descriptorCount = 1;
+    dwrites[0].pBufferInfo = &bi;
+
+    dwrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    dwrites[1].dstSet = dset;
+    dwrites[1].dstBinding = 1;
+    dwrites[1].dstArrayElement = 0;
+    dwrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    dwrites[1].descriptorCount = 1;
+    dwrites[1].pImageInfo = &ii;
+
+    dwrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    dwrites[2].dstSet = dset;
+    dwrites[2].dstBinding = 2;
+    dwrites[2].dstArrayElement = 0;
+    dwrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    dwrites[2].descriptorCount = 1;
+    dwrites[2].pBufferInfo = &fi;
+
+    dwrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    dwrites[3].dstSet = dset;
+    dwrites[3].dstBinding = 3;
+    dwrites[3].dstArrayElement = 0;
+    dwrites[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    dwrites[3].descriptorCount = 1;
+    dwrites[3].pBufferInfo = &di;
+
+    dwrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    dwrites[4].dstSet = dset;
+    dwrites[4].dstBinding = 4;
+    dwrites[4].dstArrayElement = 0;
+    dwrites[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    dwrites[4].descriptorCount = 1;
+    dwrites[4].pBufferInfo = &ti;
+
+    //without bindless there are no feedback and texture table bindings
+    if(!bindless){
+        dwrites[2] = dwrites[3];
+    }
+    vkUpdateDescriptorSets(device, bindless ? 5 : 3, dwrites.data(), 0, nullptr);
+}
+
+void Application::createBindlessSet(){
+    std::array<VkDescriptorPoolSize, 3> psizes{};
+    psizes[0].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+    psizes[0].descriptorCount = 1;
+    psizes[1].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    psizes[1].descriptorCount = bindless_capacity;
+    psizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    psizes[2].descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo pool_ci{};
+    pool_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_ci.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+    pool_ci.poolSizeCount = static_cast<uint32_t>(psizes.size());
+    pool_ci.pPoolSizes = psizes.data();
+    pool_ci.maxSets = 1;
+
+    if(vkCreateDescriptorPool(device, &pool_ci, nullptr, &bindless_pool) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create bindless descriptor pool.");
+    }
+
+    VkDescriptorSetAllocateInfo ai{};
+    ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    ai.descriptorPool = bindless_pool;
+    ai.descriptorSetCount = 1;
+    ai.pSetLayouts = &bindless_layout;
+
+    if(vkAllocateDescriptorSets(device, &ai, &bindless_set) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't allocate bindless descriptor set.");
+    }
+
+    BufferCreateInfo bci{};
+    bci.size = sizeof(Material) * MAX_MATERIALS;
+    bci.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bci.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    bci.buffer = &material_buffer;
+    bci.buffer_memory = &material_mem;
+    bci.tag = "materials";
+    bci.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
+    createBuffer(&bci);
+
+    vkMapMemory(device, material_mem, 0, bci.size, 0, reinterpret_cast<void**>(&mmaterials));
+
+    VkDescriptorImageInfo si{};
+    si.sampler = tex_sampler;
+
+    VkDescriptorBufferInfo bi{};
+    bi.buffer = material_buffer;
+    bi.offset = 0;
+    bi.range = VK_WHOLE_SIZE;
+
+    std::array<VkWriteDescriptorSet, 2> dwrites{};
+    dwrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    dwrites[0].dstSet = bindless_set;
+    dwrites[0].dstBinding = 0;
+    dwrites[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    dwrites[0].descriptorCount = 1;
+    dwrites[0].pImageInfo = &si;
+
+    dwrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    dwrites[1].dstSet = bindless_set;
+    dwrites[1].dstBinding = 2;
+    dwrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    dwrites[1].descriptorCount = 1;
+    dwrites[1].pBufferInfo = &bi;
+
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(dwrites.size()), dwrites.data(), 0, nullptr);
+
+    //materials reference streamed texture ids, the TextureInfo table maps them to the current slot
+    Material material{};
+    material.base_color = glm::vec4(1.0f);
+    std::span<const std::byte> archived = archivedAsset(tex_path);
+    material.albedo = archived.empty() ? texture_streamer.add(tex_path) : texture_streamer.add(tex_path, archived);
+    draw_material = createMaterial(material);
+
+    if(gltf_scene){
+        createSceneMaterials();
+    }
+    //every tail above goes up in one submission, waited for once
+    texture_streamer.flush();
+}
+
+/*
+    Creates a material per glTF material, their images are streamed like any other texture.
+    The external image files are read in one batch first, all in flight at once where io_uring is there,
+    rather than mapped and faulted in one after another. Then every image a material uses is decoded
+    and mipmapped on the job system at once, only handing them to the streamer is serial.
+*/
+void Application::createSceneMaterials(){
+    const std::vector<GltfScene::Image>& images = gltf_scene->images();
+    const std::vector<GltfScene::Material>& materials = gltf_scene->materials();
+    std::vector<TextureStreamer::TextureId> image_ids(images.size(), UINT32_MAX);
+
+    std::vector<bool> used(images.size(), false);
+    for(const GltfScene::Material& source : materials){
+        if(source.image < images.size()){
+            used[source.image] = true;
+        }
+    }
+
+    std::vector<std::vector<std::byte>> image_files(images.size());
+    AsyncFileReader reader;
+    for(size_t i = 0; i < images.size(); i++){
+        if(used[i] && !images[i].path.empty()){
+            image_files[i].resize(AsyncFileReader::fileSize(images[i].path));
+            reader.read(images[i].path, image_files[i]);
+        }
+    }
+    reader.wait();
+
+    //decode() only reads the streamer's constants, so it runs on the workers
+    std::vector<TextureStreamer::Decoded> decoded(images.size());
+    jobs.parallelFor(static_cast<uint32_t>(images.size()), [&](uint32_t i){
+        if(used[i]){
+            const GltfScene::Image& image = images[i];
+            decoded[i] = image.path.empty() ? texture_streamer.decode(image.name, image.bytes)
+                : texture_streamer.decode(image.path, image_files[i]);
+        }
+    });
+    image_files.clear();
+    for(size_t i = 0; i < images.size(); i++){
+        if(used[i]){
+            image_ids[i] = texture_streamer.add(std::move(decoded[i]));
+        }
+    }
+    TextureStreamer::TextureId white = UINT32_MAX;
+
+    for(const GltfScene::Material& source : materials){
+        Material material{};
+        material.base_color = source.base_color;
+
+        if(source.image < images.size()){
+            material.albedo = image_ids[source.image];
+        } else {
+            //untextured materials sample a 1x1 white image, so only the factor shows
+            if(white == UINT32_MAX){
+                static const char WHITE_PPM[] = "P6\n1 1\n255\n\xff\xff\xff";
+                white = texture_streamer.add("white", std::as_bytes(std::span(WHITE_PPM, sizeof(WHITE_PPM) - 1)));
+            }
+            material.albedo = white;
+        }
+        scene_materials.push_back(createMaterial(material));
+    }
+}
+
+/*
+    Watches the GLSL sources, the compiled SPIR-V, the texture directory and the model's directory.
+    Changed sources are compiled over their .spv, and the .spv watch rebuilds the pipeline from it, so a
+    glslc run from outside reloads the same way. All the slow work happens on the reload thread; the
+    swaps run in drawFrame once the frame's fence has signalled, and what they replace is retired.
+*/
+void Application::setupHotReload(){
+    hot_reload.watch(options.shader_source_dir, {".vert", ".frag"}, [](const std::string& path){
+        std::string spv = "shaders/" + std::filesystem::path(path).stem().string() + ".spv";
+        HotReload::compileGlsl(path, spv);
+        return std::function<void()>();
+    });
+
+    hot_reload.watch("shaders", {".spv"}, [this](const std::string& path) -> std::function<void()> {
+        std::string name = std::filesystem::path(path).filename().string();
+        if(name != "vert.spv" && name != std::filesystem::path(fragmentShaderPath()).filename().string()){
+            return {};
+        }
+
+        //reloads come from the loose files even when an archive has the shaders
+        MappedFile vert_file("shaders/vert.spv");
+        MappedFile frag_file(fragmentShaderPath());
+
+        std::lock_guard<std::mutex> lock(pipeline_mutex);
+        VkShaderModule vert = createShaderModule(vert_file.bytes());
+        VkShaderModule frag = VK_NULL_HANDLE;
+        VkPipeline rebuilt = VK_NULL_HANDLE;
+        try {
+            frag = createShaderModule(frag_file.bytes());
+            rebuilt = buildGraphicsPipeline(vert, frag);
+        } catch (...) {
+            vkDestroyShaderModule(device, vert, nullptr);
+            vkDestroyShaderModule(device, frag, nullptr);
+            throw;
+        }
+        vkDestroyShaderModule(device, vert, nullptr);
+        vkDestroyShaderModule(device, frag, nullptr);
+
+        uint64_t generation = pipeline_generation;
+        return [this, rebuilt, generation]{
+            //an MSAA switch since the build already recreated the pipeline from the new modules
+            if(generation != pipeline_generation){
+                vkDestroyPipeline(device, rebuilt, nullptr);
+                return;
+            }
+            VkPipeline replaced = pipeline;
+            retireResource([this, replaced]{ vkDestroyPipeline(device, replaced, nullptr); });
+            pipeline = rebuilt;
+        };
+    });
+
+    //only streamed textures can be swapped, the non-bindless path samples one fixed image
+    if(bindless){
+        std::string texture_dir = std::filesystem::path(tex_path).parent_path().string();
+        hot_reload.watch(texture_dir.empty() ? "." : texture_dir, {".png", ".jpg", ".jpeg", ".tga", ".bmp", ".dtex"},
+            [this](const std::string& path){
+                MappedFile file(path);
+                auto decoded = std::make_shared<TextureStreamer::Decoded>(texture_streamer.decode(path, file.bytes()));
+                return std::function<void()>([this, decoded]{
+                    TextureStreamer::TextureId id = texture_streamer.find(decoded->path);
+                    if(id != UINT32_MAX){
+                        texture_streamer.replace(id, std::move(*decoded));
+                    }
+                });
+            });
+    }
+
+    std::string model_dir = std::filesystem::path(modelPath()).parent_path().string();
+    hot_reload.watch(model_dir.empty() ? "." : model_dir, {".obj", ".gltf", ".glb", ".bin", ".dmesh"},
+        [this](const std::string& path) -> std::function<void()> {
+            //a changed .bin is one of the glTF's buffers
+            bool buffer = std::filesystem::path(path).extension() == ".bin";
+            if(!HotReload::samePath(path, modelPath()) && !(buffer && std::filesystem::path(modelPath()).extension() == ".gltf")){
+                return {};
+            }
+            auto model = std::make_shared<ModelData>(importModel(modelPath()));
+            return [this, model]{
+                swapModel(std::move(*model));
+            };
+        });
+
+    if(!hot_reload.start()){
+        std::cerr << "Hot reload needs inotify, it's off on this platform." << std::endl;
+    }
+}
+
+/*
+    Swaps in a model parsed by the reload thread. It is added to the geometry pool like at startup; the old
+    mesh is removed once no frame draws it, which compacts the pool when it leaves too big a hole.
+    Materials are created once at startup, new glTF material indices fall back to the default.
+*/
+void Application::swapModel(ModelData model){
+    uint32_t old_mesh = scene_mesh;
+    retireResource([this, old_mesh]{ geometry.remove(old_mesh); });
+
+    adoptModel(std::move(model));
+    if(software_occlusion){
+        collectOccluders();
+    }
+    uploadModel();
+    if(occlusion_culling){
+        occlusion.reserve(static_cast<uint32_t>(scene_draws.size()));
+    }
+
+    gltf_scene.reset();
+    gltf_asset.reset();
+    mesh_package.reset();
+}
+
+/*
+    Destroys something a frame in flight may still use once that frame is done. Frames up to frame_number - 1
+    may use it, the last of them is done MAX_FLIGHT_FRAMES frames later, when drawFrame has waited for its
+    fence. Destroying can retire something else, like the buffers of a pool that compacts once a mesh is
+    gone; that waits for frames of its own.
+*/
+void Application::retireResource(DeletionQueue::Destroy destroy){
+    deletion_queue.push(frame_number + MAX_FLIGHT_FRAMES, std::move(destroy));
+}
+
+void Application::createTextureStreamer(){
+    TextureStreamer::Context ctx{};
+    ctx.device = device;
+    ctx.tracker = &tracker;
+    ctx.device_info = &device_info;
+    ctx.queue = graphics_queue;
+    ctx.queue_family = queue_families.graphics.value();
+    ctx.immediate = &immediate;
+    ctx.frames_in_flight = MAX_FLIGHT_FRAMES;
+    ctx.memory_budget = memory_budget;
+    ctx.find_memory_type = [this](uint32_t type_filter, VkMemoryPropertyFlags properties){
+        return findMemoryTypeIndex(type_filter, properties);
+    };
+    ctx.register_texture = [this](VkImageView view){
+        return registerTexture(view);
+    };
+    ctx.release_texture = [this](uint32_t slot){
+        releaseTexture(slot);
+    };
+    ctx.retire = [this](DeletionQueue::Destroy destroy){
+        retireResource(std::move(destroy));
+    };
+
+    texture_streamer.setup(ctx, MAX_STREAMED_TEXTURES, VkDeviceSize(options.texture_budget_mb) * 1024 * 1024);
+}
+
+/*
+    Sets up the compute queue (the graphics one when there's no compute-only family), the graphics timeline
+    it's synchronised with, the graphics timestamps used to measure the overlap and the demo stage.
+*/
+void Application::createAsyncCompute(){
+    QueueFamilyIndices indices = queue_families;
+
+    AsyncCompute::Context ctx{};
+    ctx.device = device;
+    ctx.device_info = &device_info;
+    ctx.queue = compute_queue;
+    ctx.queue_family = indices.compute.value_or(indices.graphics.value());
+    ctx.dedicated = indices.compute.has_value();
+    ctx.timeline_ext = timeline_semaphores_ext;
+    ctx.frames_in_flight = MAX_FLIGHT_FRAMES;
+
+    async_compute.setup(ctx);
+    graphics_timeline = AsyncCompute::createTimeline(device);
+
+    uint32_t valid_bits = device_info.queueFamilies()[indices.graphics.value()].timestampValidBits;
+    if(valid_bits != 0){
+        timestamp_period = device_info.limits().timestampPeriod;
+        timestamp_mask = valid_bits >= 64 ? UINT64_MAX : (uint64_t(1) << valid_bits) - 1;
+
+        VkQueryPoolCreateInfo query_ci{};
+        query_ci.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        query_ci.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        query_ci.queryCount = 2 * MAX_FLIGHT_FRAMES;
+        if(vkCreateQueryPool(device, &query_ci, nullptr, &frame_queries) != VK_SUCCESS){
+            throw std::runtime_error("Couldn't create frame timestamp queries.");
+        }
+    }
+
+    createParticleStage();
+    async_compute.addStage("particles", [this](VkCommandBuffer target, uint64_t frame){
+        recordParticles(target, frame);
+    });
+
+    if(!options.skinned_model.empty()){
+        createSkinning();
+    }
+}
+
+//Demo compute stage: PARTICLE_COUNT particles integrated in place, only ever touched by the compute queue.
+void Application::createParticleStage(){
+    BufferCreateInfo bci{};
+    bci.size = VkDeviceSize(PARTICLE_COUNT) * sizeof(glm::vec4) * 2;
+    bci.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bci.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    bci.buffer = &particle_buffer;
+    bci.buffer_memory = &particle_mem;
+    bci.tag = "particles";
+    bci.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
+    createBuffer(&bci);
+
+    VkDescriptorSetLayoutBinding binding{};
+    binding.binding = 0;
+    binding.descriptorCount = 1;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layout_ci{};
+    layout_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_ci.bindingCount = 1;
+    layout_ci.pBindings = &binding;
+    if(vkCreateDescriptorSetLayout(device, &layout_ci, nullptr, &particle_layout) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create particle descriptor set layout.");
+    }
+
+    VkDescriptorPoolSize pool_size{};
+    pool_size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_size.descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo pool_ci{};
+    pool_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_ci.maxSets = 1;
+    pool_ci.poolSizeCount = 1;
+    pool_ci.pPoolSizes = &pool_size;
+    if(vkCreateDescriptorPool(device, &pool_ci, nullptr, &particle_pool) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create particle descriptor pool.");
+    }
+
+    VkDescriptorSetAllocateInfo alloci{};
+    alloci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloci.descriptorPool = particle_pool;
+    alloci.descriptorSetCount = 1;
+    alloci.pSetLayouts = &particle_layout;
+    if(vkAllocateDescriptorSets(device, &alloci, &particle_set) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't allocate particle descriptor set.");
+    }
+
+    VkDescriptorBufferInfo buffer_info{};
+    buffer_info.buffer = particle_buffer;
+    buffer_info.offset = 0;
+    buffer_info.range = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = particle_set;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &buffer_info;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+    VkPushConstantRange push_range{};
+    push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_range.offset = 0;
+    push_range.size = sizeof(ParticleStep);
+
+    VkPipelineLayoutCreateInfo pl_ci{};
+    pl_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pl_ci.setLayoutCount = 1;
+    pl_ci.pSetLayouts = &particle_layout;
+    pl_ci.pushConstantRangeCount = 1;
+    pl_ci.pPushConstantRanges = &push_range;
+    if(vkCreatePipelineLayout(device, &pl_ci, nullptr, &particle_pl_layout) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create particle pipeline layout.");
     }
-}
 
-void Application::recordCommandBuffer(VkCommandBuffer target, uint32_t image_index){    
-    VkCommandBufferBeginInfo begin_i{};
-    begin_i.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    
-    if(vkBeginCommandBuffer(target, &begin_i) != VK_SUCCESS){
-        throw std::runtime_error("Couldn't begin recording command buffer.");
+    VkShaderModule comp = createShaderModule("shaders/particles.spv");
+
+    VkComputePipelineCreateInfo pipeline_ci{};
+    pipeline_ci.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_ci.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_ci.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_ci.stage.module = comp;
+    pipeline_ci.stage.pName = "main";
+    pipeline_ci.layout = particle_pl_layout;
+
+    VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_ci, nullptr, &particle_pipeline);
+    vkDestroyShaderModule(device, comp, nullptr);
+    if(result != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create particle pipeline.");
     }
+}
 
-    VkRenderPassBeginInfo rp_bi{};
-    rp_bi.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    rp_bi.renderPass = render_pass;
-    rp_bi.framebuffer = sc_fb[image_index];
-    rp_bi.renderArea.offset = {0,0};
-    rp_bi.renderArea.extent = sc_extent;
+void Application::recordParticles(VkCommandBuffer target, uint64_t frame){
+    auto now = std::chrono::steady_clock::now();
+    float dt = 0.0f;
+    if(frame == 0){
+        //zeroed particles are dead and respawn on their first step
+        vkCmdFillBuffer(target, particle_buffer, 0, VK_WHOLE_SIZE, 0);
 
-    std::array<VkClearValue, 2> clears{};
-    clears[0].color = {{0.2f, 0.2f, 0.2f, 1.0f}};
-    clears[1].depthStencil = {1, 0};
-    rp_bi.clearValueCount = 2;
-    rp_bi.pClearValues = clears.data();
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(target, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+    } else {
+        dt = std::min(std::chrono::duration<float>(now - particle_clock).count(), 0.1f);
+    }
+    particle_clock = now;
+    particle_time += dt;
+
+    ParticleStep step{};
+    step.dt = dt;
+    step.time = particle_time;
+    step.count = PARTICLE_COUNT;
+
+    vkCmdBindPipeline(target, VK_PIPELINE_BIND_POINT_COMPUTE, particle_pipeline);
+    vkCmdBindDescriptorSets(target, VK_PIPELINE_BIND_POINT_COMPUTE, particle_pl_layout, 0, 1, &particle_set, 0, nullptr);
+    vkCmdPushConstants(target, particle_pl_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(step), &step);
+    vkCmdDispatch(target, (PARTICLE_COUNT + 255) / 256, 1, 1);
+}
 
-    vkCmdBeginRenderPass(cmdb[cur_frame], &rp_bi, VK_SUBPASS_CONTENTS_INLINE);
+//Loads the skinned model and lays options.characters copies of it out on a grid above the scene.
+void Application::createSkinning(){
+    GltfAsset asset(options.skinned_model);
+    SkinnedModel model = SkinnedModel::load(asset);
+
+    QueueFamilyIndices indices = queue_families;
+    uint32_t compute_family = indices.compute && timeline_semaphores ? indices.compute.value() : indices.graphics.value();
+
+    SkinningSystem::Context ctx{};
+    ctx.device = device;
+    ctx.tracker = &tracker;
+    ctx.device_info = &device_info;
+    ctx.frames_in_flight = MAX_FLIGHT_FRAMES;
+    ctx.queue_families = {indices.graphics.value()};
+    if(compute_family != indices.graphics.value()){
+        ctx.queue_families.push_back(compute_family);
+    }
+    ctx.compute_family = compute_family;
+    ctx.jobs = &jobs;
+    ctx.find_memory_type = [this](uint32_t type_filter, VkMemoryPropertyFlags properties){
+        return findMemoryTypeIndex(type_filter, properties);
+    };
+    ctx.create_shader = [this](const std::string& path){
+        return createShaderModule(path);
+    };
+    ctx.vertex_stride = sizeof(Vertex) / sizeof(float);
+    ctx.position_offset = offsetof(Vertex, pos) / sizeof(float);
+    ctx.color_offset = offsetof(Vertex, color) / sizeof(float);
+    ctx.uv_offset = offsetof(Vertex, tex_coord) / sizeof(float);
+
+    //glTF is Y up, the scene is Z up. Every character is scaled to the same height.
+    glm::vec3 extent = model.bounds_max - model.bounds_min;
+    float scale = extent.y > 0.0f ? 0.4f / extent.y : 1.0f;
+    glm::mat4 base = glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    base = glm::scale(base, glm::vec3(scale));
+    base = glm::translate(base, glm::vec3(-(model.bounds_min.x + model.bounds_max.x) * 0.5f, -model.bounds_min.y,
+        -(model.bounds_min.z + model.bounds_max.z) * 0.5f));
+
+    uint32_t count = std::max(options.characters, 1u);
+    skinning.setup(ctx, std::move(model), count);
+
+    uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(count))));
+    float spacing = 0.5f;
+    for(uint32_t i = 0; i < count; i++){
+        float x = (static_cast<float>(i % columns) - (columns - 1) * 0.5f) * spacing;
+        float y = (static_cast<float>(i / columns) - (columns - 1) * 0.5f) * spacing;
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, 0.0f)) * base;
+        skinning.addCharacter(transform, i, i + 1, static_cast<float>(i % 5) / 4.0f, static_cast<float>(i) * 0.37f);
+    }
 
-    vkCmdBindPipeline(cmdb[cur_frame], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    async_compute.addStage("skinning", [this](VkCommandBuffer target, uint64_t frame){
+        auto now = std::chrono::steady_clock::now();
+        float dt = frame == 0 ? 0.0f : std::min(std::chrono::duration<float>(now - skinning_clock).count(), 0.1f);
+        skinning_clock = now;
+        skinning.animate(frame, dt);
+        skinning.record(target, frame);
+    });
+    skinning_enabled = true;
+}
 
-    VkBuffer vert_buffers = {vertex_buffer};
-    VkDeviceSize offsets = {0};
-    vkCmdBindVertexBuffers(cmdb[cur_frame], 0, 1, &vert_buffers, &offsets);
+void Application::createOcclusionCuller(){
+    OcclusionCuller::Context ctx{};
+    ctx.device = device;
+    ctx.tracker = &tracker;
+    ctx.device_info = &device_info;
+    ctx.frames_in_flight = MAX_FLIGHT_FRAMES;
+    ctx.pipeline_barrier2 = cmd_pipeline_barrier2;
+    ctx.find_memory_type = [this](uint32_t type_filter, VkMemoryPropertyFlags properties){
+        return findMemoryTypeIndex(type_filter, properties);
+    };
+    ctx.create_shader = [this](const std::string& path){
+        return createShaderModule(path);
+    };
+    ctx.retire = [this](DeletionQueue::Destroy destroy){
+        retireResource(std::move(destroy));
+    };
+    occlusion.setup(ctx);
+}
 
-    vkCmdBindIndexBuffer(cmdb[cur_frame], index_buffer, 0, VK_INDEX_TYPE_UINT32);
-    
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = static_cast<float>(sc_extent.width);
-    viewport.height = static_cast<float>(sc_extent.height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    vkCmdSetViewport(cmdb[cur_frame], 0, 1, &viewport);
-    
-    VkRect2D scissor{};
-    scissor.offset = {0,0};
-    scissor.extent = sc_extent;
-    vkCmdSetScissor(cmdb[cur_frame], 0, 1, &scissor);
+/*
+    Hands this frame's scene draws to the culler in draw_list order, with the same model matrices writeDraws
+    writes and their place in the geometry pool. They are the first keys, so object i draws DrawData i.
+*/
+void Application::updateOcclusion(){
+    uint32_t count = static_cast<uint32_t>(scene_draws.size());
+    OcclusionCuller::Object* objects = occlusion.beginFrame(frame_number, count, view_uniforms.proj * view_uniforms.view);
+    if(objects == nullptr){
+        return;
+    }
+    const GeometryPool::Range& range = geometry.range(scene_mesh);
+    std::span<const uint64_t> keys = draw_list.keys();
+
+    for(uint32_t i = 0; i < count; i++){
+        const SceneDraw& draw = scene_draws[DrawList::index(keys[i])];
+        OcclusionCuller::Object& object = objects[i];
+        object.model = draw_model * draw.transform;
+        object.bounds_min = glm::vec4(draw.bounds_min, 1.0f);
+        object.bounds_max = glm::vec4(draw.bounds_max, 1.0f);
+        object.first_index = range.first_index + draw.first_index;
+        object.index_count = draw.index_count;
+        object.vertex_offset = static_cast<int32_t>(range.first_vertex) + draw.vertex_offset;
+    }
+}
 
-    vkCmdBindDescriptorSets(cmdb[cur_frame], VK_PIPELINE_BIND_POINT_GRAPHICS, pl_layout, 0, 1, &dsets[cur_frame], 0, nullptr);
-    vkCmdDrawIndexed(cmdb[cur_frame], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+/*
+    Takes the MAX_OCCLUDERS scene draws with the biggest boxes as occluders, leaving out dense ones over
+    MAX_OCCLUDER_TRIANGLES. Their triangles are copied out of the model before it is uploaded,
+    a glTF model is expanded once more for that.
+*/
+void Application::collectOccluders(){
+    soft_occlusion.clearOccluders();
+    occluder_draws.clear();
+    draw_visible.clear();
+
+    std::vector<uint32_t> candidates;
+    for(uint32_t i = 0; i < scene_draws.size(); i++){
+        if(scene_draws[i].index_count >= 3 && scene_draws[i].index_count / 3 <= MAX_OCCLUDER_TRIANGLES){
+            candidates.push_back(i);
+        }
+    }
+    //surface of the box in the model's space
+    auto area = [this](uint32_t i){
+        const SceneDraw& draw = scene_draws[i];
+        glm::vec3 size = glm::abs(glm::vec3(draw.transform * glm::vec4(draw.bounds_max - draw.bounds_min, 0.0f)));
+        return size.x * size.y + size.y * size.z + size.z * size.x;
+    };
+    size_t count = std::min<size_t>(candidates.size(), MAX_OCCLUDERS);
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(),
+        [&area](uint32_t a, uint32_t b){ return area(a) > area(b); });
+    candidates.resize(count);
+    if(candidates.empty()){
+        return;
+    }
 
-    ImDrawData* dd = ImGui::GetDrawData();
-    if(dd != nullptr){
-        ImGui_ImplVulkan_RenderDrawData(dd, cmdb[cur_frame]);
+    std::vector<Vertex> expanded_vertices;
+    std::vector<uint32_t> expanded_indices;
+    std::span<const Vertex> vertices = vertexi;
+    std::span<const uint32_t> model_indices = indices;
+    if(gltf_scene){
+        expanded_vertices.resize(gltf_scene->vertexCount());
+        expanded_indices.resize(gltf_scene->indexCount());
+        GltfScene::VertexLayout layout{};
+        layout.stride = sizeof(Vertex) / sizeof(float);
+        layout.position_offset = offsetof(Vertex, pos) / sizeof(float);
+        layout.color_offset = offsetof(Vertex, color) / sizeof(float);
+        layout.uv_offset = offsetof(Vertex, tex_coord) / sizeof(float);
+        gltf_scene->writeVertices(reinterpret_cast<float*>(expanded_vertices.data()), layout);
+        gltf_scene->writeIndices(expanded_indices.data());
+        vertices = expanded_vertices;
+        model_indices = expanded_indices;
+    } else if(mesh_package){
+        vertices = std::span<const Vertex>(reinterpret_cast<const Vertex*>(mesh_package->vertices().data()),
+            mesh_package->header().vertex_count);
+        model_indices = mesh_package->indices();
     }
-    vkCmdEndRenderPass(cmdb[cur_frame]);
 
-    if(vkEndCommandBuffer(cmdb[cur_frame]) != VK_SUCCESS){
-        throw std::runtime_error("Failed to record command buffer.");
+    for(uint32_t index : candidates){
+        const SceneDraw& draw = scene_draws[index];
+        std::vector<glm::vec3> positions;
+        std::vector<uint32_t> local;
+        std::unordered_map<uint32_t, uint32_t> remap;
+
+        size_t end = std::min<size_t>(size_t(draw.first_index) + draw.index_count, model_indices.size());
+        for(size_t i = draw.first_index; i + 3 <= end; i += 3){
+            uint32_t corners[3];
+            bool valid = true;
+            for(int k = 0; k < 3 && valid; k++){
+                int64_t vertex = int64_t(model_indices[i + k]) + draw.vertex_offset;
+                valid = vertex >= 0 && static_cast<uint64_t>(vertex) < vertices.size();
+                corners[k] = static_cast<uint32_t>(vertex);
+            }
+            if(!valid){
+                continue;
+            }
+            for(uint32_t corner : corners){
+                auto [it, inserted] = remap.try_emplace(corner, static_cast<uint32_t>(positions.size()));
+                if(inserted){
+                    positions.push_back(vertices[corner].pos);
+                }
+                local.push_back(it->second);
+            }
+        }
+
+        soft_occlusion.addOccluder(std::move(positions), std::move(local));
+        occluder_draws.push_back(index);
     }
 }
 
-void Application::createDescriptorPool(){
-    std::array<VkDescriptorPoolSize, 2> psizes{};
-    psizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    psizes[0].descriptorCount = static_cast<uint32_t>(MAX_FLIGHT_FRAMES);
-    psizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    psizes[1].descriptorCount = static_cast<uint32_t>(MAX_FLIGHT_FRAMES);
-    VkDescriptorPoolCreateInfo ci{};
-    ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    ci.poolSizeCount = static_cast<uint32_t>(psizes.size());;
-    ci.pPoolSizes = psizes.data();
-    ci.maxSets = static_cast<uint32_t>(MAX_FLIGHT_FRAMES);
+//Rasterizes the occluders with this frame's matrices and marks which scene draws recordMeshDraws skips.
+void Application::updateSoftwareOcclusion(){
+    occluder_models.resize(occluder_draws.size());
+    for(size_t i = 0; i < occluder_draws.size(); i++){
+        occluder_models[i] = draw_model * scene_draws[occluder_draws[i]].transform;
+    }
+    soft_occlusion.rasterize(view_uniforms.proj * view_uniforms.view, occluder_models);
 
-    if(vkCreateDescriptorPool(device, &ci, nullptr, &dpool) != VK_SUCCESS ){
-        throw std::runtime_error("Couldn't create descriptor pool.");
+    occlusion_boxes.resize(scene_draws.size());
+    for(size_t i = 0; i < scene_draws.size(); i++){
+        const SceneDraw& draw = scene_draws[i];
+        occlusion_boxes[i] = {draw_model * draw.transform, draw.bounds_min, draw.bounds_max};
     }
+    draw_visible.resize(scene_draws.size());
+    soft_occlusion.test(occlusion_boxes, draw_visible.data());
 }
 
-void Application::createDescriptorSets(){
-    std::vector<VkDescriptorSetLayout> layouts(MAX_FLIGHT_FRAMES, descriptor_set_layout);
-    VkDescriptorSetAllocateInfo ai{};
-    ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    ai.descriptorPool = dpool;
-    ai.descriptorSetCount = static_cast<uint32_t>(MAX_FLIGHT_FRAMES);
-    ai.pSetLayouts = layouts.data();
-    
-    dsets.resize(MAX_FLIGHT_FRAMES);
-    if(vkAllocateDescriptorSets(device, &ai, dsets.data()) != VK_SUCCESS) {
-        throw std::runtime_error("Couldn't allocate descriptor sets.");
+//Writes a texture into a free slot of the bindless array and returns the slot for materials to reference.
+uint32_t Application::registerTexture(VkImageView view){
+    uint32_t slot;
+    if(!free_texture_slots.empty()){
+        slot = free_texture_slots.back();
+        free_texture_slots.pop_back();
+    } else if(next_texture_slot < bindless_capacity){
+        slot = next_texture_slot++;
+    } else {
+        throw std::runtime_error("Out of bindless texture slots.");
     }
 
-    for (size_t i = 0; i < MAX_FLIGHT_FRAMES; i++){
-        VkDescriptorBufferInfo bi{};
-        bi.buffer = uniform_buffers[i];
-        bi.offset = 0;
-        bi.range = sizeof(UniformBufferObject);
-        
-        VkDescriptorImageInfo ii{};
-        ii.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        ii.imageView = tex_view;
-        ii.sampler = tex_sampler;
+    VkDescriptorImageInfo ii{};
+    ii.imageView = view;
+    ii.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-        std::array<VkWriteDescriptorSet, 2> dwrites{};
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = bindless_set;
+    write.dstBinding = 1;
+    write.dstArrayElement = slot;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    write.descriptorCount = 1;
+    write.pImageInfo = &ii;
 
-        dwrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        dwrites[0].dstSet = dsets[i];
-        dwrites[0].dstBinding = 0;
-        dwrites[0].dstArrayElement = 0;
-        dwrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        dwrites[0].descriptorCount = 1;
-        dwrites[0].pBufferInfo = &bi;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
 
-        dwrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        dwrites[1].dstSet = dsets[i];
-        dwrites[1].dstBinding = 1;
-        dwrites[1].dstArrayElement = 0;
-        dwrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        dwrites[1].descriptorCount = 1;
-        dwrites[1].pImageInfo = &ii;
+    return slot;
+}
 
-        vkUpdateDescriptorSets(device, static_cast<uint32_t>(dwrites.size()), dwrites.data(), 0, nullptr);
+//The slot must no longer be referenced by any frame in flight.
+void Application::releaseTexture(uint32_t slot){
+    free_texture_slots.push_back(slot);
+}
 
+uint32_t Application::createMaterial(const Material& material){
+    if(material_count >= MAX_MATERIALS){
+        throw std::runtime_error("Out of material slots.");
     }
 
+    mmaterials[material_count] = material;
+    return material_count++;
 }
 
 void Application::createSyncObjects(){
@@ -1606,14 +3360,22 @@ void Application::initImGUI(){
     vii.Instance = instance;
     vii.PhysicalDevice = p_device;
     vii.Device = device;
-    QueueFamilyIndices qfi = findQueueFamilies(p_device);
+    QueueFamilyIndices qfi = queue_families;
     vii.Queue = graphics_queue;
     vii.DescriptorPool = imm_dpool;
     vii.MinImageCount = MAX_FLIGHT_FRAMES;
     vii.ImageCount = MAX_FLIGHT_FRAMES;
     vii.PipelineInfoMain.RenderPass = render_pass;
     vii.PipelineInfoMain.Subpass = 0;
-    vii.PipelineInfoMain.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
+    if(dynamic_rendering){
+        vii.UseDynamicRendering = true;
+        vii.PipelineInfoMain.PipelineRenderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+        vii.PipelineInfoMain.PipelineRenderingCreateInfo.colorAttachmentCount = 1;
+        vii.PipelineInfoMain.PipelineRenderingCreateInfo.pColorAttachmentFormats = &sc_format;
+        //the overlay is its own graph pass without a depth attachment
+        vii.PipelineInfoMain.PipelineRenderingCreateInfo.depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+    }
+    vii.PipelineInfoMain.MSAASamples = dynamic_rendering ? VK_SAMPLE_COUNT_1_BIT : msaa_samples;
     vii.CheckVkResultFn = check_vk_result;
 
     ImGui_ImplVulkan_Init(&vii);
@@ -1706,9 +3468,17 @@ void Application::setupImGuiStyle(bool dark, float alpha)
 //Main loop of the application.
 void Application::mainLoop() {
     while(!glfwWindowShouldClose(window)){ // while the window should'nt close:
+        uint64_t allocated = allocations::count();
         glfwPollEvents(); // poll glfw events
         imGuiLoop();
         drawFrame();
+
+        if(options.benchmark_msaa && stepMsaaBenchmark()){
+            break;
+        }
+        if(options.count_allocations && stepAllocationCheck(allocations::count() - allocated)){
+            break;
+        }
     }
 
     vkDeviceWaitIdle(device);
@@ -1721,16 +3491,513 @@ void Application::imGuiLoop(){
 
     ImGui::Begin("Window");
     ImGui::Text("araujo vai se fuder");
+
+    //formatted on the stack, the allocation check covers this function too
+    char msaa_label[8];
+    snprintf(msaa_label, sizeof(msaa_label), "%ux", static_cast<uint32_t>(requested_msaa_samples));
+    if(ImGui::BeginCombo("MSAA", msaa_label)){
+        for(VkSampleCountFlagBits count : {VK_SAMPLE_COUNT_1_BIT, VK_SAMPLE_COUNT_2_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_8_BIT}){
+            if(count > max_msaa_samples){
+                break;
+            }
+            char label[8];
+            snprintf(label, sizeof(label), "%ux", static_cast<uint32_t>(count));
+            if(ImGui::Selectable(label, count == requested_msaa_samples)){
+                requested_msaa_samples = count;
+            }
+        }
+        ImGui::EndCombo();
+    }
+    if(dynamic_rendering){
+        ImGui::Text("Render graph: %zu passes, %zu culled", render_graph.passCount(), render_graph.culledPassCount());
+        ImGui::Text("Transient memory: %.2f MiB (%.2f MiB unaliased)",
+            render_graph.transientMemorySize() / (1024.0 * 1024.0), render_graph.transientRequestedSize() / (1024.0 * 1024.0));
+    }
+    if(bindless){
+        ImGui::Text("Streamed textures: %zu, %zu uploads pending", texture_streamer.textureCount(), texture_streamer.pendingUploads());
+        ImGui::Text("Texture memory: %.2f / %.2f MiB",
+            texture_streamer.residentBytes() / (1024.0 * 1024.0), texture_streamer.budgetBytes() / (1024.0 * 1024.0));
+    }
+    if(timeline_semaphores){
+        ImGui::Text("Async compute: %zu stages on the %s queue", async_compute.stageCount(),
+            async_compute.dedicated() ? "compute" : "graphics");
+        ImGui::Text("GPU graphics %.3f ms, compute %.3f ms, overlapped %.3f ms",
+            compute_timing.graphics_ms, compute_timing.compute_ms, compute_timing.overlap_ms);
+    }
+    ImGui::Text("Scene: %zu objects, %zu draws in %u draw calls, %zu batches, %u binds", scene.size(), scene_draws.size(),
+        draw_calls, draw_batches.size(), state_binds);
+    FrameArena::Stats arena = frame_arena.stats();
+    ImGui::Text("Frame arena: %.1f / %.1f KiB, peak %.1f KiB, %u overflows", arena.used / 1024.0,
+        arena.capacity / 1024.0, arena.peak / 1024.0, arena.overflows);
+    ImGui::Text("Deletion queue: %zu pending", deletion_queue.size());
+    GeometryPool::Stats pooled = geometry.stats();
+    ImGui::Text("Geometry: %u meshes, %.2f / %.2f MiB, %u compactions, %s uploads", pooled.meshes,
+        (pooled.vertex_bytes + pooled.index_bytes) / (1024.0 * 1024.0),
+        (pooled.vertex_capacity + pooled.index_capacity) / (1024.0 * 1024.0), pooled.compactions,
+        pooled.direct ? "direct" : "staged");
+    std::array<ResourceTracker::HeapUsage, VK_MAX_MEMORY_HEAPS> heaps;
+    uint32_t heap_count = tracker.heapUsage(heaps);
+    for(uint32_t heap = 0; heap < heap_count; heap++){
+        const ResourceTracker::HeapUsage& usage = heaps[heap];
+        const char* kind = (usage.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "device" : "host";
+        if(memory_budget){
+            ImGui::Text("Heap %u (%s): %.1f MiB in %u allocations, process %.1f / %.1f MiB budget", heap, kind,
+                usage.tracked / (1024.0 * 1024.0), usage.allocations, usage.usage / (1024.0 * 1024.0), usage.budget / (1024.0 * 1024.0));
+        } else {
+            ImGui::Text("Heap %u (%s): %.1f MiB in %u allocations, %.1f MiB heap", heap, kind,
+                usage.tracked / (1024.0 * 1024.0), usage.allocations, usage.size / (1024.0 * 1024.0));
+        }
+    }
+    if(occlusion_culling){
+        const OcclusionCuller::Stats& culled = occlusion.stats();
+        uint32_t drawn = culled.early + culled.late;
+        ImGui::Text("Occlusion: %u/%u drawn (%.1f%% culled, %u by the frustum), %u revealed late, %u Hi-Z levels",
+            drawn, culled.objects, culled.objects != 0 ? 100.0 * (culled.objects - drawn) / culled.objects : 0.0,
+            culled.frustum_culled, culled.late, occlusion.pyramidLevels());
+    }
+    if(software_occlusion){
+        const SoftwareOcclusion::Stats& soft = soft_occlusion.stats();
+        uint32_t drawn = soft.objects - soft.frustum_culled - soft.occluded;
+        ImGui::Text("CPU occlusion: %u/%u drawn (%u by the frustum, %u occluded), %u occluders, %u triangles",
+            drawn, soft.objects, soft.frustum_culled, soft.occluded, soft.occluders, soft.triangles);
+        ImGui::Text("CPU occlusion: raster %.3f ms, test %.3f ms, %s", soft.raster_ms, soft.test_ms,
+            SoftwareOcclusion::kernelName(soft_occlusion.kernel()));
+    }
+    if(options.hot_reload){
+        ImGui::Text("Hot reload: %zu reloads", hot_reload.reloadCount());
+        hot_reload.lastError(reload_error);
+        if(!reload_error.empty()){
+            ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", reload_error.c_str());
+        }
+    }
+    if(skinning_enabled){
+        size_t count = skinning.characters().size();
+        double animate_ms = skinning.animateMs();
+        double skin_ms = skinning.skinMs();
+        ImGui::Text("Skinning: %zu characters, CPU %.3f ms (%.1f/ms), GPU %.3f ms (%.1f/ms)", count,
+            animate_ms, animate_ms > 0.0 ? count / animate_ms : 0.0, skin_ms, skin_ms > 0.0 ? count / skin_ms : 0.0);
+    }
     ImGui::End();
         
     ImGui::Render();
 }
 
+/*
+    Decodes every image in options.benchmark_decode_dir (repeated up to a batch of DECODE_BENCH_IMAGES)
+    with the serial stbi path and the parallel decoder, then times the pixel kernels against their scalar versions.
+*/
+void Application::benchmarkDecode(){
+    std::vector<std::string> paths;
+    for(const auto& entry : std::filesystem::directory_iterator(options.benchmark_decode_dir)){
+        std::string extension = entry.path().extension().string();
+        if(entry.is_regular_file() && (extension == ".png" || extension == ".jpg" || extension == ".jpeg"
+            || extension == ".tga" || extension == ".bmp")){
+            paths.push_back(entry.path().string());
+        }
+    }
+    if(paths.empty()){
+        throw std::runtime_error("No images in " + options.benchmark_decode_dir + ".");
+    }
+    for(size_t i = 0; paths.size() < DECODE_BENCH_IMAGES; i++){
+        paths.push_back(paths[i]);
+    }
+
+    ImageDecoder decoder(jobs);
+    size_t bytes = decoder.plan(paths);
+    std::vector<uint8_t> staging(bytes, 0);
+
+    auto time_ms = [](auto&& work){
+        auto start = std::chrono::steady_clock::now();
+        work();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    //warm the page cache so neither path pays for the first read from disk
+    decoder.decode(staging.data());
+
+    double serial = time_ms([&]{ decoder.decodeSerial(staging.data()); });
+    double parallel = time_ms([&]{ decoder.decode(staging.data()); });
+    double serial_premultiplied = time_ms([&]{ decoder.decodeSerial(staging.data(), true); });
+    double parallel_premultiplied = time_ms([&]{ decoder.decode(staging.data(), true); });
+
+    double mib = bytes / (1024.0 * 1024.0);
+    std::cout << std::endl << "Decode benchmark: " << paths.size() << " images, " << mib << " MiB RGBA, "
+        << jobs.workerCount() + 1 << " threads" << std::endl;
+    std::cout << "  serial:   " << serial << " ms (" << serial_premultiplied << " ms premultiplied)" << std::endl;
+    std::cout << "  parallel: " << parallel << " ms (" << parallel_premultiplied << " ms premultiplied), "
+        << serial / parallel << "x" << std::endl;
+
+    const size_t kernel_pixels = 4096 * 4096;
+    std::vector<uint8_t> rgb(kernel_pixels * 3);
+    std::vector<uint8_t> rgba(kernel_pixels * 4);
+    for(size_t i = 0; i < rgb.size(); i++){
+        rgb[i] = static_cast<uint8_t>(i * 31);
+    }
+
+    double expand_scalar = time_ms([&]{ pixelformat::rgbToRgbaScalar(rgb.data(), rgba.data(), kernel_pixels); });
+    double expand_simd = time_ms([&]{ pixelformat::rgbToRgba(rgb.data(), rgba.data(), kernel_pixels); });
+
+    //mostly opaque with translucent blocks, like a typical foliage/decal atlas
+    for(size_t i = 0; i < kernel_pixels; i++){
+        rgba[i * 4 + 3] = (i / 64) % 4 == 0 ? static_cast<uint8_t>(i) : 255;
+    }
+    std::vector<uint8_t> premultiplied = rgba;
+    double premultiply_scalar = time_ms([&]{ pixelformat::premultiplySrgbScalar(premultiplied.data(), kernel_pixels); });
+    premultiplied = rgba;
+    double premultiply_skip = time_ms([&]{ pixelformat::premultiplySrgb(premultiplied.data(), kernel_pixels); });
+
+    std::cout << "  rgb->rgba (4096^2):       " << expand_scalar << " ms scalar, " << expand_simd << " ms simd" << std::endl;
+    std::cout << "  srgb premultiply (4096^2): " << premultiply_scalar << " ms scalar, " << premultiply_skip << " ms skipping opaque groups" << std::endl;
+}
+
+/*
+    Parses options.benchmark_import_gltf and options.benchmark_import_obj IMPORT_BENCH_RUNS times each, from
+    opening the file to vertices and indices ready for upload, and reports the fastest run of each.
+    The glTF side writes into preallocated memory, standing in for the staging buffer.
+*/
+void Application::benchmarkImport(){
+    if(options.benchmark_import_obj.empty()){
+        throw std::runtime_error("The import benchmark needs a glTF and an OBJ file.");
+    }
+
+    auto time_ms = [](auto&& work){
+        auto start = std::chrono::steady_clock::now();
+        work();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    std::vector<Vertex> gltf_vertices;
+    std::vector<uint32_t> gltf_indices;
+    size_t gltf_objects = 0;
+    auto import_gltf = [&]{
+        GltfAsset asset(options.benchmark_import_gltf);
+        GltfScene imported(asset);
+        Tree tree;
+        imported.buildTree(tree, nullptr);
+
+        gltf_vertices.resize(imported.vertexCount());
+        gltf_indices.resize(imported.indexCount());
+        GltfScene::VertexLayout layout{};
+        layout.stride = sizeof(Vertex) / sizeof(float);
+        layout.position_offset = offsetof(Vertex, pos) / sizeof(float);
+        layout.color_offset = offsetof(Vertex, color) / sizeof(float);
+        layout.uv_offset = offsetof(Vertex, tex_coord) / sizeof(float);
+        imported.writeVertices(reinterpret_cast<float*>(gltf_vertices.data()), layout);
+        imported.writeIndices(gltf_indices.data());
+        gltf_objects = tree.size();
+    };
+
+    std::vector<Vertex> obj_vertices;
+    std::vector<uint32_t> obj_indices;
+    auto import_obj = [&]{
+        obj_vertices.clear();
+        obj_indices.clear();
+        loadObj(options.benchmark_import_obj, obj_vertices, obj_indices);
+    };
+
+    //warm the page cache so neither path pays for the first read from disk
+    import_gltf();
+    import_obj();
+
+    double gltf_ms = std::numeric_limits<double>::max();
+    double obj_ms = std::numeric_limits<double>::max();
+    for(size_t i = 0; i < IMPORT_BENCH_RUNS; i++){
+        gltf_ms = std::min(gltf_ms, time_ms(import_gltf));
+        obj_ms = std::min(obj_ms, time_ms(import_obj));
+    }
+
+    std::cout << std::endl << "Import benchmark: fastest of " << IMPORT_BENCH_RUNS << " runs" << std::endl;
+    std::cout << "  glTF: " << gltf_ms << " ms, " << gltf_vertices.size() << " vertices, " << gltf_indices.size() / 3
+        << " triangles, " << gltf_objects << " objects" << std::endl;
+    std::cout << "  OBJ:  " << obj_ms << " ms, " << obj_vertices.size() << " vertices, " << obj_indices.size() / 3
+        << " triangles, " << obj_ms / gltf_ms << "x slower" << std::endl;
+}
+
+/*
+    A city of CITY_BLOCKS x CITY_BLOCKS buildings with CITY_PROPS_PER_BLOCK props in the streets around each,
+    seen from street level down several avenues. Every building is an occluder and every building and prop
+    a box to test. Reports the fastest of OCCLUSION_BENCH_RUNS rasterizations and tests per view for each
+    kernel the CPU runs, and how many boxes were culled.
+*/
+void Application::benchmarkOcclusion(){
+    auto time_ms = [](auto&& work){
+        auto start = std::chrono::steady_clock::now();
+        work();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    //unit cube, every building and prop is one scaled and moved
+    std::vector<glm::vec3> cube = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 0}, {0, 0, 1}, {1, 0, 1}, {0, 1, 1}, {1, 1, 1}};
+    std::vector<uint32_t> cube_indices = {0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+        2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+
+    const float block = 40.0f;
+    const float street = 12.0f;
+    //fixed seed, every run sees the same city
+    uint32_t seed = 12345;
+    auto random = [&seed]{
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / float(1 << 24);
+    };
+
+    SoftwareOcclusion culler(jobs);
+    std::vector<glm::mat4> occluder_matrices;
+    std::vector<SoftwareOcclusion::Box> boxes;
+    for(uint32_t z = 0; z < CITY_BLOCKS; z++){
+        for(uint32_t x = 0; x < CITY_BLOCKS; x++){
+            glm::vec3 corner(x * block, 0.0f, z * block);
+            glm::mat4 building = glm::scale(glm::translate(glm::mat4(1.0f), corner),
+                glm::vec3(block - street, 10.0f + random() * 50.0f, block - street));
+            culler.addOccluder(cube, cube_indices);
+            occluder_matrices.push_back(building);
+            boxes.push_back({building, glm::vec3(0.0f), glm::vec3(1.0f)});
+
+            for(uint32_t i = 0; i < CITY_PROPS_PER_BLOCK; i++){
+                //somewhere in the street along one of the building's sides
+                float along = random() * block;
+                float across = block - street + 1.0f + random() * (street - 3.0f);
+                glm::vec3 position = corner + (random() < 0.5f ? glm::vec3(along, 0.0f, across) : glm::vec3(across, 0.0f, along));
+                glm::vec3 size(1.0f + random() * 3.0f, 1.0f + random() * 2.0f, 1.0f + random() * 3.0f);
+                boxes.push_back({glm::scale(glm::translate(glm::mat4(1.0f), position), size), glm::vec3(0.0f), glm::vec3(1.0f)});
+            }
+        }
+    }
+
+    glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 2000.0f);
+    proj[1][1] *= -1;
+    float extent = CITY_BLOCKS * block;
+    std::vector<glm::mat4> views;
+    for(uint32_t i = 0; i < 8; i++){
+        //the middle of every third street, from the edge of the city
+        float avenue = (1 + i / 2 * 3) * block + block - street * 0.5f;
+        glm::vec3 eye = i % 2 == 0 ? glm::vec3(avenue, 1.8f, -10.0f) : glm::vec3(-10.0f, 1.8f, avenue);
+        glm::vec3 target = i % 2 == 0 ? glm::vec3(avenue + 30.0f, 1.8f, extent) : glm::vec3(extent, 8.0f, avenue - 20.0f);
+        views.push_back(proj * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+
+    std::vector<uint8_t> visible(boxes.size());
+    std::cout << std::endl << "Occlusion benchmark: " << culler.occluderCount() << " occluders, " << boxes.size() << " boxes, "
+        << views.size() << " views, " << SoftwareOcclusion::WIDTH << "x" << SoftwareOcclusion::HEIGHT << " buffer, "
+        << jobs.workerCount() + 1 << " threads, fastest of " << OCCLUSION_BENCH_RUNS << " runs" << std::endl;
+
+    for(SoftwareOcclusion::Kernel kernel : {SoftwareOcclusion::Kernel::Scalar, SoftwareOcclusion::Kernel::Sse2, SoftwareOcclusion::Kernel::Avx2}){
+        culler.setKernel(kernel);
+        if(culler.kernel() != kernel){
+            continue;
+        }
+
+        double raster_ms = 0.0;
+        double test_ms = 0.0;
+        uint64_t triangles = 0;
+        uint64_t frustum_culled = 0;
+        uint64_t occluded = 0;
+        for(const glm::mat4& view_proj : views){
+            double raster_fastest = std::numeric_limits<double>::max();
+            double test_fastest = std::numeric_limits<double>::max();
+            for(size_t run = 0; run < OCCLUSION_BENCH_RUNS; run++){
+                raster_fastest = std::min(raster_fastest, time_ms([&]{ culler.rasterize(view_proj, occluder_matrices); }));
+                test_fastest = std::min(test_fastest, time_ms([&]{ culler.test(boxes, visible.data()); }));
+            }
+            raster_ms += raster_fastest;
+            test_ms += test_fastest;
+            triangles += culler.stats().triangles;
+            frustum_culled += culler.stats().frustum_culled;
+            occluded += culler.stats().occluded;
+        }
+
+        double tested = double(boxes.size()) * views.size();
+        std::cout << "  " << SoftwareOcclusion::kernelName(kernel) << ": rasterize " << raster_ms / views.size() << " ms ("
+            << triangles / views.size() << " triangles), test " << test_ms / views.size() << " ms, "
+            << 100.0 * frustum_culled / tested << "% outside the frustum, " << 100.0 * occluded / tested << "% occluded" << std::endl;
+    }
+}
+
+/*
+    Sorts draw lists of a few sizes, keyed like a frame of scene draws: two passes, a few hundred materials
+    and depths spread over a city. Reports the fastest of SORT_BENCH_RUNS sorts by std::sort and by the
+    radix sort on one thread and on all of them.
+*/
+void Application::benchmarkSort(){
+    auto time_ms = [](auto&& work){
+        auto start = std::chrono::steady_clock::now();
+        work();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    uint32_t seed = 12345;
+    auto random = [&seed]{
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / float(1 << 24);
+    };
+
+    std::cout << std::endl << "Sort benchmark: " << jobs.workerCount() + 1 << " threads, fastest of " << SORT_BENCH_RUNS
+        << " runs" << std::endl;
+
+    DrawList list;
+    for(uint32_t count : {1024u, 16384u, 262144u}){
+        std::vector<uint64_t> keys(count);
+        for(uint32_t i = 0; i < count; i++){
+            uint32_t pass = random() < 0.9f ? 0 : 1;
+            keys[i] = DrawList::makeKey(pass, MESH_PIPELINE, random() * 2000.0f, static_cast<uint32_t>(random() * 300.0f), i);
+        }
+        std::vector<uint64_t> expected = keys;
+        std::sort(expected.begin(), expected.end());
+
+        double std_ms = std::numeric_limits<double>::max();
+        double serial_ms = std::numeric_limits<double>::max();
+        double parallel_ms = std::numeric_limits<double>::max();
+        bool matches = true;
+        for(size_t run = 0; run < SORT_BENCH_RUNS; run++){
+            list.data() = keys;
+            std_ms = std::min(std_ms, time_ms([&]{ std::sort(list.data().begin(), list.data().end()); }));
+            list.data() = keys;
+            serial_ms = std::min(serial_ms, time_ms([&]{ list.sort(nullptr); }));
+            matches = matches && std::equal(expected.begin(), expected.end(), list.keys().begin());
+            list.data() = keys;
+            parallel_ms = std::min(parallel_ms, time_ms([&]{ list.sort(&jobs); }));
+            matches = matches && std::equal(expected.begin(), expected.end(), list.keys().begin());
+        }
+
+        std::cout << "  " << count << " draws: std::sort " << std_ms << " ms, radix " << serial_ms << " ms, parallel radix "
+            << parallel_ms << " ms" << (matches ? "" : ", ORDER DIFFERS") << std::endl;
+    }
+}
+
+/*
+    Adds the model UPLOAD_BENCH_RUNS times to a pool that stages it and to one that writes it in place,
+    removing it after each add, and reports the fastest of each. Both pools are made big enough up front,
+    so only the upload is timed. Without device local memory the CPU can write, only staging is timed.
+    Runs from initVulkan right after uploadModel, addModel reads the glTF scene or package every time and
+    those are dropped at the end of startup.
+*/
+void Application::benchmarkUpload(){
+    auto time_ms = [](auto&& work){
+        auto start = std::chrono::steady_clock::now();
+        work();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    GeometryPool::Stats scene_stats = geometry.stats();
+    uint32_t vertex_count = static_cast<uint32_t>(scene_stats.vertex_bytes / sizeof(Vertex));
+    uint32_t index_count = static_cast<uint32_t>(scene_stats.index_bytes / sizeof(uint32_t));
+    double mib = (scene_stats.vertex_bytes + scene_stats.index_bytes) / (1024.0 * 1024.0);
+    if(vertex_count == 0 || index_count == 0){
+        std::cout << std::endl << "Upload benchmark: the model has no geometry to upload." << std::endl;
+        return;
+    }
+
+    bool direct_available = device_info.directUploadTypes() != 0;
+    std::cout << std::endl << "Upload benchmark: " << device_info.properties().deviceName << ", " << mib << " MiB of geometry, "
+        << (direct_available ? "host visible device local memory" : "no host visible device local memory")
+        << ", fastest of " << UPLOAD_BENCH_RUNS << " runs" << std::endl;
+
+    for(bool direct : {false, true}){
+        if(direct && !direct_available){
+            continue;
+        }
+        GeometryPool pool;
+        pool.setup(geometryPoolContext(direct), sizeof(Vertex), vertex_count, index_count);
+
+        double fastest = std::numeric_limits<double>::max();
+        VkDeviceSize uploaded = 0;
+        for(size_t run = 0; run < UPLOAD_BENCH_RUNS; run++){
+            uint32_t mesh = 0;
+            fastest = std::min(fastest, time_ms([&]{ mesh = addModel(pool); }));
+            GeometryPool::Stats stats = pool.stats();
+            uploaded = stats.vertex_bytes + stats.index_bytes;
+            pool.remove(mesh);
+        }
+        pool.destroy();
+
+        double uploaded_mib = uploaded / (1024.0 * 1024.0);
+        std::cout << "  " << (direct ? "direct: " : "staged: ") << fastest << " ms for " << uploaded << " bytes, "
+            << (fastest > 0.0 ? uploaded_mib / (fastest / 1000.0) : 0.0) << " MiB/s" << std::endl;
+    }
+}
+
+/*
+    Called once per frame in benchmark mode. Each sample count gets BENCH_WARMUP_FRAMES to settle
+    and is then timed over BENCH_FRAMES. Returns true once every count has been measured.
+*/
+bool Application::stepMsaaBenchmark(){
+    if(msaa_samples != msaa_bench.counts[msaa_bench.current]){
+        return false;
+    }
+
+    msaa_bench.frame++;
+    if(msaa_bench.frame == BENCH_WARMUP_FRAMES){
+        msaa_bench.start = std::chrono::steady_clock::now();
+    }
+    if(msaa_bench.frame < BENCH_WARMUP_FRAMES + BENCH_FRAMES){
+        return false;
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - msaa_bench.start;
+    msaa_bench.frame_ms.push_back(std::chrono::duration<double, std::milli>(elapsed).count() / BENCH_FRAMES);
+    msaa_bench.frame = 0;
+    msaa_bench.current++;
+
+    if(msaa_bench.current < msaa_bench.counts.size()){
+        requested_msaa_samples = msaa_bench.counts[msaa_bench.current];
+        return false;
+    }
+
+    std::cout << std::endl << "MSAA benchmark (" << sc_extent.width << "x" << sc_extent.height << ", "
+        << BENCH_FRAMES << " frames each):" << std::endl;
+    for(size_t i = 0; i < msaa_bench.counts.size(); i++){
+        std::cout << "  " << msaa_bench.counts[i] << "x: " << msaa_bench.frame_ms[i] << " ms/frame ("
+            << msaa_bench.frame_ms[i] - msaa_bench.frame_ms[0] << " ms over 1x)" << std::endl;
+    }
+    return true;
+}
+
+/*
+    Adds up the heap allocations of whole frames (events, the overlay and drawFrame) over BENCH_FRAMES
+    frames, after BENCH_WARMUP_FRAMES for the arena, draw ring and sort buffers to reach their size. Frames
+    that recreate the swapchain allocate, so the window shouldn't be resized meanwhile, and the count is
+    process wide, so a hot reload running next to it shows up too. Returns true once the frames are counted,
+    run() then fails if any of them allocated.
+*/
+bool Application::stepAllocationCheck(uint64_t allocated){
+    allocation_check.frame++;
+    if(allocation_check.frame <= BENCH_WARMUP_FRAMES){
+        return false;
+    }
+    allocation_check.allocations += allocated;
+    if(allocated != 0){
+        allocation_check.allocating_frames++;
+    }
+    if(allocation_check.frame < BENCH_WARMUP_FRAMES + BENCH_FRAMES){
+        return false;
+    }
+
+    std::cout << std::endl << "Allocation check (" << BENCH_FRAMES << " frames): " << allocation_check.allocations
+        << " heap allocations, " << allocation_check.allocating_frames << " frames allocated" << std::endl;
+    return true;
+}
+
 //draws current frame and presents last one
 void Application::drawFrame(){
+    if(requested_msaa_samples != msaa_samples){
+        applyMsaaSamples();
+    }
+
     if(vkWaitForFences(device, 1, &fs_flight[cur_frame], VK_TRUE, UINT64_MAX) != VK_SUCCESS){
         throw std::runtime_error("Couldnt wait for flight fences.");
     }
+
+    frame_arena.beginFrame(cur_frame);
+    deletion_queue.release(frame_number);
+    if(options.hot_reload){
+        hot_reload.apply();
+    }
+
+    if(bindless){
+        texture_streamer.update(cur_frame);
+    }
+    if(timeline_semaphores){
+        sampleComputeTiming();
+    }
     
     uint32_t image_index;
     VkResult next_image_result = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, sps_image_available[cur_frame], VK_NULL_HANDLE, &image_index);
@@ -1750,26 +4017,60 @@ void Application::drawFrame(){
     if(vkResetCommandBuffer(cmdb[cur_frame], 0) != VK_SUCCESS){
         throw std::runtime_error("Couldn't reset command buffer.");
     }
+    updateUniformBuffer(cur_frame);
+    if(software_occlusion){
+        updateSoftwareOcclusion();
+    }
+    sortDraws();
+    if(occlusion_culling){
+        updateOcclusion();
+    }
+    writeDraws();
+
     recordCommandBuffer(cmdb[cur_frame], image_index);
 
-    updateUniformBuffer(cur_frame);
+    uint32_t timeline_count = 0;
+    if(timeline_semaphores){
+        //compute runs a frame ahead: frame N + 1's dispatches overlap this frame's graphics
+        for(; compute_frame <= frame_number + 1; compute_frame++){
+            //graphics of the frame that last used this compute frame's slot
+            uint64_t released = compute_frame + 1 > MAX_FLIGHT_FRAMES ? compute_frame + 1 - MAX_FLIGHT_FRAMES : 0;
+            async_compute.submit(compute_frame, graphics_timeline, released);
+        }
+        timeline_count = 1;
+    }
 
     VkSubmitInfo submit_info{};
     submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore wait_semaphores[] = {sps_image_available[cur_frame]};
-    VkPipelineStageFlags stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submit_info.waitSemaphoreCount = 1;
+    VkSemaphore wait_semaphores[] = {sps_image_available[cur_frame], async_compute.timeline()};
+    VkPipelineStageFlags stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT};
+    submit_info.waitSemaphoreCount = 1 + timeline_count;
     submit_info.pWaitSemaphores = wait_semaphores;
     submit_info.pWaitDstStageMask = stages;
 
     submit_info.commandBufferCount = 1;
     submit_info.pCommandBuffers = &cmdb[cur_frame];
 
-    VkSemaphore signal_semaphores[] = {sps_render_finished[image_index]};
-    submit_info.signalSemaphoreCount = 1;
+    VkSemaphore signal_semaphores[] = {sps_render_finished[image_index], graphics_timeline};
+    submit_info.signalSemaphoreCount = 1 + timeline_count;
     submit_info.pSignalSemaphores = signal_semaphores;
 
+    //the binary semaphores' values are ignored
+    uint64_t wait_values[] = {0, frame_number + 1};
+    uint64_t signal_values[] = {0, frame_number + 1};
+
+    VkTimelineSemaphoreSubmitInfoKHR timeline_info{};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    timeline_info.waitSemaphoreValueCount = submit_info.waitSemaphoreCount;
+    timeline_info.pWaitSemaphoreValues = wait_values;
+    timeline_info.signalSemaphoreValueCount = submit_info.signalSemaphoreCount;
+    timeline_info.pSignalSemaphoreValues = signal_values;
+    if(timeline_semaphores){
+        submit_info.pNext = &timeline_info;
+    }
+
     if(vkQueueSubmit(graphics_queue, 1, &submit_info, fs_flight[cur_frame]) != VK_SUCCESS){
         throw std::runtime_error("Couldn't submit draw queue commands.");
     }
@@ -1793,36 +4094,118 @@ void Application::drawFrame(){
         throw std::runtime_error("Couldn't present swapchain images.");
     }
     cur_frame = (cur_frame + 1) % MAX_FLIGHT_FRAMES;
+    frame_number++;
+}
+
+/*
+    Called once this slot's fence signalled, so graphics of frame_number - MAX_FLIGHT_FRAMES is done.
+    Its timestamps are compared with those of the compute frame after it, which ran next to it.
+*/
+void Application::sampleComputeTiming(){
+    if(frame_queries == nullptr || frame_number < MAX_FLIGHT_FRAMES){
+        return;
+    }
+
+    AsyncCompute::Interval compute;
+    if(!async_compute.interval(frame_number - MAX_FLIGHT_FRAMES + 1, compute)){
+        return;
+    }
+
+    uint64_t ticks[2];
+    if(vkGetQueryPoolResults(device, frame_queries, cur_frame * 2, 2, sizeof(ticks), ticks, sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT) != VK_SUCCESS){
+        return;
+    }
+
+    AsyncCompute::Interval graphics;
+    graphics.begin = double(ticks[0] & timestamp_mask) * timestamp_period;
+    graphics.end = double(ticks[1] & timestamp_mask) * timestamp_period;
+
+    double overlap = std::max(0.0, std::min(graphics.end, compute.end) - std::max(graphics.begin, compute.begin));
+
+    //exponential moving average, so the overlay stays readable
+    const double smoothing = 0.05;
+    compute_timing.graphics_ms += ((graphics.end - graphics.begin) / 1e6 - compute_timing.graphics_ms) * smoothing;
+    compute_timing.compute_ms += ((compute.end - compute.begin) / 1e6 - compute_timing.compute_ms) * smoothing;
+    compute_timing.overlap_ms += (overlap / 1e6 - compute_timing.overlap_ms) * smoothing;
 }
 
+/*
+    Updates the scene model matrix, which writeDraws folds into each draw's DrawData entry, and,
+    only if the camera or the swapchain extent changed, the view/proj in this frame's ring slice.
+*/
 void Application::updateUniformBuffer(uint32_t cur_image){
     static auto start_time = std::chrono::high_resolution_clock::now();
 
     auto current_time = std::chrono::high_resolution_clock::now();
     float time = std::chrono::duration<float, std::chrono::seconds::period>(current_time - start_time).count();
 
-    UniformBufferObject ubo{};
-    ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    ubo.view = ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    ubo.proj = glm::perspective(glm::radians(45.0f), sc_extent.width / (float) sc_extent.height, 0.1f, 10.0f);
+    draw_model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
+    if(view_version != camera_version){
+        view_uniforms.view = glm::lookAt(camera_eye, camera_target, camera_up);
+        view_uniforms.proj = glm::perspective(glm::radians(45.0f), sc_extent.width / (float) sc_extent.height, 0.1f, 10.0f);
+        view_uniforms.proj[1][1] *= -1;
+        view_version = camera_version;
+    }
 
-    ubo.proj[1][1] *= -1;
+    if(view_ring_versions[cur_image] != view_version){
+        memcpy(mview_ring + view_ring_stride * cur_image, &view_uniforms, sizeof(view_uniforms));
+        view_ring_versions[cur_image] = view_version;
+    }
+}
 
-    memcpy(muniform_buffers[cur_image], &ubo, sizeof(ubo));
+void Application::setCamera(const glm::vec3& eye, const glm::vec3& target){
+    camera_eye = eye;
+    camera_target = target;
+    camera_version++;
 }
 
 //Cleans up and closes everything.
 void Application::cleanUp() {
+    hot_reload.stop();
+    //first, so retired meshes don't compact a pool that is going away
+    geometry.destroy();
+    deletion_queue.flush();
+    frame_arena.destroy();
+    vkDestroyPipelineCache(device, pipeline_cache, nullptr);
+
     for(size_t i = 0; i < MAX_FLIGHT_FRAMES; i++){ // DESTROY SYNC OBJECTS
         vkDestroySemaphore(device, sps_image_available[i], nullptr);
         vkDestroySemaphore(device, sps_render_finished[i], nullptr);
         vkDestroyFence(device, fs_flight[i], nullptr);
-        vkDestroyBuffer(device, uniform_buffers[i], nullptr);
-        vkFreeMemory(device, uniform_buffer_mems[i], nullptr);
     }
+    tracker.destroyBuffer(view_ring);
+    tracker.freeMemory(view_ring_mem);
+    tracker.destroyBuffer(draw_ring);
+    tracker.freeMemory(draw_ring_mem);
     
     vkDestroyDescriptorPool(device, dpool, nullptr);
     vkDestroyDescriptorSetLayout(device, descriptor_set_layout, nullptr);
+    vkDestroyDescriptorPool(device, bindless_pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, bindless_layout, nullptr);
+    tracker.destroyBuffer(material_buffer);
+    tracker.freeMemory(material_mem);
+    if(bindless){
+        texture_streamer.destroy();
+    }
+    if(skinning_enabled){
+        skinning.destroy();
+    }
+    if(occlusion_culling){
+        occlusion.destroy();
+    }
+    if(timeline_semaphores){
+        async_compute.destroy();
+        vkDestroySemaphore(device, graphics_timeline, nullptr);
+        vkDestroyQueryPool(device, frame_queries, nullptr);
+        vkDestroyPipeline(device, particle_pipeline, nullptr);
+        vkDestroyPipelineLayout(device, particle_pl_layout, nullptr);
+        vkDestroyDescriptorPool(device, particle_pool, nullptr);
+        vkDestroyDescriptorSetLayout(device, particle_layout, nullptr);
+        tracker.destroyBuffer(particle_buffer);
+        tracker.freeMemory(particle_mem);
+    }
    
     ImGui_ImplVulkan_Shutdown();
     ImGui_ImplGlfw_Shutdown();
@@ -1831,20 +4214,21 @@ void Application::cleanUp() {
 
     vkDestroySampler(device, tex_sampler, nullptr);
     vkDestroyImageView(device, tex_view, nullptr);
-    vkDestroyImage(device, tex_image, nullptr);
-    vkFreeMemory(device, tex_mem, nullptr);
-
-    vkDestroyBuffer(device, vertex_buffer, nullptr);
-    vkFreeMemory(device, vertex_mem, nullptr);
-    vkDestroyBuffer(device, index_buffer, nullptr);
-    vkFreeMemory(device, index_mem, nullptr);
+    tracker.destroyImage(tex_image);
+    tracker.freeMemory(tex_mem);
 
     vkDestroyCommandPool(device, cmdp, nullptr); // DESTROY COMMAND POOL
+    immediate.destroy();
+    transfer_immediate.destroy();
 
     vkDestroyPipeline(device, pipeline, nullptr); // DESTROY PIPELINE
     vkDestroyPipelineLayout(device, pl_layout, nullptr); // DESTROY PIPELINE LAYOUT
     vkDestroyRenderPass(device, render_pass, nullptr); // DESTROY RENDER PASS
 
+    size_t leaked = tracker.reportLeaks(std::cerr);
+    if(leaked != 0){
+        std::cerr << leaked << " buffers, images or allocations weren't destroyed." << std::endl;
+    }
     vkDestroyDevice(device, nullptr); // DESTROY LOGICAL DEVICE
 
     vkDestroySurfaceKHR(instance, surface, nullptr); // DESTROY WINDOW SURFACE
@@ -0,0 +1,339 @@
+#include "archive.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+
+#ifdef DOMK_HAS_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+
+#ifdef DOMK_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+    const int ZSTD_LEVEL = 19;
+
+    uint64_t alignUp(uint64_t offset, uint64_t alignment){
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    //Empty when the entry should be stored, because the codec is missing or it didn't shrink enough.
+    std::vector<std::byte> compress(std::span<const std::byte> data, AssetArchive::Compression compression){
+        std::vector<std::byte> out;
+        switch(compression){
+#ifdef DOMK_HAS_LZ4
+            case AssetArchive::Compression::Lz4: {
+                if(data.size() > LZ4_MAX_INPUT_SIZE){
+                    return {};
+                }
+                out.resize(LZ4_compressBound(static_cast<int>(data.size())));
+                int written = LZ4_compress_HC(reinterpret_cast<const char*>(data.data()), reinterpret_cast<char*>(out.data()),
+                    static_cast<int>(data.size()), static_cast<int>(out.size()), LZ4HC_CLEVEL_DEFAULT);
+                out.resize(written > 0 ? static_cast<size_t>(written) : 0);
+                break;
+            }
+#endif
+#ifdef DOMK_HAS_ZSTD
+            case AssetArchive::Compression::Zstd: {
+                out.resize(ZSTD_compressBound(data.size()));
+                size_t written = ZSTD_compress(out.data(), out.size(), data.data(), data.size(), ZSTD_LEVEL);
+                out.resize(ZSTD_isError(written) ? 0 : written);
+                break;
+            }
+#endif
+            default:
+                return {};
+        }
+
+        if(out.empty() || out.size() > data.size() - data.size() / 8){
+            return {};
+        }
+        return out;
+    }
+
+    //src and dst go unused when neither codec is compiled in
+    void decompress([[maybe_unused]] std::span<const std::byte> src, AssetArchive::Compression compression,
+        [[maybe_unused]] std::span<std::byte> dst){
+        switch(compression){
+#ifdef DOMK_HAS_LZ4
+            case AssetArchive::Compression::Lz4: {
+                int written = LZ4_decompress_safe(reinterpret_cast<const char*>(src.data()), reinterpret_cast<char*>(dst.data()),
+                    static_cast<int>(src.size()), static_cast<int>(dst.size()));
+                if(written < 0 || static_cast<size_t>(written) != dst.size()){
+                    throw std::runtime_error("Corrupt LZ4 entry in asset archive.");
+                }
+                return;
+            }
+#endif
+#ifdef DOMK_HAS_ZSTD
+            case AssetArchive::Compression::Zstd: {
+                size_t written = ZSTD_decompress(dst.data(), dst.size(), src.data(), src.size());
+                if(ZSTD_isError(written) || written != dst.size()){
+                    throw std::runtime_error("Corrupt zstd entry in asset archive.");
+                }
+                return;
+            }
+#endif
+            default:
+                throw std::runtime_error("Asset archive entry uses a compression this build doesn't support.");
+        }
+    }
+}
+
+AssetArchive::AssetArchive(const std::string& path) : source(path), file(path, MappedFile::Access::Random) {
+    if(file.size() < sizeof(Header)){
+        throw std::runtime_error(path + " is not an asset archive.");
+    }
+    header = reinterpret_cast<const Header*>(file.data());
+    if(header->magic != MAGIC){
+        throw std::runtime_error(path + " is not an asset archive.");
+    }
+    if(header->version != VERSION){
+        throw std::runtime_error(path + " was packed by a different version, pack it again.");
+    }
+
+    uint64_t bucket_count = uint64_t(1) << header->bucket_bits;
+    if(header->bucket_bits > 32 || header->entry_count > file.size() / sizeof(TocEntry)
+        || header->toc_offset + header->entry_count * sizeof(TocEntry) > file.size()
+        || header->buckets_offset + (bucket_count + 1) * sizeof(uint32_t) > file.size()
+        || header->names_offset > file.size() || header->names_size > file.size() - header->names_offset
+        || header->toc_offset % alignof(TocEntry) != 0 || header->buckets_offset % alignof(uint32_t) != 0){
+        throw std::runtime_error(path + " is truncated.");
+    }
+    toc = reinterpret_cast<const TocEntry*>(file.data() + header->toc_offset);
+    buckets = reinterpret_cast<const uint32_t*>(file.data() + header->buckets_offset);
+
+    //checked once here so lookups can trust the tables
+    if(buckets[bucket_count] != header->entry_count){
+        throw std::runtime_error(path + " has a broken table of contents.");
+    }
+    for(uint64_t b = 0; b < bucket_count; b++){
+        if(buckets[b] > buckets[b + 1]){
+            throw std::runtime_error(path + " has a broken table of contents.");
+        }
+    }
+    for(uint64_t i = 0; i < header->entry_count; i++){
+        const TocEntry& entry = toc[i];
+        if(entry.offset > file.size() || entry.stored_size > file.size() - entry.offset || entry.name_offset >= header->names_size
+            || (entry.compression == Compression::None && entry.stored_size != entry.size)){
+            throw std::runtime_error(path + " has a broken table of contents.");
+        }
+    }
+
+    unpacked_offsets.assign(header->entry_count, SIZE_MAX);
+    statistics.entries = header->entry_count;
+}
+
+/*
+    Every compressed entry gets its own 16 byte aligned range of one allocation, sized up front,
+    so the jobs write to disjoint memory and nothing moves afterwards.
+*/
+void AssetArchive::unpack(JobSystem& jobs){
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<uint32_t> pending;
+    size_t total = 0;
+    for(uint32_t i = 0; i < header->entry_count; i++){
+        if(toc[i].compression != Compression::None && unpacked_offsets[i] == SIZE_MAX){
+            unpacked_offsets[i] = total;
+            total = alignUp(total + toc[i].size, 16);
+            pending.push_back(i);
+        }
+    }
+    if(pending.empty()){
+        return;
+    }
+
+    std::vector<std::byte> arena(total);
+    jobs.parallelFor(static_cast<uint32_t>(pending.size()), [this, &pending, &arena](uint32_t job){
+        const TocEntry& entry = toc[pending[job]];
+        decompress(file.bytes().subspan(entry.offset, entry.stored_size), entry.compression,
+            std::span(arena).subspan(unpacked_offsets[pending[job]], entry.size));
+    });
+    unpacked = std::move(arena);
+
+    for(uint32_t i : pending){
+        statistics.read_bytes += toc[i].stored_size;
+        statistics.unpacked_bytes += toc[i].size;
+    }
+    statistics.unpacked_entries += pending.size();
+    statistics.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+const AssetArchive::TocEntry* AssetArchive::lookup(uint64_t id) const {
+    uint64_t bucket = header->bucket_bits == 0 ? 0 : id >> (64 - header->bucket_bits);
+    for(uint32_t i = buckets[bucket]; i < buckets[bucket + 1]; i++){
+        if(toc[i].id == id){
+            return &toc[i];
+        }
+    }
+    return nullptr;
+}
+
+std::span<const std::byte> AssetArchive::find(uint64_t id) const {
+    const TocEntry* entry = lookup(id);
+    if(entry == nullptr){
+        return {};
+    }
+    if(entry->compression == Compression::None){
+        return file.bytes().subspan(entry->offset, entry->size);
+    }
+
+    size_t offset = unpacked_offsets[entry - toc];
+    if(offset == SIZE_MAX){
+        throw std::runtime_error("Asset archive " + source + " has to be unpacked before reading compressed entries.");
+    }
+    return std::span<const std::byte>(unpacked).subspan(offset, entry->size);
+}
+
+//the id alone could match a name that was never packed, so the stored name is compared too
+std::span<const std::byte> AssetArchive::find(const std::string& name) const {
+    uint64_t id = assetId(name);
+    const TocEntry* entry = lookup(id);
+    if(entry == nullptr){
+        return {};
+    }
+    const char* names = file.data() + header->names_offset;
+    std::string_view stored(names + entry->name_offset, strnlen(names + entry->name_offset, header->names_size - entry->name_offset));
+    if(stored != std::filesystem::path(name).lexically_normal().generic_string()){
+        return {};
+    }
+    return find(id);
+}
+
+const AssetArchive::Stats& AssetArchive::stats() const {
+    return statistics;
+}
+
+size_t AssetArchive::size() const {
+    return header->entry_count;
+}
+
+uint64_t AssetArchive::assetId(const std::string& name){
+    std::string normal = std::filesystem::path(name).lexically_normal().generic_string();
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for(char c : normal){
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+bool AssetArchive::supports(Compression compression){
+    switch(compression){
+        case Compression::None:
+            return true;
+#ifdef DOMK_HAS_LZ4
+        case Compression::Lz4:
+            return true;
+#endif
+#ifdef DOMK_HAS_ZSTD
+        case Compression::Zstd:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+void AssetArchive::write(const std::string& path, const std::vector<Source>& sources, Compression compression, JobSystem& jobs){
+    if(!supports(compression)){
+        throw std::runtime_error("This build can't compress asset archives with the requested codec.");
+    }
+
+    struct Pending{
+        uint64_t id;
+        std::string name;
+        MappedFile file;
+        std::vector<std::byte> compressed;
+    };
+    std::vector<Pending> entries(sources.size());
+    for(size_t i = 0; i < sources.size(); i++){
+        entries[i].name = std::filesystem::path(sources[i].name).lexically_normal().generic_string();
+        entries[i].id = assetId(entries[i].name);
+        entries[i].file = MappedFile(sources[i].path);
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Pending& a, const Pending& b){
+        return a.id < b.id;
+    });
+    for(size_t i = 1; i < entries.size(); i++){
+        if(entries[i].id == entries[i - 1].id){
+            throw std::runtime_error("Asset ids of " + entries[i - 1].name + " and " + entries[i].name + " collide.");
+        }
+    }
+
+    jobs.parallelFor(static_cast<uint32_t>(entries.size()), [&entries, compression](uint32_t i){
+        entries[i].compressed = compress(entries[i].file.bytes(), compression);
+    });
+
+    Header header{};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.page_size = PAGE_SIZE;
+    header.entry_count = entries.size();
+    while((uint64_t(1) << header.bucket_bits) < entries.size()){
+        header.bucket_bits++;
+    }
+    uint64_t bucket_count = uint64_t(1) << header.bucket_bits;
+
+    std::vector<TocEntry> table(entries.size());
+    std::vector<uint32_t> bucket_table(bucket_count + 1, 0);
+    std::string names;
+    for(size_t i = 0; i < entries.size(); i++){
+        table[i].id = entries[i].id;
+        table[i].size = entries[i].file.size();
+        table[i].compression = entries[i].compressed.empty() ? Compression::None : compression;
+        table[i].stored_size = entries[i].compressed.empty() ? entries[i].file.size() : entries[i].compressed.size();
+        table[i].name_offset = static_cast<uint32_t>(names.size());
+        names += entries[i].name;
+        names.push_back('\0');
+
+        uint64_t bucket = header.bucket_bits == 0 ? 0 : entries[i].id >> (64 - header.bucket_bits);
+        bucket_table[bucket + 1]++;
+    }
+    std::partial_sum(bucket_table.begin(), bucket_table.end(), bucket_table.begin());
+
+    header.toc_offset = alignUp(sizeof(Header), alignof(TocEntry));
+    header.buckets_offset = header.toc_offset + table.size() * sizeof(TocEntry);
+    header.names_offset = header.buckets_offset + bucket_table.size() * sizeof(uint32_t);
+    header.names_size = names.size();
+    uint64_t offset = header.names_offset + names.size();
+    for(TocEntry& entry : table){
+        entry.offset = alignUp(offset, PAGE_SIZE);
+        offset = entry.offset + entry.stored_size;
+    }
+
+    std::string temporary = path + ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    if(!out){
+        throw std::runtime_error("Couldn't create " + temporary + ".");
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.seekp(static_cast<std::streamoff>(header.toc_offset));
+    out.write(reinterpret_cast<const char*>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(TocEntry)));
+    out.write(reinterpret_cast<const char*>(bucket_table.data()), static_cast<std::streamsize>(bucket_table.size() * sizeof(uint32_t)));
+    out.write(names.data(), static_cast<std::streamsize>(names.size()));
+
+    static const char padding[PAGE_SIZE] = {};
+    uint64_t written = header.names_offset + names.size();
+    for(size_t i = 0; i < entries.size(); i++){
+        out.write(padding, static_cast<std::streamsize>(table[i].offset - written));
+        std::span<const std::byte> stored = entries[i].compressed.empty() ? entries[i].file.bytes() : std::span<const std::byte>(entries[i].compressed);
+        out.write(reinterpret_cast<const char*>(stored.data()), static_cast<std::streamsize>(stored.size()));
+        written = table[i].offset + stored.size();
+    }
+
+    out.close();
+    if(!out){
+        throw std::runtime_error("Couldn't write " + temporary + ".");
+    }
+    std::filesystem::rename(temporary, path);
+}
@@ -0,0 +1,214 @@
+#include "asynccompute.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+void AsyncCompute::setup(const Context& context){
+    ctx = context;
+
+    wait_semaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(
+        vkGetDeviceProcAddr(ctx.device, ctx.timeline_ext ? "vkWaitSemaphoresKHR" : "vkWaitSemaphores"));
+    get_counter_value = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+        vkGetDeviceProcAddr(ctx.device, ctx.timeline_ext ? "vkGetSemaphoreCounterValueKHR" : "vkGetSemaphoreCounterValue"));
+    if(wait_semaphores == nullptr || get_counter_value == nullptr){
+        throw std::runtime_error("Couldn't load timeline semaphore functions.");
+    }
+
+    timeline_semaphore = createTimeline(ctx.device);
+
+    VkCommandPoolCreateInfo pool_ci{};
+    pool_ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_ci.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_ci.queueFamilyIndex = ctx.queue_family;
+    if(vkCreateCommandPool(ctx.device, &pool_ci, nullptr, &pool) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create compute command pool.");
+    }
+
+    buffers.resize(ctx.frames_in_flight);
+    slot_frames.assign(ctx.frames_in_flight, UINT64_MAX);
+
+    VkCommandBufferAllocateInfo buffer_i{};
+    buffer_i.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    buffer_i.commandPool = pool;
+    buffer_i.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    buffer_i.commandBufferCount = ctx.frames_in_flight;
+    if(vkAllocateCommandBuffers(ctx.device, &buffer_i, buffers.data()) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't allocate compute command buffers.");
+    }
+
+    uint32_t valid_bits = ctx.device_info->queueFamilies()[ctx.queue_family].timestampValidBits;
+    if(valid_bits != 0){
+        timestamp_period = ctx.device_info->limits().timestampPeriod;
+        timestamp_mask = valid_bits >= 64 ? UINT64_MAX : (uint64_t(1) << valid_bits) - 1;
+
+        VkQueryPoolCreateInfo query_ci{};
+        query_ci.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        query_ci.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        query_ci.queryCount = 2 * ctx.frames_in_flight;
+        if(vkCreateQueryPool(ctx.device, &query_ci, nullptr, &queries) != VK_SUCCESS){
+            throw std::runtime_error("Couldn't create compute timestamp queries.");
+        }
+    }
+}
+
+void AsyncCompute::destroy(){
+    if(timeline_semaphore == VK_NULL_HANDLE){
+        return;
+    }
+
+    vkDestroyQueryPool(ctx.device, queries, nullptr);
+    vkDestroyCommandPool(ctx.device, pool, nullptr);
+    vkDestroySemaphore(ctx.device, timeline_semaphore, nullptr);
+
+    queries = VK_NULL_HANDLE;
+    pool = VK_NULL_HANDLE;
+    timeline_semaphore = VK_NULL_HANDLE;
+    buffers.clear();
+    slot_frames.clear();
+    stages.clear();
+}
+
+void AsyncCompute::addStage(const std::string& name, RecordFn record){
+    stages.push_back({name, std::move(record)});
+}
+
+uint64_t AsyncCompute::submit(uint64_t frame, VkSemaphore wait_semaphore, uint64_t wait_value){
+    uint32_t slot = static_cast<uint32_t>(frame % ctx.frames_in_flight);
+
+    //the slot's command buffer was last submitted frames_in_flight frames ago
+    if(slot_frames[slot] != UINT64_MAX){
+        wait(slot_frames[slot]);
+    }
+    slot_frames[slot] = frame;
+
+    VkCommandBuffer target = buffers[slot];
+    if(vkResetCommandBuffer(target, 0) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't reset compute command buffer.");
+    }
+
+    VkCommandBufferBeginInfo begin_i{};
+    begin_i.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_i.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if(vkBeginCommandBuffer(target, &begin_i) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't begin recording compute command buffer.");
+    }
+
+    if(queries != VK_NULL_HANDLE){
+        vkCmdResetQueryPool(target, queries, slot * 2, 2);
+        vkCmdWriteTimestamp(target, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queries, slot * 2);
+    }
+
+    //also orders this frame's dispatches after the previous frame's on the same queue
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    for(Stage& stage : stages){
+        vkCmdPipelineBarrier(target, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+        stage.record(target, frame);
+    }
+
+    if(queries != VK_NULL_HANDLE){
+        vkCmdWriteTimestamp(target, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queries, slot * 2 + 1);
+    }
+
+    if(vkEndCommandBuffer(target) != VK_SUCCESS){
+        throw std::runtime_error("Failed to record compute command buffer.");
+    }
+
+    uint64_t signal_value = frame + 1;
+
+    VkTimelineSemaphoreSubmitInfoKHR timeline_info{};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    timeline_info.waitSemaphoreValueCount = 1;
+    timeline_info.pWaitSemaphoreValues = &wait_value;
+    timeline_info.signalSemaphoreValueCount = 1;
+    timeline_info.pSignalSemaphoreValues = &signal_value;
+
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+    VkSubmitInfo submit_info{};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = &timeline_info;
+    submit_info.waitSemaphoreCount = 1;
+    submit_info.pWaitSemaphores = &wait_semaphore;
+    submit_info.pWaitDstStageMask = &wait_stage;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &target;
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &timeline_semaphore;
+
+    if(vkQueueSubmit(ctx.queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't submit compute commands.");
+    }
+
+    return signal_value;
+}
+
+void AsyncCompute::wait(uint64_t frame) const {
+    uint64_t value = frame + 1;
+
+    VkSemaphoreWaitInfoKHR wait_i{};
+    wait_i.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+    wait_i.semaphoreCount = 1;
+    wait_i.pSemaphores = &timeline_semaphore;
+    wait_i.pValues = &value;
+
+    if(wait_semaphores(ctx.device, &wait_i, UINT64_MAX) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't wait for compute timeline.");
+    }
+}
+
+bool AsyncCompute::finished(uint64_t frame) const {
+    uint64_t value = 0;
+    get_counter_value(ctx.device, timeline_semaphore, &value);
+    return value > frame;
+}
+
+bool AsyncCompute::interval(uint64_t frame, Interval& out) const {
+    uint32_t slot = static_cast<uint32_t>(frame % ctx.frames_in_flight);
+    if(queries == VK_NULL_HANDLE || slot_frames[slot] != frame || !finished(frame)){
+        return false;
+    }
+
+    uint64_t ticks[2];
+    if(vkGetQueryPoolResults(ctx.device, queries, slot * 2, 2, sizeof(ticks), ticks, sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT) != VK_SUCCESS){
+        return false;
+    }
+
+    out.begin = double(ticks[0] & timestamp_mask) * timestamp_period;
+    out.end = double(ticks[1] & timestamp_mask) * timestamp_period;
+    return true;
+}
+
+VkSemaphore AsyncCompute::timeline() const {
+    return timeline_semaphore;
+}
+
+bool AsyncCompute::dedicated() const {
+    return ctx.dedicated;
+}
+
+size_t AsyncCompute::stageCount() const {
+    return stages.size();
+}
+
+VkSemaphore AsyncCompute::createTimeline(VkDevice device){
+    VkSemaphoreTypeCreateInfoKHR type_ci{};
+    type_ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+    type_ci.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+    type_ci.initialValue = 0;
+
+    VkSemaphoreCreateInfo ci{};
+    ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    ci.pNext = &type_ci;
+
+    VkSemaphore semaphore;
+    if(vkCreateSemaphore(device, &ci, nullptr, &semaphore) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create timeline semaphore.");
+    }
+    return semaphore;
+}
@@ -0,0 +1,54 @@
+#include "deletionqueue.hpp"
+
+#include <algorithm>
+
+void DeletionQueue::push(uint64_t point, Destroy destroy){
+    last_point = std::max(last_point, point);
+    if(count == entries.size()){
+        grow();
+    }
+    Entry& entry = at(count);
+    entry.point = last_point;
+    entry.destroy = std::move(destroy);
+    count++;
+}
+
+//The due entries are counted first, entries pushed by the ones running go to the back.
+size_t DeletionQueue::release(uint64_t completed){
+    size_t due = 0;
+    while(due < count && at(due).point <= completed){
+        due++;
+    }
+    for(size_t i = 0; i < due; i++){
+        //moved out first, running it may push and grow the ring
+        Destroy destroy = std::move(at(0).destroy);
+        head = (head + 1) & (entries.size() - 1);
+        count--;
+        destroy();
+    }
+    return due;
+}
+
+//Until nothing is left, destroying can push more.
+void DeletionQueue::flush(){
+    while(count != 0){
+        release(at(count - 1).point);
+    }
+}
+
+size_t DeletionQueue::size() const {
+    return count;
+}
+
+DeletionQueue::Entry& DeletionQueue::at(size_t index){
+    return entries[(head + index) & (entries.size() - 1)];
+}
+
+void DeletionQueue::grow(){
+    std::vector<Entry> larger(std::max<size_t>(entries.size() * 2, 16));
+    for(size_t i = 0; i < count; i++){
+        larger[i] = std::move(at(i));
+    }
+    entries.swap(larger);
+    head = 0;
+}
@@ -0,0 +1,226 @@
+#include "deviceinfo.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+
+void DeviceInfo::query(VkPhysicalDevice target, VkSurfaceKHR surface){
+    auto start = std::chrono::steady_clock::now();
+    physical_device = target;
+
+    vkGetPhysicalDeviceProperties(target, &device_properties);
+    vkGetPhysicalDeviceFeatures(target, &device_features);
+    vkGetPhysicalDeviceMemoryProperties(target, &memory_properties);
+
+    uint32_t family_count;
+    vkGetPhysicalDeviceQueueFamilyProperties(target, &family_count, nullptr);
+    families.resize(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(target, &family_count, families.data());
+
+    present_support.assign(family_count, VK_FALSE);
+    for(uint32_t i = 0; i < family_count; i++){
+        vkGetPhysicalDeviceSurfaceSupportKHR(target, i, surface, &present_support[i]);
+    }
+
+    uint32_t extension_count;
+    vkEnumerateDeviceExtensionProperties(target, nullptr, &extension_count, nullptr);
+    std::vector<VkExtensionProperties> available(extension_count);
+    vkEnumerateDeviceExtensionProperties(target, nullptr, &extension_count, available.data());
+    extensions.clear();
+    extensions.reserve(extension_count);
+    for(const VkExtensionProperties& extension : available){
+        extensions.emplace_back(extension.extensionName);
+    }
+    std::sort(extensions.begin(), extensions.end());
+
+    queryExtensionFeatures();
+
+    formats.resize(CORE_FORMATS);
+    for(uint32_t format = 0; format < CORE_FORMATS; format++){
+        vkGetPhysicalDeviceFormatProperties(target, static_cast<VkFormat>(format), &formats[format]);
+    }
+
+    for(uint32_t flags = 0; flags < MEMORY_FLAG_COMBINATIONS; flags++){
+        uint32_t mask = 0;
+        for(uint32_t i = 0; i < memory_properties.memoryTypeCount; i++){
+            if((memory_properties.memoryTypes[i].propertyFlags & flags) == flags){
+                mask |= 1u << i;
+            }
+        }
+        types_with[flags] = mask;
+    }
+
+    VkDeviceSize device_local_heap = 0;
+    for(uint32_t heap = 0; heap < memory_properties.memoryHeapCount; heap++){
+        if(memory_properties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT){
+            device_local_heap = std::max(device_local_heap, memory_properties.memoryHeaps[heap].size);
+        }
+    }
+    direct_upload_types = 0;
+    uint32_t mappable = types_with[VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+        | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT];
+    for(uint32_t i = 0; i < memory_properties.memoryTypeCount; i++){
+        if((mappable & (1u << i)) && memory_properties.memoryHeaps[memory_properties.memoryTypes[i].heapIndex].size == device_local_heap){
+            direct_upload_types |= 1u << i;
+        }
+    }
+
+    query_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//Chains only the structures the device knows, an unknown one in the chain isn't valid usage.
+void DeviceInfo::queryExtensionFeatures(){
+    uint32_t version = device_properties.apiVersion;
+    indexing_features = {};
+    indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    indexing_properties = {};
+    indexing_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+    timeline_features = {};
+    timeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    rendering_features = {};
+    rendering_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    sync2_features = {};
+    sync2_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+
+    void* feature_chain = nullptr;
+    void* property_chain = nullptr;
+    if(version >= VK_API_VERSION_1_2 || hasExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)){
+        indexing_features.pNext = feature_chain;
+        feature_chain = &indexing_features;
+        indexing_properties.pNext = property_chain;
+        property_chain = &indexing_properties;
+    }
+    if(version >= VK_API_VERSION_1_2 || hasExtension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)){
+        timeline_features.pNext = feature_chain;
+        feature_chain = &timeline_features;
+    }
+    if(version >= VK_API_VERSION_1_3 || hasExtension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)){
+        rendering_features.pNext = feature_chain;
+        feature_chain = &rendering_features;
+    }
+    if(version >= VK_API_VERSION_1_3 || hasExtension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME)){
+        sync2_features.pNext = feature_chain;
+        feature_chain = &sync2_features;
+    }
+
+    if(feature_chain != nullptr){
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = feature_chain;
+        vkGetPhysicalDeviceFeatures2(physical_device, &features);
+    }
+    if(property_chain != nullptr){
+        VkPhysicalDeviceProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = property_chain;
+        vkGetPhysicalDeviceProperties2(physical_device, &properties);
+    }
+
+    indexing_features.pNext = nullptr;
+    indexing_properties.pNext = nullptr;
+    timeline_features.pNext = nullptr;
+    rendering_features.pNext = nullptr;
+    sync2_features.pNext = nullptr;
+}
+
+VkPhysicalDevice DeviceInfo::physicalDevice() const {
+    return physical_device;
+}
+
+const VkPhysicalDeviceProperties& DeviceInfo::properties() const {
+    return device_properties;
+}
+
+const VkPhysicalDeviceLimits& DeviceInfo::limits() const {
+    return device_properties.limits;
+}
+
+const VkPhysicalDeviceFeatures& DeviceInfo::features() const {
+    return device_features;
+}
+
+const VkPhysicalDeviceDescriptorIndexingFeaturesEXT& DeviceInfo::descriptorIndexingFeatures() const {
+    return indexing_features;
+}
+
+const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& DeviceInfo::descriptorIndexingProperties() const {
+    return indexing_properties;
+}
+
+const VkPhysicalDeviceTimelineSemaphoreFeaturesKHR& DeviceInfo::timelineSemaphoreFeatures() const {
+    return timeline_features;
+}
+
+const VkPhysicalDeviceDynamicRenderingFeaturesKHR& DeviceInfo::dynamicRenderingFeatures() const {
+    return rendering_features;
+}
+
+const VkPhysicalDeviceSynchronization2FeaturesKHR& DeviceInfo::synchronization2Features() const {
+    return sync2_features;
+}
+
+const VkPhysicalDeviceMemoryProperties& DeviceInfo::memory() const {
+    return memory_properties;
+}
+
+const std::vector<VkQueueFamilyProperties>& DeviceInfo::queueFamilies() const {
+    return families;
+}
+
+bool DeviceInfo::canPresent(uint32_t family) const {
+    return family < present_support.size() && present_support[family];
+}
+
+bool DeviceInfo::hasExtension(const char* name) const {
+    auto it = std::lower_bound(extensions.begin(), extensions.end(), name,
+        [](const std::string& extension, const char* wanted){ return extension.compare(wanted) < 0; });
+    return it != extensions.end() && it->compare(name) == 0;
+}
+
+VkFormatFeatureFlags DeviceInfo::formatFeatures(VkFormat format, VkImageTiling tiling) const {
+    VkFormatProperties properties;
+    if(static_cast<uint32_t>(format) < formats.size()){
+        properties = formats[format];
+    } else {
+        vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+    }
+    return tiling == VK_IMAGE_TILING_LINEAR ? properties.linearTilingFeatures : properties.optimalTilingFeatures;
+}
+
+VkFormat DeviceInfo::findFormat(std::initializer_list<VkFormat> candidates, VkImageTiling tiling, VkFormatFeatureFlags required) const {
+    for(VkFormat format : candidates){
+        if((formatFeatures(format, tiling) & required) == required){
+            return format;
+        }
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+uint32_t DeviceInfo::findMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties) const {
+    uint32_t matching = 0;
+    if(properties < MEMORY_FLAG_COMBINATIONS){
+        matching = types_with[properties];
+    } else {
+        for(uint32_t i = 0; i < memory_properties.memoryTypeCount; i++){
+            if((memory_properties.memoryTypes[i].propertyFlags & properties) == properties){
+                matching |= 1u << i;
+            }
+        }
+    }
+
+    matching &= type_filter;
+    return matching != 0 ? static_cast<uint32_t>(std::countr_zero(matching)) : UINT32_MAX;
+}
+
+uint32_t DeviceInfo::findDirectUploadType(uint32_t type_filter) const {
+    uint32_t matching = direct_upload_types & type_filter;
+    return matching != 0 ? static_cast<uint32_t>(std::countr_zero(matching)) : UINT32_MAX;
+}
+
+uint32_t DeviceInfo::directUploadTypes() const {
+    return direct_upload_types;
+}
+
+double DeviceInfo::queryMs() const {
+    return query_ms;
+}
@@ -0,0 +1,133 @@
+#include "drawlist.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+uint64_t DrawList::makeKey(uint32_t pass, uint32_t pipeline, float depth, uint32_t material, uint32_t index){
+    //a positive float's bits grow with its value, the top ones are a coarse log scale of the distance
+    if(!(depth > 0.0f)){
+        depth = 0.0f;
+    }
+    uint32_t bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    uint64_t bucket = bits >> (31 - DEPTH_BITS);
+
+    uint64_t key = pass & ((1u << PASS_BITS) - 1);
+    key = (key << PIPELINE_BITS) | (pipeline & ((1u << PIPELINE_BITS) - 1));
+    key = (key << DEPTH_BITS) | bucket;
+    key = (key << MATERIAL_BITS) | (material & ((1u << MATERIAL_BITS) - 1));
+    key = (key << INDEX_BITS) | (index & ((1u << INDEX_BITS) - 1));
+    return key;
+}
+
+uint32_t DrawList::pass(uint64_t key){
+    return static_cast<uint32_t>(key >> (64 - PASS_BITS));
+}
+
+uint32_t DrawList::pipeline(uint64_t key){
+    return static_cast<uint32_t>(key >> (64 - PASS_BITS - PIPELINE_BITS)) & ((1u << PIPELINE_BITS) - 1);
+}
+
+uint32_t DrawList::index(uint64_t key){
+    return static_cast<uint32_t>(key) & ((1u << INDEX_BITS) - 1);
+}
+
+void DrawList::clear(){
+    packed.clear();
+}
+
+void DrawList::add(uint64_t key){
+    packed.push_back(key);
+}
+
+size_t DrawList::size() const {
+    return packed.size();
+}
+
+void DrawList::sort(JobSystem* jobs, std::pmr::memory_resource* scratch_memory){
+    uint32_t count = static_cast<uint32_t>(packed.size());
+    if(count < 2){
+        return;
+    }
+    std::pmr::vector<uint64_t> scratch(count, scratch_memory);
+
+    uint32_t chunks = 1;
+    if(jobs != nullptr){
+        chunks = std::clamp(count / MIN_CHUNK_KEYS, 1u, jobs->workerCount() + 1);
+    }
+    //per chunk, the count and then the first output slot of every byte value
+    std::pmr::vector<std::array<uint32_t, 256>> histograms(chunks, scratch_memory);
+    //per chunk, the bits where one of its keys differs from the first key
+    std::pmr::vector<uint64_t> chunk_differs(chunks, 0, scratch_memory);
+    auto run = [&](const auto& job){
+        if(chunks == 1){
+            job(0);
+        } else {
+            jobs->parallelFor(chunks, job);
+        }
+    };
+    auto begin = [&](uint32_t chunk){
+        return static_cast<uint32_t>(uint64_t(count) * chunk / chunks);
+    };
+
+    //bits where some key differs from the first, bytes without any are already sorted
+    run([&](uint32_t chunk){
+        uint64_t first = packed[0];
+        uint64_t differs = 0;
+        for(uint32_t i = begin(chunk); i < begin(chunk + 1); i++){
+            differs |= packed[i] ^ first;
+        }
+        chunk_differs[chunk] = differs;
+    });
+    uint64_t differs = 0;
+    for(uint64_t chunk : chunk_differs){
+        differs |= chunk;
+    }
+
+    uint64_t* src = packed.data();
+    uint64_t* dst = scratch.data();
+    for(uint32_t shift = 0; shift < 64; shift += 8){
+        if(((differs >> shift) & 0xff) == 0){
+            continue;
+        }
+
+        run([&](uint32_t chunk){
+            std::array<uint32_t, 256>& histogram = histograms[chunk];
+            histogram.fill(0);
+            for(uint32_t i = begin(chunk); i < begin(chunk + 1); i++){
+                histogram[(src[i] >> shift) & 0xff]++;
+            }
+        });
+
+        //every chunk's keys of a byte value go after those of the chunks before it, which keeps the sort stable
+        uint32_t offset = 0;
+        for(uint32_t value = 0; value < 256; value++){
+            for(uint32_t chunk = 0; chunk < chunks; chunk++){
+                uint32_t keys_here = histograms[chunk][value];
+                histograms[chunk][value] = offset;
+                offset += keys_here;
+            }
+        }
+
+        run([&](uint32_t chunk){
+            std::array<uint32_t, 256>& slots = histograms[chunk];
+            for(uint32_t i = begin(chunk); i < begin(chunk + 1); i++){
+                dst[slots[(src[i] >> shift) & 0xff]++] = src[i];
+            }
+        });
+        std::swap(src, dst);
+    }
+
+    //an odd number of passes ended in the scratch keys
+    if(src != packed.data()){
+        std::copy(scratch.begin(), scratch.end(), packed.begin());
+    }
+}
+
+std::span<const uint64_t> DrawList::keys() const {
+    return packed;
+}
+
+std::vector<uint64_t>& DrawList::data(){
+    return packed;
+}
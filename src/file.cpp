@@ -0,0 +1,317 @@
+#include "file.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <fstream>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef DOMK_HAS_IO_URING
+#include <liburing.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path, Access access){
+    file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        access == Access::Random ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file_handle == INVALID_HANDLE_VALUE){
+        file_handle = nullptr;
+        throw std::runtime_error("Couldn't open file " + path + "!");
+    }
+
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file_handle, &file_size);
+    length = static_cast<size_t>(file_size.QuadPart);
+    if(length == 0){
+        return;
+    }
+
+    map_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(map_handle != nullptr){
+        mapping = MapViewOfFile(map_handle, FILE_MAP_READ, 0, 0, 0);
+    }
+    if(mapping == nullptr){
+        unmap();
+        throw std::runtime_error("Couldn't map file " + path + "!");
+    }
+}
+
+void MappedFile::unmap(){
+    if(mapping != nullptr){
+        UnmapViewOfFile(mapping);
+    }
+    if(map_handle != nullptr){
+        CloseHandle(map_handle);
+    }
+    if(file_handle != nullptr){
+        CloseHandle(file_handle);
+    }
+    mapping = nullptr;
+    map_handle = nullptr;
+    file_handle = nullptr;
+    length = 0;
+}
+
+void MappedFile::release(){
+    if(mapping != nullptr){
+        //unlocking pages that aren't locked drops them from the working set
+        VirtualUnlock(mapping, length);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path, Access access){
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        throw std::runtime_error("Couldn't open file " + path + "!");
+    }
+
+    struct stat info;
+    if(fstat(fd, &info) != 0){
+        close(fd);
+        throw std::runtime_error("Couldn't stat file " + path + "!");
+    }
+    length = static_cast<size_t>(info.st_size);
+    if(length == 0){
+        close(fd);
+        return;
+    }
+
+    //the mapping keeps its own reference to the file, the descriptor isn't needed past this point
+    void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED){
+        length = 0;
+        throw std::runtime_error("Couldn't map file " + path + ": " + std::strerror(errno));
+    }
+    mapping = mapped;
+
+    int advice = MADV_SEQUENTIAL;
+    if(access == Access::Random){
+        advice = MADV_RANDOM;
+    } else if(access == Access::WillNeed){
+        advice = MADV_WILLNEED;
+    }
+    madvise(mapping, length, advice);
+}
+
+void MappedFile::unmap(){
+    if(mapping != nullptr){
+        munmap(mapping, length);
+    }
+    mapping = nullptr;
+    length = 0;
+}
+
+void MappedFile::release(){
+    if(mapping != nullptr){
+        madvise(mapping, length, MADV_DONTNEED);
+    }
+}
+
+#endif
+
+MappedFile::~MappedFile(){
+    unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if(this != &other){
+        unmap();
+        mapping = std::exchange(other.mapping, nullptr);
+        length = std::exchange(other.length, 0);
+#ifdef _WIN32
+        file_handle = std::exchange(other.file_handle, nullptr);
+        map_handle = std::exchange(other.map_handle, nullptr);
+#endif
+    }
+    return *this;
+}
+
+std::span<const std::byte> MappedFile::bytes() const {
+    return {static_cast<const std::byte*>(mapping), length};
+}
+
+const char* MappedFile::data() const {
+    return static_cast<const char*>(mapping);
+}
+
+size_t MappedFile::size() const {
+    return length;
+}
+
+AsyncFileReader::AsyncFileReader(uint32_t queue_depth) : depth(queue_depth) {
+#ifdef DOMK_HAS_IO_URING
+    //older kernels or seccomp'd containers refuse io_uring, the blocking path covers them
+    io_uring* uring = new io_uring;
+    if(io_uring_queue_init(depth, uring, 0) == 0){
+        ring = uring;
+    } else {
+        delete uring;
+    }
+#endif
+}
+
+AsyncFileReader::~AsyncFileReader(){
+#ifndef _WIN32
+    for(Request& request : requests){
+        if(request.fd >= 0){
+            close(request.fd);
+        }
+    }
+#endif
+#ifdef DOMK_HAS_IO_URING
+    if(ring != nullptr){
+        io_uring* uring = static_cast<io_uring*>(ring);
+        io_uring_queue_exit(uring);
+        delete uring;
+    }
+#endif
+}
+
+bool AsyncFileReader::usesIoUring() const {
+    return ring != nullptr;
+}
+
+size_t AsyncFileReader::fileSize(const std::string& path){
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if(!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &info)){
+        throw std::runtime_error("Couldn't stat file " + path + "!");
+    }
+    return (static_cast<size_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+#else
+    struct stat info;
+    if(stat(path.c_str(), &info) != 0){
+        throw std::runtime_error("Couldn't stat file " + path + "!");
+    }
+    return static_cast<size_t>(info.st_size);
+#endif
+}
+
+void AsyncFileReader::read(const std::string& path, std::span<std::byte> dst, uint64_t offset){
+    Request request{};
+    request.path = path;
+    request.dst = dst.data();
+    request.size = dst.size();
+    request.offset = offset;
+
+#ifndef _WIN32
+    request.fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(request.fd < 0){
+        throw std::runtime_error("Couldn't open file " + path + "!");
+    }
+#endif
+
+    requests.push_back(std::move(request));
+}
+
+void AsyncFileReader::readBlocking(Request& request){
+#ifdef _WIN32
+    std::ifstream file(request.path, std::ios::binary);
+    file.seekg(static_cast<std::streamoff>(request.offset));
+    file.read(reinterpret_cast<char*>(request.dst), static_cast<std::streamsize>(request.size));
+    if(static_cast<size_t>(file.gcount()) != request.size){
+        throw std::runtime_error("Short read from " + request.path + "!");
+    }
+    request.done = request.size;
+#else
+    while(request.done < request.size){
+        ssize_t got = pread(request.fd, request.dst + request.done, request.size - request.done,
+            static_cast<off_t>(request.offset + request.done));
+        if(got < 0 && errno == EINTR){
+            continue;
+        }
+        if(got <= 0){
+            throw std::runtime_error("Short read from " + request.path + "!");
+        }
+        request.done += static_cast<size_t>(got);
+    }
+#endif
+}
+
+/*
+    Keeps up to depth reads in flight. Short reads are resubmitted for the remainder,
+    so a request only completes once all of its bytes have arrived.
+*/
+void AsyncFileReader::wait(){
+#ifdef DOMK_HAS_IO_URING
+    if(ring != nullptr){
+        io_uring* uring = static_cast<io_uring*>(ring);
+        std::vector<size_t> queued(requests.size());
+        for(size_t i = 0; i < requests.size(); i++){
+            queued[i] = requests.size() - 1 - i;
+        }
+
+        uint32_t in_flight = 0;
+        while(!queued.empty() || in_flight > 0){
+            while(!queued.empty() && in_flight < depth){
+                io_uring_sqe* sqe = io_uring_get_sqe(uring);
+                if(sqe == nullptr){
+                    break;
+                }
+                size_t index = queued.back();
+                queued.pop_back();
+
+                Request& request = requests[index];
+                io_uring_prep_read(sqe, request.fd, request.dst + request.done,
+                    static_cast<unsigned>(request.size - request.done), request.offset + request.done);
+                io_uring_sqe_set_data64(sqe, index);
+                in_flight++;
+            }
+            io_uring_submit(uring);
+
+            io_uring_cqe* cqe;
+            int result = io_uring_wait_cqe(uring, &cqe);
+            if(result == -EINTR){
+                continue;
+            }
+            if(result < 0){
+                throw std::runtime_error(std::string("io_uring wait failed: ") + std::strerror(-result));
+            }
+
+            size_t index = io_uring_cqe_get_data64(cqe);
+            Request& request = requests[index];
+            int got = cqe->res;
+            io_uring_cqe_seen(uring, cqe);
+            in_flight--;
+
+            if(got <= 0){
+                throw std::runtime_error("Short read from " + request.path + "!");
+            }
+            request.done += static_cast<size_t>(got);
+            if(request.done < request.size){
+                queued.push_back(index);
+            }
+        }
+    }
+#endif
+
+    for(Request& request : requests){
+        if(request.done < request.size){
+            readBlocking(request);
+        }
+#ifndef _WIN32
+        close(request.fd);
+        request.fd = -1;
+#endif
+    }
+    requests.clear();
+}
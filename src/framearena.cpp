@@ -0,0 +1,105 @@
+#include "framearena.hpp"
+
+#include <algorithm>
+#include <new>
+
+FrameArena::~FrameArena(){
+    destroy();
+}
+
+void FrameArena::setup(uint32_t slot_count, size_t slot_bytes){
+    destroy();
+    slots.resize(slot_count);
+    for(Slot& slot : slots){
+        slot.block = allocateBlock(slot_bytes);
+    }
+    current = 0;
+}
+
+void FrameArena::destroy(){
+    for(Slot& slot : slots){
+        freeBlock(slot.block);
+        for(Block& block : slot.overflow){
+            freeBlock(block);
+        }
+    }
+    slots.clear();
+    peak = 0;
+    overflows = 0;
+}
+
+//Folds the overflow of the slot's last frame into one bigger block, the only time this touches the heap.
+void FrameArena::beginFrame(uint32_t slot_index){
+    current = slot_index;
+    Slot& slot = slots[current];
+
+    if(!slot.overflow.empty()){
+        size_t needed = slot.used + slot.overflow_used;
+        for(Block& block : slot.overflow){
+            freeBlock(block);
+        }
+        slot.overflow.clear();
+        freeBlock(slot.block);
+        slot.block = allocateBlock(std::max(needed + needed / 2, slot.block.size * 2));
+    }
+    slot.used = 0;
+    slot.overflow_used = 0;
+}
+
+FrameArena::Stats FrameArena::stats() const {
+    Stats stats;
+    for(const Slot& slot : slots){
+        stats.capacity += slot.block.size;
+    }
+    if(!slots.empty()){
+        stats.used = slots[current].used + slots[current].overflow_used;
+    }
+    stats.peak = peak;
+    stats.overflows = overflows;
+    return stats;
+}
+
+void* FrameArena::do_allocate(size_t bytes, size_t alignment){
+    if(slots.empty()){
+        throw std::bad_alloc();
+    }
+    Slot& slot = slots[current];
+
+    uintptr_t base = reinterpret_cast<uintptr_t>(slot.block.memory);
+    size_t start = ((base + slot.used + alignment - 1) & ~(alignment - 1)) - base;
+    if(start + bytes <= slot.block.size){
+        slot.used = start + bytes;
+        peak = std::max(peak, slot.used + slot.overflow_used);
+        return slot.block.memory + start;
+    }
+
+    //blocks start BLOCK_ALIGNMENT aligned, padding for a larger alignment is reserved on top
+    Block block = allocateBlock(bytes + (alignment > BLOCK_ALIGNMENT ? alignment : 0));
+    slot.overflow.push_back(block);
+    slot.overflow_used += bytes;
+    peak = std::max(peak, slot.used + slot.overflow_used);
+    overflows++;
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(block.memory);
+    return block.memory + (((address + alignment - 1) & ~(alignment - 1)) - address);
+}
+
+void FrameArena::do_deallocate(void*, size_t, size_t){}
+
+bool FrameArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+FrameArena::Block FrameArena::allocateBlock(size_t size){
+    Block block;
+    block.memory = static_cast<std::byte*>(::operator new(size, std::align_val_t(BLOCK_ALIGNMENT)));
+    block.size = size;
+    return block;
+}
+
+void FrameArena::freeBlock(Block& block){
+    if(block.memory != nullptr){
+        ::operator delete(block.memory, std::align_val_t(BLOCK_ALIGNMENT));
+    }
+    block = {};
+}
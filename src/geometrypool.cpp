@@ -0,0 +1,355 @@
+#include "geometrypool.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+void GeometryPool::FreeList::reset(uint32_t capacity, uint32_t used){
+    blocks.clear();
+    if(used < capacity){
+        blocks.push_back({used, capacity - used});
+    }
+}
+
+std::optional<uint32_t> GeometryPool::FreeList::allocate(uint32_t count){
+    if(count == 0){
+        return 0;
+    }
+    for(size_t i = 0; i < blocks.size(); i++){
+        if(blocks[i].count < count){
+            continue;
+        }
+        uint32_t offset = blocks[i].offset;
+        blocks[i].offset += count;
+        blocks[i].count -= count;
+        if(blocks[i].count == 0){
+            blocks.erase(blocks.begin() + i);
+        }
+        return offset;
+    }
+    return std::nullopt;
+}
+
+void GeometryPool::FreeList::release(uint32_t offset, uint32_t count){
+    if(count == 0){
+        return;
+    }
+    auto next = std::lower_bound(blocks.begin(), blocks.end(), offset,
+        [](const Block& block, uint32_t value){ return block.offset < value; });
+    auto inserted = blocks.insert(next, {offset, count});
+
+    //merge with the block after, then with the one before
+    auto after = inserted + 1;
+    if(after != blocks.end() && inserted->offset + inserted->count == after->offset){
+        inserted->count += after->count;
+        blocks.erase(after);
+    }
+    if(inserted != blocks.begin()){
+        auto before = inserted - 1;
+        if(before->offset + before->count == inserted->offset){
+            before->count += inserted->count;
+            blocks.erase(inserted);
+        }
+    }
+}
+
+uint32_t GeometryPool::FreeList::holes(uint32_t capacity) const {
+    uint32_t total = 0;
+    for(const Block& block : blocks){
+        if(block.offset + block.count != capacity){
+            total += block.count;
+        }
+    }
+    return total;
+}
+
+void GeometryPool::setup(const Context& context, uint32_t stride, uint32_t initial_vertices, uint32_t initial_indices){
+    ctx = context;
+    vertex_stride = stride;
+    rebuild(std::max(initial_vertices, 1u), std::max(initial_indices, 1u));
+    compactions = 0;
+}
+
+void GeometryPool::destroy(){
+    ctx.tracker->destroyBuffer(vertex_buffer);
+    ctx.tracker->freeMemory(vertex_memory);
+    ctx.tracker->destroyBuffer(index_buffer);
+    ctx.tracker->freeMemory(index_memory);
+    vertex_buffer = VK_NULL_HANDLE;
+    index_buffer = VK_NULL_HANDLE;
+    vertex_mapped = nullptr;
+    index_mapped = nullptr;
+    meshes.clear();
+    free_ids.clear();
+}
+
+void GeometryPool::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, const char* tag, VkBuffer& buffer, VkDeviceMemory& memory,
+    std::byte*& mapped){
+    VkBufferCreateInfo bci{};
+    bci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bci.size = size;
+    bci.usage = usage;
+    if(ctx.queue_families.size() > 1){
+        bci.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bci.queueFamilyIndexCount = static_cast<uint32_t>(ctx.queue_families.size());
+        bci.pQueueFamilyIndices = ctx.queue_families.data();
+    } else {
+        bci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+    if(ctx.tracker->createBuffer(bci, buffer, tag) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create geometry buffer.");
+    }
+
+    VkMemoryRequirements reqs;
+    vkGetBufferMemoryRequirements(ctx.device, buffer, &reqs);
+
+    uint32_t type = ctx.find_direct_type ? ctx.find_direct_type(reqs.memoryTypeBits) : UINT32_MAX;
+    bool direct = type != UINT32_MAX;
+    if(!direct){
+        type = ctx.find_memory_type(reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+    if(type == UINT32_MAX){
+        throw std::runtime_error("No memory type for geometry buffer.");
+    }
+
+    VkMemoryAllocateInfo alloci{};
+    alloci.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloci.allocationSize = reqs.size;
+    alloci.memoryTypeIndex = type;
+    if(ctx.tracker->allocateMemory(alloci, memory, tag) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't allocate geometry buffer memory.");
+    }
+
+    vkBindBufferMemory(ctx.device, buffer, memory, 0);
+
+    //stays mapped until the memory is freed
+    mapped = nullptr;
+    if(direct && vkMapMemory(ctx.device, memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&mapped)) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't map geometry buffer memory.");
+    }
+}
+
+void GeometryPool::rebuild(uint32_t new_vertex_capacity, uint32_t new_index_capacity){
+    VkBuffer old_vertices = vertex_buffer;
+    VkDeviceMemory old_vertex_memory = vertex_memory;
+    VkBuffer old_indices = index_buffer;
+    VkDeviceMemory old_index_memory = index_memory;
+
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    createBuffer(VkDeviceSize(new_vertex_capacity) * vertex_stride, usage | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        "geometry vertices", vertex_buffer, vertex_memory, vertex_mapped);
+    createBuffer(VkDeviceSize(new_index_capacity) * sizeof(uint32_t), usage | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        "geometry indices", index_buffer, index_memory, index_mapped);
+
+    //live meshes keep their order and are packed from the front
+    std::vector<VkBufferCopy> vertex_copies;
+    std::vector<VkBufferCopy> index_copies;
+    std::vector<uint32_t> order;
+    for(uint32_t id = 0; id < meshes.size(); id++){
+        if(meshes[id]){
+            order.push_back(id);
+        }
+    }
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b){ return meshes[a]->first_vertex < meshes[b]->first_vertex; });
+
+    uint32_t next_vertex = 0;
+    for(uint32_t id : order){
+        Range& range = *meshes[id];
+        if(range.vertex_count != 0){
+            vertex_copies.push_back({VkDeviceSize(range.first_vertex) * vertex_stride, VkDeviceSize(next_vertex) * vertex_stride,
+                VkDeviceSize(range.vertex_count) * vertex_stride});
+        }
+        range.first_vertex = next_vertex;
+        next_vertex += range.vertex_count;
+    }
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b){ return meshes[a]->first_index < meshes[b]->first_index; });
+
+    uint32_t next_index = 0;
+    for(uint32_t id : order){
+        Range& range = *meshes[id];
+        if(range.index_count != 0){
+            index_copies.push_back({VkDeviceSize(range.first_index) * sizeof(uint32_t), VkDeviceSize(next_index) * sizeof(uint32_t),
+                VkDeviceSize(range.index_count) * sizeof(uint32_t)});
+        }
+        range.first_index = next_index;
+        next_index += range.index_count;
+    }
+
+    if(!vertex_copies.empty() || !index_copies.empty()){
+        ctx.submit_transfer([&](VkCommandBuffer target){
+            if(!vertex_copies.empty()){
+                vkCmdCopyBuffer(target, old_vertices, vertex_buffer, static_cast<uint32_t>(vertex_copies.size()), vertex_copies.data());
+            }
+            if(!index_copies.empty()){
+                vkCmdCopyBuffer(target, old_indices, index_buffer, static_cast<uint32_t>(index_copies.size()), index_copies.data());
+            }
+        });
+    }
+
+    if(old_vertices != VK_NULL_HANDLE){
+        ctx.retire([tracker = ctx.tracker, old_vertices, old_vertex_memory, old_indices, old_index_memory]{
+            tracker->destroyBuffer(old_vertices);
+            tracker->freeMemory(old_vertex_memory);
+            tracker->destroyBuffer(old_indices);
+            tracker->freeMemory(old_index_memory);
+        });
+    }
+
+    vertex_capacity = new_vertex_capacity;
+    index_capacity = new_index_capacity;
+    free_vertices.reset(vertex_capacity, used_vertices);
+    free_indices.reset(index_capacity, used_indices);
+    compactions++;
+}
+
+uint32_t GeometryPool::add(uint32_t vertex_count, uint32_t index_count, const std::function<void(void*)>& write_vertices,
+    const std::function<void(uint32_t*)>& write_indices){
+    std::optional<uint32_t> first_vertex = free_vertices.allocate(vertex_count);
+    std::optional<uint32_t> first_index = free_indices.allocate(index_count);
+    if(!first_vertex || !first_index){
+        if(first_vertex){
+            free_vertices.release(*first_vertex, vertex_count);
+        }
+        if(first_index){
+            free_indices.release(*first_index, index_count);
+        }
+
+        //packing may be enough, otherwise double until it fits
+        uint64_t vertices_needed = uint64_t(used_vertices) + vertex_count;
+        uint64_t indices_needed = uint64_t(used_indices) + index_count;
+        uint64_t new_vertex_capacity = vertex_capacity;
+        uint64_t new_index_capacity = index_capacity;
+        while(new_vertex_capacity < vertices_needed){
+            new_vertex_capacity *= 2;
+        }
+        while(new_index_capacity < indices_needed){
+            new_index_capacity *= 2;
+        }
+        if(new_vertex_capacity > UINT32_MAX || new_index_capacity > UINT32_MAX){
+            throw std::runtime_error("Geometry pool can't hold the mesh.");
+        }
+        rebuild(static_cast<uint32_t>(new_vertex_capacity), static_cast<uint32_t>(new_index_capacity));
+
+        first_vertex = free_vertices.allocate(vertex_count);
+        first_index = free_indices.allocate(index_count);
+    }
+    used_vertices += vertex_count;
+    used_indices += index_count;
+
+    Range range{*first_vertex, vertex_count, *first_index, index_count};
+    uint32_t id;
+    if(!free_ids.empty()){
+        id = free_ids.back();
+        free_ids.pop_back();
+        meshes[id] = range;
+    } else {
+        id = static_cast<uint32_t>(meshes.size());
+        meshes.push_back(range);
+    }
+
+    VkDeviceSize vertex_bytes = VkDeviceSize(vertex_count) * vertex_stride;
+    VkDeviceSize index_bytes = VkDeviceSize(index_count) * sizeof(uint32_t);
+    if(vertex_bytes + index_bytes == 0){
+        return id;
+    }
+
+    //the range is new, no frame in flight reads it. Coherent writes are visible to the next submit.
+    if(vertex_mapped != nullptr && index_mapped != nullptr){
+        if(vertex_bytes != 0){
+            write_vertices(vertex_mapped + VkDeviceSize(range.first_vertex) * vertex_stride);
+        }
+        if(index_bytes != 0){
+            write_indices(reinterpret_cast<uint32_t*>(index_mapped) + range.first_index);
+        }
+        return id;
+    }
+
+    VkBufferCreateInfo bci{};
+    bci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bci.size = vertex_bytes + index_bytes;
+    bci.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkBuffer staging;
+    if(ctx.tracker->createBuffer(bci, staging, "geometry staging") != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create geometry staging buffer.");
+    }
+
+    VkMemoryRequirements reqs;
+    vkGetBufferMemoryRequirements(ctx.device, staging, &reqs);
+    VkMemoryAllocateInfo alloci{};
+    alloci.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloci.allocationSize = reqs.size;
+    alloci.memoryTypeIndex = ctx.find_memory_type(reqs.memoryTypeBits,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    VkDeviceMemory staging_memory;
+    if(alloci.memoryTypeIndex == UINT32_MAX || ctx.tracker->allocateMemory(alloci, staging_memory, "geometry staging") != VK_SUCCESS){
+        ctx.tracker->destroyBuffer(staging);
+        throw std::runtime_error("Couldn't allocate geometry staging memory.");
+    }
+    vkBindBufferMemory(ctx.device, staging, staging_memory, 0);
+
+    char* data;
+    vkMapMemory(ctx.device, staging_memory, 0, bci.size, 0, reinterpret_cast<void**>(&data));
+    if(vertex_bytes != 0){
+        write_vertices(data);
+    }
+    if(index_bytes != 0){
+        write_indices(reinterpret_cast<uint32_t*>(data + vertex_bytes));
+    }
+    vkUnmapMemory(ctx.device, staging_memory);
+
+    ctx.submit_transfer([&](VkCommandBuffer target){
+        if(vertex_bytes != 0){
+            VkBufferCopy copy{0, VkDeviceSize(range.first_vertex) * vertex_stride, vertex_bytes};
+            vkCmdCopyBuffer(target, staging, vertex_buffer, 1, &copy);
+        }
+        if(index_bytes != 0){
+            VkBufferCopy copy{vertex_bytes, VkDeviceSize(range.first_index) * sizeof(uint32_t), index_bytes};
+            vkCmdCopyBuffer(target, staging, index_buffer, 1, &copy);
+        }
+    });
+
+    ctx.tracker->destroyBuffer(staging);
+    ctx.tracker->freeMemory(staging_memory);
+    return id;
+}
+
+void GeometryPool::remove(uint32_t mesh){
+    if(mesh >= meshes.size() || !meshes[mesh]){
+        return;
+    }
+    const Range& range = *meshes[mesh];
+    free_vertices.release(range.first_vertex, range.vertex_count);
+    free_indices.release(range.first_index, range.index_count);
+    used_vertices -= range.vertex_count;
+    used_indices -= range.index_count;
+    meshes[mesh].reset();
+    free_ids.push_back(mesh);
+
+    if(free_vertices.holes(vertex_capacity) * 4 > used_vertices || free_indices.holes(index_capacity) * 4 > used_indices){
+        rebuild(vertex_capacity, index_capacity);
+    }
+}
+
+const GeometryPool::Range& GeometryPool::range(uint32_t mesh) const {
+    return *meshes[mesh];
+}
+
+VkBuffer GeometryPool::vertexBuffer() const {
+    return vertex_buffer;
+}
+
+VkBuffer GeometryPool::indexBuffer() const {
+    return index_buffer;
+}
+
+GeometryPool::Stats GeometryPool::stats() const {
+    Stats stats;
+    stats.meshes = static_cast<uint32_t>(meshes.size() - free_ids.size());
+    stats.vertex_bytes = VkDeviceSize(used_vertices) * vertex_stride;
+    stats.vertex_capacity = VkDeviceSize(vertex_capacity) * vertex_stride;
+    stats.index_bytes = VkDeviceSize(used_indices) * sizeof(uint32_t);
+    stats.index_capacity = VkDeviceSize(index_capacity) * sizeof(uint32_t);
+    stats.compactions = compactions;
+    stats.direct = vertex_mapped != nullptr && index_mapped != nullptr;
+    return stats;
+}
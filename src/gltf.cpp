@@ -0,0 +1,284 @@
+#include "gltf.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+    const uint32_t GLB_MAGIC = 0x46546C67;
+    const uint32_t CHUNK_JSON = 0x4E4F534A;
+    const uint32_t CHUNK_BIN = 0x004E4942;
+
+    uint32_t readU32(const std::byte* bytes){
+        uint32_t value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+
+    uint32_t componentCount(const std::string& type){
+        if(type == "SCALAR") return 1;
+        if(type == "VEC2") return 2;
+        if(type == "VEC3") return 3;
+        if(type == "VEC4") return 4;
+        if(type == "MAT2") return 4;
+        if(type == "MAT3") return 9;
+        if(type == "MAT4") return 16;
+        throw std::runtime_error("Unknown glTF accessor type " + type + ".");
+    }
+
+    float readComponent(const std::byte* src, uint32_t component_type, bool normalized){
+        switch(component_type){
+            case GltfAsset::Float: {
+                float value;
+                memcpy(&value, src, sizeof(value));
+                return value;
+            }
+            case GltfAsset::UnsignedByte: {
+                uint8_t value = static_cast<uint8_t>(*src);
+                return normalized ? value / 255.0f : value;
+            }
+            case GltfAsset::Byte: {
+                int8_t value = static_cast<int8_t>(*src);
+                return normalized ? std::max(value / 127.0f, -1.0f) : value;
+            }
+            case GltfAsset::UnsignedShort: {
+                uint16_t value;
+                memcpy(&value, src, sizeof(value));
+                return normalized ? value / 65535.0f : value;
+            }
+            case GltfAsset::Short: {
+                int16_t value;
+                memcpy(&value, src, sizeof(value));
+                return normalized ? std::max(value / 32767.0f, -1.0f) : value;
+            }
+            case GltfAsset::UnsignedInt: {
+                uint32_t value;
+                memcpy(&value, src, sizeof(value));
+                return static_cast<float>(value);
+            }
+        }
+        return 0.0f;
+    }
+
+    uint32_t readInteger(const std::byte* src, uint32_t component_type){
+        switch(component_type){
+            case GltfAsset::UnsignedByte:
+            case GltfAsset::Byte:
+                return static_cast<uint8_t>(*src);
+            case GltfAsset::UnsignedShort:
+            case GltfAsset::Short: {
+                uint16_t value;
+                memcpy(&value, src, sizeof(value));
+                return value;
+            }
+            case GltfAsset::UnsignedInt: {
+                uint32_t value;
+                memcpy(&value, src, sizeof(value));
+                return value;
+            }
+            case GltfAsset::Float: {
+                float value;
+                memcpy(&value, src, sizeof(value));
+                return static_cast<uint32_t>(value);
+            }
+        }
+        return 0;
+    }
+}
+
+GltfAsset::GltfAsset(const std::string& path) : source(path), file(path, MappedFile::Access::Random) {
+    std::span<const std::byte> bytes = file.bytes();
+    std::span<const std::byte> embedded;
+    std::string_view text;
+
+    if(bytes.size() >= 12 && readU32(bytes.data()) == GLB_MAGIC){
+        //12 byte header, then chunks of (length, type, data) padded to 4 bytes
+        size_t offset = 12;
+        size_t end = std::min<size_t>(readU32(bytes.data() + 8), bytes.size());
+        while(offset + 8 <= end){
+            uint32_t length = readU32(bytes.data() + offset);
+            uint32_t type = readU32(bytes.data() + offset + 4);
+            offset += 8;
+            if(offset + length > end){
+                throw std::runtime_error("Truncated chunk in " + path + ".");
+            }
+            if(type == CHUNK_JSON && text.empty()){
+                text = std::string_view(reinterpret_cast<const char*>(bytes.data() + offset), length);
+            } else if(type == CHUNK_BIN && embedded.empty()){
+                embedded = bytes.subspan(offset, length);
+            }
+            offset += (length + 3) & ~size_t(3);
+        }
+        if(text.empty()){
+            throw std::runtime_error("No JSON chunk in " + path + ".");
+        }
+    } else {
+        text = std::string_view(file.data(), file.size());
+    }
+
+    root = json::parse(text);
+
+    std::filesystem::path directory = std::filesystem::path(path).parent_path();
+    const json::Value& buffer_list = root["buffers"];
+    for(size_t i = 0; i < buffer_list.size(); i++){
+        const json::Value& buffer = buffer_list[i];
+        const std::string& uri = buffer["uri"].string();
+        size_t length = static_cast<size_t>(buffer["byteLength"].integer());
+
+        std::span<const std::byte> data;
+        if(uri.empty()){
+            //only the first buffer may live in the GLB BIN chunk
+            if(i != 0 || embedded.empty()){
+                throw std::runtime_error("Buffer without uri in " + path + ".");
+            }
+            data = embedded;
+        } else if(uri.starts_with("data:")){
+            throw std::runtime_error("Embedded data URIs aren't supported (" + path + ").");
+        } else {
+            external.emplace_back((directory / uri).string(), MappedFile::Access::Random);
+            data = external.back().bytes();
+        }
+
+        if(data.size() < length){
+            throw std::runtime_error("Buffer " + std::to_string(i) + " of " + path + " is truncated.");
+        }
+        buffers.push_back(data.first(length));
+    }
+}
+
+const json::Value& GltfAsset::document() const {
+    return root;
+}
+
+const std::string& GltfAsset::path() const {
+    return source;
+}
+
+uint32_t GltfAsset::componentSize(uint32_t component_type){
+    switch(component_type){
+        case Byte:
+        case UnsignedByte:
+            return 1;
+        case Short:
+        case UnsignedShort:
+            return 2;
+        case UnsignedInt:
+        case Float:
+            return 4;
+    }
+    throw std::runtime_error("Unknown glTF component type " + std::to_string(component_type) + ".");
+}
+
+std::span<const std::byte> GltfAsset::bufferView(size_t index) const {
+    const json::Value& view = root["bufferViews"][index];
+    if(view.isNull()){
+        throw std::runtime_error("Missing buffer view " + std::to_string(index) + " in " + source + ".");
+    }
+
+    size_t buffer = static_cast<size_t>(view["buffer"].integer());
+    size_t offset = static_cast<size_t>(view["byteOffset"].integer());
+    size_t length = static_cast<size_t>(view["byteLength"].integer());
+    if(buffer >= buffers.size() || offset + length > buffers[buffer].size()){
+        throw std::runtime_error("Buffer view " + std::to_string(index) + " of " + source + " is out of range.");
+    }
+    return buffers[buffer].subspan(offset, length);
+}
+
+GltfAsset::Accessor GltfAsset::accessor(size_t index) const {
+    const json::Value& desc = root["accessors"][index];
+    if(desc.isNull()){
+        throw std::runtime_error("Missing accessor " + std::to_string(index) + " in " + source + ".");
+    }
+    if(desc.has("sparse")){
+        throw std::runtime_error("Sparse accessors aren't supported (" + source + ").");
+    }
+
+    Accessor result{};
+    result.count = static_cast<size_t>(desc["count"].integer());
+    result.component_type = static_cast<uint32_t>(desc["componentType"].integer());
+    result.components = componentCount(desc["type"].string());
+    result.normalized = desc["normalized"].boolean();
+
+    size_t element_size = size_t(componentSize(result.component_type)) * result.components;
+    if(!desc.has("bufferView")){
+        //all zeros per the spec, callers see a null pointer
+        result.stride = element_size;
+        return result;
+    }
+
+    size_t view_index = static_cast<size_t>(desc["bufferView"].integer());
+    std::span<const std::byte> view = bufferView(view_index);
+    size_t stride = static_cast<size_t>(root["bufferViews"][view_index]["byteStride"].integer(0));
+    result.stride = stride != 0 ? stride : element_size;
+
+    size_t offset = static_cast<size_t>(desc["byteOffset"].integer());
+    if(result.count != 0 && offset + result.stride * (result.count - 1) + element_size > view.size()){
+        throw std::runtime_error("Accessor " + std::to_string(index) + " of " + source + " is out of range.");
+    }
+    result.data = view.data() + offset;
+    return result;
+}
+
+void GltfAsset::readFloats(size_t accessor_index, float* dst, uint32_t components, size_t dst_stride) const {
+    Accessor source_accessor = accessor(accessor_index);
+    uint32_t size = componentSize(source_accessor.component_type);
+    uint32_t copied = std::min(components, source_accessor.components);
+    if(dst_stride == 0){
+        dst_stride = components;
+    }
+
+    //the common case, tightly packed floats of the same width, is a straight copy
+    if(source_accessor.data != nullptr && source_accessor.component_type == Float && copied == components
+        && source_accessor.components == components && source_accessor.stride == size_t(size) * components){
+        if(dst_stride == components){
+            memcpy(dst, source_accessor.data, source_accessor.count * source_accessor.stride);
+        } else {
+            for(size_t i = 0; i < source_accessor.count; i++){
+                memcpy(dst + i * dst_stride, source_accessor.data + i * source_accessor.stride, source_accessor.stride);
+            }
+        }
+        return;
+    }
+
+    for(size_t i = 0; i < source_accessor.count; i++){
+        float* out = dst + i * dst_stride;
+        for(uint32_t c = 0; c < components; c++){
+            out[c] = 0.0f;
+        }
+        if(source_accessor.data == nullptr){
+            continue;
+        }
+        const std::byte* element = source_accessor.data + i * source_accessor.stride;
+        for(uint32_t c = 0; c < copied; c++){
+            out[c] = readComponent(element + size_t(c) * size, source_accessor.component_type, source_accessor.normalized);
+        }
+    }
+}
+
+void GltfAsset::readUints(size_t accessor_index, uint32_t* dst, uint32_t components) const {
+    Accessor source_accessor = accessor(accessor_index);
+    uint32_t size = componentSize(source_accessor.component_type);
+    uint32_t copied = std::min(components, source_accessor.components);
+
+    if(source_accessor.data != nullptr && source_accessor.component_type == UnsignedInt
+        && source_accessor.components == components && source_accessor.stride == size_t(size) * components){
+        memcpy(dst, source_accessor.data, source_accessor.count * source_accessor.stride);
+        return;
+    }
+
+    for(size_t i = 0; i < source_accessor.count; i++){
+        uint32_t* out = dst + i * components;
+        for(uint32_t c = 0; c < components; c++){
+            out[c] = 0;
+        }
+        if(source_accessor.data == nullptr){
+            continue;
+        }
+        const std::byte* element = source_accessor.data + i * source_accessor.stride;
+        for(uint32_t c = 0; c < copied; c++){
+            out[c] = readInteger(element + size_t(c) * size, source_accessor.component_type);
+        }
+    }
+}
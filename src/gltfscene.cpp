@@ -0,0 +1,251 @@
+#include "gltfscene.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+    const uint32_t MODE_TRIANGLES = 4;
+    //deeper hierarchies are treated as malformed (glTF forbids cycles but nothing stops a file having one)
+    const uint32_t MAX_NODE_DEPTH = 256;
+
+    size_t optionalAccessor(const json::Value& attributes, std::string_view name){
+        return attributes.has(name) ? static_cast<size_t>(attributes[name].integer()) : std::numeric_limits<size_t>::max();
+    }
+
+    glm::mat4 nodeTransform(const json::Value& node){
+        const json::Value& matrix = node["matrix"];
+        if(matrix.size() == 16){
+            glm::mat4 result;
+            for(int i = 0; i < 16; i++){
+                result[i / 4][i % 4] = static_cast<float>(matrix[i].number());
+            }
+            return result;
+        }
+
+        const json::Value& t = node["translation"];
+        const json::Value& r = node["rotation"];
+        const json::Value& s = node["scale"];
+        glm::vec3 translation(t[0].number(), t[1].number(), t[2].number());
+        glm::quat rotation(static_cast<float>(r[3].number(1.0)), static_cast<float>(r[0].number()),
+            static_cast<float>(r[1].number()), static_cast<float>(r[2].number()));
+        glm::vec3 scale(s[0].number(1.0), s[1].number(1.0), s[2].number(1.0));
+
+        return glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), scale);
+    }
+}
+
+GltfScene::GltfScene(const GltfAsset& source) : asset(source) {
+    const json::Value& doc = asset.document();
+
+    const json::Value& meshes = doc["meshes"];
+    for(size_t m = 0; m < meshes.size(); m++){
+        const json::Value& primitives = meshes[m]["primitives"];
+
+        Mesh mesh{};
+        mesh.name = meshes[m]["name"].string();
+        mesh.first_primitive = static_cast<uint32_t>(primitive_list.size());
+
+        for(size_t p = 0; p < primitives.size(); p++){
+            const json::Value& desc = primitives[p];
+            const json::Value& attributes = desc["attributes"];
+            if(desc["mode"].integer(MODE_TRIANGLES) != MODE_TRIANGLES || !attributes.has("POSITION")){
+                continue;
+            }
+
+            Primitive primitive{};
+            primitive.positions = optionalAccessor(attributes, "POSITION");
+            primitive.uvs = optionalAccessor(attributes, "TEXCOORD_0");
+            primitive.colors = optionalAccessor(attributes, "COLOR_0");
+            primitive.indices = optionalAccessor(desc, "indices");
+            primitive.material = desc.has("material") ? static_cast<uint32_t>(desc["material"].integer())
+                : std::numeric_limits<uint32_t>::max();
+
+            primitive.vertex_count = static_cast<uint32_t>(asset.accessor(primitive.positions).count);
+            primitive.vertex_offset = static_cast<int32_t>(vertex_total);
+            primitive.first_index = static_cast<uint32_t>(index_total);
+            primitive.index_count = primitive.indices != std::numeric_limits<size_t>::max()
+                ? static_cast<uint32_t>(asset.accessor(primitive.indices).count) : primitive.vertex_count;
+
+            //POSITION has to carry min and max, files that leave them out are measured
+            const json::Value& position_desc = doc["accessors"][primitive.positions];
+            const json::Value& lo = position_desc["min"];
+            const json::Value& hi = position_desc["max"];
+            if(lo.size() >= 3 && hi.size() >= 3){
+                primitive.bounds_min = glm::vec3(lo[0].number(), lo[1].number(), lo[2].number());
+                primitive.bounds_max = glm::vec3(hi[0].number(), hi[1].number(), hi[2].number());
+            } else if(primitive.vertex_count != 0){
+                std::vector<float> positions(size_t(primitive.vertex_count) * 3);
+                asset.readFloats(primitive.positions, positions.data(), 3);
+                primitive.bounds_min = glm::vec3(std::numeric_limits<float>::max());
+                primitive.bounds_max = glm::vec3(std::numeric_limits<float>::lowest());
+                for(size_t v = 0; v < positions.size(); v += 3){
+                    glm::vec3 position(positions[v], positions[v + 1], positions[v + 2]);
+                    primitive.bounds_min = glm::min(primitive.bounds_min, position);
+                    primitive.bounds_max = glm::max(primitive.bounds_max, position);
+                }
+            }
+
+            vertex_total += primitive.vertex_count;
+            index_total += primitive.index_count;
+            primitive_list.push_back(primitive);
+        }
+
+        mesh.primitive_count = static_cast<uint32_t>(primitive_list.size()) - mesh.first_primitive;
+        mesh_list.push_back(mesh);
+    }
+
+    const json::Value& textures = doc["textures"];
+    const json::Value& materials = doc["materials"];
+    for(size_t i = 0; i < materials.size(); i++){
+        const json::Value& pbr = materials[i]["pbrMetallicRoughness"];
+        const json::Value& factor = pbr["baseColorFactor"];
+
+        Material material{};
+        material.base_color = glm::vec4(factor[0].number(1.0), factor[1].number(1.0), factor[2].number(1.0), factor[3].number(1.0));
+        material.image = std::numeric_limits<uint32_t>::max();
+        if(pbr.has("baseColorTexture")){
+            const json::Value& texture = textures[static_cast<size_t>(pbr["baseColorTexture"]["index"].integer())];
+            if(texture.has("source")){
+                material.image = static_cast<uint32_t>(texture["source"].integer());
+            }
+        }
+        material_list.push_back(material);
+    }
+
+    std::filesystem::path directory = std::filesystem::path(asset.path()).parent_path();
+    const json::Value& images = doc["images"];
+    for(size_t i = 0; i < images.size(); i++){
+        const json::Value& desc = images[i];
+
+        Image image{};
+        image.name = asset.path() + "#image" + std::to_string(i);
+        if(desc.has("bufferView")){
+            image.bytes = asset.bufferView(static_cast<size_t>(desc["bufferView"].integer()));
+        } else if(desc["uri"].string().starts_with("data:")){
+            throw std::runtime_error("Embedded data URIs aren't supported (" + asset.path() + ").");
+        } else {
+            image.path = (directory / desc["uri"].string()).string();
+            image.name = image.path;
+        }
+        image_list.push_back(image);
+    }
+}
+
+void GltfScene::buildTree(Tree& tree, Object* parent) const {
+    const json::Value& doc = asset.document();
+    const json::Value& scenes = doc["scenes"];
+
+    if(scenes.size() != 0){
+        const json::Value& roots = scenes[static_cast<size_t>(doc["scene"].integer())]["nodes"];
+        for(size_t i = 0; i < roots.size(); i++){
+            addNode(tree, parent, static_cast<size_t>(roots[i].integer()), 0);
+        }
+        return;
+    }
+
+    //without scenes every node that isn't somebody's child is a root
+    const json::Value& nodes = doc["nodes"];
+    std::vector<bool> is_child(nodes.size(), false);
+    for(size_t i = 0; i < nodes.size(); i++){
+        const json::Value& children = nodes[i]["children"];
+        for(size_t c = 0; c < children.size(); c++){
+            size_t child = static_cast<size_t>(children[c].integer());
+            if(child < is_child.size()){
+                is_child[child] = true;
+            }
+        }
+    }
+    for(size_t i = 0; i < nodes.size(); i++){
+        if(!is_child[i]){
+            addNode(tree, parent, i, 0);
+        }
+    }
+}
+
+void GltfScene::addNode(Tree& tree, Object* parent, size_t node, uint32_t depth) const {
+    const json::Value& desc = asset.document()["nodes"][node];
+    if(desc.isNull() || depth > MAX_NODE_DEPTH){
+        throw std::runtime_error("Invalid node hierarchy in " + asset.path() + ".");
+    }
+
+    Object* object = tree.create_object(parent);
+    object->set_name(desc["name"].string());
+    object->set_transform(nodeTransform(desc));
+    if(desc.has("mesh")){
+        object->set_mesh(static_cast<int32_t>(desc["mesh"].integer()));
+    }
+
+    const json::Value& children = desc["children"];
+    for(size_t i = 0; i < children.size(); i++){
+        addNode(tree, object, static_cast<size_t>(children[i].integer()), depth + 1);
+    }
+}
+
+void GltfScene::writeVertices(float* dst, const VertexLayout& layout) const {
+    for(const Primitive& primitive : primitive_list){
+        float* base = dst + size_t(primitive.vertex_offset) * layout.stride;
+
+        asset.readFloats(primitive.positions, base + layout.position_offset, 3, layout.stride);
+
+        if(primitive.uvs != std::numeric_limits<size_t>::max()){
+            asset.readFloats(primitive.uvs, base + layout.uv_offset, 2, layout.stride);
+        } else {
+            for(uint32_t i = 0; i < primitive.vertex_count; i++){
+                base[size_t(i) * layout.stride + layout.uv_offset] = 0.0f;
+                base[size_t(i) * layout.stride + layout.uv_offset + 1] = 0.0f;
+            }
+        }
+
+        if(primitive.colors != std::numeric_limits<size_t>::max()){
+            asset.readFloats(primitive.colors, base + layout.color_offset, 3, layout.stride);
+        } else {
+            for(uint32_t i = 0; i < primitive.vertex_count; i++){
+                float* color = base + size_t(i) * layout.stride + layout.color_offset;
+                color[0] = 1.0f;
+                color[1] = 1.0f;
+                color[2] = 1.0f;
+            }
+        }
+    }
+}
+
+void GltfScene::writeIndices(uint32_t* dst) const {
+    for(const Primitive& primitive : primitive_list){
+        uint32_t* out = dst + primitive.first_index;
+        if(primitive.indices != std::numeric_limits<size_t>::max()){
+            asset.readUints(primitive.indices, out, 1);
+        } else {
+            for(uint32_t i = 0; i < primitive.index_count; i++){
+                out[i] = i;
+            }
+        }
+    }
+}
+
+size_t GltfScene::vertexCount() const {
+    return vertex_total;
+}
+
+size_t GltfScene::indexCount() const {
+    return index_total;
+}
+
+const std::vector<GltfScene::Mesh>& GltfScene::meshes() const {
+    return mesh_list;
+}
+
+const std::vector<GltfScene::Primitive>& GltfScene::primitives() const {
+    return primitive_list;
+}
+
+const std::vector<GltfScene::Material>& GltfScene::materials() const {
+    return material_list;
+}
+
+const std::vector<GltfScene::Image>& GltfScene::images() const {
+    return image_list;
+}
@@ -0,0 +1,295 @@
+#include "hotreload.hpp"
+#include "file.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
+
+#ifdef DOMK_HAS_SHADERC
+#include <shaderc/shaderc.hpp>
+#endif
+
+namespace{
+#ifndef DOMK_HAS_SHADERC
+    /*
+        Runs a program found on PATH with these arguments and returns whether it exited with 0.
+        No shell is involved, file names that came from inotify are passed through as they are.
+    */
+    bool runProgram(const std::vector<std::string>& args){
+#ifdef _WIN32
+        //CreateProcess takes one command line, quoted the way CommandLineToArgvW splits it back up
+        std::string command_line;
+        for(const std::string& arg : args){
+            command_line += command_line.empty() ? "\"" : " \"";
+            size_t backslashes = 0;
+            for(char c : arg){
+                if(c == '\\'){
+                    backslashes++;
+                    continue;
+                }
+                command_line.append(c == '"' ? backslashes * 2 + 1 : backslashes, '\\');
+                command_line += c;
+                backslashes = 0;
+            }
+            command_line.append(backslashes * 2, '\\');
+            command_line += '"';
+        }
+
+        STARTUPINFOA startup{};
+        startup.cb = sizeof(startup);
+        PROCESS_INFORMATION process{};
+        if(!CreateProcessA(nullptr, command_line.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup, &process)){
+            return false;
+        }
+        WaitForSingleObject(process.hProcess, INFINITE);
+        DWORD exit_code = 1;
+        GetExitCodeProcess(process.hProcess, &exit_code);
+        CloseHandle(process.hThread);
+        CloseHandle(process.hProcess);
+        return exit_code == 0;
+#else
+        std::vector<char*> argv;
+        for(const std::string& arg : args){
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+
+        pid_t pid;
+        if(posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0){
+            return false;
+        }
+        int status = 0;
+        while(waitpid(pid, &status, 0) < 0){
+            if(errno != EINTR){
+                return false;
+            }
+        }
+        return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+    }
+#endif
+}
+
+HotReload::~HotReload(){
+    stop();
+}
+
+void HotReload::watch(const std::string& directory, const std::vector<std::string>& extensions, Handler handler){
+    Watch target{};
+    target.directory = directory;
+    target.extensions = extensions;
+    target.handler = std::move(handler);
+    watches.push_back(std::move(target));
+}
+
+bool HotReload::start(){
+#ifdef __linux__
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(inotify_fd < 0){
+        return false;
+    }
+
+    //editors either rewrite the file or write a new one and rename it over the old
+    for(Watch& target : watches){
+        target.descriptor = inotify_add_watch(inotify_fd, target.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if(target.descriptor < 0){
+            std::cerr << "Can't watch " << target.directory << " for changes." << std::endl;
+        }
+    }
+
+    stopping = false;
+    thread = std::thread(&HotReload::threadLoop, this);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void HotReload::stop(){
+    stopping = true;
+    if(thread.joinable()){
+        thread.join();
+    }
+#ifdef __linux__
+    if(inotify_fd >= 0){
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+#endif
+}
+
+void HotReload::threadLoop(){
+#ifdef __linux__
+    struct Pending{
+        size_t watch;
+        std::string path;
+        std::chrono::steady_clock::time_point last_event;
+    };
+    std::vector<Pending> pending;
+
+    alignas(inotify_event) char events[4096];
+    while(!stopping){
+        pollfd descriptor{inotify_fd, POLLIN, 0};
+        if(poll(&descriptor, 1, pending.empty() ? POLL_MS : SETTLE_MS) > 0 && (descriptor.revents & POLLIN)){
+            ssize_t length = read(inotify_fd, events, sizeof(events));
+            for(ssize_t offset = 0; offset < length;){
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(events + offset);
+                offset += sizeof(inotify_event) + event->len;
+                if(event->len == 0){
+                    continue;
+                }
+
+                //watches of the same directory share a descriptor, the extension picks the handler
+                std::string name = event->name;
+                std::string extension = std::filesystem::path(name).extension().string();
+                auto target = std::find_if(watches.begin(), watches.end(), [event, &extension](const Watch& candidate){
+                    return candidate.descriptor == event->wd
+                        && std::find(candidate.extensions.begin(), candidate.extensions.end(), extension) != candidate.extensions.end();
+                });
+                if(target == watches.end()){
+                    continue;
+                }
+
+                std::string path = target->directory + "/" + name;
+                auto now = std::chrono::steady_clock::now();
+                auto existing = std::find_if(pending.begin(), pending.end(), [&path](const Pending& candidate){
+                    return candidate.path == path;
+                });
+                if(existing != pending.end()){
+                    existing->last_event = now;
+                } else {
+                    pending.push_back({static_cast<size_t>(target - watches.begin()), path, now});
+                }
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < pending.size();){
+            if(now - pending[i].last_event >= std::chrono::milliseconds(SETTLE_MS)){
+                handle(watches[pending[i].watch], pending[i].path);
+                pending.erase(pending.begin() + i);
+            } else {
+                i++;
+            }
+        }
+    }
+#endif
+}
+
+void HotReload::handle(const Watch& target, const std::string& path){
+    try {
+        std::function<void()> swap = target.handler(path);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if(swap){
+            ready.push_back(std::move(swap));
+        }
+        error.clear();
+    } catch (const std::exception& e) {
+        std::cerr << "Reloading " << path << " failed: " << e.what() << std::endl;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        error = path + ": " + e.what();
+    }
+}
+
+size_t HotReload::apply(){
+    std::vector<std::function<void()>> swaps;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        swaps.swap(ready);
+    }
+
+    for(std::function<void()>& swap : swaps){
+        try {
+            swap();
+        } catch (const std::exception& e) {
+            std::cerr << "Applying a reload failed: " << e.what() << std::endl;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            error = e.what();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    reloads += swaps.size();
+    return swaps.size();
+}
+
+size_t HotReload::reloadCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return reloads;
+}
+
+void HotReload::lastError(std::string& message) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    message.assign(error);
+}
+
+void HotReload::compileGlsl(const std::string& source_path, const std::string& spv_path){
+    std::string temporary = spv_path + ".tmp";
+
+#ifdef DOMK_HAS_SHADERC
+    std::string extension = std::filesystem::path(source_path).extension().string();
+    shaderc_shader_kind kind;
+    if(extension == ".vert"){
+        kind = shaderc_vertex_shader;
+    } else if(extension == ".frag"){
+        kind = shaderc_fragment_shader;
+    } else if(extension == ".comp"){
+        kind = shaderc_compute_shader;
+    } else {
+        throw std::runtime_error("Unknown shader stage for " + source_path + ".");
+    }
+
+    MappedFile source(source_path);
+    shaderc::Compiler compiler;
+    shaderc::CompileOptions options;
+    shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source.data(), source.size(), kind,
+        source_path.c_str(), options);
+    if(result.GetCompilationStatus() != shaderc_compilation_status_success){
+        throw std::runtime_error(result.GetErrorMessage());
+    }
+
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(result.cbegin()), (result.cend() - result.cbegin()) * sizeof(uint32_t));
+    if(!out){
+        throw std::runtime_error("Couldn't write " + temporary + ".");
+    }
+    out.close();
+#else
+    //same invocation as compile-shaders.bat
+    if(!runProgram({"glslc", source_path, "-o", temporary})){
+        throw std::runtime_error("glslc couldn't compile " + source_path + ".");
+    }
+#endif
+
+    std::filesystem::rename(temporary, spv_path);
+}
+
+bool HotReload::samePath(const std::string& a, const std::string& b){
+    std::error_code error_code;
+    return std::filesystem::equivalent(a, b, error_code);
+}
@@ -0,0 +1,102 @@
+#include "imagedecoder.hpp"
+#include "pixelformat.hpp"
+
+#include <stb_image.h>
+
+#include <cstring>
+#include <stdexcept>
+
+ImageDecoder::ImageDecoder(JobSystem& job_system) : jobs(job_system) {}
+
+const std::vector<ImageDecoder::Image>& ImageDecoder::images() const {
+    return planned;
+}
+
+bool ImageDecoder::probe(std::span<const std::byte> file, Image& image){
+    int width, height, channels;
+    if(!stbi_info_from_memory(reinterpret_cast<const stbi_uc*>(file.data()), static_cast<int>(file.size()),
+        &width, &height, &channels)){
+        return false;
+    }
+
+    image.width = static_cast<uint32_t>(width);
+    image.height = static_cast<uint32_t>(height);
+    image.channels = static_cast<uint32_t>(channels);
+    image.size = size_t(image.width) * image.height * 4;
+    return true;
+}
+
+size_t ImageDecoder::plan(const std::vector<std::string>& paths, size_t alignment){
+    planned.clear();
+    files.clear();
+    planned.reserve(paths.size());
+    files.reserve(paths.size());
+
+    size_t total = 0;
+    for(const std::string& path : paths){
+        MappedFile file(path, MappedFile::Access::WillNeed);
+
+        Image image{};
+        image.path = path;
+        if(!probe(file.bytes(), image)){
+            throw std::runtime_error("Couldn't read image header of " + path + ": " + stbi_failure_reason());
+        }
+        total = (total + alignment - 1) / alignment * alignment;
+        image.offset = total;
+        total += image.size;
+
+        planned.push_back(image);
+        files.push_back(std::move(file));
+    }
+
+    return total;
+}
+
+/*
+    stb always returns its own allocation, but decoding at the native channel count keeps it as small
+    as possible and the single expansion pass writes the destination directly.
+*/
+void ImageDecoder::decodeInto(std::span<const std::byte> file, const Image& image, uint8_t* dst, bool premultiply){
+    int width, height, channels;
+    stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.data()), static_cast<int>(file.size()),
+        &width, &height, &channels, 0);
+    if(pixels == nullptr){
+        throw std::runtime_error("Failed to decode " + image.path + ": " + stbi_failure_reason());
+    }
+    if(static_cast<uint32_t>(width) != image.width || static_cast<uint32_t>(height) != image.height){
+        stbi_image_free(pixels);
+        throw std::runtime_error("Image " + image.path + " doesn't match its header.");
+    }
+
+    size_t count = size_t(image.width) * image.height;
+    pixelformat::expandToRgba(pixels, static_cast<uint32_t>(channels), dst, count);
+    stbi_image_free(pixels);
+
+    if(premultiply){
+        pixelformat::premultiplySrgb(dst, count);
+    }
+}
+
+void ImageDecoder::decode(uint8_t* dst, bool premultiply){
+    jobs.parallelFor(static_cast<uint32_t>(planned.size()), [&](uint32_t index){
+        decodeInto(files[index].bytes(), planned[index], dst + planned[index].offset, premultiply);
+        files[index].release();
+    });
+}
+
+void ImageDecoder::decodeSerial(uint8_t* dst, bool premultiply){
+    for(const Image& image : planned){
+        int width, height, channels;
+        stbi_uc* pixels = stbi_load(image.path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+        if(pixels == nullptr){
+            throw std::runtime_error("Failed to decode " + image.path + ": " + stbi_failure_reason());
+        }
+
+        memcpy(dst + image.offset, pixels, image.size);
+        stbi_image_free(pixels);
+
+        if(premultiply){
+            pixelformat::premultiplySrgbScalar(dst + image.offset, size_t(image.width) * image.height);
+        }
+    }
+}
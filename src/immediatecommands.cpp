@@ -0,0 +1,189 @@
+#include "immediatecommands.hpp"
+
+#include <stdexcept>
+
+namespace{
+    struct LayoutUse{
+        VkPipelineStageFlags2KHR stage;
+        VkAccessFlags2KHR access;
+    };
+
+    //Stages and accesses around an image in this layout, as far as one-off uploads use it.
+    LayoutUse useOf(VkImageLayout layout){
+        switch(layout){
+            case VK_IMAGE_LAYOUT_UNDEFINED:
+                return {VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT_KHR, 0};
+            case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+                return {VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT_KHR};
+            case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+                return {VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR};
+            case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+                return {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR};
+            default:
+                throw std::invalid_argument("Unsupported layout transition.");
+        }
+    }
+}
+
+void ImmediateCommands::setup(const Context& context){
+    ctx = context;
+
+    VkCommandPoolCreateInfo pool_ci{};
+    pool_ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_ci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_ci.queueFamilyIndex = ctx.queue_family;
+    if(vkCreateCommandPool(ctx.device, &pool_ci, nullptr, &pool) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create immediate command pool.");
+    }
+
+    VkCommandBufferAllocateInfo buffer_i{};
+    buffer_i.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    buffer_i.commandPool = pool;
+    buffer_i.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    buffer_i.commandBufferCount = 1;
+    if(vkAllocateCommandBuffers(ctx.device, &buffer_i, &buffer) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't allocate immediate command buffer.");
+    }
+
+    VkFenceCreateInfo fence_ci{};
+    fence_ci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if(vkCreateFence(ctx.device, &fence_ci, nullptr, &fence) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create immediate command fence.");
+    }
+}
+
+void ImmediateCommands::destroy(){
+    if(pool == VK_NULL_HANDLE){
+        return;
+    }
+    vkDestroyFence(ctx.device, fence, nullptr);
+    vkDestroyCommandPool(ctx.device, pool, nullptr);
+    pool = VK_NULL_HANDLE;
+    buffer = VK_NULL_HANDLE;
+    fence = VK_NULL_HANDLE;
+    recording = false;
+    pending.clear();
+}
+
+void ImmediateCommands::transition(VkImage image, VkImageAspectFlags aspect, VkImageLayout old_layout, VkImageLayout new_layout,
+    uint32_t mip_levels, uint32_t array_layers){
+    LayoutUse before = useOf(old_layout);
+    LayoutUse after = useOf(new_layout);
+
+    VkImageMemoryBarrier2KHR barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+    barrier.srcStageMask = before.stage;
+    barrier.srcAccessMask = before.access;
+    barrier.dstStageMask = after.stage;
+    barrier.dstAccessMask = after.access;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {aspect, 0, mip_levels, 0, array_layers};
+
+    pending.push_back(barrier);
+    counted.transitions++;
+}
+
+void ImmediateCommands::copyBufferToImage(VkBuffer source, VkImage image, std::span<const VkBufferImageCopy> regions){
+    VkCommandBuffer target = commandBuffer();
+    recordBarriers();
+    vkCmdCopyBufferToImage(target, source, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        static_cast<uint32_t>(regions.size()), regions.data());
+    counted.copies++;
+}
+
+void ImmediateCommands::record(const std::function<void(VkCommandBuffer)>& commands){
+    VkCommandBuffer target = commandBuffer();
+    recordBarriers();
+    commands(target);
+}
+
+void ImmediateCommands::flush(){
+    if(!recording && pending.empty()){
+        return;
+    }
+    commandBuffer();
+    recordBarriers();
+
+    if(vkEndCommandBuffer(buffer) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't record immediate commands.");
+    }
+    recording = false;
+
+    VkSubmitInfo submit{};
+    submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &buffer;
+    if(vkQueueSubmit(ctx.queue, 1, &submit, fence) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't submit immediate commands.");
+    }
+    if(vkWaitForFences(ctx.device, 1, &fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't wait for immediate commands.");
+    }
+    vkResetFences(ctx.device, 1, &fence);
+    vkResetCommandPool(ctx.device, pool, 0);
+    counted.submits++;
+}
+
+const ImmediateCommands::Stats& ImmediateCommands::stats() const {
+    return counted;
+}
+
+VkCommandBuffer ImmediateCommands::commandBuffer(){
+    if(!recording){
+        VkCommandBufferBeginInfo begin_i{};
+        begin_i.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_i.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if(vkBeginCommandBuffer(buffer, &begin_i) != VK_SUCCESS){
+            throw std::runtime_error("Couldn't begin immediate commands.");
+        }
+        recording = true;
+    }
+    return buffer;
+}
+
+/*
+    Every queued transition in one barrier. Without sync2 the stage masks are merged, the legacy stage and
+    access bits have the same values as the sync2 ones used here.
+*/
+void ImmediateCommands::recordBarriers(){
+    if(pending.empty()){
+        return;
+    }
+
+    if(ctx.pipeline_barrier2 != nullptr){
+        VkDependencyInfoKHR dependency{};
+        dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+        dependency.imageMemoryBarrierCount = static_cast<uint32_t>(pending.size());
+        dependency.pImageMemoryBarriers = pending.data();
+        ctx.pipeline_barrier2(buffer, &dependency);
+    } else {
+        VkPipelineStageFlags source_stages = 0;
+        VkPipelineStageFlags destination_stages = 0;
+        legacy.clear();
+        for(const VkImageMemoryBarrier2KHR& pending_barrier : pending){
+            source_stages |= static_cast<VkPipelineStageFlags>(pending_barrier.srcStageMask);
+            destination_stages |= static_cast<VkPipelineStageFlags>(pending_barrier.dstStageMask);
+
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = static_cast<VkAccessFlags>(pending_barrier.srcAccessMask);
+            barrier.dstAccessMask = static_cast<VkAccessFlags>(pending_barrier.dstAccessMask);
+            barrier.oldLayout = pending_barrier.oldLayout;
+            barrier.newLayout = pending_barrier.newLayout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = pending_barrier.image;
+            barrier.subresourceRange = pending_barrier.subresourceRange;
+            legacy.push_back(barrier);
+        }
+        vkCmdPipelineBarrier(buffer, source_stages, destination_stages, 0, 0, nullptr, 0, nullptr,
+            static_cast<uint32_t>(legacy.size()), legacy.data());
+    }
+
+    pending.clear();
+    counted.barriers++;
+}
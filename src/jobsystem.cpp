@@ -0,0 +1,95 @@
+#include "jobsystem.hpp"
+
+#include <algorithm>
+
+JobSystem::JobSystem(uint32_t threads){
+    if(threads == 0){
+        threads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+
+    workers.reserve(threads);
+    for(uint32_t i = 0; i < threads; i++){
+        workers.emplace_back([this]{ workerLoop(); });
+    }
+}
+
+JobSystem::~JobSystem(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for(std::thread& worker : workers){
+        worker.join();
+    }
+}
+
+uint32_t JobSystem::workerCount() const {
+    return static_cast<uint32_t>(workers.size());
+}
+
+void JobSystem::run(uint32_t count, const void* context, Invoke invoke){
+    if(count == 0){
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batch = context;
+        batch_invoke = invoke;
+        batch_size = count;
+        next_index.store(0, std::memory_order_relaxed);
+        error = nullptr;
+        busy_workers = static_cast<uint32_t>(workers.size());
+        generation++;
+    }
+    wake.notify_all();
+
+    runIndices();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this]{ return busy_workers == 0; });
+    batch = nullptr;
+    batch_invoke = nullptr;
+
+    if(error){
+        std::rethrow_exception(error);
+    }
+}
+
+void JobSystem::runIndices(){
+    for(uint32_t index = next_index.fetch_add(1, std::memory_order_relaxed); index < batch_size;
+        index = next_index.fetch_add(1, std::memory_order_relaxed)){
+        try {
+            batch_invoke(batch, index);
+        } catch(...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!error){
+                error = std::current_exception();
+            }
+        }
+    }
+}
+
+void JobSystem::workerLoop(){
+    uint64_t seen = 0;
+
+    while(true){
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]{ return stopping || generation != seen; });
+            if(stopping){
+                return;
+            }
+            seen = generation;
+        }
+
+        runIndices();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if(--busy_workers == 0){
+            done.notify_one();
+        }
+    }
+}
@@ -0,0 +1,332 @@
+#include "json.hpp"
+
+#include <cstdlib>
+#include <stdexcept>
+
+namespace json{
+    namespace {
+        const Value& nullValue(){
+            static const Value null;
+            return null;
+        }
+
+        const std::string& emptyString(){
+            static const std::string empty;
+            return empty;
+        }
+    }
+
+    Value::Type Value::type() const {
+        return kind;
+    }
+
+    bool Value::isNull() const {
+        return kind == Type::Null;
+    }
+
+    bool Value::isNumber() const {
+        return kind == Type::Number;
+    }
+
+    bool Value::isString() const {
+        return kind == Type::String;
+    }
+
+    bool Value::isArray() const {
+        return kind == Type::Array;
+    }
+
+    bool Value::isObject() const {
+        return kind == Type::Object;
+    }
+
+    bool Value::boolean(bool fallback) const {
+        return kind == Type::Bool ? flag : fallback;
+    }
+
+    double Value::number(double fallback) const {
+        return kind == Type::Number ? num : fallback;
+    }
+
+    int64_t Value::integer(int64_t fallback) const {
+        return kind == Type::Number ? static_cast<int64_t>(num) : fallback;
+    }
+
+    const std::string& Value::string() const {
+        return kind == Type::String ? str : emptyString();
+    }
+
+    size_t Value::size() const {
+        if(kind == Type::Array){
+            return elements.size();
+        }
+        if(kind == Type::Object){
+            return fields.size();
+        }
+        return 0;
+    }
+
+    bool Value::has(std::string_view key) const {
+        return !(*this)[key].isNull();
+    }
+
+    const Value& Value::operator[](size_t index) const {
+        if(kind != Type::Array || index >= elements.size()){
+            return nullValue();
+        }
+        return elements[index];
+    }
+
+    //glTF objects have a handful of members, a linear scan beats hashing them
+    const Value& Value::operator[](std::string_view key) const {
+        if(kind == Type::Object){
+            for(const auto& [name, value] : fields){
+                if(name == key){
+                    return value;
+                }
+            }
+        }
+        return nullValue();
+    }
+
+    const std::vector<std::pair<std::string, Value>>& Value::members() const {
+        return fields;
+    }
+
+    class Parser{
+    public:
+        explicit Parser(std::string_view source) : text(source) {}
+
+        Value document(){
+            Value root = value(0);
+            skipSpace();
+            if(pos != text.size()){
+                fail("trailing characters");
+            }
+            return root;
+        }
+
+    private:
+        //deep enough for any real document, shallow enough to never exhaust the stack
+        static constexpr int MAX_DEPTH = 256;
+
+        std::string_view text;
+        size_t pos = 0;
+
+        [[noreturn]] void fail(const char* what) const {
+            throw std::runtime_error(std::string("JSON parse error at byte ") + std::to_string(pos) + ": " + what);
+        }
+
+        void skipSpace(){
+            while(pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r')){
+                pos++;
+            }
+        }
+
+        bool consume(std::string_view literal){
+            if(text.substr(pos, literal.size()) == literal){
+                pos += literal.size();
+                return true;
+            }
+            return false;
+        }
+
+        void expect(char c){
+            skipSpace();
+            if(pos >= text.size() || text[pos] != c){
+                fail("unexpected character");
+            }
+            pos++;
+        }
+
+        Value value(int depth){
+            if(depth > MAX_DEPTH){
+                fail("nested too deeply");
+            }
+
+            skipSpace();
+            if(pos >= text.size()){
+                fail("unexpected end of input");
+            }
+
+            Value result;
+            char c = text[pos];
+            if(c == '{'){
+                result.kind = Value::Type::Object;
+                pos++;
+                skipSpace();
+                if(pos < text.size() && text[pos] == '}'){
+                    pos++;
+                    return result;
+                }
+                while(true){
+                    skipSpace();
+                    std::string key = string();
+                    expect(':');
+                    result.fields.emplace_back(std::move(key), value(depth + 1));
+                    skipSpace();
+                    if(pos < text.size() && text[pos] == ','){
+                        pos++;
+                        continue;
+                    }
+                    expect('}');
+                    return result;
+                }
+            }
+            if(c == '['){
+                result.kind = Value::Type::Array;
+                pos++;
+                skipSpace();
+                if(pos < text.size() && text[pos] == ']'){
+                    pos++;
+                    return result;
+                }
+                while(true){
+                    result.elements.push_back(value(depth + 1));
+                    skipSpace();
+                    if(pos < text.size() && text[pos] == ','){
+                        pos++;
+                        continue;
+                    }
+                    expect(']');
+                    return result;
+                }
+            }
+            if(c == '"'){
+                result.kind = Value::Type::String;
+                result.str = string();
+                return result;
+            }
+            if(consume("true")){
+                result.kind = Value::Type::Bool;
+                result.flag = true;
+                return result;
+            }
+            if(consume("false")){
+                result.kind = Value::Type::Bool;
+                return result;
+            }
+            if(consume("null")){
+                return result;
+            }
+
+            result.kind = Value::Type::Number;
+            result.num = number();
+            return result;
+        }
+
+        double number(){
+            size_t start = pos;
+            if(pos < text.size() && text[pos] == '-'){
+                pos++;
+            }
+            while(pos < text.size() && ((text[pos] >= '0' && text[pos] <= '9') || text[pos] == '.'
+                || text[pos] == 'e' || text[pos] == 'E' || text[pos] == '+' || text[pos] == '-')){
+                pos++;
+            }
+            if(pos == start){
+                fail("unexpected character");
+            }
+
+            //strtod needs a terminated string, numbers are short
+            std::string digits(text.substr(start, pos - start));
+            char* end = nullptr;
+            double result = std::strtod(digits.c_str(), &end);
+            if(end != digits.c_str() + digits.size()){
+                fail("malformed number");
+            }
+            return result;
+        }
+
+        uint32_t hex4(){
+            if(pos + 4 > text.size()){
+                fail("truncated escape");
+            }
+            uint32_t code = 0;
+            for(int i = 0; i < 4; i++){
+                char h = text[pos++];
+                code <<= 4;
+                if(h >= '0' && h <= '9'){
+                    code |= h - '0';
+                } else if(h >= 'a' && h <= 'f'){
+                    code |= h - 'a' + 10;
+                } else if(h >= 'A' && h <= 'F'){
+                    code |= h - 'A' + 10;
+                } else {
+                    fail("malformed escape");
+                }
+            }
+            return code;
+        }
+
+        static void appendUtf8(std::string& out, uint32_t code){
+            if(code < 0x80){
+                out += static_cast<char>(code);
+            } else if(code < 0x800){
+                out += static_cast<char>(0xC0 | (code >> 6));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            } else if(code < 0x10000){
+                out += static_cast<char>(0xE0 | (code >> 12));
+                out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            } else {
+                out += static_cast<char>(0xF0 | (code >> 18));
+                out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+        }
+
+        std::string string(){
+            if(pos >= text.size() || text[pos] != '"'){
+                fail("expected a string");
+            }
+            pos++;
+
+            std::string result;
+            while(true){
+                if(pos >= text.size()){
+                    fail("unterminated string");
+                }
+                char c = text[pos++];
+                if(c == '"'){
+                    return result;
+                }
+                if(c != '\\'){
+                    result += c;
+                    continue;
+                }
+
+                if(pos >= text.size()){
+                    fail("unterminated string");
+                }
+                char escape = text[pos++];
+                switch(escape){
+                    case '"': result += '"'; break;
+                    case '\\': result += '\\'; break;
+                    case '/': result += '/'; break;
+                    case 'b': result += '\b'; break;
+                    case 'f': result += '\f'; break;
+                    case 'n': result += '\n'; break;
+                    case 'r': result += '\r'; break;
+                    case 't': result += '\t'; break;
+                    case 'u': {
+                        uint32_t code = hex4();
+                        //surrogate pair
+                        if(code >= 0xD800 && code < 0xDC00 && consume("\\u")){
+                            uint32_t low = hex4();
+                            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        }
+                        appendUtf8(result, code);
+                        break;
+                    }
+                    default: fail("unknown escape");
+                }
+            }
+        }
+    };
+
+    Value parse(std::string_view text){
+        return Parser(text).document();
+    }
+}
@@ -1,11 +1,61 @@
+#include "allocations.hpp"
 #include "application.hpp"
 
 #include <iostream>
+#include <string>
 
-int main(){
+int main(int argc, char** argv){
     std::cout << "Demonstration of my knowledge.";
 
-    Application app;
+    Application::Options options;
+    for(int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+        if(arg == "--benchmark-msaa"){
+            options.benchmark_msaa = true;
+        } else if(arg == "--benchmark-decode" && i + 1 < argc){
+            options.benchmark_decode_dir = argv[++i];
+        } else if(arg == "--benchmark-import" && i + 2 < argc){
+            options.benchmark_import_gltf = argv[++i];
+            options.benchmark_import_obj = argv[++i];
+        } else if(arg == "--model" && i + 1 < argc){
+            options.model = argv[++i];
+        } else if(arg == "--archive" && i + 1 < argc){
+            options.archive = argv[++i];
+        } else if(arg == "--hot-reload"){
+            options.hot_reload = true;
+        } else if(arg == "--shader-source" && i + 1 < argc){
+            options.shader_source_dir = argv[++i];
+        } else if(arg == "--device" && i + 1 < argc){
+            options.device = argv[++i];
+        } else if(arg == "--texture-budget" && i + 1 < argc){
+            options.texture_budget_mb = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if(arg == "--skinned" && i + 1 < argc){
+            options.skinned_model = argv[++i];
+        } else if(arg == "--characters" && i + 1 < argc){
+            options.characters = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if(arg == "--no-occlusion"){
+            options.occlusion_culling = false;
+        } else if(arg == "--software-occlusion"){
+            options.software_occlusion = true;
+        } else if(arg == "--benchmark-occlusion"){
+            options.benchmark_occlusion = true;
+        } else if(arg == "--benchmark-sort"){
+            options.benchmark_sort = true;
+        } else if(arg == "--count-allocations"){
+            options.count_allocations = true;
+        } else if(arg == "--staged-uploads"){
+            options.staged_uploads = true;
+        } else if(arg == "--benchmark-upload"){
+            options.benchmark_upload = true;
+        }
+    }
+
+    if(options.count_allocations && !allocations::counted()){
+        std::cerr << "--count-allocations needs a build configured with -DDOMK_COUNT_ALLOCATIONS=ON." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    Application app(options);
 
     try {
         app.run();
@@ -6,4 +6,41 @@ std::vector<Object*> Object::get_children(){
 
 Object* Object::get_parent(){
     return  parent;
-}
\ No newline at end of file
+}
+
+void Object::add_child(Object* child){
+    child->parent = this;
+    children.push_back(child);
+}
+
+const std::string& Object::get_name(){
+    return name;
+}
+
+void Object::set_name(const std::string& new_name){
+    name = new_name;
+}
+
+const glm::mat4& Object::get_transform(){
+    return transform;
+}
+
+void Object::set_transform(const glm::mat4& new_transform){
+    transform = new_transform;
+}
+
+glm::mat4 Object::get_world_transform(){
+    glm::mat4 world = transform;
+    for(Object* ancestor = parent; ancestor != nullptr; ancestor = ancestor->parent){
+        world = ancestor->transform * world;
+    }
+    return world;
+}
+
+int32_t Object::get_mesh(){
+    return mesh;
+}
+
+void Object::set_mesh(int32_t new_mesh){
+    mesh = new_mesh;
+}
@@ -0,0 +1,577 @@
+#include "occlusion.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    const uint32_t CULL_GROUP_SIZE = 64;
+    const uint32_t REDUCE_GROUP_SIZE = 8;
+    const VkFormat PYRAMID_FORMAT = VK_FORMAT_R32G32_SFLOAT;
+
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment){
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+void OcclusionCuller::setup(const Context& context){
+    ctx = context;
+
+    limits = ctx.device_info->limits();
+
+    //texelFetch ignores filtering, the sampler only has to exist
+    VkSamplerCreateInfo sampler_ci{};
+    sampler_ci.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_ci.magFilter = VK_FILTER_NEAREST;
+    sampler_ci.minFilter = VK_FILTER_NEAREST;
+    sampler_ci.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_ci.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_ci.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_ci.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_ci.maxLod = VK_LOD_CLAMP_NONE;
+    if(vkCreateSampler(ctx.device, &sampler_ci, nullptr, &sampler) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create Hi-Z sampler.");
+    }
+
+    createPipelines();
+}
+
+void OcclusionCuller::destroy(){
+    destroyPyramid();
+
+    vkDestroyDescriptorPool(ctx.device, cull_pool, nullptr);
+    ctx.tracker->destroyBuffer(draw_buffer);
+    ctx.tracker->freeMemory(draw_memory);
+    ctx.tracker->destroyBuffer(upload_buffer);
+    ctx.tracker->freeMemory(upload_memory);
+
+    vkDestroyPipeline(ctx.device, cull_pipeline, nullptr);
+    vkDestroyPipelineLayout(ctx.device, cull_pl_layout, nullptr);
+    vkDestroyDescriptorSetLayout(ctx.device, cull_layout, nullptr);
+    vkDestroyPipeline(ctx.device, reduce_ms_pipeline, nullptr);
+    vkDestroyPipeline(ctx.device, reduce_pipeline, nullptr);
+    vkDestroyPipelineLayout(ctx.device, reduce_pl_layout, nullptr);
+    vkDestroyDescriptorSetLayout(ctx.device, reduce_layout, nullptr);
+    vkDestroySampler(ctx.device, sampler, nullptr);
+
+    cull_sets.clear();
+    slot_counts.clear();
+    capacity = 0;
+}
+
+void OcclusionCuller::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, const char* tag,
+    VkBuffer& buffer, VkDeviceMemory& memory){
+    VkBufferCreateInfo bci{};
+    bci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bci.size = size;
+    bci.usage = usage;
+    bci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if(ctx.tracker->createBuffer(bci, buffer, tag) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create occlusion buffer.");
+    }
+
+    VkMemoryRequirements reqs;
+    vkGetBufferMemoryRequirements(ctx.device, buffer, &reqs);
+
+    uint32_t type = ctx.find_memory_type(reqs.memoryTypeBits, properties);
+    if(type == UINT32_MAX){
+        throw std::runtime_error("No memory type for occlusion buffer.");
+    }
+
+    VkMemoryAllocateInfo alloci{};
+    alloci.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloci.allocationSize = reqs.size;
+    alloci.memoryTypeIndex = type;
+    if(ctx.tracker->allocateMemory(alloci, memory, tag) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't allocate occlusion buffer memory.");
+    }
+
+    vkBindBufferMemory(ctx.device, buffer, memory, 0);
+}
+
+void OcclusionCuller::createPipelines(){
+    std::array<VkDescriptorSetLayoutBinding, 2> reduce_bindings{};
+    reduce_bindings[0].binding = 0;
+    reduce_bindings[0].descriptorCount = 1;
+    reduce_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    reduce_bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    reduce_bindings[1].binding = 1;
+    reduce_bindings[1].descriptorCount = 1;
+    reduce_bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    reduce_bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layout_ci{};
+    layout_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_ci.bindingCount = static_cast<uint32_t>(reduce_bindings.size());
+    layout_ci.pBindings = reduce_bindings.data();
+    if(vkCreateDescriptorSetLayout(ctx.device, &layout_ci, nullptr, &reduce_layout) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create Hi-Z descriptor set layout.");
+    }
+
+    //binding 0 is the uniforms, 1 to 3 the objects, counters and commands, 4 the pyramid
+    std::array<VkDescriptorSetLayoutBinding, 5> cull_bindings{};
+    for(uint32_t i = 0; i < cull_bindings.size(); i++){
+        cull_bindings[i].binding = i;
+        cull_bindings[i].descriptorCount = 1;
+        cull_bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        cull_bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    cull_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    cull_bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+    layout_ci.bindingCount = static_cast<uint32_t>(cull_bindings.size());
+    layout_ci.pBindings = cull_bindings.data();
+    if(vkCreateDescriptorSetLayout(ctx.device, &layout_ci, nullptr, &cull_layout) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create culling descriptor set layout.");
+    }
+
+    //both shaders take a single flag: the source is the depth buffer, or this is the late phase
+    VkPushConstantRange push_range{};
+    push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_range.size = sizeof(uint32_t);
+
+    VkPipelineLayoutCreateInfo pl_ci{};
+    pl_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pl_ci.setLayoutCount = 1;
+    pl_ci.pSetLayouts = &reduce_layout;
+    pl_ci.pushConstantRangeCount = 1;
+    pl_ci.pPushConstantRanges = &push_range;
+    if(vkCreatePipelineLayout(ctx.device, &pl_ci, nullptr, &reduce_pl_layout) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create Hi-Z pipeline layout.");
+    }
+
+    pl_ci.pSetLayouts = &cull_layout;
+    if(vkCreatePipelineLayout(ctx.device, &pl_ci, nullptr, &cull_pl_layout) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create culling pipeline layout.");
+    }
+
+    reduce_pipeline = createComputePipeline("shaders/hiz_reduce.spv", reduce_pl_layout);
+    reduce_ms_pipeline = createComputePipeline("shaders/hiz_reduce_ms.spv", reduce_pl_layout);
+    cull_pipeline = createComputePipeline("shaders/cull.spv", cull_pl_layout);
+}
+
+VkPipeline OcclusionCuller::createComputePipeline(const std::string& shader, VkPipelineLayout layout){
+    VkShaderModule comp = ctx.create_shader(shader);
+
+    VkComputePipelineCreateInfo pipeline_ci{};
+    pipeline_ci.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_ci.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_ci.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_ci.stage.module = comp;
+    pipeline_ci.stage.pName = "main";
+    pipeline_ci.layout = layout;
+
+    VkPipeline result_pipeline = VK_NULL_HANDLE;
+    VkResult result = vkCreateComputePipelines(ctx.device, VK_NULL_HANDLE, 1, &pipeline_ci, nullptr, &result_pipeline);
+    vkDestroyShaderModule(ctx.device, comp, nullptr);
+    if(result != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create occlusion pipeline from " + shader + ".");
+    }
+    return result_pipeline;
+}
+
+/*
+    Level 0 is half the depth resolution, rounded down, and each level halves the one before until 1x1.
+    Rounding down is what lets a reduction texel fold in the odd row or column next to it.
+*/
+void OcclusionCuller::createPyramid(VkExtent2D extent){
+    depth_extent = extent;
+
+    VkExtent2D base = {std::max(extent.width / 2, 1u), std::max(extent.height / 2, 1u)};
+    uint32_t levels = 1;
+    while(std::max(base.width, base.height) >> levels){
+        levels++;
+    }
+    level_extents.resize(levels);
+    for(uint32_t level = 0; level < levels; level++){
+        level_extents[level] = {std::max(base.width >> level, 1u), std::max(base.height >> level, 1u)};
+    }
+
+    VkImageCreateInfo ici{};
+    ici.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    ici.imageType = VK_IMAGE_TYPE_2D;
+    ici.extent = {base.width, base.height, 1};
+    ici.mipLevels = levels;
+    ici.arrayLayers = 1;
+    ici.format = PYRAMID_FORMAT;
+    ici.tiling = VK_IMAGE_TILING_OPTIMAL;
+    ici.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    ici.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    ici.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    ici.samples = VK_SAMPLE_COUNT_1_BIT;
+    if(ctx.tracker->createImage(ici, pyramid, "Hi-Z pyramid") != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create Hi-Z pyramid.");
+    }
+
+    VkMemoryRequirements reqs;
+    vkGetImageMemoryRequirements(ctx.device, pyramid, &reqs);
+    uint32_t type = ctx.find_memory_type(reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if(type == UINT32_MAX){
+        throw std::runtime_error("No memory type for the Hi-Z pyramid.");
+    }
+
+    VkMemoryAllocateInfo alloci{};
+    alloci.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloci.allocationSize = reqs.size;
+    alloci.memoryTypeIndex = type;
+    if(ctx.tracker->allocateMemory(alloci, pyramid_memory, "Hi-Z pyramid") != VK_SUCCESS){
+        throw std::runtime_error("Couldn't allocate Hi-Z pyramid memory.");
+    }
+    vkBindImageMemory(ctx.device, pyramid, pyramid_memory, 0);
+
+    VkImageViewCreateInfo vci{};
+    vci.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    vci.image = pyramid;
+    vci.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    vci.format = PYRAMID_FORMAT;
+    vci.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1};
+    if(vkCreateImageView(ctx.device, &vci, nullptr, &pyramid_view) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create Hi-Z pyramid view.");
+    }
+
+    level_views.resize(levels);
+    for(uint32_t level = 0; level < levels; level++){
+        vci.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+        if(vkCreateImageView(ctx.device, &vci, nullptr, &level_views[level]) != VK_SUCCESS){
+            throw std::runtime_error("Couldn't create Hi-Z level view.");
+        }
+    }
+
+    std::array<VkDescriptorPoolSize, 2> pool_sizes{};
+    pool_sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    pool_sizes[0].descriptorCount = levels;
+    pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    pool_sizes[1].descriptorCount = levels;
+
+    VkDescriptorPoolCreateInfo pool_ci{};
+    pool_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_ci.maxSets = levels;
+    pool_ci.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+    pool_ci.pPoolSizes = pool_sizes.data();
+    if(vkCreateDescriptorPool(ctx.device, &pool_ci, nullptr, &reduce_pool) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create Hi-Z descriptor pool.");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(levels, reduce_layout);
+    VkDescriptorSetAllocateInfo set_alloci{};
+    set_alloci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    set_alloci.descriptorPool = reduce_pool;
+    set_alloci.descriptorSetCount = levels;
+    set_alloci.pSetLayouts = layouts.data();
+    reduce_sets.resize(levels);
+    if(vkAllocateDescriptorSets(ctx.device, &set_alloci, reduce_sets.data()) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't allocate Hi-Z descriptor sets.");
+    }
+
+    pyramid_fresh = true;
+    history = false;
+}
+
+void OcclusionCuller::destroyPyramid(){
+    vkDestroyDescriptorPool(ctx.device, reduce_pool, nullptr);
+    for(VkImageView view : level_views){
+        vkDestroyImageView(ctx.device, view, nullptr);
+    }
+    vkDestroyImageView(ctx.device, pyramid_view, nullptr);
+    ctx.tracker->destroyImage(pyramid);
+    ctx.tracker->freeMemory(pyramid_memory);
+
+    reduce_pool = VK_NULL_HANDLE;
+    pyramid_view = VK_NULL_HANDLE;
+    pyramid = VK_NULL_HANDLE;
+    pyramid_memory = VK_NULL_HANDLE;
+    level_views.clear();
+    level_extents.clear();
+    reduce_sets.clear();
+    history = false;
+}
+
+void OcclusionCuller::bindDepth(VkImageView depth, VkExtent2D extent, VkSampleCountFlagBits samples){
+    destroyPyramid();
+    createPyramid(extent);
+    multisampled = samples != VK_SAMPLE_COUNT_1_BIT;
+
+    for(uint32_t level = 0; level < level_views.size(); level++){
+        //level 0 reads the depth buffer, every other level the one before it
+        VkDescriptorImageInfo source{};
+        source.sampler = sampler;
+        source.imageView = level == 0 ? depth : level_views[level - 1];
+        source.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+        VkDescriptorImageInfo destination{};
+        destination.imageView = level_views[level];
+        destination.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        std::array<VkWriteDescriptorSet, 2> writes{};
+        for(uint32_t b = 0; b < writes.size(); b++){
+            writes[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[b].dstSet = reduce_sets[level];
+            writes[b].dstBinding = b;
+            writes[b].descriptorCount = 1;
+        }
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[0].pImageInfo = &source;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[1].pImageInfo = &destination;
+        vkUpdateDescriptorSets(ctx.device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+
+    writeCullSets();
+}
+
+void OcclusionCuller::reserve(uint32_t count){
+    if(count <= capacity){
+        return;
+    }
+
+    if(upload_buffer != VK_NULL_HANDLE){
+        ctx.retire([device = ctx.device, tracker = ctx.tracker, pool = cull_pool, upload = upload_buffer, upload_mem = upload_memory,
+            draws = draw_buffer, draws_mem = draw_memory]{
+            vkDestroyDescriptorPool(device, pool, nullptr);
+            tracker->destroyBuffer(upload);
+            tracker->freeMemory(upload_mem);
+            tracker->destroyBuffer(draws);
+            tracker->freeMemory(draws_mem);
+        });
+    }
+    capacity = count;
+
+    VkDeviceSize alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+    counters_offset = alignUp(sizeof(CullUniforms), alignment);
+    objects_offset = alignUp(counters_offset + sizeof(Counters), alignment);
+    upload_stride = alignUp(objects_offset + sizeof(Object) * capacity, alignment);
+    createBuffer(upload_stride * ctx.frames_in_flight, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "occlusion uploads", upload_buffer, upload_memory);
+    vkMapMemory(ctx.device, upload_memory, 0, upload_stride * ctx.frames_in_flight, 0, reinterpret_cast<void**>(&mupload));
+    memset(mupload, 0, upload_stride * ctx.frames_in_flight);
+
+    draw_stride = alignUp(2 * sizeof(VkDrawIndexedIndirectCommand) * capacity, limits.minStorageBufferOffsetAlignment);
+    createBuffer(draw_stride * ctx.frames_in_flight, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "occlusion draws", draw_buffer, draw_memory);
+
+    std::array<VkDescriptorPoolSize, 3> pool_sizes{};
+    pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    pool_sizes[0].descriptorCount = ctx.frames_in_flight;
+    pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_sizes[1].descriptorCount = 3 * ctx.frames_in_flight;
+    pool_sizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    pool_sizes[2].descriptorCount = ctx.frames_in_flight;
+
+    VkDescriptorPoolCreateInfo pool_ci{};
+    pool_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_ci.maxSets = ctx.frames_in_flight;
+    pool_ci.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+    pool_ci.pPoolSizes = pool_sizes.data();
+    if(vkCreateDescriptorPool(ctx.device, &pool_ci, nullptr, &cull_pool) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create culling descriptor pool.");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(ctx.frames_in_flight, cull_layout);
+    VkDescriptorSetAllocateInfo alloci{};
+    alloci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloci.descriptorPool = cull_pool;
+    alloci.descriptorSetCount = ctx.frames_in_flight;
+    alloci.pSetLayouts = layouts.data();
+    cull_sets.resize(ctx.frames_in_flight);
+    if(vkAllocateDescriptorSets(ctx.device, &alloci, cull_sets.data()) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't allocate culling descriptor sets.");
+    }
+
+    slot_counts.assign(ctx.frames_in_flight, 0);
+    writeCullSets();
+}
+
+void OcclusionCuller::writeCullSets(){
+    if(cull_sets.empty() || pyramid_view == VK_NULL_HANDLE){
+        return;
+    }
+
+    for(uint32_t slot = 0; slot < ctx.frames_in_flight; slot++){
+        std::array<VkDescriptorBufferInfo, 4> buffers{};
+        buffers[0] = {upload_buffer, upload_stride * slot, sizeof(CullUniforms)};
+        buffers[1] = {upload_buffer, upload_stride * slot + objects_offset, sizeof(Object) * capacity};
+        buffers[2] = {upload_buffer, upload_stride * slot + counters_offset, sizeof(Counters)};
+        buffers[3] = {draw_buffer, draw_stride * slot, 2 * sizeof(VkDrawIndexedIndirectCommand) * capacity};
+
+        VkDescriptorImageInfo image{};
+        image.sampler = sampler;
+        image.imageView = pyramid_view;
+        image.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        std::array<VkWriteDescriptorSet, 5> writes{};
+        for(uint32_t b = 0; b < writes.size(); b++){
+            writes[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[b].dstSet = cull_sets[slot];
+            writes[b].dstBinding = b;
+            writes[b].descriptorCount = 1;
+            writes[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            if(b < buffers.size()){
+                writes[b].pBufferInfo = &buffers[b];
+            }
+        }
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        writes[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[4].pImageInfo = &image;
+        vkUpdateDescriptorSets(ctx.device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+}
+
+OcclusionCuller::Object* OcclusionCuller::beginFrame(uint64_t frame, uint32_t count, const glm::mat4& frame_view_proj){
+    if(capacity == 0){
+        return nullptr;
+    }
+    uint32_t slot = static_cast<uint32_t>(frame % ctx.frames_in_flight);
+    char* base = mupload + upload_stride * slot;
+
+    //the slot's previous frame has finished, so its counters are final
+    Counters* counters = reinterpret_cast<Counters*>(base + counters_offset);
+    if(slot_counts[slot] != 0){
+        last_stats.objects = slot_counts[slot];
+        last_stats.early = counters->early;
+        last_stats.late = counters->late;
+        last_stats.frustum_culled = counters->frustum_culled;
+    }
+    *counters = Counters{};
+
+    slot_counts[slot] = std::min(count, capacity);
+    view_proj = frame_view_proj;
+
+    CullUniforms* uniforms = reinterpret_cast<CullUniforms*>(base);
+    uniforms->view_proj = view_proj;
+    uniforms->prev_view_proj = prev_view_proj;
+    uniforms->depth_size = glm::vec2(static_cast<float>(depth_extent.width), static_cast<float>(depth_extent.height));
+    uniforms->object_count = slot_counts[slot];
+    uniforms->levels = static_cast<uint32_t>(level_views.size());
+    uniforms->history = history ? 1 : 0;
+    uniforms->late_base = capacity;
+
+    return reinterpret_cast<Object*>(base + objects_offset);
+}
+
+void OcclusionCuller::memoryBarrier(VkCommandBuffer target, VkPipelineStageFlags2KHR src_stage, VkAccessFlags2KHR src_access,
+    VkPipelineStageFlags2KHR dst_stage, VkAccessFlags2KHR dst_access){
+    VkMemoryBarrier2KHR barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR;
+    barrier.srcStageMask = src_stage;
+    barrier.srcAccessMask = src_access;
+    barrier.dstStageMask = dst_stage;
+    barrier.dstAccessMask = dst_access;
+
+    VkDependencyInfoKHR dependency{};
+    dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+    dependency.memoryBarrierCount = 1;
+    dependency.pMemoryBarriers = &barrier;
+    ctx.pipeline_barrier2(target, &dependency);
+}
+
+void OcclusionCuller::recordEarly(VkCommandBuffer target, uint64_t frame){
+    if(pyramid == VK_NULL_HANDLE){
+        return;
+    }
+
+    if(pyramid_fresh){
+        //a new pyramid goes to GENERAL once and stays there, the reduction writes it and the cull samples it
+        VkImageMemoryBarrier2KHR barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+        barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+        barrier.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT_KHR | VK_ACCESS_2_SHADER_WRITE_BIT_KHR;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = pyramid;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1};
+
+        VkDependencyInfoKHR dependency{};
+        dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+        dependency.imageMemoryBarrierCount = 1;
+        dependency.pImageMemoryBarriers = &barrier;
+        ctx.pipeline_barrier2(target, &dependency);
+        pyramid_fresh = false;
+    } else {
+        //the previous frame's reduction wrote it
+        memoryBarrier(target, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR);
+    }
+
+    if(cull_sets.empty()){
+        return;
+    }
+    uint32_t slot = static_cast<uint32_t>(frame % ctx.frames_in_flight);
+    uint32_t count = slot_counts[slot];
+    if(count == 0){
+        return;
+    }
+
+    uint32_t late = 0;
+    vkCmdBindPipeline(target, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline);
+    vkCmdBindDescriptorSets(target, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pl_layout, 0, 1, &cull_sets[slot], 0, nullptr);
+    vkCmdPushConstants(target, cull_pl_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(late), &late);
+    vkCmdDispatch(target, (count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+    //the early pass draws the commands, the late cull reads which of them were drawn
+    memoryBarrier(target, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR,
+        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT_KHR | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+        VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT_KHR | VK_ACCESS_2_SHADER_READ_BIT_KHR);
+}
+
+void OcclusionCuller::recordLate(VkCommandBuffer target, uint64_t frame){
+    if(pyramid == VK_NULL_HANDLE){
+        return;
+    }
+
+    //the early cull sampled the pyramid that is overwritten now
+    memoryBarrier(target, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, 0,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR);
+
+    for(uint32_t level = 0; level < level_views.size(); level++){
+        uint32_t from_depth = level == 0 ? 1 : 0;
+        if(level <= 1){
+            vkCmdBindPipeline(target, VK_PIPELINE_BIND_POINT_COMPUTE, from_depth && multisampled ? reduce_ms_pipeline : reduce_pipeline);
+        }
+        vkCmdBindDescriptorSets(target, VK_PIPELINE_BIND_POINT_COMPUTE, reduce_pl_layout, 0, 1, &reduce_sets[level], 0, nullptr);
+        vkCmdPushConstants(target, reduce_pl_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(from_depth), &from_depth);
+        vkCmdDispatch(target, (level_extents[level].width + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE,
+            (level_extents[level].height + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, 1);
+
+        memoryBarrier(target, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR);
+    }
+    prev_view_proj = view_proj;
+    history = true;
+
+    uint32_t slot = static_cast<uint32_t>(frame % ctx.frames_in_flight);
+    if(cull_sets.empty() || slot_counts[slot] == 0){
+        return;
+    }
+
+    uint32_t late = 1;
+    vkCmdBindPipeline(target, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline);
+    vkCmdBindDescriptorSets(target, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pl_layout, 0, 1, &cull_sets[slot], 0, nullptr);
+    vkCmdPushConstants(target, cull_pl_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(late), &late);
+    vkCmdDispatch(target, (slot_counts[slot] + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+    //the late pass draws the commands, beginFrame reads the counters once the frame's fence signalled
+    memoryBarrier(target, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR,
+        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT_KHR | VK_PIPELINE_STAGE_2_HOST_BIT_KHR,
+        VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT_KHR | VK_ACCESS_2_HOST_READ_BIT_KHR);
+}
+
+VkBuffer OcclusionCuller::drawBuffer() const {
+    return draw_buffer;
+}
+
+VkDeviceSize OcclusionCuller::drawOffset(uint64_t frame, Phase phase, uint32_t object) const {
+    uint32_t slot = static_cast<uint32_t>(frame % ctx.frames_in_flight);
+    uint32_t index = phase == Phase::Late ? capacity + object : object;
+    return draw_stride * slot + sizeof(VkDrawIndexedIndirectCommand) * index;
+}
+
+const OcclusionCuller::Stats& OcclusionCuller::stats() const {
+    return last_stats;
+}
+
+uint32_t OcclusionCuller::pyramidLevels() const {
+    return static_cast<uint32_t>(level_views.size());
+}
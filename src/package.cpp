@@ -0,0 +1,189 @@
+#include "package.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+    size_t alignSection(size_t offset){
+        return (offset + package::SECTION_ALIGNMENT - 1) & ~(package::SECTION_ALIGNMENT - 1);
+    }
+
+    bool inBounds(uint64_t offset, uint64_t size, size_t file_size){
+        return offset <= file_size && size <= file_size - offset && offset % package::SECTION_ALIGNMENT == 0;
+    }
+
+    //Pads to each section's offset, writes to a temporary file and renames it over path, so a running
+    //hot reload never maps half a package.
+    class PackageWriter{
+    public:
+        explicit PackageWriter(const std::string& path) : target(path), temporary(path + ".tmp"),
+            out(temporary, std::ios::binary | std::ios::trunc) {
+            if(!out){
+                throw std::runtime_error("Couldn't create " + temporary + ".");
+            }
+        }
+
+        size_t reserve(size_t size){
+            size_t offset = alignSection(position);
+            position = offset + size;
+            return offset;
+        }
+
+        void write(size_t offset, const void* data, size_t size){
+            static const char zeros[package::SECTION_ALIGNMENT] = {};
+            out.write(zeros, static_cast<std::streamsize>(offset - written));
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+            written = offset + size;
+        }
+
+        void commit(){
+            out.close();
+            if(!out){
+                throw std::runtime_error("Couldn't write " + temporary + ".");
+            }
+            std::filesystem::rename(temporary, target);
+        }
+
+    private:
+        std::string target;
+        std::string temporary;
+        std::ofstream out;
+        size_t position = 0;
+        size_t written = 0;
+    };
+}
+
+namespace package{
+    bool Vertex::operator==(const Vertex& other) const{
+        return pos == other.pos && color == other.color && tex_coord == other.tex_coord;
+    }
+
+    size_t mipLayout(uint32_t width, uint32_t height, std::vector<size_t>& mip_offsets){
+        uint32_t mip_count = 1;
+        while(std::max(width, height) >> mip_count){
+            mip_count++;
+        }
+
+        mip_offsets.resize(mip_count);
+        size_t total = 0;
+        for(uint32_t mip = 0; mip < mip_count; mip++){
+            mip_offsets[mip] = total;
+            total += size_t(std::max(width >> mip, 1u)) * std::max(height >> mip, 1u) * 4;
+        }
+        return total;
+    }
+
+    const TextureHeader* textureHeader(std::span<const std::byte> bytes){
+        if(bytes.size() < sizeof(TextureHeader)){
+            return nullptr;
+        }
+        const TextureHeader* header = reinterpret_cast<const TextureHeader*>(bytes.data());
+        if(header->magic != TEXTURE_MAGIC || header->version != VERSION || header->width == 0 || header->height == 0){
+            return nullptr;
+        }
+
+        std::vector<size_t> offsets;
+        size_t expected = mipLayout(header->width, header->height, offsets);
+        if(header->mip_count != offsets.size() || header->pixels_size != expected
+            || !inBounds(header->pixels_offset, header->pixels_size, bytes.size())){
+            return nullptr;
+        }
+        return header;
+    }
+
+    void writeMesh(const std::string& path, std::span<const MeshDraw> draws, std::span<const Vertex> vertices,
+        std::span<const uint32_t> indices){
+        PackageWriter writer(path);
+
+        MeshHeader header{};
+        header.magic = MESH_MAGIC;
+        header.version = VERSION;
+        header.vertex_stride = sizeof(Vertex);
+        header.position_offset = offsetof(Vertex, pos);
+        header.color_offset = offsetof(Vertex, color);
+        header.uv_offset = offsetof(Vertex, tex_coord);
+        header.draw_count = static_cast<uint32_t>(draws.size());
+        header.vertex_count = vertices.size();
+        header.index_count = indices.size();
+
+        writer.reserve(sizeof(MeshHeader));
+        header.draws_offset = writer.reserve(draws.size_bytes());
+        header.vertices_offset = writer.reserve(vertices.size_bytes());
+        header.indices_offset = writer.reserve(indices.size_bytes());
+
+        writer.write(0, &header, sizeof(header));
+        writer.write(header.draws_offset, draws.data(), draws.size_bytes());
+        writer.write(header.vertices_offset, vertices.data(), vertices.size_bytes());
+        writer.write(header.indices_offset, indices.data(), indices.size_bytes());
+        writer.commit();
+    }
+
+    void writeTexture(const std::string& path, uint32_t width, uint32_t height, uint32_t mip_count,
+        std::span<const uint8_t> pixels){
+        PackageWriter writer(path);
+
+        TextureHeader header{};
+        header.magic = TEXTURE_MAGIC;
+        header.version = VERSION;
+        header.width = width;
+        header.height = height;
+        header.mip_count = mip_count;
+        header.pixels_size = pixels.size();
+
+        writer.reserve(sizeof(TextureHeader));
+        header.pixels_offset = writer.reserve(pixels.size());
+
+        writer.write(0, &header, sizeof(header));
+        writer.write(header.pixels_offset, pixels.data(), pixels.size());
+        writer.commit();
+    }
+
+    Mesh::Mesh(const std::string& path) : file(path) {
+        data = file.bytes();
+        validate(path);
+    }
+
+    Mesh::Mesh(const std::string& name, std::span<const std::byte> bytes) : data(bytes) {
+        validate(name);
+    }
+
+    void Mesh::validate(const std::string& name){
+        if(data.size() < sizeof(MeshHeader) || reinterpret_cast<uintptr_t>(data.data()) % SECTION_ALIGNMENT != 0){
+            throw std::runtime_error(name + " is not a mesh package.");
+        }
+        head = reinterpret_cast<const MeshHeader*>(data.data());
+        if(head->magic != MESH_MAGIC){
+            throw std::runtime_error(name + " is not a mesh package.");
+        }
+        if(head->version != VERSION){
+            throw std::runtime_error(name + " was cooked by a different version, cook it again.");
+        }
+
+        if(!inBounds(head->draws_offset, uint64_t(head->draw_count) * sizeof(MeshDraw), data.size())
+            || head->vertex_stride == 0 || head->vertex_count > data.size() / head->vertex_stride
+            || !inBounds(head->vertices_offset, head->vertex_count * head->vertex_stride, data.size())
+            || head->index_count > data.size() / sizeof(uint32_t)
+            || !inBounds(head->indices_offset, head->index_count * sizeof(uint32_t), data.size())){
+            throw std::runtime_error(name + " is truncated.");
+        }
+    }
+
+    const MeshHeader& Mesh::header() const {
+        return *head;
+    }
+
+    std::span<const MeshDraw> Mesh::draws() const {
+        return {reinterpret_cast<const MeshDraw*>(data.data() + head->draws_offset), head->draw_count};
+    }
+
+    std::span<const std::byte> Mesh::vertices() const {
+        return data.subspan(head->vertices_offset, head->vertex_count * head->vertex_stride);
+    }
+
+    std::span<const uint32_t> Mesh::indices() const {
+        return {reinterpret_cast<const uint32_t*>(data.data() + head->indices_offset), head->index_count};
+    }
+}
@@ -0,0 +1,234 @@
+#include "pixelformat.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DOMK_PIXEL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define DOMK_TARGET_SSSE3
+#else
+#define DOMK_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+#elif defined(__ARM_NEON)
+#define DOMK_PIXEL_NEON
+#include <arm_neon.h>
+#endif
+
+namespace {
+    /*
+        sRGB <-> linear tables. Linear values are 16-bit fixed point, so the round trip of an
+        opaque pixel is exact and dark values keep their precision after premultiplication.
+    */
+    struct SrgbTables{
+        uint16_t to_linear[256];
+        std::vector<uint8_t> from_linear;
+
+        SrgbTables() : from_linear(65536) {
+            for(int i = 0; i < 256; i++){
+                double c = i / 255.0;
+                double linear = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+                to_linear[i] = static_cast<uint16_t>(std::lround(linear * 65535.0));
+            }
+            for(int i = 0; i < 65536; i++){
+                double linear = i / 65535.0;
+                double c = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+                from_linear[i] = static_cast<uint8_t>(std::lround(c * 255.0));
+            }
+        }
+    };
+
+    const SrgbTables& srgbTables(){
+        static const SrgbTables tables;
+        return tables;
+    }
+
+    inline void premultiplyPixel(uint8_t* pixel, const SrgbTables& tables){
+        uint32_t alpha = pixel[3];
+        if(alpha == 255){
+            return;
+        }
+        for(int c = 0; c < 3; c++){
+            uint32_t linear = (tables.to_linear[pixel[c]] * alpha + 127) / 255;
+            pixel[c] = tables.from_linear[linear];
+        }
+    }
+
+#ifdef DOMK_PIXEL_X86
+    bool hasSsse3(){
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 9)) != 0;
+#else
+        return __builtin_cpu_supports("ssse3");
+#endif
+    }
+
+    //16 pixels (48 bytes in, 64 out) per iteration, pshufb spreads each group of 4 pixels and the alpha is or'ed in.
+    DOMK_TARGET_SSSE3 size_t rgbToRgbaSsse3(const uint8_t* src, uint8_t* dst, size_t pixels){
+        const __m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+
+        size_t i = 0;
+        for(; i + 16 <= pixels; i += 16){
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 16));
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 32));
+
+            __m128i p0 = _mm_shuffle_epi8(a, spread);
+            __m128i p1 = _mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), spread);
+            __m128i p2 = _mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), spread);
+            __m128i p3 = _mm_shuffle_epi8(_mm_srli_si128(c, 4), spread);
+
+            __m128i* out = reinterpret_cast<__m128i*>(dst + i * 4);
+            _mm_storeu_si128(out + 0, _mm_or_si128(p0, alpha));
+            _mm_storeu_si128(out + 1, _mm_or_si128(p1, alpha));
+            _mm_storeu_si128(out + 2, _mm_or_si128(p2, alpha));
+            _mm_storeu_si128(out + 3, _mm_or_si128(p3, alpha));
+        }
+        return i;
+    }
+
+    //Not a vectorised premultiply, the tables are per pixel. SSE2 is part of x86-64, so no dispatch: it tests
+    //4 alphas at once and only groups with a translucent pixel go through premultiplyPixel.
+    size_t premultiplySrgbSse2(uint8_t* rgba, size_t pixels, const SrgbTables& tables){
+        const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+
+        size_t i = 0;
+        for(; i + 4 <= pixels; i += 4){
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + i * 4));
+            __m128i opaque = _mm_cmpeq_epi8(_mm_and_si128(v, alpha), alpha);
+            if(_mm_movemask_epi8(opaque) == 0xFFFF){
+                continue;
+            }
+            for(size_t p = 0; p < 4; p++){
+                premultiplyPixel(rgba + (i + p) * 4, tables);
+            }
+        }
+        return i;
+    }
+#endif
+
+#ifdef DOMK_PIXEL_NEON
+    size_t rgbToRgbaNeon(const uint8_t* src, uint8_t* dst, size_t pixels){
+        size_t i = 0;
+        for(; i + 16 <= pixels; i += 16){
+            uint8x16x3_t rgb = vld3q_u8(src + i * 3);
+            uint8x16x4_t rgba;
+            rgba.val[0] = rgb.val[0];
+            rgba.val[1] = rgb.val[1];
+            rgba.val[2] = rgb.val[2];
+            rgba.val[3] = vdupq_n_u8(255);
+            vst4q_u8(dst + i * 4, rgba);
+        }
+        return i;
+    }
+
+#ifdef __aarch64__
+    //Same as the SSE2 one for 16 pixels, vminvq_u8 needs AArch64.
+    size_t premultiplySrgbNeon(uint8_t* rgba, size_t pixels, const SrgbTables& tables){
+        size_t i = 0;
+        for(; i + 16 <= pixels; i += 16){
+            uint8x16x4_t v = vld4q_u8(rgba + i * 4);
+            if(vminvq_u8(v.val[3]) == 255){
+                continue;
+            }
+            for(size_t p = 0; p < 16; p++){
+                premultiplyPixel(rgba + (i + p) * 4, tables);
+            }
+        }
+        return i;
+    }
+#endif
+#endif
+}
+
+namespace pixelformat{
+    void rgbToRgbaScalar(const uint8_t* src, uint8_t* dst, size_t pixels){
+        for(size_t i = 0; i < pixels; i++){
+            dst[i * 4 + 0] = src[i * 3 + 0];
+            dst[i * 4 + 1] = src[i * 3 + 1];
+            dst[i * 4 + 2] = src[i * 3 + 2];
+            dst[i * 4 + 3] = 255;
+        }
+    }
+
+    void premultiplySrgbScalar(uint8_t* rgba, size_t pixels){
+        const SrgbTables& tables = srgbTables();
+        for(size_t i = 0; i < pixels; i++){
+            premultiplyPixel(rgba + i * 4, tables);
+        }
+    }
+
+    void rgbToRgba(const uint8_t* src, uint8_t* dst, size_t pixels){
+        size_t done = 0;
+#if defined(DOMK_PIXEL_X86)
+        static const bool ssse3 = hasSsse3();
+        if(ssse3){
+            done = rgbToRgbaSsse3(src, dst, pixels);
+        }
+#elif defined(DOMK_PIXEL_NEON)
+        done = rgbToRgbaNeon(src, dst, pixels);
+#endif
+        rgbToRgbaScalar(src + done * 3, dst + done * 4, pixels - done);
+    }
+
+    void premultiplySrgb(uint8_t* rgba, size_t pixels){
+        const SrgbTables& tables = srgbTables();
+        size_t done = 0;
+#if defined(DOMK_PIXEL_X86)
+        done = premultiplySrgbSse2(rgba, pixels, tables);
+#elif defined(DOMK_PIXEL_NEON) && defined(__aarch64__)
+        done = premultiplySrgbNeon(rgba, pixels, tables);
+#endif
+        for(size_t i = done; i < pixels; i++){
+            premultiplyPixel(rgba + i * 4, tables);
+        }
+    }
+
+    void expandToRgba(const uint8_t* src, uint32_t channels, uint8_t* dst, size_t pixels){
+        switch(channels){
+            case 4:
+                memcpy(dst, src, pixels * 4);
+                break;
+            case 3:
+                rgbToRgba(src, dst, pixels);
+                break;
+            case 2:
+                for(size_t i = 0; i < pixels; i++){
+                    dst[i * 4 + 0] = dst[i * 4 + 1] = dst[i * 4 + 2] = src[i * 2];
+                    dst[i * 4 + 3] = src[i * 2 + 1];
+                }
+                break;
+            default:
+                for(size_t i = 0; i < pixels; i++){
+                    dst[i * 4 + 0] = dst[i * 4 + 1] = dst[i * 4 + 2] = src[i];
+                    dst[i * 4 + 3] = 255;
+                }
+                break;
+        }
+    }
+
+    void downsampleRgba(const uint8_t* src, uint32_t src_width, uint32_t src_height, uint8_t* dst){
+        uint32_t dst_width = std::max(src_width >> 1, 1u);
+        uint32_t dst_height = std::max(src_height >> 1, 1u);
+        for(uint32_t y = 0; y < dst_height; y++){
+            uint32_t y0 = std::min(y * 2, src_height - 1);
+            uint32_t y1 = std::min(y * 2 + 1, src_height - 1);
+            for(uint32_t x = 0; x < dst_width; x++){
+                uint32_t x0 = std::min(x * 2, src_width - 1);
+                uint32_t x1 = std::min(x * 2 + 1, src_width - 1);
+                for(uint32_t c = 0; c < 4; c++){
+                    uint32_t sum = src[(y0 * src_width + x0) * 4 + c] + src[(y0 * src_width + x1) * 4 + c]
+                        + src[(y1 * src_width + x0) * 4 + c] + src[(y1 * src_width + x1) * 4 + c];
+                    dst[(y * dst_width + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,625 @@
+#include "rendergraph.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    const VkAccessFlags2KHR WRITE_ACCESS = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR
+        | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR
+        | VK_ACCESS_2_SHADER_WRITE_BIT_KHR
+        | VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR
+        | VK_ACCESS_2_MEMORY_WRITE_BIT_KHR;
+
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment){
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+RenderGraph::Pass::Pass(std::string pass_name) : name(std::move(pass_name)) {}
+
+RenderGraph::Pass& RenderGraph::Pass::writeColor(ResourceId resource, VkAttachmentLoadOp load_op, VkClearValue clear){
+    color.push_back({resource, load_op, VK_ATTACHMENT_STORE_OP_STORE, clear});
+    return *this;
+}
+
+//Depth is almost never needed after the pass that wrote it, so it isn't stored unless compile() finds a later pass using it.
+RenderGraph::Pass& RenderGraph::Pass::writeDepth(ResourceId resource, VkAttachmentLoadOp load_op, VkClearValue clear){
+    depth = Attachment{resource, load_op, VK_ATTACHMENT_STORE_OP_DONT_CARE, clear};
+    return *this;
+}
+
+//Resolves the last color attachment into target at the end of the pass. The multisampled source is then not stored.
+RenderGraph::Pass& RenderGraph::Pass::resolveColor(ResourceId target){
+    color.back().resolve = target;
+    color.back().store_op = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::read(ResourceId resource){
+    sampled.push_back(resource);
+    return *this;
+}
+
+//The pass dispatches compute work, its reads wait for and are visible to the compute stage.
+RenderGraph::Pass& RenderGraph::Pass::compute(){
+    compute_reads = true;
+    return *this;
+}
+
+//Keeps the pass alive even if nothing it writes is read, e.g. readbacks or queries.
+RenderGraph::Pass& RenderGraph::Pass::sideEffects(){
+    side_effects = true;
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::execute(std::function<void(VkCommandBuffer)> callback){
+    record = std::move(callback);
+    return *this;
+}
+
+void RenderGraph::setup(const Context& context){
+    ctx = context;
+}
+
+RenderGraph::ResourceId RenderGraph::importImage(const std::string& name, const ImageDesc& desc, VkImageLayout initial_layout,
+    VkPipelineStageFlags2KHR initial_stage, VkImageLayout final_layout){
+    Resource resource{};
+    resource.name = name;
+    resource.desc = desc;
+    resource.imported = true;
+    resource.initial.layout = initial_layout;
+    resource.initial.stage = initial_stage;
+    resource.final_layout = final_layout;
+    resources.push_back(resource);
+
+    return static_cast<ResourceId>(resources.size() - 1);
+}
+
+RenderGraph::ResourceId RenderGraph::createTransient(const std::string& name, const ImageDesc& desc){
+    Resource resource{};
+    resource.name = name;
+    resource.desc = desc;
+    resources.push_back(resource);
+
+    return static_cast<ResourceId>(resources.size() - 1);
+}
+
+void RenderGraph::bindImported(ResourceId resource, VkImage image, VkImageView view){
+    resources[resource].image = image;
+    resources[resource].view = view;
+}
+
+void RenderGraph::markOutput(ResourceId resource){
+    resources[resource].output = true;
+}
+
+void RenderGraph::addPass(const Pass& pass){
+    passes.push_back(pass);
+}
+
+VkImageAspectFlags RenderGraph::aspectOf(VkFormat format){
+    switch(format){
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        case VK_FORMAT_S8_UINT:
+            return VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+//Layout, stages and accesses a pass needs a resource in. A pass may use a resource at most once.
+RenderGraph::State RenderGraph::stateFor(const Pass& pass, ResourceId resource, bool& used){
+    State state{};
+    used = false;
+
+    for(const Attachment& att : pass.color){
+        if(att.resolve == resource){
+            used = true;
+            state.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            state.stage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR;
+            state.access = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR;
+            state.write = true;
+        }
+        if(att.resource != resource){
+            continue;
+        }
+        used = true;
+        state.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        state.stage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR;
+        state.access = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR;
+        if(att.load_op == VK_ATTACHMENT_LOAD_OP_LOAD){
+            state.access |= VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT_KHR;
+        }
+        state.write = true;
+    }
+
+    if(pass.depth && pass.depth->resource == resource){
+        used = true;
+        state.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        state.stage = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR;
+        state.access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR;
+        state.write = true;
+    }
+
+    for(ResourceId read : pass.sampled){
+        if(read != resource){
+            continue;
+        }
+        used = true;
+        state.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        state.stage = pass.compute_reads ? VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR : VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR;
+        state.access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT_KHR;
+    }
+
+    return state;
+}
+
+/*
+    Walks the passes backwards from the outputs.
+    A pass survives if it writes something that is still needed, it then makes its own inputs needed.
+    Clearing an attachment ends the need for whatever was in it before.
+*/
+void RenderGraph::cullPasses(std::vector<uint32_t>& live) const {
+    std::vector<bool> needed(resources.size(), false);
+    for(size_t i = 0; i < resources.size(); i++){
+        needed[i] = resources[i].output;
+    }
+
+    std::vector<bool> keep(passes.size(), false);
+    for(size_t p = passes.size(); p-- > 0;){
+        const Pass& pass = passes[p];
+
+        bool writes_needed = pass.side_effects;
+        for(const Attachment& att : pass.color){
+            writes_needed = writes_needed || needed[att.resource] || (att.resolve && needed[*att.resolve]);
+        }
+        if(pass.depth){
+            writes_needed = writes_needed || needed[pass.depth->resource];
+        }
+        if(!writes_needed){
+            continue;
+        }
+        keep[p] = true;
+
+        for(const Attachment& att : pass.color){
+            needed[att.resource] = att.load_op == VK_ATTACHMENT_LOAD_OP_LOAD;
+            if(att.resolve){
+                needed[*att.resolve] = false;
+            }
+        }
+        if(pass.depth){
+            needed[pass.depth->resource] = pass.depth->load_op == VK_ATTACHMENT_LOAD_OP_LOAD;
+        }
+        for(ResourceId read : pass.sampled){
+            needed[read] = true;
+        }
+    }
+
+    live.clear();
+    for(uint32_t p = 0; p < passes.size(); p++){
+        if(keep[p]){
+            live.push_back(p);
+        }
+    }
+}
+
+//A depth attachment a later live pass samples or loads has to be stored after all.
+void RenderGraph::storeReadDepth(const std::vector<uint32_t>& live){
+    for(size_t position = 0; position < live.size(); position++){
+        Pass& pass = passes[live[position]];
+        if(!pass.depth){
+            continue;
+        }
+        ResourceId resource = pass.depth->resource;
+        for(size_t later = position + 1; later < live.size(); later++){
+            const Pass& next = passes[live[later]];
+            bool used;
+            stateFor(next, resource, used);
+            if(!used){
+                continue;
+            }
+            bool cleared = next.depth && next.depth->resource == resource && next.depth->load_op != VK_ATTACHMENT_LOAD_OP_LOAD;
+            if(!cleared){
+                pass.depth->store_op = VK_ATTACHMENT_STORE_OP_STORE;
+            }
+            break;
+        }
+    }
+}
+
+void RenderGraph::computeLifetimes(const std::vector<uint32_t>& live){
+    for(uint32_t position = 0; position < live.size(); position++){
+        const Pass& pass = passes[live[position]];
+
+        for(ResourceId r = 0; r < resources.size(); r++){
+            bool used;
+            State state = stateFor(pass, r, used);
+            if(!used){
+                continue;
+            }
+
+            Resource& resource = resources[r];
+            resource.first_use = std::min(resource.first_use, position);
+            resource.last_use = std::max(resource.last_use, position);
+            resource.last_state = state;
+
+            if(state.layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL){
+                resource.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+            } else if(state.layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL){
+                resource.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            } else if(state.layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL){
+                resource.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+            }
+        }
+    }
+}
+
+/*
+    Creates every live transient image and packs them into one allocation.
+    Biggest images are placed first, each at the lowest offset that doesn't collide with
+    an already placed image whose lifetime overlaps its own.
+*/
+void RenderGraph::allocateTransients(){
+    std::vector<ResourceId> transients;
+    std::vector<VkMemoryRequirements> reqs(resources.size());
+    uint32_t type_bits = ~0u;
+    bool lazy = true;
+
+    for(ResourceId r = 0; r < resources.size(); r++){
+        Resource& resource = resources[r];
+        if(resource.imported || resource.first_use == UINT32_MAX){
+            continue;
+        }
+
+        VkImageCreateInfo ici{};
+        ici.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        ici.imageType = VK_IMAGE_TYPE_2D;
+        ici.extent = {resource.desc.extent.width, resource.desc.extent.height, 1};
+        ici.mipLevels = 1;
+        ici.arrayLayers = 1;
+        ici.format = resource.desc.format;
+        ici.tiling = VK_IMAGE_TILING_OPTIMAL;
+        ici.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        ici.usage = resource.usage;
+        if(!(resource.usage & ~(VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT))){
+            //never sampled or stored past its passes, so lazily allocated memory is enough
+            resource.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+            ici.usage = resource.usage;
+        }
+        ici.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        ici.samples = resource.desc.samples;
+
+        if(ctx.tracker->createImage(ici, resource.image, "render graph transient") != VK_SUCCESS){
+            throw std::runtime_error("Couldn't create transient image " + resource.name + ".");
+        }
+
+        vkGetImageMemoryRequirements(ctx.device, resource.image, &reqs[r]);
+        lazy = lazy && (resource.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT);
+        resource.size = reqs[r].size;
+        type_bits &= reqs[r].memoryTypeBits;
+        transients.push_back(r);
+    }
+
+    if(transients.empty()){
+        return;
+    }
+    if(type_bits == 0){
+        throw std::runtime_error("Transient images share no memory type.");
+    }
+
+    std::sort(transients.begin(), transients.end(), [this](ResourceId a, ResourceId b){
+        return resources[a].size > resources[b].size;
+    });
+
+    auto overlaps = [this](const Resource& a, const Resource& b, VkDeviceSize a_offset){
+        bool alive_together = a.first_use <= b.last_use && b.first_use <= a.last_use;
+        bool share_memory = a_offset < b.offset + b.size && b.offset < a_offset + a.size;
+        return alive_together && share_memory;
+    };
+
+    std::vector<ResourceId> placed;
+    transient_size = 0;
+    for(ResourceId t : transients){
+        Resource& resource = resources[t];
+
+        std::vector<VkDeviceSize> candidates = {0};
+        for(ResourceId p : placed){
+            candidates.push_back(alignUp(resources[p].offset + resources[p].size, reqs[t].alignment));
+        }
+        std::sort(candidates.begin(), candidates.end());
+
+        for(VkDeviceSize candidate : candidates){
+            bool collides = false;
+            for(ResourceId p : placed){
+                if(overlaps(resource, resources[p], candidate)){
+                    collides = true;
+                    break;
+                }
+            }
+            if(!collides){
+                resource.offset = candidate;
+                break;
+            }
+        }
+
+        placed.push_back(t);
+        transient_size = std::max(transient_size, resource.offset + resource.size);
+    }
+
+    VkMemoryAllocateInfo alloci{};
+    alloci.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloci.allocationSize = transient_size;
+    alloci.memoryTypeIndex = UINT32_MAX;
+    if(lazy){
+        alloci.memoryTypeIndex = ctx.find_memory_type(type_bits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+    }
+    if(alloci.memoryTypeIndex == UINT32_MAX){
+        alloci.memoryTypeIndex = ctx.find_memory_type(type_bits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+    if(alloci.memoryTypeIndex == UINT32_MAX){
+        throw std::runtime_error("No device local memory type for transient images.");
+    }
+
+    if(ctx.tracker->allocateMemory(alloci, transient_memory, "render graph transients") != VK_SUCCESS){
+        throw std::runtime_error("Couldn't allocate transient attachment memory.");
+    }
+
+    for(ResourceId t : transients){
+        Resource& resource = resources[t];
+
+        if(vkBindImageMemory(ctx.device, resource.image, transient_memory, resource.offset) != VK_SUCCESS){
+            throw std::runtime_error("Couldn't bind transient image " + resource.name + ".");
+        }
+
+        VkImageAspectFlags aspect = aspectOf(resource.desc.format);
+        if(aspect & VK_IMAGE_ASPECT_DEPTH_BIT){
+            aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+        }
+
+        VkImageViewCreateInfo vci{};
+        vci.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        vci.image = resource.image;
+        vci.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        vci.format = resource.desc.format;
+        vci.subresourceRange = {aspect, 0, 1, 0, 1};
+
+        if(vkCreateImageView(ctx.device, &vci, nullptr, &resource.view) != VK_SUCCESS){
+            throw std::runtime_error("Couldn't create transient image view " + resource.name + ".");
+        }
+
+        //the first use has to wait for whatever last touched this memory, in this frame or the previous one
+        resource.initial = State{};
+        for(ResourceId other : transients){
+            const Resource& o = resources[other];
+            bool share_memory = resource.offset < o.offset + o.size && o.offset < resource.offset + resource.size;
+            if(!share_memory){
+                continue;
+            }
+            resource.initial.stage |= o.last_state.stage;
+            if(o.last_state.write){
+                resource.initial.access |= o.last_state.access & WRITE_ACCESS;
+                resource.initial.write = true;
+            }
+        }
+    }
+}
+
+/*
+    Simulates the layout and access state of every resource through the live passes.
+    Reads following reads in the same layout need no barrier, they are merged so the next writer waits on all of them.
+*/
+void RenderGraph::planBarriers(const std::vector<uint32_t>& live){
+    std::vector<State> current(resources.size());
+    for(size_t r = 0; r < resources.size(); r++){
+        current[r] = resources[r].initial;
+    }
+
+    plan.clear();
+    for(uint32_t p : live){
+        PlannedPass planned{};
+        planned.pass = p;
+
+        for(ResourceId r = 0; r < resources.size(); r++){
+            bool used;
+            State next = stateFor(passes[p], r, used);
+            if(!used){
+                continue;
+            }
+
+            State& cur = current[r];
+            if(cur.layout != next.layout || cur.write || next.write){
+                planned.barriers.push_back({r, cur, next});
+                cur = next;
+            } else {
+                cur.stage |= next.stage;
+                cur.access |= next.access;
+            }
+        }
+
+        plan.push_back(planned);
+    }
+
+    final_barriers.clear();
+    for(ResourceId r = 0; r < resources.size(); r++){
+        const Resource& resource = resources[r];
+        if(!resource.imported || resource.final_layout == VK_IMAGE_LAYOUT_UNDEFINED || current[r].layout == resource.final_layout){
+            continue;
+        }
+
+        State present{};
+        present.layout = resource.final_layout;
+        final_barriers.push_back({r, current[r], present});
+    }
+}
+
+void RenderGraph::compile(){
+    std::vector<uint32_t> live;
+    cullPasses(live);
+    storeReadDepth(live);
+    computeLifetimes(live);
+    allocateTransients();
+    planBarriers(live);
+
+    size_t most_barriers = final_barriers.size();
+    size_t most_attachments = 0;
+    for(const PlannedPass& planned : plan){
+        most_barriers = std::max(most_barriers, planned.barriers.size());
+        most_attachments = std::max(most_attachments, passes[planned.pass].color.size() + 1);
+    }
+    barrier_scratch.reserve(most_barriers);
+    attachment_scratch.reserve(most_attachments);
+}
+
+void RenderGraph::emitBarriers(VkCommandBuffer buffer, const std::vector<Barrier>& barriers){
+    if(barriers.empty()){
+        return;
+    }
+
+    barrier_scratch.clear();
+    for(const Barrier& b : barriers){
+        const Resource& resource = resources[b.resource];
+
+        VkImageMemoryBarrier2KHR barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+        barrier.srcStageMask = b.src.stage;
+        barrier.srcAccessMask = b.src.write ? (b.src.access & WRITE_ACCESS) : 0;
+        barrier.dstStageMask = b.dst.stage;
+        barrier.dstAccessMask = b.dst.access;
+        barrier.oldLayout = b.src.layout;
+        barrier.newLayout = b.dst.layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = resource.image;
+        barrier.subresourceRange = {aspectOf(resource.desc.format), 0, 1, 0, 1};
+        barrier_scratch.push_back(barrier);
+    }
+
+    VkDependencyInfoKHR dependency{};
+    dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+    dependency.imageMemoryBarrierCount = static_cast<uint32_t>(barrier_scratch.size());
+    dependency.pImageMemoryBarriers = barrier_scratch.data();
+    ctx.pipeline_barrier2(buffer, &dependency);
+}
+
+void RenderGraph::beginRendering(VkCommandBuffer buffer, const Pass& pass){
+    attachment_scratch.clear();
+    VkExtent2D extent{};
+
+    auto push = [&](const Attachment& att, VkImageLayout layout){
+        const Resource& resource = resources[att.resource];
+
+        VkRenderingAttachmentInfoKHR info{};
+        info.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        info.imageView = resource.view;
+        info.imageLayout = layout;
+        info.loadOp = att.load_op;
+        info.storeOp = att.store_op;
+        info.clearValue = att.clear;
+        if(att.resolve){
+            info.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT_KHR;
+            info.resolveImageView = resources[*att.resolve].view;
+            info.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        }
+        attachment_scratch.push_back(info);
+
+        extent = resource.desc.extent;
+    };
+
+    for(const Attachment& att : pass.color){
+        push(att, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    }
+    if(pass.depth){
+        push(*pass.depth, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    }
+
+    VkRenderingInfoKHR rendering_i{};
+    rendering_i.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    rendering_i.renderArea.offset = {0, 0};
+    rendering_i.renderArea.extent = extent;
+    rendering_i.layerCount = 1;
+    rendering_i.colorAttachmentCount = static_cast<uint32_t>(pass.color.size());
+    rendering_i.pColorAttachments = attachment_scratch.data();
+    rendering_i.pDepthAttachment = pass.depth ? &attachment_scratch.back() : nullptr;
+
+    ctx.begin_rendering(buffer, &rendering_i);
+}
+
+void RenderGraph::execute(VkCommandBuffer buffer){
+    for(const PlannedPass& planned : plan){
+        emitBarriers(buffer, planned.barriers);
+
+        const Pass& pass = passes[planned.pass];
+        bool renders = !pass.color.empty() || pass.depth;
+
+        if(renders){
+            beginRendering(buffer, pass);
+        }
+        if(pass.record){
+            pass.record(buffer);
+        }
+        if(renders){
+            ctx.end_rendering(buffer);
+        }
+    }
+
+    emitBarriers(buffer, final_barriers);
+}
+
+//Destroys the transients and forgets every pass, the graph can then be rebuilt (e.g. on swapchain resize).
+void RenderGraph::reset(){
+    for(Resource& resource : resources){
+        if(resource.imported){
+            continue;
+        }
+        if(resource.view != VK_NULL_HANDLE){
+            vkDestroyImageView(ctx.device, resource.view, nullptr);
+        }
+        if(resource.image != VK_NULL_HANDLE){
+            ctx.tracker->destroyImage(resource.image);
+        }
+    }
+    if(transient_memory != VK_NULL_HANDLE){
+        ctx.tracker->freeMemory(transient_memory);
+        transient_memory = VK_NULL_HANDLE;
+    }
+
+    transient_size = 0;
+    resources.clear();
+    passes.clear();
+    plan.clear();
+    final_barriers.clear();
+}
+
+VkImageView RenderGraph::view(ResourceId resource) const {
+    return resources[resource].view;
+}
+
+size_t RenderGraph::passCount() const {
+    return passes.size();
+}
+
+size_t RenderGraph::culledPassCount() const {
+    return passes.size() - plan.size();
+}
+
+VkDeviceSize RenderGraph::transientMemorySize() const {
+    return transient_size;
+}
+
+//What the transients would take without aliasing.
+VkDeviceSize RenderGraph::transientRequestedSize() const {
+    VkDeviceSize total = 0;
+    for(const Resource& resource : resources){
+        if(!resource.imported){
+            total += resource.size;
+        }
+    }
+    return total;
+}
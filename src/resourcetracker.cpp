@@ -0,0 +1,118 @@
+#include "resourcetracker.hpp"
+
+void ResourceTracker::setup(const Context& context){
+    ctx = context;
+}
+
+VkResult ResourceTracker::createBuffer(const VkBufferCreateInfo& info, VkBuffer& buffer, const char* tag, std::source_location where){
+    VkResult result = vkCreateBuffer(ctx.device, &info, nullptr, &buffer);
+    if(result == VK_SUCCESS){
+        add(BUFFER, key(buffer), {tag, info.size, UINT32_MAX, where});
+    }
+    return result;
+}
+
+VkResult ResourceTracker::createImage(const VkImageCreateInfo& info, VkImage& image, const char* tag, std::source_location where){
+    VkResult result = vkCreateImage(ctx.device, &info, nullptr, &image);
+    if(result == VK_SUCCESS){
+        VkMemoryRequirements reqs;
+        vkGetImageMemoryRequirements(ctx.device, image, &reqs);
+        add(IMAGE, key(image), {tag, reqs.size, UINT32_MAX, where});
+    }
+    return result;
+}
+
+VkResult ResourceTracker::allocateMemory(const VkMemoryAllocateInfo& info, VkDeviceMemory& memory, const char* tag,
+    std::source_location where){
+    VkResult result = vkAllocateMemory(ctx.device, &info, nullptr, &memory);
+    if(result == VK_SUCCESS){
+        uint32_t heap = ctx.device_info->memory().memoryTypes[info.memoryTypeIndex].heapIndex;
+        add(MEMORY, key(memory), {tag, info.allocationSize, heap, where});
+    }
+    return result;
+}
+
+void ResourceTracker::destroyBuffer(VkBuffer buffer){
+    if(buffer != VK_NULL_HANDLE){
+        remove(BUFFER, key(buffer));
+        vkDestroyBuffer(ctx.device, buffer, nullptr);
+    }
+}
+
+void ResourceTracker::destroyImage(VkImage image){
+    if(image != VK_NULL_HANDLE){
+        remove(IMAGE, key(image));
+        vkDestroyImage(ctx.device, image, nullptr);
+    }
+}
+
+void ResourceTracker::freeMemory(VkDeviceMemory memory){
+    if(memory != VK_NULL_HANDLE){
+        remove(MEMORY, key(memory));
+        vkFreeMemory(ctx.device, memory, nullptr);
+    }
+}
+
+uint32_t ResourceTracker::heapUsage(std::array<HeapUsage, VK_MAX_MEMORY_HEAPS>& heaps) const {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT heap_budget{};
+    heap_budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    if(ctx.memory_budget){
+        VkPhysicalDeviceMemoryProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        properties.pNext = &heap_budget;
+        vkGetPhysicalDeviceMemoryProperties2(ctx.device_info->physicalDevice(), &properties);
+    }
+
+    const VkPhysicalDeviceMemoryProperties& memory = ctx.device_info->memory();
+    std::lock_guard<std::mutex> lock(mutex);
+    for(uint32_t heap = 0; heap < memory.memoryHeapCount; heap++){
+        HeapUsage& usage = heaps[heap];
+        usage.flags = memory.memoryHeaps[heap].flags;
+        usage.size = memory.memoryHeaps[heap].size;
+        usage.tracked = heap_bytes[heap];
+        usage.allocations = heap_allocations[heap];
+        usage.usage = ctx.memory_budget ? heap_budget.heapUsage[heap] : 0;
+        usage.budget = ctx.memory_budget ? heap_budget.heapBudget[heap] : usage.size;
+    }
+    return memory.memoryHeapCount;
+}
+
+size_t ResourceTracker::reportLeaks(std::ostream& out) const {
+    static const char* const KIND_NAMES[KIND_COUNT] = {"buffer", "image", "memory"};
+
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t count = 0;
+    for(uint32_t kind = 0; kind < KIND_COUNT; kind++){
+        for(const auto& [handle, entry] : live[kind]){
+            out << "Leaked " << KIND_NAMES[kind] << " \"" << entry.tag << "\", " << entry.size << " bytes";
+            if(entry.heap != UINT32_MAX){
+                out << " on heap " << entry.heap;
+            }
+            out << ", created at " << entry.where.file_name() << ":" << entry.where.line() << std::endl;
+            count++;
+        }
+    }
+    return count;
+}
+
+void ResourceTracker::add(Kind kind, uint64_t handle, const Entry& entry){
+    std::lock_guard<std::mutex> lock(mutex);
+    live[kind].insert_or_assign(handle, entry);
+    if(entry.heap != UINT32_MAX){
+        heap_bytes[entry.heap] += entry.size;
+        heap_allocations[entry.heap]++;
+    }
+}
+
+void ResourceTracker::remove(Kind kind, uint64_t handle){
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = live[kind].find(handle);
+    if(it == live[kind].end()){
+        return;
+    }
+    if(it->second.heap != UINT32_MAX){
+        heap_bytes[it->second.heap] -= it->second.size;
+        heap_allocations[it->second.heap]--;
+    }
+    live[kind].erase(it);
+}
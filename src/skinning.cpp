@@ -0,0 +1,361 @@
+#include "skinning.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    const uint32_t SKIN_GROUP_SIZE = 64;
+}
+
+void SkinningSystem::setup(const Context& context, SkinnedModel skinned_model, uint32_t max_characters){
+    ctx = context;
+    skinned = std::move(skinned_model);
+    //characters are the y dimension of the dispatch, which is guaranteed up to 65535
+    capacity = std::min<uint32_t>(max_characters, 65535);
+    instances.reserve(capacity);
+
+    VkMemoryPropertyFlags host = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    VkDeviceSize source_size = sizeof(SkinnedVertex) * skinned.vertices.size();
+    createBuffer(source_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host, false, "skinning source", source_buffer, source_memory);
+    void* data;
+    vkMapMemory(ctx.device, source_memory, 0, source_size, 0, &data);
+    memcpy(data, skinned.vertices.data(), source_size);
+    vkUnmapMemory(ctx.device, source_memory);
+
+    VkDeviceSize index_size = sizeof(uint32_t) * skinned.indices.size();
+    createBuffer(index_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, host, true, "skinning indices", index_buffer, index_memory);
+    vkMapMemory(ctx.device, index_memory, 0, index_size, 0, &data);
+    memcpy(data, skinned.indices.data(), index_size);
+    vkUnmapMemory(ctx.device, index_memory);
+
+    const VkPhysicalDeviceLimits& limits = ctx.device_info->limits();
+    VkDeviceSize alignment = limits.minStorageBufferOffsetAlignment;
+    palette_stride = sizeof(glm::mat4) * skinned.skeleton.jointCount() * capacity;
+    palette_stride = (palette_stride + alignment - 1) / alignment * alignment;
+
+    createBuffer(palette_stride * ctx.frames_in_flight, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host, false,
+        "skinning palettes", palette_buffer, palette_memory);
+    vkMapMemory(ctx.device, palette_memory, 0, palette_stride * ctx.frames_in_flight, 0, reinterpret_cast<void**>(&mpalettes));
+
+    VkDeviceSize output_size = VkDeviceSize(ctx.vertex_stride) * sizeof(float) * skinned.vertices.size() * capacity;
+    output_buffers.resize(ctx.frames_in_flight);
+    output_memory.resize(ctx.frames_in_flight);
+    for(uint32_t i = 0; i < ctx.frames_in_flight; i++){
+        createBuffer(output_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, "skinned vertices", output_buffers[i], output_memory[i]);
+    }
+
+    createPipeline();
+
+    uint32_t valid_bits = ctx.device_info->queueFamilies()[ctx.compute_family].timestampValidBits;
+    if(valid_bits != 0){
+        timestamp_period = limits.timestampPeriod;
+        timestamp_mask = valid_bits >= 64 ? UINT64_MAX : (uint64_t(1) << valid_bits) - 1;
+
+        VkQueryPoolCreateInfo query_ci{};
+        query_ci.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        query_ci.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        query_ci.queryCount = 2 * ctx.frames_in_flight;
+        if(vkCreateQueryPool(ctx.device, &query_ci, nullptr, &queries) != VK_SUCCESS){
+            throw std::runtime_error("Couldn't create skinning timestamp queries.");
+        }
+        queries_written.assign(ctx.frames_in_flight, false);
+    }
+}
+
+void SkinningSystem::destroy(){
+    vkDestroyQueryPool(ctx.device, queries, nullptr);
+    vkDestroyPipeline(ctx.device, pipeline, nullptr);
+    vkDestroyPipelineLayout(ctx.device, pipeline_layout, nullptr);
+    vkDestroyDescriptorPool(ctx.device, pool, nullptr);
+    vkDestroyDescriptorSetLayout(ctx.device, set_layout, nullptr);
+
+    for(size_t i = 0; i < output_buffers.size(); i++){
+        ctx.tracker->destroyBuffer(output_buffers[i]);
+        ctx.tracker->freeMemory(output_memory[i]);
+    }
+    ctx.tracker->destroyBuffer(palette_buffer);
+    ctx.tracker->freeMemory(palette_memory);
+    ctx.tracker->destroyBuffer(index_buffer);
+    ctx.tracker->freeMemory(index_memory);
+    ctx.tracker->destroyBuffer(source_buffer);
+    ctx.tracker->freeMemory(source_memory);
+
+    output_buffers.clear();
+    output_memory.clear();
+    sets.clear();
+    instances.clear();
+}
+
+void SkinningSystem::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+    bool shared, const char* tag, VkBuffer& buffer, VkDeviceMemory& memory){
+    VkBufferCreateInfo bci{};
+    bci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bci.size = size;
+    bci.usage = usage;
+    if(shared && ctx.queue_families.size() > 1){
+        bci.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bci.queueFamilyIndexCount = static_cast<uint32_t>(ctx.queue_families.size());
+        bci.pQueueFamilyIndices = ctx.queue_families.data();
+    } else {
+        bci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+    if(ctx.tracker->createBuffer(bci, buffer, tag) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create skinning buffer.");
+    }
+
+    VkMemoryRequirements reqs;
+    vkGetBufferMemoryRequirements(ctx.device, buffer, &reqs);
+
+    uint32_t type = ctx.find_memory_type(reqs.memoryTypeBits, properties);
+    if(type == UINT32_MAX){
+        throw std::runtime_error("No memory type for skinning buffer.");
+    }
+
+    VkMemoryAllocateInfo alloci{};
+    alloci.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloci.allocationSize = reqs.size;
+    alloci.memoryTypeIndex = type;
+    if(ctx.tracker->allocateMemory(alloci, memory, tag) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't allocate skinning buffer memory.");
+    }
+
+    vkBindBufferMemory(ctx.device, buffer, memory, 0);
+}
+
+void SkinningSystem::createPipeline(){
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+    for(uint32_t i = 0; i < bindings.size(); i++){
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_ci{};
+    layout_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_ci.bindingCount = static_cast<uint32_t>(bindings.size());
+    layout_ci.pBindings = bindings.data();
+    if(vkCreateDescriptorSetLayout(ctx.device, &layout_ci, nullptr, &set_layout) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create skinning descriptor set layout.");
+    }
+
+    VkDescriptorPoolSize pool_size{};
+    pool_size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_size.descriptorCount = static_cast<uint32_t>(bindings.size()) * ctx.frames_in_flight;
+
+    VkDescriptorPoolCreateInfo pool_ci{};
+    pool_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_ci.maxSets = ctx.frames_in_flight;
+    pool_ci.poolSizeCount = 1;
+    pool_ci.pPoolSizes = &pool_size;
+    if(vkCreateDescriptorPool(ctx.device, &pool_ci, nullptr, &pool) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create skinning descriptor pool.");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(ctx.frames_in_flight, set_layout);
+    VkDescriptorSetAllocateInfo alloci{};
+    alloci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloci.descriptorPool = pool;
+    alloci.descriptorSetCount = ctx.frames_in_flight;
+    alloci.pSetLayouts = layouts.data();
+    sets.resize(ctx.frames_in_flight);
+    if(vkAllocateDescriptorSets(ctx.device, &alloci, sets.data()) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't allocate skinning descriptor sets.");
+    }
+
+    for(uint32_t i = 0; i < ctx.frames_in_flight; i++){
+        std::array<VkDescriptorBufferInfo, 3> infos{};
+        infos[0].buffer = source_buffer;
+        infos[0].range = VK_WHOLE_SIZE;
+        infos[1].buffer = palette_buffer;
+        infos[1].offset = palette_stride * i;
+        infos[1].range = palette_stride;
+        infos[2].buffer = output_buffers[i];
+        infos[2].range = VK_WHOLE_SIZE;
+
+        std::array<VkWriteDescriptorSet, 3> writes{};
+        for(uint32_t b = 0; b < writes.size(); b++){
+            writes[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[b].dstSet = sets[i];
+            writes[b].dstBinding = b;
+            writes[b].descriptorCount = 1;
+            writes[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[b].pBufferInfo = &infos[b];
+        }
+        vkUpdateDescriptorSets(ctx.device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+
+    VkPushConstantRange push_range{};
+    push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_range.size = sizeof(SkinParams);
+
+    VkPipelineLayoutCreateInfo pl_ci{};
+    pl_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pl_ci.setLayoutCount = 1;
+    pl_ci.pSetLayouts = &set_layout;
+    pl_ci.pushConstantRangeCount = 1;
+    pl_ci.pPushConstantRanges = &push_range;
+    if(vkCreatePipelineLayout(ctx.device, &pl_ci, nullptr, &pipeline_layout) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create skinning pipeline layout.");
+    }
+
+    //the output layout comes from the C++ Vertex struct, so the shader doesn't hardcode its padding
+    std::array<uint32_t, 4> layout_constants = {ctx.vertex_stride, ctx.position_offset, ctx.color_offset, ctx.uv_offset};
+    std::array<VkSpecializationMapEntry, 4> entries{};
+    for(uint32_t i = 0; i < entries.size(); i++){
+        entries[i].constantID = i;
+        entries[i].offset = i * sizeof(uint32_t);
+        entries[i].size = sizeof(uint32_t);
+    }
+
+    VkSpecializationInfo specialization{};
+    specialization.mapEntryCount = static_cast<uint32_t>(entries.size());
+    specialization.pMapEntries = entries.data();
+    specialization.dataSize = sizeof(layout_constants);
+    specialization.pData = layout_constants.data();
+
+    VkShaderModule comp = ctx.create_shader("shaders/skinning.spv");
+
+    VkComputePipelineCreateInfo pipeline_ci{};
+    pipeline_ci.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_ci.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_ci.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_ci.stage.module = comp;
+    pipeline_ci.stage.pName = "main";
+    pipeline_ci.stage.pSpecializationInfo = &specialization;
+    pipeline_ci.layout = pipeline_layout;
+
+    VkResult result = vkCreateComputePipelines(ctx.device, VK_NULL_HANDLE, 1, &pipeline_ci, nullptr, &pipeline);
+    vkDestroyShaderModule(ctx.device, comp, nullptr);
+    if(result != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create skinning pipeline.");
+    }
+}
+
+uint32_t SkinningSystem::addCharacter(const glm::mat4& transform, uint32_t clip_a, uint32_t clip_b, float blend, float time_offset){
+    if(instances.size() >= capacity){
+        throw std::runtime_error("Out of skinned character slots.");
+    }
+
+    uint32_t clip_count = static_cast<uint32_t>(skinned.clips.size());
+    Character character{};
+    character.transform = transform;
+    character.clip_a = clip_count != 0 ? clip_a % clip_count : 0;
+    character.clip_b = clip_count != 0 ? clip_b % clip_count : 0;
+    character.blend = std::clamp(blend, 0.0f, 1.0f);
+    character.time = time_offset;
+    character.speed = 1.0f;
+    instances.push_back(character);
+    return static_cast<uint32_t>(instances.size() - 1);
+}
+
+void SkinningSystem::animate(uint64_t frame, float dt){
+    uint32_t slot = static_cast<uint32_t>(frame % ctx.frames_in_flight);
+
+    //the slot's previous dispatch has finished, so its timestamps are available
+    if(queries != VK_NULL_HANDLE && queries_written[slot]){
+        uint64_t ticks[2];
+        if(vkGetQueryPoolResults(ctx.device, queries, slot * 2, 2, sizeof(ticks), ticks, sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT) == VK_SUCCESS){
+            double ms = double((ticks[1] & timestamp_mask) - (ticks[0] & timestamp_mask)) * timestamp_period / 1e6;
+            skin_ms += (ms - skin_ms) * 0.05;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    const Skeleton& skeleton = skinned.skeleton;
+    size_t joint_count = skeleton.jointCount();
+    glm::mat4* palettes = reinterpret_cast<glm::mat4*>(mpalettes + palette_stride * slot);
+
+    ctx.jobs->parallelFor(static_cast<uint32_t>(instances.size()), [&](uint32_t index){
+        //scratch per worker, so the hot loop doesn't allocate
+        thread_local std::vector<JointPose> pose_a;
+        thread_local std::vector<JointPose> pose_b;
+        thread_local std::vector<glm::mat4> model_space;
+        pose_a.resize(joint_count);
+        pose_b.resize(joint_count);
+        model_space.resize(joint_count);
+
+        Character& character = instances[index];
+        character.time += dt * character.speed;
+
+        if(skinned.clips.empty()){
+            std::copy(skeleton.rest_pose.begin(), skeleton.rest_pose.end(), pose_a.begin());
+        } else {
+            animation::samplePose(skeleton, skinned.clips[character.clip_a], character.time, pose_a.data());
+            if(character.blend > 0.0f && character.clip_b != character.clip_a){
+                animation::samplePose(skeleton, skinned.clips[character.clip_b], character.time, pose_b.data());
+                animation::blendPoses(pose_a.data(), pose_b.data(), character.blend, joint_count, pose_a.data());
+            }
+        }
+
+        animation::buildPalette(skeleton, pose_a.data(), model_space.data(), palettes + size_t(index) * joint_count);
+    });
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    animate_ms += (ms - animate_ms) * 0.05;
+}
+
+void SkinningSystem::record(VkCommandBuffer target, uint64_t frame){
+    if(instances.empty()){
+        return;
+    }
+    uint32_t slot = static_cast<uint32_t>(frame % ctx.frames_in_flight);
+
+    if(queries != VK_NULL_HANDLE){
+        vkCmdResetQueryPool(target, queries, slot * 2, 2);
+        vkCmdWriteTimestamp(target, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queries, slot * 2);
+        queries_written[slot] = true;
+    }
+
+    SkinParams params{};
+    params.vertex_count = vertexCount();
+    params.joint_count = static_cast<uint32_t>(skinned.skeleton.jointCount());
+
+    vkCmdBindPipeline(target, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(target, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &sets[slot], 0, nullptr);
+    vkCmdPushConstants(target, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+    vkCmdDispatch(target, (params.vertex_count + SKIN_GROUP_SIZE - 1) / SKIN_GROUP_SIZE, static_cast<uint32_t>(instances.size()), 1);
+
+    if(queries != VK_NULL_HANDLE){
+        vkCmdWriteTimestamp(target, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queries, slot * 2 + 1);
+    }
+}
+
+VkBuffer SkinningSystem::outputBuffer(uint64_t frame) const {
+    return output_buffers[frame % ctx.frames_in_flight];
+}
+
+VkBuffer SkinningSystem::indexBuffer() const {
+    return index_buffer;
+}
+
+uint32_t SkinningSystem::indexCount() const {
+    return static_cast<uint32_t>(skinned.indices.size());
+}
+
+uint32_t SkinningSystem::vertexCount() const {
+    return static_cast<uint32_t>(skinned.vertices.size());
+}
+
+const std::vector<SkinningSystem::Character>& SkinningSystem::characters() const {
+    return instances;
+}
+
+const SkinnedModel& SkinningSystem::model() const {
+    return skinned;
+}
+
+double SkinningSystem::animateMs() const {
+    return animate_ms;
+}
+
+double SkinningSystem::skinMs() const {
+    return skin_ms;
+}
@@ -0,0 +1,460 @@
+#include "softocclusion.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DOMK_RASTER_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define DOMK_TARGET_AVX2
+#else
+#define DOMK_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+    //boxes handed to one test job
+    const uint32_t TEST_CHUNK = 256;
+
+    static_assert(SoftwareOcclusion::WIDTH % SoftwareOcclusion::TILE_SIZE == 0
+        && SoftwareOcclusion::HEIGHT % SoftwareOcclusion::TILE_SIZE == 0, "The buffer is made of whole tiles.");
+    //the SIMD kernels round a span out to 8 pixels, which must not leave the tile
+    static_assert(SoftwareOcclusion::TILE_SIZE % 8 == 0, "Tiles are a multiple of the AVX2 width.");
+
+    double elapsedMs(std::chrono::steady_clock::time_point start){
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    //Kept as the reference and for benchmarking the SIMD kernels against.
+    void fillScalar(const SoftwareOcclusion::ScreenTriangle& tri, int32_t x0, int32_t x1, int32_t y0, int32_t y1, float* depth){
+        for(int32_t y = y0; y < y1; y++){
+            float cy = y + 0.5f;
+            float r0 = tri.edge_b[0] * cy + tri.edge_c[0];
+            float r1 = tri.edge_b[1] * cy + tri.edge_c[1];
+            float r2 = tri.edge_b[2] * cy + tri.edge_c[2];
+            float rz = tri.depth_b * cy + tri.depth_c;
+            float* row = depth + size_t(y) * SoftwareOcclusion::WIDTH;
+
+            for(int32_t x = x0; x < x1; x++){
+                float cx = x + 0.5f;
+                if(tri.edge_a[0] * cx + r0 >= 0.0f && tri.edge_a[1] * cx + r1 >= 0.0f && tri.edge_a[2] * cx + r2 >= 0.0f){
+                    row[x] = std::min(row[x], tri.depth_a * cx + rz);
+                }
+            }
+        }
+    }
+
+#ifdef DOMK_RASTER_X86
+    bool hasAvx2(){
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        if(info[0] < 7){
+            return false;
+        }
+        __cpuid(info, 1);
+        //the OS has to save the ymm registers too
+        if((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6){
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    //SSE2 is part of x86-64, so no dispatch: 4 pixels per step, the ones outside any edge keep their depth.
+    void fillSse2(const SoftwareOcclusion::ScreenTriangle& tri, int32_t x0, int32_t x1, int32_t y0, int32_t y1, float* depth){
+        x0 &= ~3;
+        x1 = (x1 + 3) & ~3;
+        const __m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 a0 = _mm_set1_ps(tri.edge_a[0]);
+        const __m128 a1 = _mm_set1_ps(tri.edge_a[1]);
+        const __m128 a2 = _mm_set1_ps(tri.edge_a[2]);
+        const __m128 az = _mm_set1_ps(tri.depth_a);
+
+        for(int32_t y = y0; y < y1; y++){
+            float cy = y + 0.5f;
+            __m128 r0 = _mm_set1_ps(tri.edge_b[0] * cy + tri.edge_c[0]);
+            __m128 r1 = _mm_set1_ps(tri.edge_b[1] * cy + tri.edge_c[1]);
+            __m128 r2 = _mm_set1_ps(tri.edge_b[2] * cy + tri.edge_c[2]);
+            __m128 rz = _mm_set1_ps(tri.depth_b * cy + tri.depth_c);
+            float* row = depth + size_t(y) * SoftwareOcclusion::WIDTH;
+
+            for(int32_t x = x0; x < x1; x += 4){
+                __m128 cx = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lane);
+                __m128 inside = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, cx), r0), zero),
+                    _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, cx), r1), zero),
+                        _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, cx), r2), zero)));
+                if(_mm_movemask_ps(inside) == 0){
+                    continue;
+                }
+                __m128 current = _mm_loadu_ps(row + x);
+                __m128 nearer = _mm_min_ps(current, _mm_add_ps(_mm_mul_ps(az, cx), rz));
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+            }
+        }
+    }
+
+    //8 pixels per step, the same arithmetic as the scalar kernel so both fill the same pixels.
+    DOMK_TARGET_AVX2 void fillAvx2(const SoftwareOcclusion::ScreenTriangle& tri, int32_t x0, int32_t x1, int32_t y0, int32_t y1, float* depth){
+        x0 &= ~7;
+        x1 = (x1 + 7) & ~7;
+        const __m256 lane = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 a0 = _mm256_set1_ps(tri.edge_a[0]);
+        const __m256 a1 = _mm256_set1_ps(tri.edge_a[1]);
+        const __m256 a2 = _mm256_set1_ps(tri.edge_a[2]);
+        const __m256 az = _mm256_set1_ps(tri.depth_a);
+
+        for(int32_t y = y0; y < y1; y++){
+            float cy = y + 0.5f;
+            __m256 r0 = _mm256_set1_ps(tri.edge_b[0] * cy + tri.edge_c[0]);
+            __m256 r1 = _mm256_set1_ps(tri.edge_b[1] * cy + tri.edge_c[1]);
+            __m256 r2 = _mm256_set1_ps(tri.edge_b[2] * cy + tri.edge_c[2]);
+            __m256 rz = _mm256_set1_ps(tri.depth_b * cy + tri.depth_c);
+            float* row = depth + size_t(y) * SoftwareOcclusion::WIDTH;
+
+            for(int32_t x = x0; x < x1; x += 8){
+                __m256 cx = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), lane);
+                __m256 inside = _mm256_and_ps(_mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(a0, cx), r0), zero, _CMP_GE_OQ),
+                    _mm256_and_ps(_mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(a1, cx), r1), zero, _CMP_GE_OQ),
+                        _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(a2, cx), r2), zero, _CMP_GE_OQ)));
+                if(_mm256_movemask_ps(inside) == 0){
+                    continue;
+                }
+                __m256 current = _mm256_loadu_ps(row + x);
+                __m256 nearer = _mm256_min_ps(current, _mm256_add_ps(_mm256_mul_ps(az, cx), rz));
+                _mm256_storeu_ps(row + x, _mm256_blendv_ps(current, nearer, inside));
+            }
+        }
+    }
+#endif
+}
+
+SoftwareOcclusion::SoftwareOcclusion(JobSystem& job_system) : jobs(job_system), used_kernel(bestKernel()),
+    depth_buffer(size_t(WIDTH) * HEIGHT, 1.0f), tile_farthest((WIDTH / TILE_SIZE) * (HEIGHT / TILE_SIZE), 1.0f) {}
+
+uint32_t SoftwareOcclusion::addOccluder(std::vector<glm::vec3> positions, std::vector<uint32_t> indices){
+    Occluder occluder;
+    occluder.positions = std::move(positions);
+    occluder.indices = std::move(indices);
+    occluders.push_back(std::move(occluder));
+    return static_cast<uint32_t>(occluders.size() - 1);
+}
+
+void SoftwareOcclusion::clearOccluders(){
+    occluders.clear();
+    triangles.clear();
+}
+
+size_t SoftwareOcclusion::occluderCount() const {
+    return occluders.size();
+}
+
+void SoftwareOcclusion::setKernel(Kernel used){
+    //never wider than what the CPU runs
+    used_kernel = std::min(used, bestKernel());
+}
+
+SoftwareOcclusion::Kernel SoftwareOcclusion::kernel() const {
+    return used_kernel;
+}
+
+SoftwareOcclusion::Kernel SoftwareOcclusion::bestKernel(){
+#ifdef DOMK_RASTER_X86
+    static const bool avx2 = hasAvx2();
+    return avx2 ? Kernel::Avx2 : Kernel::Sse2;
+#else
+    return Kernel::Scalar;
+#endif
+}
+
+const char* SoftwareOcclusion::kernelName(Kernel named){
+    switch(named){
+        case Kernel::Avx2: return "AVX2";
+        case Kernel::Sse2: return "SSE2";
+        default: return "scalar";
+    }
+}
+
+/*
+    Sets up the triangles of every occluder on the job threads, then fills the tiles. A tile job walks
+    all triangles and only draws the part inside its tile, so no two jobs write the same pixel.
+*/
+void SoftwareOcclusion::rasterize(const glm::mat4& frame_view_proj, std::span<const glm::mat4> models){
+    auto start = std::chrono::steady_clock::now();
+    view_proj = frame_view_proj;
+
+    triangles.resize(occluders.size());
+    jobs.parallelFor(static_cast<uint32_t>(occluders.size()), [this, models](uint32_t occluder){
+        glm::mat4 model = occluder < models.size() ? models[occluder] : glm::mat4(1.0f);
+        setupTriangles(occluder, view_proj * model);
+    });
+
+    jobs.parallelFor(static_cast<uint32_t>(tile_farthest.size()), [this](uint32_t tile){
+        rasterizeTile(tile);
+    });
+
+    last_stats.occluders = static_cast<uint32_t>(occluders.size());
+    last_stats.triangles = 0;
+    for(const std::vector<ScreenTriangle>& list : triangles){
+        last_stats.triangles += static_cast<uint32_t>(list.size());
+    }
+    last_stats.raster_ms = elapsedMs(start);
+}
+
+//Transforms the occluder, drops triangles outside a frustum plane and clips the rest against the near plane.
+void SoftwareOcclusion::setupTriangles(uint32_t index, const glm::mat4& mvp){
+    Occluder& occluder = occluders[index];
+    std::vector<ScreenTriangle>& out = triangles[index];
+    out.clear();
+
+    occluder.clip.resize(occluder.positions.size());
+    for(size_t i = 0; i < occluder.positions.size(); i++){
+        occluder.clip[i] = mvp * glm::vec4(occluder.positions[i], 1.0f);
+    }
+
+    for(size_t i = 0; i + 2 < occluder.indices.size(); i += 3){
+        const uint32_t* corner = occluder.indices.data() + i;
+        if(corner[0] >= occluder.clip.size() || corner[1] >= occluder.clip.size() || corner[2] >= occluder.clip.size()){
+            continue;
+        }
+        const glm::vec4& p0 = occluder.clip[corner[0]];
+        const glm::vec4& p1 = occluder.clip[corner[1]];
+        const glm::vec4& p2 = occluder.clip[corner[2]];
+
+        if((p0.x < -p0.w && p1.x < -p1.w && p2.x < -p2.w) || (p0.x > p0.w && p1.x > p1.w && p2.x > p2.w)
+            || (p0.y < -p0.w && p1.y < -p1.w && p2.y < -p2.w) || (p0.y > p0.w && p1.y > p1.w && p2.y > p2.w)
+            || (p0.z < 0.0f && p1.z < 0.0f && p2.z < 0.0f) || (p0.z > p0.w && p1.z > p1.w && p2.z > p2.w)){
+            continue;
+        }
+
+        if(p0.z >= 0.0f && p1.z >= 0.0f && p2.z >= 0.0f){
+            addTriangle(p0, p1, p2, out);
+            continue;
+        }
+
+        //one or two corners in front of the near plane, what's left is a triangle or a quad
+        const glm::vec4 in[3] = {p0, p1, p2};
+        glm::vec4 polygon[4];
+        int count = 0;
+        for(int k = 0; k < 3; k++){
+            const glm::vec4& a = in[k];
+            const glm::vec4& b = in[(k + 1) % 3];
+            if(a.z >= 0.0f){
+                polygon[count++] = a;
+            }
+            if((a.z >= 0.0f) != (b.z >= 0.0f)){
+                polygon[count++] = a + (b - a) * (a.z / (a.z - b.z));
+            }
+        }
+        for(int k = 1; k + 1 < count; k++){
+            addTriangle(polygon[0], polygon[k], polygon[k + 1], out);
+        }
+    }
+}
+
+//Projects a clipped triangle to pixels, either winding, and sets up its edge and depth planes.
+void SoftwareOcclusion::addTriangle(const glm::vec4& p0, const glm::vec4& p1, const glm::vec4& p2, std::vector<ScreenTriangle>& out){
+    if(p0.w <= 0.0f || p1.w <= 0.0f || p2.w <= 0.0f){
+        return;
+    }
+
+    float x[3];
+    float y[3];
+    float z[3];
+    const glm::vec4* corners[3] = {&p0, &p1, &p2};
+    for(int k = 0; k < 3; k++){
+        const glm::vec4& p = *corners[k];
+        x[k] = (p.x / p.w * 0.5f + 0.5f) * WIDTH;
+        y[k] = (p.y / p.w * 0.5f + 0.5f) * HEIGHT;
+        z[k] = p.z / p.w;
+    }
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if(std::abs(area) < 1e-6f){
+        return;
+    }
+
+    ScreenTriangle tri;
+    tri.min_x = std::max(0, static_cast<int32_t>(std::floor(std::min({x[0], x[1], x[2]}))));
+    tri.min_y = std::max(0, static_cast<int32_t>(std::floor(std::min({y[0], y[1], y[2]}))));
+    tri.max_x = std::min(static_cast<int32_t>(WIDTH), static_cast<int32_t>(std::ceil(std::max({x[0], x[1], x[2]}))));
+    tri.max_y = std::min(static_cast<int32_t>(HEIGHT), static_cast<int32_t>(std::ceil(std::max({y[0], y[1], y[2]}))));
+    if(tri.min_x >= tri.max_x || tri.min_y >= tri.max_y){
+        return;
+    }
+
+    //edge k runs from corner k to the next one, positive on the side of the third corner
+    float sign = area > 0.0f ? 1.0f : -1.0f;
+    for(int k = 0; k < 3; k++){
+        int next = (k + 1) % 3;
+        tri.edge_a[k] = sign * (y[k] - y[next]);
+        tri.edge_b[k] = sign * (x[next] - x[k]);
+        tri.edge_c[k] = sign * (x[k] * y[next] - x[next] * y[k]);
+    }
+
+    tri.depth_a = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+    tri.depth_b = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+    tri.depth_c = z[0] - tri.depth_a * x[0] - tri.depth_b * y[0];
+
+    out.push_back(tri);
+}
+
+void SoftwareOcclusion::rasterizeTile(uint32_t tile){
+    const int32_t tiles_x = WIDTH / TILE_SIZE;
+    const int32_t tile_x = (tile % tiles_x) * TILE_SIZE;
+    const int32_t tile_y = (tile / tiles_x) * TILE_SIZE;
+    float* depth = depth_buffer.data();
+
+    for(int32_t y = tile_y; y < tile_y + int32_t(TILE_SIZE); y++){
+        std::fill_n(depth + size_t(y) * WIDTH + tile_x, TILE_SIZE, 1.0f);
+    }
+
+    for(const std::vector<ScreenTriangle>& list : triangles){
+        for(const ScreenTriangle& tri : list){
+            int32_t x0 = std::max(tri.min_x, tile_x);
+            int32_t x1 = std::min(tri.max_x, tile_x + int32_t(TILE_SIZE));
+            int32_t y0 = std::max(tri.min_y, tile_y);
+            int32_t y1 = std::min(tri.max_y, tile_y + int32_t(TILE_SIZE));
+            if(x0 >= x1 || y0 >= y1){
+                continue;
+            }
+
+            switch(used_kernel){
+#ifdef DOMK_RASTER_X86
+                case Kernel::Avx2: fillAvx2(tri, x0, x1, y0, y1, depth); break;
+                case Kernel::Sse2: fillSse2(tri, x0, x1, y0, y1, depth); break;
+#endif
+                default: fillScalar(tri, x0, x1, y0, y1, depth); break;
+            }
+        }
+    }
+
+    float farthest = 0.0f;
+    for(int32_t y = tile_y; y < tile_y + int32_t(TILE_SIZE); y++){
+        const float* row = depth + size_t(y) * WIDTH + tile_x;
+        farthest = std::max(farthest, *std::max_element(row, row + TILE_SIZE));
+    }
+    tile_farthest[tile] = farthest;
+}
+
+void SoftwareOcclusion::test(std::span<const Box> boxes, uint8_t* visible){
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<uint32_t> frustum_culled{0};
+    std::atomic<uint32_t> occluded{0};
+
+    uint32_t count = static_cast<uint32_t>(boxes.size());
+    jobs.parallelFor((count + TEST_CHUNK - 1) / TEST_CHUNK, [&](uint32_t chunk){
+        uint32_t end = std::min(count, (chunk + 1) * TEST_CHUNK);
+        uint32_t chunk_frustum = 0;
+        uint32_t chunk_hidden = 0;
+        for(uint32_t i = chunk * TEST_CHUNK; i < end; i++){
+            uint32_t before = chunk_frustum;
+            bool shown = testBox(boxes[i], chunk_frustum);
+            visible[i] = shown ? 1 : 0;
+            chunk_hidden += !shown && before == chunk_frustum ? 1 : 0;
+        }
+        frustum_culled += chunk_frustum;
+        occluded += chunk_hidden;
+    });
+
+    last_stats.objects = count;
+    last_stats.frustum_culled = frustum_culled;
+    last_stats.occluded = occluded;
+    last_stats.test_ms = elapsedMs(start);
+}
+
+/*
+    Projects the 8 corners like cull.comp does. A box reaching in front of the near plane is always visible,
+    anything else is hidden when the buffer is nearer than its nearest corner at every pixel its rectangle touches.
+*/
+bool SoftwareOcclusion::testBox(const Box& box, uint32_t& frustum_culled) const {
+    glm::mat4 mvp = view_proj * box.model;
+    const glm::vec3& lo = box.bounds_min;
+    const glm::vec3& hi = box.bounds_max;
+
+    //corners outside -x, +x, -y, +y, near and far
+    uint32_t outside[6] = {};
+    bool crosses_near = false;
+    glm::vec2 rect_min(std::numeric_limits<float>::max());
+    glm::vec2 rect_max(std::numeric_limits<float>::lowest());
+    float nearest = 1.0f;
+
+    for(uint32_t i = 0; i < 8; i++){
+        glm::vec4 clip = mvp * glm::vec4((i & 1) ? hi.x : lo.x, (i & 2) ? hi.y : lo.y, (i & 4) ? hi.z : lo.z, 1.0f);
+        outside[0] += clip.x < -clip.w;
+        outside[1] += clip.x > clip.w;
+        outside[2] += clip.y < -clip.w;
+        outside[3] += clip.y > clip.w;
+        outside[4] += clip.z < 0.0f;
+        outside[5] += clip.z > clip.w;
+
+        if(clip.z < 0.0f || clip.w <= 0.0f){
+            crosses_near = true;
+            continue;
+        }
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        glm::vec2 pixel((ndc.x * 0.5f + 0.5f) * WIDTH, (ndc.y * 0.5f + 0.5f) * HEIGHT);
+        rect_min = glm::min(rect_min, pixel);
+        rect_max = glm::max(rect_max, pixel);
+        nearest = std::min(nearest, ndc.z);
+    }
+
+    for(uint32_t count : outside){
+        if(count == 8){
+            frustum_culled++;
+            return false;
+        }
+    }
+    if(crosses_near){
+        return true;
+    }
+
+    int32_t x0 = std::max(0, static_cast<int32_t>(std::floor(rect_min.x)));
+    int32_t y0 = std::max(0, static_cast<int32_t>(std::floor(rect_min.y)));
+    int32_t x1 = std::min(static_cast<int32_t>(WIDTH), static_cast<int32_t>(std::ceil(rect_max.x)));
+    int32_t y1 = std::min(static_cast<int32_t>(HEIGHT), static_cast<int32_t>(std::ceil(rect_max.y)));
+    if(x0 >= x1 || y0 >= y1){
+        //in no plane's outside, but the projection misses the screen
+        frustum_culled++;
+        return false;
+    }
+
+    const int32_t tiles_x = WIDTH / TILE_SIZE;
+    for(int32_t tile_y = y0 / TILE_SIZE; tile_y <= (y1 - 1) / int32_t(TILE_SIZE); tile_y++){
+        for(int32_t tile_x = x0 / TILE_SIZE; tile_x <= (x1 - 1) / int32_t(TILE_SIZE); tile_x++){
+            if(nearest > tile_farthest[tile_y * tiles_x + tile_x]){
+                continue;
+            }
+            int32_t row_end = std::min(y1, (tile_y + 1) * int32_t(TILE_SIZE));
+            int32_t column_begin = std::max(x0, tile_x * int32_t(TILE_SIZE));
+            int32_t column_end = std::min(x1, (tile_x + 1) * int32_t(TILE_SIZE));
+            for(int32_t y = std::max(y0, tile_y * int32_t(TILE_SIZE)); y < row_end; y++){
+                const float* row = depth_buffer.data() + size_t(y) * WIDTH;
+                for(int32_t x = column_begin; x < column_end; x++){
+                    if(row[x] >= nearest){
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+const SoftwareOcclusion::Stats& SoftwareOcclusion::stats() const {
+    return last_stats;
+}
+
+const float* SoftwareOcclusion::depth() const {
+    return depth_buffer.data();
+}
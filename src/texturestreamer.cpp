@@ -0,0 +1,633 @@
+#include "texturestreamer.hpp"
+#include "file.hpp"
+#include "imagedecoder.hpp"
+#include "immediatecommands.hpp"
+#include "package.hpp"
+#include "pixelformat.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+void TextureStreamer::setup(const Context& context, uint32_t max_textures, VkDeviceSize budget){
+    ctx = context;
+    capacity = max_textures;
+    configured_budget = budget;
+
+    VkCommandPoolCreateInfo pool_ci{};
+    pool_ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_ci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_ci.queueFamilyIndex = ctx.queue_family;
+    if(vkCreateCommandPool(ctx.device, &pool_ci, nullptr, &pool) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create texture streaming command pool.");
+    }
+
+    //one slice per frame in flight for both: the CPU writes a TextureInfo slice and reads a feedback slice
+    //only once the frame that used it finished
+    VkDeviceSize alignment = ctx.device_info->limits().minStorageBufferOffsetAlignment;
+    info_stride = (sizeof(TextureInfo) * capacity + alignment - 1) / alignment * alignment;
+    createHostBuffer(info_stride * ctx.frames_in_flight, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false,
+        "texture infos", info_buffer, info_memory, reinterpret_cast<void**>(&minfo));
+    infos.assign(capacity, TextureInfo{});
+    info_version = 0;
+    info_slice_versions.assign(ctx.frames_in_flight, 0);
+
+    feedback_stride = (sizeof(uint32_t) * capacity + alignment - 1) / alignment * alignment;
+
+    createHostBuffer(feedback_stride * ctx.frames_in_flight, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true,
+        "texture feedback", feedback_buffer, feedback_memory, reinterpret_cast<void**>(&mfeedback));
+    memset(mfeedback, 0xFF, feedback_stride * ctx.frames_in_flight);
+
+    budget_bytes = queryBudget();
+}
+
+void TextureStreamer::destroy(){
+    //queued by add() but never flushed, nothing was submitted
+    for(Upload& upload : added){
+        release(upload.residency);
+        ctx.tracker->destroyBuffer(upload.staging);
+        ctx.tracker->freeMemory(upload.staging_memory);
+    }
+    added.clear();
+    for(Upload& upload : uploads){
+        vkWaitForFences(ctx.device, 1, &upload.fence, VK_TRUE, UINT64_MAX);
+        release(upload.residency);
+        ctx.tracker->destroyBuffer(upload.staging);
+        ctx.tracker->freeMemory(upload.staging_memory);
+        vkDestroyFence(ctx.device, upload.fence, nullptr);
+    }
+    for(Texture& texture : textures){
+        release(texture.resident);
+    }
+    uploads.clear();
+    textures.clear();
+
+    ctx.tracker->destroyBuffer(info_buffer);
+    ctx.tracker->freeMemory(info_memory);
+    ctx.tracker->destroyBuffer(feedback_buffer);
+    ctx.tracker->freeMemory(feedback_memory);
+    vkDestroyCommandPool(ctx.device, pool, nullptr);
+}
+
+//Feedback is read back by the CPU, so it prefers cached memory. Everything else is written once and read by the GPU.
+void TextureStreamer::createHostBuffer(VkDeviceSize size, VkBufferUsageFlags usage, bool readback, const char* tag, VkBuffer& buffer,
+    VkDeviceMemory& memory, void** mapped){
+    VkBufferCreateInfo bci{};
+    bci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bci.size = size;
+    bci.usage = usage;
+    bci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if(ctx.tracker->createBuffer(bci, buffer, tag) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create texture streaming buffer.");
+    }
+
+    VkMemoryRequirements reqs;
+    vkGetBufferMemoryRequirements(ctx.device, buffer, &reqs);
+
+    VkMemoryPropertyFlags host = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    uint32_t type = UINT32_MAX;
+    if(readback){
+        type = ctx.find_memory_type(reqs.memoryTypeBits, host | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    }
+    if(type == UINT32_MAX){
+        type = ctx.find_memory_type(reqs.memoryTypeBits, host);
+    }
+    if(type == UINT32_MAX){
+        throw std::runtime_error("No host visible memory type for texture streaming.");
+    }
+
+    VkMemoryAllocateInfo alloci{};
+    alloci.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloci.allocationSize = reqs.size;
+    alloci.memoryTypeIndex = type;
+    if(ctx.tracker->allocateMemory(alloci, memory, tag) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't allocate texture streaming buffer memory.");
+    }
+
+    vkBindBufferMemory(ctx.device, buffer, memory, 0);
+    vkMapMemory(ctx.device, memory, 0, size, 0, mapped);
+}
+
+TextureStreamer::TextureId TextureStreamer::add(const std::string& path){
+    MappedFile file(path);
+    return add(path, file.bytes());
+}
+
+TextureStreamer::TextureId TextureStreamer::add(const std::string& path, std::span<const std::byte> encoded){
+    return add(decode(path, encoded));
+}
+
+TextureStreamer::TextureId TextureStreamer::add(Decoded decoded){
+    if(textures.size() >= capacity){
+        throw std::runtime_error("Out of streamed texture slots.");
+    }
+
+    Texture texture{};
+    static_cast<Decoded&>(texture) = std::move(decoded);
+    texture.wanted_mip = texture.tail_mip;
+
+    TextureId id = static_cast<TextureId>(textures.size());
+    textures.push_back(std::move(texture));
+
+    //recorded into the shared batch rather than submitted, flush() waits once for all of them
+    Upload upload{};
+    std::vector<VkBufferImageCopy> regions;
+    if(!prepare(id, textures[id].tail_mip, upload, regions)){
+        throw std::runtime_error("Couldn't make texture " + textures[id].path + " resident.");
+    }
+    uint32_t levels = static_cast<uint32_t>(regions.size());
+    ctx.immediate->transition(upload.residency.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levels);
+    ctx.immediate->copyBufferToImage(upload.staging, upload.residency.image, regions);
+    ctx.immediate->transition(upload.residency.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, levels);
+
+    textures[id].pending = true;
+    added.push_back(upload);
+    return id;
+}
+
+/*
+    The TextureInfo entry of a new texture has nothing to point at until its tail is published, so the
+    tails add() queued are waited for here, all in the one submission. It runs at load time, replace()
+    keeps the old image sampled instead.
+*/
+void TextureStreamer::flush(){
+    if(added.empty()){
+        return;
+    }
+    ctx.immediate->flush();
+    //no command buffer or fence of their own, complete() skips the null handles
+    for(Upload& upload : added){
+        complete(upload);
+    }
+    added.clear();
+}
+
+TextureStreamer::Decoded TextureStreamer::decode(const std::string& path, std::span<const std::byte> encoded) const {
+    Decoded texture{};
+    texture.path = path;
+
+    //cooked textures already hold their mip chain in this layout, they're only copied
+    if(const package::TextureHeader* cooked = package::textureHeader(encoded)){
+        texture.width = cooked->width;
+        texture.height = cooked->height;
+        texture.mip_count = cooked->mip_count;
+        package::mipLayout(texture.width, texture.height, texture.mip_offsets);
+        const uint8_t* pixels = reinterpret_cast<const uint8_t*>(encoded.data() + cooked->pixels_offset);
+        texture.pixels.assign(pixels, pixels + cooked->pixels_size);
+        texture.tail_mip = tailMip(texture);
+        return texture;
+    }
+
+    ImageDecoder::Image image{};
+    image.path = path;
+    if(!ImageDecoder::probe(encoded, image)){
+        throw std::runtime_error("Failed to load texture " + path + "!");
+    }
+
+    texture.width = image.width;
+    texture.height = image.height;
+    texture.pixels.resize(package::mipLayout(texture.width, texture.height, texture.mip_offsets));
+    texture.mip_count = static_cast<uint32_t>(texture.mip_offsets.size());
+    ImageDecoder::decodeInto(encoded, image, texture.pixels.data(), false);
+
+    buildMips(texture);
+    texture.tail_mip = tailMip(texture);
+    return texture;
+}
+
+/*
+    An upload still in flight was built from the old pixels, publishing it after the new tail would put
+    the old image back. It is marked discarded instead of waited for, update() frees it once its fence
+    signalled. The new tail is submitted without waiting either; frames keep sampling the old image until
+    update() publishes the tail, which hands the old image to ctx.retire like any residency change, so it
+    goes once no frame in flight can reference it. Nothing here waits on the GPU.
+*/
+void TextureStreamer::replace(TextureId id, Decoded decoded){
+    for(std::vector<Upload>* queue : {&added, &uploads}){
+        for(Upload& upload : *queue){
+            if(upload.texture == id){
+                upload.discarded = true;
+            }
+        }
+    }
+
+    Texture& texture = textures[id];
+    static_cast<Decoded&>(texture) = std::move(decoded);
+    texture.wanted_mip = texture.tail_mip;
+    makeTailResident(id);
+}
+
+TextureStreamer::TextureId TextureStreamer::find(const std::string& path) const {
+    std::filesystem::path wanted = std::filesystem::path(path).lexically_normal();
+    for(TextureId id = 0; id < textures.size(); id++){
+        if(std::filesystem::path(textures[id].path).lexically_normal() == wanted){
+            return id;
+        }
+    }
+    return UINT32_MAX;
+}
+
+//Submits the tail without waiting, update() publishes it once its fence signalled.
+void TextureStreamer::makeTailResident(TextureId id){
+    if(!schedule(id, textures[id].tail_mip)){
+        throw std::runtime_error("Couldn't make texture " + textures[id].path + " resident.");
+    }
+}
+
+void TextureStreamer::buildMips(Decoded& texture) const {
+    for(uint32_t mip = 1; mip < texture.mip_count; mip++){
+        pixelformat::downsampleRgba(texture.pixels.data() + texture.mip_offsets[mip - 1],
+            std::max(texture.width >> (mip - 1), 1u), std::max(texture.height >> (mip - 1), 1u),
+            texture.pixels.data() + texture.mip_offsets[mip]);
+    }
+}
+
+//first mip no larger than TAIL_SIZE, always resident
+uint32_t TextureStreamer::tailMip(const Decoded& texture) const {
+    uint32_t tail = 0;
+    while(tail + 1 < texture.mip_count && std::max(texture.width >> tail, texture.height >> tail) > TAIL_SIZE){
+        tail++;
+    }
+    return tail;
+}
+
+VkDeviceSize TextureStreamer::mipBytes(const Texture& texture, uint32_t base_mip) const {
+    return texture.pixels.size() - texture.mip_offsets[base_mip];
+}
+
+/*
+    Creates an image holding mips [base_mip, mip_count) and a staging buffer filled with them, and fills
+    regions with the copies between the two. Returns false if the device is out of memory.
+*/
+bool TextureStreamer::prepare(TextureId id, uint32_t base_mip, Upload& upload, std::vector<VkBufferImageCopy>& regions){
+    Texture& texture = textures[id];
+    uint32_t levels = texture.mip_count - base_mip;
+
+    upload.texture = id;
+    upload.residency.base_mip = base_mip;
+
+    VkImageCreateInfo ici{};
+    ici.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    ici.imageType = VK_IMAGE_TYPE_2D;
+    ici.format = VK_FORMAT_R8G8B8A8_SRGB;
+    ici.extent = {std::max(texture.width >> base_mip, 1u), std::max(texture.height >> base_mip, 1u), 1};
+    ici.mipLevels = levels;
+    ici.arrayLayers = 1;
+    ici.samples = VK_SAMPLE_COUNT_1_BIT;
+    ici.tiling = VK_IMAGE_TILING_OPTIMAL;
+    ici.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    ici.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    ici.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if(ctx.tracker->createImage(ici, upload.residency.image, "streamed texture") != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create streamed image for " + texture.path + ".");
+    }
+
+    VkMemoryRequirements reqs;
+    vkGetImageMemoryRequirements(ctx.device, upload.residency.image, &reqs);
+
+    VkMemoryAllocateInfo alloci{};
+    alloci.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloci.allocationSize = reqs.size;
+    alloci.memoryTypeIndex = ctx.find_memory_type(reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if(alloci.memoryTypeIndex == UINT32_MAX
+        || ctx.tracker->allocateMemory(alloci, upload.residency.memory, "streamed texture") != VK_SUCCESS){
+        ctx.tracker->destroyImage(upload.residency.image);
+        return false;
+    }
+    upload.residency.size = reqs.size;
+    vkBindImageMemory(ctx.device, upload.residency.image, upload.residency.memory, 0);
+
+    VkImageViewCreateInfo vci{};
+    vci.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    vci.image = upload.residency.image;
+    vci.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    vci.format = ici.format;
+    vci.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    vci.subresourceRange.levelCount = levels;
+    vci.subresourceRange.layerCount = 1;
+    if(vkCreateImageView(ctx.device, &vci, nullptr, &upload.residency.view) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't create streamed image view for " + texture.path + ".");
+    }
+
+    VkDeviceSize bytes = mipBytes(texture, base_mip);
+    void* mapped;
+    createHostBuffer(bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, false, "texture streaming staging", upload.staging, upload.staging_memory, &mapped);
+    memcpy(mapped, texture.pixels.data() + texture.mip_offsets[base_mip], bytes);
+    vkUnmapMemory(ctx.device, upload.staging_memory);
+
+    regions.assign(levels, VkBufferImageCopy{});
+    for(uint32_t level = 0; level < levels; level++){
+        uint32_t mip = base_mip + level;
+        regions[level].bufferOffset = texture.mip_offsets[mip] - texture.mip_offsets[base_mip];
+        regions[level].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        regions[level].imageSubresource.mipLevel = level;
+        regions[level].imageSubresource.layerCount = 1;
+        regions[level].imageExtent = {std::max(texture.width >> mip, 1u), std::max(texture.height >> mip, 1u), 1};
+    }
+    return true;
+}
+
+/*
+    Submits the upload of mips [base_mip, mip_count) into a new image without waiting.
+    The texture keeps sampling its current image until publish() swaps the new one in.
+    Returns false if the device is out of memory, the texture then simply stays as it is.
+*/
+bool TextureStreamer::schedule(TextureId id, uint32_t base_mip){
+    Upload upload{};
+    std::vector<VkBufferImageCopy> regions;
+    if(!prepare(id, base_mip, upload, regions)){
+        return false;
+    }
+    uint32_t levels = static_cast<uint32_t>(regions.size());
+
+    VkCommandBufferAllocateInfo ai{};
+    ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    ai.commandPool = pool;
+    ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    ai.commandBufferCount = 1;
+    vkAllocateCommandBuffers(ctx.device, &ai, &upload.commands);
+
+    VkCommandBufferBeginInfo bi{};
+    bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(upload.commands, &bi);
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = upload.residency.image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = levels;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(upload.commands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    vkCmdCopyBufferToImage(upload.commands, upload.staging, upload.residency.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        levels, regions.data());
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(upload.commands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    vkEndCommandBuffer(upload.commands);
+
+    VkFenceCreateInfo fci{};
+    fci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    vkCreateFence(ctx.device, &fci, nullptr, &upload.fence);
+
+    VkSubmitInfo si{};
+    si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    si.commandBufferCount = 1;
+    si.pCommandBuffers = &upload.commands;
+    if(vkQueueSubmit(ctx.queue, 1, &si, upload.fence) != VK_SUCCESS){
+        throw std::runtime_error("Couldn't submit texture upload.");
+    }
+
+    textures[id].pending = true;
+    uploads.push_back(upload);
+    return true;
+}
+
+/*
+    Points the texture at its freshly uploaded image. Only the CPU copy of the table changes here, frames in
+    flight keep reading their slices with the old slot, whose image is retired and released once none can.
+    The new slot came back from a released image, so no pending frame uses its descriptor either.
+*/
+void TextureStreamer::publish(Upload& upload){
+    Texture& texture = textures[upload.texture];
+
+    upload.residency.slot = ctx.register_texture(upload.residency.view);
+    infos[upload.texture] = {upload.residency.slot, static_cast<float>(upload.residency.base_mip)};
+    info_version++;
+    resident_bytes += upload.residency.size;
+
+    if(texture.resident.image != VK_NULL_HANDLE){
+        ctx.retire([this, old = texture.resident]() mutable { release(old); });
+    }
+    texture.resident = upload.residency;
+    texture.pending = false;
+}
+
+//For an upload whose fence signalled. A discarded one was never published, no frame can use its image.
+void TextureStreamer::complete(Upload& upload){
+    if(upload.discarded){
+        release(upload.residency);
+    } else {
+        publish(upload);
+    }
+
+    vkFreeCommandBuffers(ctx.device, pool, 1, &upload.commands);
+    ctx.tracker->destroyBuffer(upload.staging);
+    ctx.tracker->freeMemory(upload.staging_memory);
+    vkDestroyFence(ctx.device, upload.fence, nullptr);
+}
+
+void TextureStreamer::release(Residency& residency){
+    if(residency.slot != UINT32_MAX){
+        ctx.release_texture(residency.slot);
+        resident_bytes -= residency.size;
+    }
+    vkDestroyImageView(ctx.device, residency.view, nullptr);
+    ctx.tracker->destroyImage(residency.image);
+    ctx.tracker->freeMemory(residency.memory);
+    residency = Residency{};
+}
+
+/*
+    Device local memory the streamer may occupy: the configured budget, clamped to what VK_EXT_memory_budget
+    says is left (plus what the streamer already holds). Without either, half of the largest device local heap.
+*/
+VkDeviceSize TextureStreamer::queryBudget() const {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT heap_budget{};
+    heap_budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    VkPhysicalDeviceMemoryProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    properties.pNext = ctx.memory_budget ? &heap_budget : nullptr;
+    vkGetPhysicalDeviceMemoryProperties2(ctx.device_info->physicalDevice(), &properties);
+
+    const VkPhysicalDeviceMemoryProperties& memory = properties.memoryProperties;
+    if(!ctx.memory_budget){
+        if(configured_budget != 0){
+            return configured_budget;
+        }
+        VkDeviceSize largest = 0;
+        for(uint32_t heap = 0; heap < memory.memoryHeapCount; heap++){
+            if(memory.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT){
+                largest = std::max(largest, memory.memoryHeaps[heap].size);
+            }
+        }
+        return largest / 2;
+    }
+
+    VkDeviceSize available = resident_bytes;
+    for(uint32_t heap = 0; heap < memory.memoryHeapCount; heap++){
+        if((memory.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+            && heap_budget.heapBudget[heap] > heap_budget.heapUsage[heap]){
+            available += heap_budget.heapBudget[heap] - heap_budget.heapUsage[heap];
+        }
+    }
+    return configured_budget != 0 ? std::min(configured_budget, available) : available;
+}
+
+/*
+    1. publishes finished uploads, retiring the images they replace, and frees the ones replace() discarded
+    2. folds this frame's feedback into wanted_mip / last_used and clears it for reuse
+    3. grows the most recently used textures one mip closer to what they want, shrinking
+       the least recently used (or over-resident) ones first when that would exceed the budget
+*/
+void TextureStreamer::update(uint32_t frame){
+    frame_counter++;
+
+    for(size_t i = 0; i < uploads.size();){
+        if(vkGetFenceStatus(ctx.device, uploads[i].fence) == VK_SUCCESS){
+            complete(uploads[i]);
+            uploads[i] = uploads.back();
+            uploads.pop_back();
+        } else {
+            i++;
+        }
+    }
+
+    //no frame in flight reads this frame's slice, the ones that do keep the entries they were recorded with
+    if(info_slice_versions[frame] != info_version){
+        memcpy(reinterpret_cast<char*>(minfo) + info_stride * frame, infos.data(), sizeof(TextureInfo) * textures.size());
+        info_slice_versions[frame] = info_version;
+    }
+
+    uint32_t* feedback = mfeedback + feedback_stride / sizeof(uint32_t) * frame;
+    candidates.clear();
+    for(TextureId id = 0; id < textures.size(); id++){
+        Texture& texture = textures[id];
+        if(feedback[id] != UINT32_MAX){
+            texture.last_used = frame_counter;
+            texture.wanted_mip = std::min(feedback[id], texture.tail_mip);
+        }
+        if(!texture.pending && texture.wanted_mip < texture.resident.base_mip){
+            candidates.push_back(id);
+        }
+    }
+    std::fill(feedback, feedback + textures.size(), UINT32_MAX);
+
+    if(candidates.empty()){
+        return;
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [this](TextureId a, TextureId b){
+        if(textures[a].last_used != textures[b].last_used){
+            return textures[a].last_used > textures[b].last_used;
+        }
+        return textures[a].resident.base_mip - textures[a].wanted_mip > textures[b].resident.base_mip - textures[b].wanted_mip;
+    });
+
+    budget_bytes = queryBudget();
+
+    //shrinks are counted as soon as they are scheduled, their memory comes back a few frames later.
+    //Allocation sizes rather than mipBytes: a replaced texture's resident image and discarded uploads
+    //belong to pixels it no longer has.
+    VkDeviceSize projected = resident_bytes;
+    for(const Upload& upload : uploads){
+        projected += upload.residency.size;
+        if(!upload.discarded){
+            projected -= std::min(projected, textures[upload.texture].resident.size);
+        }
+    }
+
+    VkDeviceSize uploaded = 0;
+    for(TextureId id : candidates){
+        Texture& texture = textures[id];
+        uint32_t target = texture.resident.base_mip - 1;
+        VkDeviceSize growth = mipBytes(texture, target) - mipBytes(texture, texture.resident.base_mip);
+
+        if(uploaded > 0 && uploaded + mipBytes(texture, target) > MAX_UPLOAD_BYTES_PER_FRAME){
+            break;
+        }
+
+        while(projected + growth > budget_bytes){
+            TextureId victim = UINT32_MAX;
+            for(TextureId other = 0; other < textures.size(); other++){
+                const Texture& candidate = textures[other];
+                bool over_resident = candidate.wanted_mip > candidate.resident.base_mip;
+                bool colder = candidate.last_used < texture.last_used && candidate.resident.base_mip < candidate.tail_mip;
+                if(other == id || candidate.pending || !(over_resident || colder)){
+                    continue;
+                }
+                if(victim == UINT32_MAX || candidate.last_used < textures[victim].last_used){
+                    victim = other;
+                }
+            }
+            if(victim == UINT32_MAX){
+                return;
+            }
+
+            Texture& evicted = textures[victim];
+            uint32_t shrink_to = evicted.last_used < texture.last_used ? evicted.tail_mip : evicted.wanted_mip;
+            VkDeviceSize savings = mipBytes(evicted, evicted.resident.base_mip) - mipBytes(evicted, shrink_to);
+            if(!schedule(victim, shrink_to)){
+                return;
+            }
+            projected -= std::min(projected, savings);
+            uploaded += mipBytes(evicted, shrink_to);
+        }
+
+        if(!schedule(id, target)){
+            return;
+        }
+        projected += growth;
+        uploaded += mipBytes(texture, target);
+    }
+}
+
+void TextureStreamer::setBudget(VkDeviceSize budget){
+    configured_budget = budget;
+}
+
+VkBuffer TextureStreamer::infoBuffer() const {
+    return info_buffer;
+}
+
+VkDeviceSize TextureStreamer::infoRange() const {
+    return sizeof(TextureInfo) * capacity;
+}
+
+uint32_t TextureStreamer::infoOffset(uint32_t frame) const {
+    return static_cast<uint32_t>(info_stride * frame);
+}
+
+VkBuffer TextureStreamer::feedbackBuffer() const {
+    return feedback_buffer;
+}
+
+VkDeviceSize TextureStreamer::feedbackRange() const {
+    return sizeof(uint32_t) * capacity;
+}
+
+uint32_t TextureStreamer::feedbackOffset(uint32_t frame) const {
+    return static_cast<uint32_t>(feedback_stride * frame);
+}
+
+size_t TextureStreamer::textureCount() const {
+    return textures.size();
+}
+
+size_t TextureStreamer::pendingUploads() const {
+    return uploads.size();
+}
+
+VkDeviceSize TextureStreamer::residentBytes() const {
+    return resident_bytes;
+}
+
+VkDeviceSize TextureStreamer::budgetBytes() const {
+    return budget_bytes;
+}
@@ -1,5 +1,29 @@
 #include "tree.hpp"
 
 Object* Tree::get_root(){
+    if(root == nullptr){
+        objects.push_back(std::make_unique<Object>());
+        root = objects.back().get();
+        root->set_name("root");
+    }
     return root;
-}
\ No newline at end of file
+}
+
+Object* Tree::create_object(Object* parent){
+    if(parent == nullptr){
+        parent = get_root();
+    }
+    objects.push_back(std::make_unique<Object>());
+    Object* object = objects.back().get();
+    parent->add_child(object);
+    return object;
+}
+
+size_t Tree::size(){
+    return objects.size();
+}
+
+void Tree::clear(){
+    objects.clear();
+    root = nullptr;
+}